@@ -54,9 +54,45 @@ DEFINE_int32(http_ui_port, 8080,
 #endif
 DEFINE_bool(populate_knowledge_base_from_file, false,
             "True if we should load the knowledge base from file.");
+DEFINE_uint64(heartbeat_threads, 4,
+              "Number of threads that apply the heartbeats received between "
+              "two iterations of the coordinator's main loop.");
 
 namespace firmament {
 
+// Minimum number of heartbeats for which we use another thread.
+static const uint64_t kMinHeartbeatsPerThread = 256;
+// Maximum number of applied heartbeats of each kind that we keep for reuse.
+static const uint64_t kMaxSpareHeartbeats = 16384;
+
+// Moves the contents of msg to the back of queue. If there is a spare message,
+// msg takes over its memory, so that the next message decoded into msg reuses
+// it instead of allocating.
+template <typename M>
+static void QueueMessage(M* msg, vector<M>* queue, vector<M>* spares) {
+  queue->push_back(M());
+  queue->back().Swap(msg);
+  if (!spares->empty()) {
+    msg->Swap(&spares->back());
+    spares->pop_back();
+  }
+}
+
+// Clears the messages of an applied batch and keeps them as spares. Cleared
+// messages hold on to their sub-messages and strings.
+template <typename M>
+static void RecycleMessages(vector<M>* batch, vector<M>* spares) {
+  for (auto& msg : *batch) {
+    if (spares->size() >= kMaxSpareHeartbeats) {
+      break;
+    }
+    msg.Clear();
+    spares->push_back(M());
+    spares->back().Swap(&msg);
+  }
+  batch->clear();
+}
+
 Coordinator::Coordinator()
   : Node(GenerateResourceID(
         boost::asio::ip::host_name() + "/" + FLAGS_listen_uri)),
@@ -68,8 +104,21 @@ Coordinator::Coordinator()
     object_store_(new store::SimpleObjectStore(uuid_)),
     parent_chan_(NULL),
     hostname_(boost::asio::ip::host_name()),
-    time_manager_(new WallTime) {
+    time_manager_(new WallTime),
+    heartbeat_io_service_(new boost::asio::io_service),
+    num_pending_partitions_(0) {
   trace_generator_ = new TraceGenerator(time_manager_);
+  // Start the heartbeat threads; the main loop's thread applies one partition
+  // of each batch itself.
+  if (FLAGS_heartbeat_threads > 1) {
+    heartbeat_io_service_work_.reset(
+        new boost::asio::io_service::work(*heartbeat_io_service_));
+    for (uint64_t i = 1; i < FLAGS_heartbeat_threads; ++i) {
+      heartbeat_threads_.create_thread(
+          boost::bind(&boost::asio::io_service::run,
+                      heartbeat_io_service_.get()));
+    }
+  }
   // Start up a coordinator according to the platform parameter
   string desc_name = hostname_;
   resource_desc_.set_uuid(to_string(uuid_));
@@ -129,6 +178,9 @@ Coordinator::Coordinator()
 }
 
 Coordinator::~Coordinator() {
+  heartbeat_io_service_work_.reset();
+  heartbeat_io_service_->stop();
+  heartbeat_threads_.join_all();
   delete trace_generator_;
   delete time_manager_;
   // TODO(malte): check destruction order in C++; c_http_ui_ may already
@@ -201,6 +253,64 @@ void Coordinator::AddResource(ResourceTopologyNodeDescriptor* rtnd,
   }
 }
 
+void Coordinator::ApplyHeartbeats(HeartbeatPartition* partition,
+                                  uint64_t timestamp) {
+  vector<const MachinePerfStatisticsSample*> machine_samples;
+  for (auto& msg : partition->heartbeats_) {
+    ResourceStatus* rsp =
+      FindPtrOrNull(*associated_resources_, ResourceIDFromString(msg->uuid()));
+    if (!rsp) {
+      LOG(WARNING) << "HEARTBEAT from UNKNOWN resource (uuid: "
+                   << msg->uuid() << ")!";
+      continue;
+    }
+    VLOG(1) << "HEARTBEAT from resource " << msg->uuid()
+            << " (last seen at " << rsp->last_heartbeat() << ")";
+    // Update timestamp
+    rsp->set_last_heartbeat(timestamp);
+    if (msg->has_load()) {
+      VLOG(2) << "Remote resource stats: " << msg->load().ShortDebugString();
+      machine_samples.push_back(&msg->load());
+    }
+  }
+  vector<const TaskPerfStatisticsSample*> task_samples;
+  for (auto& msg : partition->task_heartbeats_) {
+    TaskDescriptor* tdp = FindPtrOrNull(*task_table_, msg->task_id());
+    if (!tdp) {
+      LOG(WARNING) << "HEARTBEAT from UNKNOWN task (ID: "
+                   << msg->task_id() << ")!";
+      continue;
+    }
+    VLOG(1) << "HEARTBEAT from task " << msg->task_id();
+    // Remember the current location from which this task reports (compact
+    // heartbeats only carry it when it changed)
+    if (msg->has_location()) {
+      tdp->set_last_heartbeat_location(msg->location());
+    }
+    // Remember the heartbeat time
+    tdp->set_last_heartbeat_time(timestamp);
+    // The profiling information submitted by the task goes into the
+    // knowledge base
+    task_samples.push_back(&msg->stats());
+  }
+  // Record the resource and task statistics samples
+  if (!machine_samples.empty()) {
+    scheduler_->knowledge_base()->AddMachineSamples(machine_samples);
+  }
+  if (!task_samples.empty()) {
+    scheduler_->knowledge_base()->AddTaskSamples(task_samples);
+  }
+}
+
+void Coordinator::ApplyHeartbeatPartition(HeartbeatPartition* partition,
+                                          uint64_t timestamp) {
+  ApplyHeartbeats(partition, timestamp);
+  boost::lock_guard<boost::mutex> lock(heartbeat_partitions_lock_);
+  if (--num_pending_partitions_ == 0) {
+    heartbeat_partitions_done_.notify_one();
+  }
+}
+
 void Coordinator::Run() {
   // Test topology detection
   LOG(INFO) << "Detecting resource topology:";
@@ -249,6 +359,7 @@ void Coordinator::Run() {
     // itself might need to take, and how they can be triggered
     VLOG(3) << "Hello from main loop!";
     AwaitNextMessage();
+    ProcessPendingHeartbeats();
     // TODO(malte): wrap this in a timer
     cur_time = time_manager_->GetCurrentTimestamp();
     if (cur_time - last_heartbeat_time > FLAGS_heartbeat_interval) {
@@ -262,6 +373,8 @@ void Coordinator::Run() {
         SendHeartbeatToParent(stats);
       }
       last_heartbeat_time = cur_time;
+      VLOG(1) << "Received messages: "
+              << m_adapter_->message_stats()->GetStatsString();
     }
   }
 
@@ -308,24 +421,42 @@ bool Coordinator::HasJobCompleted(const JobDescriptor& jd) {
 void Coordinator::HandleIncomingMessage(BaseMessage *bm,
                                         const string& remote_endpoint) {
   uint32_t handled_extensions = 0;
+  // Resource and task heartbeats are queued, and the main loop applies them
+  // in batches. We take them out of the message rather than copying them, and
+  // hand the message the memory of a heartbeat from an earlier batch in
+  // return (the messaging adapter reuses the message for later receives).
+  if (bm->has_heartbeat() || bm->has_task_heartbeat() ||
+      bm->task_heartbeats_size() > 0) {
+    boost::lock_guard<boost::mutex> lock(pending_heartbeats_lock_);
+    if (bm->has_heartbeat()) {
+      QueueMessage(bm->mutable_heartbeat(), &pending_heartbeats_,
+                   &spare_heartbeats_);
+      bm->clear_heartbeat();
+      handled_extensions++;
+    }
+    if (bm->has_task_heartbeat()) {
+      QueueMessage(bm->mutable_task_heartbeat(), &pending_task_heartbeats_,
+                   &spare_task_heartbeats_);
+      bm->clear_task_heartbeat();
+      handled_extensions++;
+    }
+    // Batch of task heartbeats forwarded by a child coordinator
+    if (bm->task_heartbeats_size() > 0) {
+      for (int32_t i = 0; i < bm->task_heartbeats_size(); ++i) {
+        QueueMessage(bm->mutable_task_heartbeats(i), &pending_task_heartbeats_,
+                     &spare_task_heartbeats_);
+      }
+      bm->clear_task_heartbeats();
+      handled_extensions++;
+    }
+  }
+  boost::lock_guard<boost::mutex> lock(message_handler_lock_);
   // Registration message
   if (bm->has_registration()) {
     const RegistrationMessage& msg = bm->registration();
     HandleRegistrationRequest(msg);
     handled_extensions++;
   }
-  // Resource Heartbeat message
-  if (bm->has_heartbeat()) {
-    const HeartbeatMessage& msg = bm->heartbeat();
-    HandleHeartbeat(msg);
-    handled_extensions++;
-  }
-  // Task heartbeat message
-  if (bm->has_task_heartbeat()) {
-    const TaskHeartbeatMessage& msg = bm->task_heartbeat();
-    HandleTaskHeartbeat(msg);
-    handled_extensions++;
-  }
   // Task state change message
   if (bm->has_task_state()) {
     const TaskStateMessage& msg = bm->task_state();
@@ -432,25 +563,6 @@ void Coordinator::HandleCreateRequest(const CreateRequest& msg,
   m_adapter_->SendMessageToEndpoint(remote_endpoint, resp_msg);
 }
 
-void Coordinator::HandleHeartbeat(const HeartbeatMessage& msg) {
-  boost::uuids::string_generator gen;
-  boost::uuids::uuid uuid = gen(msg.uuid());
-  ResourceStatus* rsp = FindPtrOrNull(*associated_resources_, uuid);
-  if (!rsp) {
-      LOG(WARNING) << "HEARTBEAT from UNKNOWN resource (uuid: "
-              << msg.uuid() << ")!";
-  } else {
-      VLOG(1) << "HEARTBEAT from resource " << msg.uuid()
-              << " (last seen at " << rsp->last_heartbeat() << ")";
-      if (msg.has_load())
-        VLOG(2) << "Remote resource stats: " << msg.load().ShortDebugString();
-      // Update timestamp
-      rsp->set_last_heartbeat(time_manager_->GetCurrentTimestamp());
-      // Record resource statistics sample
-      scheduler_->knowledge_base()->AddMachineSample(msg.load());
-  }
-}
-
 void Coordinator::HandleIONotification(const BaseMessage& bm,
                                        const string& remote_uri) {
   if (bm.has_end_write_notification()) {
@@ -545,41 +657,6 @@ void Coordinator::HandleRegistrationRequest(
   }
 }
 
-void Coordinator::HandleTaskHeartbeat(const TaskHeartbeatMessage& msg) {
-  TaskID_t task_id = msg.task_id();
-  TaskDescriptor* tdp = FindPtrOrNull(*task_table_, task_id);
-  if (!tdp) {
-    LOG(WARNING) << "HEARTBEAT from UNKNOWN task (ID: "
-                 << task_id << ")!";
-  } else {
-    VLOG(1) << "HEARTBEAT from task " << task_id;
-    // Remember the current location from which this task reports
-    tdp->set_last_heartbeat_location(msg.location());
-    // Remember the heartbeat time
-    tdp->set_last_heartbeat_time(time_manager_->GetCurrentTimestamp());
-    // Process the profiling information submitted by the task, add it to
-    // the knowledge base
-    scheduler_->knowledge_base()->AddTaskSample(msg.stats());
-  }
-
-  // If we have a parent coordinator on whose behalf we are managing this task,
-  // forward the message.
-  // TODO(malte): this does not currently perform any aggregation, so we're
-  // likely to DoS the parent coordinator on a large deployment. Instead, we
-  // should only selectively forward heartbeats and aggregate them.
-  if (parent_chan_ != NULL) {
-    BaseMessage bm;
-    bm.mutable_task_heartbeat()->CopyFrom(msg);
-    if (!SendMessageToRemote(parent_chan_, &bm)) {
-      LOG(ERROR) << "Failed to forward heartbeat to parent coordinator!";
-      // Try to re-register
-      RegisterWithCoordinator(parent_chan_);
-    }
-  } else {
-    scheduler_->knowledge_base()->AddTaskSample(msg.stats());
-  }
-}
-
 void Coordinator::HandleTaskDelegationRequest(
     const TaskDelegationRequestMessage& msg,
     const string& remote_endpoint) {
@@ -693,6 +770,13 @@ void Coordinator::HandleTaskStateChange(
   TaskDescriptor* td_ptr = FindPtrOrNull(*task_table_, msg.id());
   CHECK(td_ptr) << "Received task state change message for task "
                 << msg.id();
+  if (msg.new_state() == TaskDescriptor::COMPLETED ||
+      msg.new_state() == TaskDescriptor::ABORTED ||
+      msg.new_state() == TaskDescriptor::FAILED) {
+    // The task sends no more heartbeats (also if the state change is
+    // spurious, as the task has finished before)
+    last_task_samples_.erase(msg.id());
+  }
   if (td_ptr->state() == TaskDescriptor::FAILED ||
       td_ptr->state() == TaskDescriptor::ABORTED) {
     LOG(ERROR) << "Spurious task state change: Task  " << msg.id() << " has "
@@ -923,6 +1007,108 @@ void Coordinator::AddJobsTasksToTables(TaskDescriptor* td, JobID_t job_id) {
   }
 }
 
+bool Coordinator::ExpandTaskHeartbeat(TaskHeartbeatMessage* msg) {
+  if (!msg->has_delta()) {
+    // Full heartbeat from a task that does not send compact heartbeats
+    return true;
+  }
+  if (!msg->delta()) {
+    // Full heartbeat that later deltas from the task are relative to
+    TaskPerfStatisticsSample* last_sample =
+      &last_task_samples_[msg->task_id()];
+    last_sample->CopyFrom(msg->stats());
+    msg->clear_delta();
+    return true;
+  }
+  TaskPerfStatisticsSample* last_sample =
+    FindOrNull(last_task_samples_, msg->task_id());
+  if (!last_sample) {
+    LOG(WARNING) << "Dropping compact heartbeat from task " << msg->task_id()
+                 << ", as we have not received a full heartbeat from it.";
+    return false;
+  }
+  // The delta only contains the fields that changed, which MergeFrom
+  // overwrites.
+  last_sample->MergeFrom(msg->stats());
+  msg->mutable_stats()->CopyFrom(*last_sample);
+  msg->clear_delta();
+  return true;
+}
+
+void Coordinator::ProcessPendingHeartbeats() {
+  {
+    boost::lock_guard<boost::mutex> lock(pending_heartbeats_lock_);
+    if (pending_heartbeats_.empty() && pending_task_heartbeats_.empty()) {
+      return;
+    }
+    heartbeats_.swap(pending_heartbeats_);
+    task_heartbeats_.swap(pending_task_heartbeats_);
+  }
+  boost::lock_guard<boost::mutex> handler_lock(message_handler_lock_);
+  uint64_t num_heartbeats = heartbeats_.size() + task_heartbeats_.size();
+  uint64_t num_threads =
+    max(static_cast<uint64_t>(1),
+        min(static_cast<uint64_t>(heartbeat_threads_.size() + 1),
+            num_heartbeats / kMinHeartbeatsPerThread));
+  // The heartbeats of a resource or a task always go to the same partition,
+  // so that no two threads update the same status or descriptor.
+  vector<HeartbeatPartition> partitions(num_threads);
+  boost::hash<string> uuid_hash;
+  for (auto& msg : heartbeats_) {
+    partitions[uuid_hash(msg.uuid()) % num_threads].heartbeats_.push_back(
+        &msg);
+  }
+  for (auto& msg : task_heartbeats_) {
+    if (!ExpandTaskHeartbeat(&msg)) {
+      msg.Clear();
+      continue;
+    }
+    partitions[msg.task_id() % num_threads].task_heartbeats_.push_back(&msg);
+  }
+  VLOG(2) << "Applying " << heartbeats_.size() << " resource and "
+          << task_heartbeats_.size() << " task heartbeats using "
+          << num_threads << " threads";
+  uint64_t timestamp = time_manager_->GetCurrentTimestamp();
+  // The calling thread applies the first partition, and the heartbeat threads
+  // the others.
+  num_pending_partitions_ = num_threads - 1;
+  for (uint64_t index = 1; index < num_threads; ++index) {
+    heartbeat_io_service_->post(
+        boost::bind(&Coordinator::ApplyHeartbeatPartition, this,
+                    &partitions[index], timestamp));
+  }
+  ApplyHeartbeats(&partitions[0], timestamp);
+  {
+    boost::unique_lock<boost::mutex> lock(heartbeat_partitions_lock_);
+    while (num_pending_partitions_ > 0) {
+      heartbeat_partitions_done_.wait(lock);
+    }
+  }
+  // If we have a parent coordinator on whose behalf we are managing the
+  // tasks, forward their heartbeats. All heartbeats of the batch go to the
+  // parent in a single message.
+  // TODO(malte): this does not currently perform any aggregation, so we're
+  // likely to DoS the parent coordinator on a large deployment. Instead, we
+  // should only selectively forward heartbeats and aggregate them.
+  if (parent_chan_ != NULL) {
+    BaseMessage bm;
+    for (auto& msg : task_heartbeats_) {
+      if (msg.has_task_id()) {
+        bm.add_task_heartbeats()->Swap(&msg);
+      }
+    }
+    if (bm.task_heartbeats_size() > 0 &&
+        !SendMessageToRemote(parent_chan_, &bm)) {
+      LOG(ERROR) << "Failed to forward heartbeats to parent coordinator!";
+      // Try to re-register
+      RegisterWithCoordinator(parent_chan_);
+    }
+  }
+  boost::lock_guard<boost::mutex> lock(pending_heartbeats_lock_);
+  RecycleMessages(&heartbeats_, &spare_heartbeats_);
+  RecycleMessages(&task_heartbeats_, &spare_task_heartbeats_);
+}
+
 void Coordinator::SendHeartbeatToParent(
     const MachinePerfStatisticsSample& stats) {
   BaseMessage bm;
@@ -1006,6 +1192,8 @@ void Coordinator::Shutdown(const string& reason) {
       c_http_ui_->Shutdown(false);
 #endif
   m_adapter_->StopListen();
+  LOG(INFO) << "Received messages: "
+            << m_adapter_->message_stats()->GetStatsString();
   VLOG(1) << "All connections shut down; now exiting...";
   // Toggling the exit flag will make the Coordinator drop out of its main loop.
   exit_ = true;
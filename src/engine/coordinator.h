@@ -15,6 +15,7 @@
 
 // XXX(malte): Think about the Boost dependency!
 #ifdef __PLATFORM_HAS_BOOST__
+#include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/uuid/uuid.hpp>
@@ -79,6 +80,12 @@ class CoordinatorHTTPUI;
 using webui::CoordinatorHTTPUI;
 #endif
 
+// The heartbeats of a batch that one thread applies.
+struct HeartbeatPartition {
+  vector<const HeartbeatMessage*> heartbeats_;
+  vector<const TaskHeartbeatMessage*> task_heartbeats_;
+};
+
 class Coordinator : public Node,
                     public boost::enable_shared_from_this<Coordinator> {
  public:
@@ -230,10 +237,28 @@ class Coordinator : public Node,
                        TaskKillMessage::TaskKillReason reason);
 
  protected:
+  FRIEND_TEST(CoordinatorTest, DropDeltaWithoutBase);
+  FRIEND_TEST(CoordinatorTest, ExpandDeltaHeartbeats);
+  FRIEND_TEST(CoordinatorTest, ForgetBaseOnCompletion);
+  FRIEND_TEST(CoordinatorTest, ForwardedTaskHeartbeats);
+  FRIEND_TEST(CoordinatorTest, FullHeartbeatResetsBase);
   void AddJobsTasksToTables(TaskDescriptor* td, JobID_t job_id);
   void AddResource(ResourceTopologyNodeDescriptor* rtnd,
                    const string& endpoint_uri,
                    bool local);
+  void ApplyHeartbeats(HeartbeatPartition* partition, uint64_t timestamp);
+  /**
+   * Applies a partition on one of the heartbeat threads, and signals the
+   * main loop once it is done.
+   */
+  void ApplyHeartbeatPartition(HeartbeatPartition* partition,
+                               uint64_t timestamp);
+  /**
+   * Turns a compact task heartbeat into a full one, using the task's
+   * previous heartbeat.
+   * @return false if the heartbeat cannot be expanded and must be dropped
+   */
+  bool ExpandTaskHeartbeat(TaskHeartbeatMessage* msg);
   bool RegisterWithCoordinator(StreamSocketsChannel<BaseMessage>* chan);
   void DetectLocalResources();
   bool HasJobCompleted(const JobDescriptor& jd);
@@ -242,7 +267,6 @@ class Coordinator : public Node,
   void HandleIncomingMessage(BaseMessage *bm, const string& remote_endpoint);
   void HandleIncomingReceiveError(const boost::system::error_code& error,
                                   const string& remote_endpoint);
-  void HandleHeartbeat(const HeartbeatMessage& msg);
   void HandleLookupRequest(const LookupRequest& msg,
                            const string& remote_endpoint);
   void HandleIONotification(const BaseMessage& msg,
@@ -253,7 +277,6 @@ class Coordinator : public Node,
                                    const string& endpoint);
   void HandleTaskDelegationResponse(const TaskDelegationResponseMessage& msg,
                                     const string& endpoint);
-  void HandleTaskHeartbeat(const TaskHeartbeatMessage& msg);
   void HandleTaskInfoRequest(const TaskInfoRequestMessage& msg,
                              const string& remote_endpoint);
   void HandleTaskSpawn(const TaskSpawnMessage& msg);
@@ -265,6 +288,12 @@ class Coordinator : public Node,
 #ifdef __HTTP_UI__
   void InitHTTPUI();
 #endif
+  /**
+   * Applies the resource and task heartbeats received since the last call
+   * in one batch. The batch is split between the calling thread and the
+   * heartbeat threads.
+   */
+  void ProcessPendingHeartbeats();
   void SendHeartbeatToParent(const MachinePerfStatisticsSample& stats);
 
 #ifdef __HTTP_UI__
@@ -311,6 +340,35 @@ class Coordinator : public Node,
   // Object that must be used to get the current time.
   WallTime* time_manager_;
   TraceGenerator* trace_generator_;
+  // The message handlers run on the messaging adapter's thread. The lock
+  // serializes them with the application of heartbeat batches.
+  boost::mutex message_handler_lock_;
+  // Heartbeats received since the main loop last applied a batch.
+  boost::mutex pending_heartbeats_lock_;
+  vector<HeartbeatMessage> pending_heartbeats_;
+  vector<TaskHeartbeatMessage> pending_task_heartbeats_;
+  // The batch of heartbeats that is being applied. The vectors are swapped
+  // with the pending ones in order to reuse their memory.
+  vector<HeartbeatMessage> heartbeats_;
+  vector<TaskHeartbeatMessage> task_heartbeats_;
+  // The -heartbeat_threads - 1 threads that apply partitions of a batch
+  // alongside the main loop. They are started once and wait for work on the
+  // io_service.
+  shared_ptr<boost::asio::io_service> heartbeat_io_service_;
+  scoped_ptr<boost::asio::io_service::work> heartbeat_io_service_work_;
+  boost::thread_group heartbeat_threads_;
+  // Number of partitions of the current batch that the heartbeat threads have
+  // not applied yet.
+  boost::mutex heartbeat_partitions_lock_;
+  boost::condition_variable heartbeat_partitions_done_;
+  uint64_t num_pending_partitions_;
+  // Cleared heartbeats from applied batches, whose memory is handed to
+  // received messages. Protected by pending_heartbeats_lock_.
+  vector<HeartbeatMessage> spare_heartbeats_;
+  vector<TaskHeartbeatMessage> spare_task_heartbeats_;
+  // The last full statistics of each task that sends compact heartbeats.
+  // Protected by message_handler_lock_.
+  unordered_map<TaskID_t, TaskPerfStatisticsSample> last_task_samples_;
 };
 
 }  // namespace firmament
@@ -843,15 +843,15 @@ void CoordinatorHTTPUI::HandleStatisticsURI(
       return;
     }
     output += "{ \"samples\": [";
-    const deque<TaskPerfStatisticsSample>* samples_result =
+    const deque<TaskPerfStatisticsSample> samples_result =
       coordinator_->scheduler()->knowledge_base()->GetStatsForTask(
             TaskIDFromString(task_id_str));
-    if (samples_result) {
+    if (!samples_result.empty()) {
       bool first = true;
-      int64_t length = static_cast<int64_t>(samples_result->size());
+      int64_t length = static_cast<int64_t>(samples_result.size());
       for (deque<TaskPerfStatisticsSample>::const_iterator it =
-             samples_result->begin() + max(0LL, length - WEBUI_PERF_QUEUE_LEN);
-          it != samples_result->end();
+             samples_result.begin() + max(0LL, length - WEBUI_PERF_QUEUE_LEN);
+          it != samples_result.end();
           ++it) {
         if (!first)
           output += ", ";
@@ -861,14 +861,14 @@ void CoordinatorHTTPUI::HandleStatisticsURI(
     }
     output += "]";
     output += ", \"reports\": [";
-    const deque<TaskFinalReport>* report_result =
+    const deque<TaskFinalReport> report_result =
       coordinator_->scheduler()->knowledge_base()->GetFinalReportForTask(
           td->uid());
-    if (report_result) {
+    if (!report_result.empty()) {
       bool first = true;
       for (deque<TaskFinalReport>::const_iterator it =
-          report_result->begin();
-          it != report_result->end();
+          report_result.begin();
+          it != report_result.end();
           ++it) {
         if (!first)
           output += ", ";
@@ -879,14 +879,14 @@ void CoordinatorHTTPUI::HandleStatisticsURI(
     output += "] }";
   } else if (!ec_id_str.empty()) {
     output += "{ \"reports\": [";
-    const deque<TaskFinalReport>* report_result =
+    const deque<TaskFinalReport> report_result =
       coordinator_->scheduler()->knowledge_base()->GetFinalReportsForTEC(
           strtoull(ec_id_str.c_str(), 0, 10));
-    if (report_result) {
+    if (!report_result.empty()) {
       bool first = true;
       for (deque<TaskFinalReport>::const_iterator it =
-          report_result->begin();
-          it != report_result->end();
+          report_result.begin();
+          it != report_result.end();
           ++it) {
         if (!first)
           output += ", ";
@@ -10,14 +10,13 @@
 
 #include "base/common.h"
 #include "engine/coordinator.h"
+#include "misc/pb_utils.h"
 
 #ifdef __HTTP_UI__
 DECLARE_bool(http_ui);
 #endif
 
-namespace {
-
-using firmament::Coordinator;
+namespace firmament {
 
 // The fixture for testing class Coordinator.
 class CoordinatorTest : public ::testing::Test {
@@ -46,6 +45,32 @@ class CoordinatorTest : public ::testing::Test {
     // before the destructor).
   }
 
+  // Builds the statistics of a task's heartbeat.
+  TaskPerfStatisticsSample Sample(TaskID_t task_id, uint64_t timestamp,
+                                  uint64_t vsize, uint64_t rsize) {
+    TaskPerfStatisticsSample sample;
+    sample.set_task_id(task_id);
+    sample.set_timestamp(timestamp);
+    sample.set_vsize(vsize);
+    sample.set_rsize(rsize);
+    sample.set_hostname("host");
+    return sample;
+  }
+
+  // Fills in msg as a task that sends compact heartbeats would: in full if
+  // prev is NULL, and as the delta from prev otherwise.
+  void CompactHeartbeat(const TaskPerfStatisticsSample* prev,
+                        const TaskPerfStatisticsSample& cur,
+                        TaskHeartbeatMessage* msg) {
+    msg->set_task_id(cur.task_id());
+    if (prev) {
+      DeltaEncodeTaskStatistics(*prev, cur, msg->mutable_stats());
+    } else {
+      msg->mutable_stats()->CopyFrom(cur);
+    }
+    msg->set_delta(prev != NULL);
+  }
+
   // Objects declared here can be used by all tests in the test case for
   // Coordinator.
 };
@@ -62,8 +87,123 @@ TEST_F(CoordinatorTest, HTTPUIStartStopTest) {
   test_coordinator.Shutdown("test end");
 }
 
+// Checks that deltas are merged into the previous heartbeat, one after the
+// other.
+TEST_F(CoordinatorTest, ExpandDeltaHeartbeats) {
+  Coordinator test_coordinator;
+  TaskPerfStatisticsSample first = Sample(1, 100, 4096, 1024);
+  TaskPerfStatisticsSample second = Sample(1, 200, 8192, 1024);
+  TaskPerfStatisticsSample third = Sample(1, 300, 8192, 2048);
+  TaskHeartbeatMessage msg;
+  CompactHeartbeat(NULL, first, &msg);
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_FALSE(msg.has_delta());
+  // The delta only carries the statistics that changed
+  msg.Clear();
+  CompactHeartbeat(&first, second, &msg);
+  EXPECT_EQ(msg.stats().vsize(), 8192);
+  EXPECT_FALSE(msg.stats().has_rsize());
+  EXPECT_FALSE(msg.stats().has_hostname());
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_FALSE(msg.has_delta());
+  EXPECT_EQ(msg.stats().SerializeAsString(), second.SerializeAsString());
+  msg.Clear();
+  CompactHeartbeat(&second, third, &msg);
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_EQ(msg.stats().SerializeAsString(), third.SerializeAsString());
+  // Heartbeats from tasks that do not send compact heartbeats are left alone,
+  // and do not become a base.
+  msg.Clear();
+  msg.set_task_id(2);
+  msg.mutable_stats()->CopyFrom(Sample(2, 100, 4096, 1024));
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_EQ(test_coordinator.last_task_samples_.size(), 1);
+}
+
+// Checks that a delta from a task whose full heartbeat we have not received
+// is dropped.
+TEST_F(CoordinatorTest, DropDeltaWithoutBase) {
+  Coordinator test_coordinator;
+  TaskPerfStatisticsSample first = Sample(1, 100, 4096, 1024);
+  TaskHeartbeatMessage msg;
+  CompactHeartbeat(&first, Sample(1, 200, 8192, 1024), &msg);
+  EXPECT_FALSE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_TRUE(test_coordinator.last_task_samples_.empty());
+}
+
+// Checks that a full heartbeat replaces the base rather than being merged
+// into it.
+TEST_F(CoordinatorTest, FullHeartbeatResetsBase) {
+  Coordinator test_coordinator;
+  TaskPerfStatisticsSample first = Sample(1, 100, 4096, 1024);
+  TaskPerfStatisticsSample second = Sample(1, 200, 8192, 1024);
+  second.clear_hostname();
+  TaskPerfStatisticsSample third = Sample(1, 300, 8192, 2048);
+  third.clear_hostname();
+  TaskHeartbeatMessage msg;
+  CompactHeartbeat(NULL, first, &msg);
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  msg.Clear();
+  CompactHeartbeat(NULL, second, &msg);
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_FALSE(msg.stats().has_hostname());
+  msg.Clear();
+  CompactHeartbeat(&second, third, &msg);
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_FALSE(msg.stats().has_hostname());
+  EXPECT_EQ(msg.stats().SerializeAsString(), third.SerializeAsString());
+}
+
+// Checks that the base of a task is forgotten once the task has finished,
+// so that later deltas are dropped.
+TEST_F(CoordinatorTest, ForgetBaseOnCompletion) {
+  Coordinator test_coordinator;
+  TaskDescriptor td;
+  td.set_uid(1);
+  td.set_state(TaskDescriptor::COMPLETED);
+  CHECK(InsertIfNotPresent(test_coordinator.task_table_.get(), td.uid(),
+                           &td));
+  TaskPerfStatisticsSample first = Sample(1, 100, 4096, 1024);
+  TaskHeartbeatMessage msg;
+  CompactHeartbeat(NULL, first, &msg);
+  EXPECT_TRUE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  EXPECT_EQ(test_coordinator.last_task_samples_.size(), 1);
+  TaskStateMessage state_msg;
+  state_msg.set_id(td.uid());
+  state_msg.set_new_state(TaskDescriptor::COMPLETED);
+  test_coordinator.HandleTaskStateChange(state_msg);
+  EXPECT_TRUE(test_coordinator.last_task_samples_.empty());
+  msg.Clear();
+  CompactHeartbeat(&first, Sample(1, 200, 8192, 1024), &msg);
+  EXPECT_FALSE(test_coordinator.ExpandTaskHeartbeat(&msg));
+  test_coordinator.task_table_->erase(td.uid());
+}
+
+// Checks that the heartbeats a child coordinator forwards in a batch are
+// queued and expanded in order.
+TEST_F(CoordinatorTest, ForwardedTaskHeartbeats) {
+  Coordinator test_coordinator;
+  TaskPerfStatisticsSample first = Sample(1, 100, 4096, 1024);
+  TaskPerfStatisticsSample second = Sample(1, 200, 8192, 1024);
+  BaseMessage bm;
+  CompactHeartbeat(NULL, first, bm.add_task_heartbeats());
+  CompactHeartbeat(&first, second, bm.add_task_heartbeats());
+  CompactHeartbeat(NULL, Sample(2, 100, 512, 256), bm.add_task_heartbeats());
+  test_coordinator.HandleIncomingMessage(&bm, "tcp:localhost:9999");
+  EXPECT_EQ(bm.task_heartbeats_size(), 0);
+  ASSERT_EQ(test_coordinator.pending_task_heartbeats_.size(), 3);
+  EXPECT_EQ(test_coordinator.pending_task_heartbeats_[1].task_id(), 1);
+  EXPECT_TRUE(test_coordinator.pending_task_heartbeats_[1].delta());
+  EXPECT_EQ(test_coordinator.pending_task_heartbeats_[2].task_id(), 2);
+  test_coordinator.ProcessPendingHeartbeats();
+  EXPECT_TRUE(test_coordinator.pending_task_heartbeats_.empty());
+  ASSERT_EQ(test_coordinator.last_task_samples_.size(), 2);
+  EXPECT_EQ(test_coordinator.last_task_samples_[1].SerializeAsString(),
+            second.SerializeAsString());
+}
+
 
-}  // namespace
+}  // namespace firmament
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
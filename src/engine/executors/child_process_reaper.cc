@@ -0,0 +1,226 @@
+// The Firmament project
+// Copyright (c) 2011-2015 Malte Schwarzkopf <malte.schwarzkopf@cl.cam.ac.uk>
+//
+// Child process reaper implementation.
+
+#include "engine/executors/child_process_reaper.h"
+
+extern "C" {
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+#include "misc/map-util.h"
+
+DEFINE_uint64(reaper_poll_interval_ms, 100,
+              "Interval at which child processes are checked for exit if the "
+              "kernel does not support pidfd_open(2).");
+
+namespace firmament {
+namespace executor {
+
+// Maximum number of events handled per epoll_wait(2) call.
+static const int kMaxReaperEvents = 64;
+// The epoll data of the wakeup eventfd; PIDs are always positive.
+static const uint64_t kWakeupToken = 0;
+
+ChildProcessReaper::ChildProcessReaper()
+    : epoll_fd_(-1), wakeup_fd_(-1), use_pidfd_(true), stopping_(false) {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  PCHECK(epoll_fd_ >= 0) << "Failed to create epoll set for child reaper";
+  wakeup_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  PCHECK(wakeup_fd_ >= 0) << "Failed to create eventfd for child reaper";
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = kWakeupToken;
+  PCHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev) == 0);
+  // Probe for pidfd support using our own PID.
+  int probe_fd = OpenPidFd(getpid());
+  if (probe_fd < 0) {
+    LOG(WARNING) << "pidfd_open(2) is not available; will check for exited "
+                 << "child processes every " << FLAGS_reaper_poll_interval_ms
+                 << "ms.";
+    use_pidfd_ = false;
+  } else {
+    close(probe_fd);
+  }
+  reaper_thread_ = boost::thread(boost::bind(&ChildProcessReaper::Run, this));
+}
+
+ChildProcessReaper::~ChildProcessReaper() {
+  {
+    boost::lock_guard<boost::mutex> lock(lock_);
+    stopping_ = true;
+  }
+  uint64_t one = 1;
+  if (write(wakeup_fd_, &one, sizeof(one)) != sizeof(one))
+    PLOG(ERROR) << "Failed to wake up child reaper thread";
+  reaper_thread_.join();
+  // Any children still running are left alone; they receive their
+  // parent-death signal now that the reaper thread has exited.
+  for (unordered_map<pid_t, Child>::iterator it = children_.begin();
+       it != children_.end();
+       ++it) {
+    if (it->second.pidfd >= 0)
+      close(it->second.pidfd);
+  }
+  close(wakeup_fd_);
+  close(epoll_fd_);
+}
+
+void ChildProcessReaper::HandleSpawnRequests() {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  while (!spawn_requests_.empty()) {
+    SpawnRequest* req = spawn_requests_.front();
+    spawn_requests_.pop_front();
+    req->pid = req->spawn();
+    if (req->pid > 0) {
+      Child child;
+      child.pidfd = -1;
+      child.on_exit = req->on_exit;
+      if (use_pidfd_) {
+        // N.B.: this succeeds even if the child has already exited, since we
+        // have not reaped it yet; the pidfd is then immediately readable.
+        child.pidfd = OpenPidFd(req->pid);
+        if (child.pidfd < 0) {
+          PLOG(FATAL) << "Failed to open pidfd for child " << req->pid;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = static_cast<uint64_t>(req->pid);
+        PCHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, child.pidfd, &ev) == 0);
+      }
+      CHECK(InsertIfNotPresent(&children_, req->pid, child));
+      VLOG(1) << "Reaper now watching child process " << req->pid;
+    }
+    req->done = true;
+  }
+  spawn_cond_.notify_all();
+}
+
+uint64_t ChildProcessReaper::NumChildren() {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  return children_.size();
+}
+
+int ChildProcessReaper::OpenPidFd(pid_t pid) {
+#ifdef __NR_pidfd_open
+  return static_cast<int>(syscall(__NR_pidfd_open, pid, 0));
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+void ChildProcessReaper::ReapChild(pid_t pid) {
+  int status;
+  pid_t ret = waitpid(pid, &status, WNOHANG);
+  if (ret == 0) {
+    // Still running
+    return;
+  } else if (ret < 0) {
+    PLOG(ERROR) << "waitpid(2) failed for child " << pid;
+    return;
+  }
+  Child child;
+  {
+    boost::lock_guard<boost::mutex> lock(lock_);
+    Child* child_ptr = FindOrNull(children_, pid);
+    CHECK_NOTNULL(child_ptr);
+    child = *child_ptr;
+    children_.erase(pid);
+  }
+  if (child.pidfd >= 0) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, child.pidfd, NULL);
+    close(child.pidfd);
+  }
+  if (WIFEXITED(status)) {
+    VLOG(1) << "Child process with PID " << pid << " exited with status "
+            << WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    VLOG(1) << "Child process with PID " << pid << " exited due to uncaught "
+            << "signal " << WTERMSIG(status);
+  }
+  if (child.on_exit)
+    child.on_exit(pid, status);
+}
+
+void ChildProcessReaper::ReapExitedChildren() {
+  // Polling fallback: check every child, since we do not know which one
+  // exited. Copy the PIDs first as ReapChild modifies the map.
+  vector<pid_t> pids;
+  {
+    boost::lock_guard<boost::mutex> lock(lock_);
+    pids.reserve(children_.size());
+    for (unordered_map<pid_t, Child>::const_iterator it = children_.begin();
+         it != children_.end();
+         ++it) {
+      pids.push_back(it->first);
+    }
+  }
+  for (vector<pid_t>::const_iterator it = pids.begin();
+       it != pids.end();
+       ++it) {
+    ReapChild(*it);
+  }
+}
+
+void ChildProcessReaper::Run() {
+  struct epoll_event events[kMaxReaperEvents];
+  while (true) {
+    int timeout = -1;
+    if (!use_pidfd_ && NumChildren() > 0)
+      timeout = static_cast<int>(FLAGS_reaper_poll_interval_ms);
+    int num_events = epoll_wait(epoll_fd_, events, kMaxReaperEvents, timeout);
+    if (num_events < 0) {
+      if (errno == EINTR)
+        continue;
+      PLOG(FATAL) << "epoll_wait(2) failed in child reaper";
+    }
+    for (int i = 0; i < num_events; ++i) {
+      if (events[i].data.u64 == kWakeupToken) {
+        uint64_t count;
+        // Reset the eventfd counter; EAGAIN just means a racing reader.
+        if (read(wakeup_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+          PLOG(ERROR) << "Failed to read child reaper eventfd";
+      } else {
+        ReapChild(static_cast<pid_t>(events[i].data.u64));
+      }
+    }
+    if (!use_pidfd_)
+      ReapExitedChildren();
+    HandleSpawnRequests();
+    {
+      boost::lock_guard<boost::mutex> lock(lock_);
+      if (stopping_)
+        break;
+    }
+  }
+}
+
+pid_t ChildProcessReaper::Spawn(SpawnFunction spawn, ExitCallback on_exit) {
+  CHECK(boost::this_thread::get_id() != reaper_thread_.get_id())
+    << "Spawn() must not be called from a reaper callback";
+  SpawnRequest req;
+  req.spawn = spawn;
+  req.on_exit = on_exit;
+  req.pid = -1;
+  req.done = false;
+  boost::unique_lock<boost::mutex> lock(lock_);
+  CHECK(!stopping_);
+  spawn_requests_.push_back(&req);
+  uint64_t one = 1;
+  if (write(wakeup_fd_, &one, sizeof(one)) != sizeof(one))
+    PLOG(FATAL) << "Failed to wake up child reaper thread";
+  while (!req.done)
+    spawn_cond_.wait(lock);
+  return req.pid;
+}
+
+}  // namespace executor
+}  // namespace firmament
@@ -0,0 +1,92 @@
+// The Firmament project
+// Copyright (c) 2011-2015 Malte Schwarzkopf <malte.schwarzkopf@cl.cam.ac.uk>
+//
+// Child process reaper. A single thread creates and waits for all of an
+// executor's child processes, instead of each child having a dedicated thread
+// blocked in waitpid(2).
+//
+// Each child is watched through a pidfd (Linux >= 5.3) registered with an
+// epoll set, so the reaper sleeps until some child exits. On kernels without
+// pidfd_open(2), the reaper instead checks its children with a non-blocking
+// waitpid(2) every FLAGS_reaper_poll_interval_ms milliseconds.
+//
+// Children are created on the reaper's thread. This matters since the
+// parent-death signal set by PR_SET_PDEATHSIG fires when the *thread* that
+// created the child exits, not when the process does.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_CHILD_PROCESS_REAPER_H
+#define FIRMAMENT_ENGINE_EXECUTORS_CHILD_PROCESS_REAPER_H
+
+#include <deque>
+
+#ifdef __PLATFORM_HAS_BOOST__
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#else
+#error Boost not available!
+#endif
+
+#include "base/common.h"
+#include "base/types.h"
+
+namespace firmament {
+namespace executor {
+
+class ChildProcessReaper {
+ public:
+  // Creates a child process and returns its PID, or -1 on failure.
+  typedef boost::function<pid_t()> SpawnFunction;
+  // Invoked with the child's PID and its wait(2) status once it has been
+  // reaped.
+  typedef boost::function<void(pid_t, int)> ExitCallback;
+
+  ChildProcessReaper();
+  ~ChildProcessReaper();
+  /**
+   * Runs spawn on the reaper's thread and watches the process it creates.
+   * Blocks until spawn has returned.
+   * N.B.: on_exit is invoked on the reaper's thread, so it must not block or
+   * call Spawn() itself.
+   * @param spawn function that creates the child process
+   * @param on_exit callback to invoke once the child has exited
+   * @return the PID of the child, or -1 if spawn failed
+   */
+  pid_t Spawn(SpawnFunction spawn, ExitCallback on_exit);
+  uint64_t NumChildren();
+
+ protected:
+  struct SpawnRequest {
+    SpawnFunction spawn;
+    ExitCallback on_exit;
+    pid_t pid;
+    bool done;
+  };
+  struct Child {
+    int pidfd;
+    ExitCallback on_exit;
+  };
+  void HandleSpawnRequests();
+  int OpenPidFd(pid_t pid);
+  void ReapChild(pid_t pid);
+  void ReapExitedChildren();
+  void Run();
+
+  int epoll_fd_;
+  // Used by Spawn() and the destructor to wake up the reaper thread.
+  int wakeup_fd_;
+  bool use_pidfd_;
+  bool stopping_;
+  boost::mutex lock_;
+  boost::condition_variable spawn_cond_;
+  deque<SpawnRequest*> spawn_requests_;
+  // Only accessed from the reaper thread, except for NumChildren(), which
+  // reads the size under lock_.
+  unordered_map<pid_t, Child> children_;
+  boost::thread reaper_thread_;
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_CHILD_PROCESS_REAPER_H
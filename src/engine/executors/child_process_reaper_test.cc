@@ -0,0 +1,104 @@
+// The Firmament project
+// Copyright (c) 2011-2015 Malte Schwarzkopf <malte.schwarzkopf@cl.cam.ac.uk>
+//
+// ChildProcessReaper class unit tests.
+
+extern "C" {
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+#include <gtest/gtest.h>
+
+#include "base/common.h"
+#include "engine/executors/child_process_reaper.h"
+
+namespace firmament {
+namespace executor {
+
+// The fixture for testing class ChildProcessReaper.
+class ChildProcessReaperTest : public ::testing::Test {
+ public:
+  ChildProcessReaperTest() : num_exited_(0) {
+    FLAGS_v = 2;
+  }
+
+  static pid_t ForkAndExit(int exit_code) {
+    pid_t pid = fork();
+    if (pid == 0)
+      _exit(exit_code);
+    return pid;
+  }
+
+  static pid_t FailToSpawn() {
+    return -1;
+  }
+
+  void HandleExit(pid_t pid, int status) {
+    boost::lock_guard<boost::mutex> lock(lock_);
+    exit_status_[pid] = status;
+    ++num_exited_;
+    cond_.notify_all();
+  }
+
+  void WaitForExits(uint64_t num_exits) {
+    boost::unique_lock<boost::mutex> lock(lock_);
+    while (num_exited_ < num_exits)
+      cond_.wait(lock);
+  }
+
+  boost::mutex lock_;
+  boost::condition_variable cond_;
+  unordered_map<pid_t, int> exit_status_;
+  uint64_t num_exited_;
+};
+
+// Tests that a single child is reaped and its exit status reported.
+TEST_F(ChildProcessReaperTest, ReapSingleChild) {
+  ChildProcessReaper reaper;
+  pid_t pid = reaper.Spawn(
+      boost::bind(&ChildProcessReaperTest::ForkAndExit, 3),
+      boost::bind(&ChildProcessReaperTest::HandleExit, this, _1, _2));
+  ASSERT_GT(pid, 0);
+  WaitForExits(1);
+  EXPECT_TRUE(WIFEXITED(exit_status_[pid]));
+  EXPECT_EQ(WEXITSTATUS(exit_status_[pid]), 3);
+  EXPECT_EQ(reaper.NumChildren(), 0ULL);
+}
+
+// Tests that many concurrently running children are all reaped by the one
+// reaper thread.
+TEST_F(ChildProcessReaperTest, ReapManyChildren) {
+  ChildProcessReaper reaper;
+  vector<pid_t> pids;
+  for (int i = 0; i < 32; ++i) {
+    pid_t pid = reaper.Spawn(
+        boost::bind(&ChildProcessReaperTest::ForkAndExit, i),
+        boost::bind(&ChildProcessReaperTest::HandleExit, this, _1, _2));
+    ASSERT_GT(pid, 0);
+    pids.push_back(pid);
+  }
+  WaitForExits(pids.size());
+  for (int i = 0; i < 32; ++i) {
+    EXPECT_TRUE(WIFEXITED(exit_status_[pids[i]]));
+    EXPECT_EQ(WEXITSTATUS(exit_status_[pids[i]]), i);
+  }
+}
+
+// Tests that a failed spawn is reported and not watched.
+TEST_F(ChildProcessReaperTest, FailedSpawn) {
+  ChildProcessReaper reaper;
+  pid_t pid = reaper.Spawn(
+      &ChildProcessReaperTest::FailToSpawn,
+      boost::bind(&ChildProcessReaperTest::HandleExit, this, _1, _2));
+  EXPECT_EQ(pid, -1);
+  EXPECT_EQ(reaper.NumChildren(), 0ULL);
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -13,11 +13,11 @@ extern "C" {
 #include <sys/prctl.h>
 #endif
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 }
-#include <boost/regex.hpp>
 
 #include "base/common.h"
 #include "base/types.h"
@@ -25,6 +25,7 @@ extern "C" {
 #include "engine/executors/task_health_checker.h"
 #include "misc/utils.h"
 #include "misc/map-util.h"
+#include "platforms/unix/perf_event_counters.h"
 
 DEFINE_bool(pin_tasks_to_cores, true,
             "Pin tasks to their allocated CPU core when executing.");
@@ -33,33 +34,29 @@ DEFINE_bool(debug_tasks, false,
 DEFINE_uint64(debug_interactively, 0,
               "Run this task ID inside an interactive debugger.");
 DEFINE_bool(perf_monitoring, true,
-            "Enable performance monitoring for tasks executed.");
+            "Count tasks' cycles, instructions and LLC references/misses "
+            "using perf events.");
 DEFINE_string(task_lib_dir, "build/engine/",
               "Path where task_lib.a and task_lib_inject.so are.");
 DEFINE_string(task_log_dir, "/tmp/firmament-log",
               "Path where task logs will be stored.");
-DEFINE_string(task_perf_dir, "/tmp/firmament-perf",
-              "Path where tasks' perf logs should be written.");
 DEFINE_string(task_data_dir, "/tmp/firmament-data",
               "Path where tasks' perf logs should be written.");
-DEFINE_string(perf_event_list,
-              "cpu-clock,task-clock,context-switches,cpu-migrations,"
-              "page-faults,cycles,instructions,branches,branch-misses,"
-              "cache-misses,cache-references,stalled-cycles-frontend,"
-              "stalled-cycles-backend,node-loads,node-load-misses",
-              "Comma-separated list of perf events to monitor.");
-
 namespace firmament {
 namespace executor {
 
 using common::pb_to_vector;
 
+// How long to wait for a completed task's process to exit, so that its perf
+// event counts are final.
+static const int64_t kPerfDataTimeoutMs = 1000;
+
 LocalExecutor::LocalExecutor(ResourceID_t resource_id,
                              const string& coordinator_uri,
                              TimeInterface* time_manager)
     : local_resource_id_(resource_id),
       coordinator_uri_(coordinator_uri),
-      health_checker_(&task_handler_threads_, &handler_map_mutex_),
+      health_checker_(&task_pids_, &task_exit_status_, &pid_map_mutex_),
       time_manager_(time_manager),
       topology_manager_(shared_ptr<TopologyManager>()),  // NULL
       heartbeat_interval_(1000000000ULL) {  // 1 billios nanosec = 1 sec
@@ -74,7 +71,7 @@ LocalExecutor::LocalExecutor(ResourceID_t resource_id,
                              shared_ptr<TopologyManager> topology_mgr)
     : local_resource_id_(resource_id),
       coordinator_uri_(coordinator_uri),
-      health_checker_(&task_handler_threads_, &handler_map_mutex_),
+      health_checker_(&task_pids_, &task_exit_status_, &pid_map_mutex_),
       time_manager_(time_manager),
       topology_manager_(topology_mgr),
       heartbeat_interval_(1000000000ULL) {  // 1 billios nanosec = 1 sec
@@ -84,20 +81,13 @@ LocalExecutor::LocalExecutor(ResourceID_t resource_id,
   CreateDirectories();
 }
 
-char* LocalExecutor::AddPerfMonitoringToCommandLine(
-    const unordered_map<string, string>& env,
-    vector<char*>* argv) {
-  // Define the string prefix for performance monitoring
-  //string perf_string = "perf stat -x, -o ";
-  VLOG(2) << "Enabling performance monitoring...";
-  string perf_string = "perf stat -o ";
-  const string* perf_fname = FindOrNull(env, "PERF_FNAME");
-  CHECK_NOTNULL(perf_fname);
-  perf_string += *perf_fname;
-  perf_string += " -e ";
-  perf_string += FLAGS_perf_event_list;
-  perf_string += " -- ";
-  return TokenizeIntoArgv(perf_string, argv);
+LocalExecutor::~LocalExecutor() {
+  for (unordered_map<TaskID_t, PerfEventCounters*>::iterator it =
+       task_perf_counters_.begin();
+       it != task_perf_counters_.end();
+       ++it) {
+    delete it->second;
+  }
 }
 
 char* LocalExecutor::AddDebuggingToCommandLine(vector<char*>* argv) {
@@ -116,17 +106,24 @@ bool LocalExecutor::CheckRunningTasksHealth(vector<TaskID_t>* failed_tasks) {
 }
 
 void LocalExecutor::CleanUpCompletedTask(const TaskDescriptor& td) {
-  // Drop task handler thread
-  boost::unique_lock<boost::shared_mutex> handler_lock(handler_map_mutex_);
   boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
-  task_handler_threads_.erase(td.uid());
-  // Issue a kill to make double-sure that the task has finished
-  // XXX(malte): this is a hack!
   pid_t* pid = FindOrNull(task_pids_, td.uid());
   CHECK_NOTNULL(pid);
-  int ret = kill(*pid, SIGKILL);
-  LOG(INFO) << "kill(2) for task " << td.uid() << " returned " << ret;
+  // Issue a kill to make double-sure that the task has finished. We must not
+  // do so once the reaper has collected the process, as its PID may since
+  // have been reused.
+  // XXX(malte): this is a hack!
+  if (*pid > 0 && !ContainsKey(task_exit_status_, td.uid())) {
+    int ret = kill(*pid, SIGKILL);
+    LOG(INFO) << "kill(2) for task " << td.uid() << " returned " << ret;
+  }
   task_pids_.erase(td.uid());
+  task_exit_status_.erase(td.uid());
+  PerfEventCounters** counters = FindOrNull(task_perf_counters_, td.uid());
+  if (counters) {
+    delete *counters;
+    task_perf_counters_.erase(td.uid());
+  }
 }
 
 
@@ -137,11 +134,6 @@ void LocalExecutor::CreateDirectories() {
       stat(FLAGS_task_log_dir.c_str(), &st) == -1) {
     mkdir(FLAGS_task_log_dir.c_str(), 0700);
   }
-  // Tasks' perf logs
-  if (!FLAGS_task_perf_dir.empty() &&
-      stat(FLAGS_task_perf_dir.c_str(), &st) == -1) {
-    mkdir(FLAGS_task_perf_dir.c_str(), 0700);
-  }
   // Tasks' data directory
   if (!FLAGS_task_data_dir.empty() &&
       stat(FLAGS_task_data_dir.c_str(), &st) == -1) {
@@ -149,28 +141,86 @@ void LocalExecutor::CreateDirectories() {
   }
 }
 
-void LocalExecutor::GetPerfDataFromLine(TaskFinalReport* report,
-                                        const string& line) {
-  boost::regex e("[[:space:]]*? ([0-9,.]+) ([a-zA-Z-]+) .*");
-  boost::smatch m;
-  if (boost::regex_match(line, m, e, boost::match_extra)
-      && m.size() == 3) {
-    string number = m[1].str();
-    // Remove any commas
-    number.erase(std::remove(number.begin(), number.end(), ','), number.end());
-    VLOG(1) << "matched: " << m[2] << ", " << number;
-    if (m[2] == "instructions") {
-      report->set_instructions(strtoul(number.c_str(), NULL, 10));
-    } else if (m[2] == "cycles") {
-      report->set_cycles(strtoul(number.c_str(), NULL, 10));
-    } else if (m[2] == "seconds") {
-      report->set_runtime(strtod(number.c_str(), NULL));
-    } else if (m[2] == "cache-references") {
-      report->set_llc_refs(strtoul(number.c_str(), NULL, 10));
-    } else if (m[2] == "cache-misses") {
-      report->set_llc_misses(strtoul(number.c_str(), NULL, 10));
+pid_t LocalExecutor::ForkAndExecTask(TaskID_t task_id,
+                                     bool perf_monitoring,
+                                     char* const* argv,
+                                     char* const* envv,
+                                     const char* stdout_path,
+                                     const char* stderr_path,
+                                     const char* data_dir) {
+  // N.B.: this runs on the reaper thread, so that the child's parent-death
+  // signal is tied to the long-lived reaper rather than to whichever thread
+  // placed the task.
+  // We use vfork() since it does not copy the coordinator's page tables, which
+  // makes it far cheaper than fork() for a large parent. In exchange, the
+  // child shares our memory until it calls exec, so it must only make system
+  // calls on pre-computed arguments and then either exec or _exit(2).
+  pid_t pid = vfork();
+  switch (pid) {
+    case -1:
+      // Error
+      PLOG(ERROR) << "Failed to fork child process for task " << task_id;
+      break;
+    case 0: {
+      // Child
+      // Set up stderr and stdout log redirections to files
+      int stdout_fd = open(stdout_path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+      int stderr_fd = open(stderr_path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+      if (stdout_fd < 0 || stderr_fd < 0 ||
+          dup2(stdout_fd, STDOUT_FILENO) < 0 ||
+          dup2(stderr_fd, STDERR_FILENO) < 0)
+        _exit(1);
+      close(stdout_fd);
+      close(stderr_fd);
+      // Change to task's working directory
+      if (data_dir[0] != '\0' && chdir(data_dir) != 0)
+        _exit(1);
+      // Close the open FDs in the child before exec-ing, so that the task does
+      // not inherit all of the coordinator's sockets and FDs.
+      // We start from 3 here in order to avoid closing stdin/stdout/stderr.
+      // close_range(2) does this in one system call on Linux >= 5.9.
+#ifdef __NR_close_range
+      if (syscall(__NR_close_range, 3U, ~0U, 0U) != 0)
+#endif
+      {
+        int fds;
+        if ((fds = getdtablesize()) == -1) fds = OPEN_MAX_GUESS;
+        for (int fd = 3; fd < fds; fd++)
+          close(fd);
+      }
+      // kill child process if parent terminates
+      // SOMEDAY(adam): make this portable beyond Linux?
+#ifdef __linux__
+      prctl(PR_SET_PDEATHSIG, SIGHUP);
+#endif
+      // Run the task binary
+      execvpe(argv[0], argv, envv);
+      // execvpe only returns if there was an error; we cannot log here, but
+      // the non-zero exit status is picked up by the reaper.
+      _exit(1);
     }
+    default:
+      // Parent
+      VLOG(1) << "Task process with PID " << pid << " created.";
   }
+  // Record the PID before the reaper starts watching the child, so that its
+  // exit callback always finds it.
+  boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+  CHECK(InsertIfNotPresent(&task_pids_, task_id, pid));
+  if (pid < 0) {
+    // Report the task as failed on the next health check
+    CHECK(InsertIfNotPresent(&task_exit_status_, task_id, -1));
+  } else if (perf_monitoring) {
+    // The counters are inherited by any threads and processes the task
+    // creates, and remain readable after it exits.
+    PerfEventCounters* counters = new PerfEventCounters();
+    if (counters->Open(pid)) {
+      CHECK(InsertIfNotPresent(&task_perf_counters_, task_id, counters));
+    } else {
+      delete counters;
+    }
+  }
+  return pid;
 }
 
 void LocalExecutor::HandleTaskCompletion(TaskDescriptor* td,
@@ -182,45 +232,56 @@ void LocalExecutor::HandleTaskCompletion(TaskDescriptor* td,
   report->set_task_id(td->uid());
   report->set_start_time(start_time);
   report->set_finish_time(end_time);
-  // Load perf data, if it exists
-  if (FLAGS_perf_monitoring) {
-    FILE* fptr;
-    char line[1024];
-    string file_name = PerfDataFileName(*td);
-    if (WaitForPerfFile(file_name)) {
-      // Once we get here, we have non-zero data in the perf data file
-      if ((fptr = fopen(file_name.c_str(), "r")) == NULL) {
-        LOG(ERROR) << "Failed to open perf data file " << file_name;
-      } else {
-        VLOG(1) << "Processing perf output in file " << file_name
-                << "...";
-        while (!feof(fptr)) {
-          char* lptr = fgets(line, 1024, fptr);
-          if (lptr != NULL) {
-            GetPerfDataFromLine(report, line);
-          }
-        }
-        if (fclose(fptr) != 0) {
-          PLOG(ERROR) << "Failed to close perf file " << file_name
-                      << " after reading!";
-        }
-      }
-    } else {
-      LOG(ERROR) << "Perf file " << file_name << " does not exists or does not "
-                 << "contain data!";
+  // TODO(malte): this is a bit of a hack -- we use the executor's runtime
+  // measurements, rather than the task's. Multiplication by 1M converts from
+  // microseconds to seconds.
+  report->set_runtime(end_time / SECONDS_TO_MICROSECONDS -
+                      start_time / SECONDS_TO_MICROSECONDS);
+  // Add the task's perf event counts, if we have them. These are only final
+  // once its process (and any children) have exited.
+  PerfEventCounters* counters = NULL;
+  {
+    boost::shared_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    PerfEventCounters** counters_ptr =
+      FindOrNull(task_perf_counters_, td->uid());
+    if (counters_ptr)
+      counters = *counters_ptr;
+  }
+  if (counters) {
+    PerfEventValues values;
+    if (!WaitForTaskExit(td->uid(), kPerfDataTimeoutMs, NULL)) {
+      // The task has reported completion, so it should do little more work;
+      // we use the counts so far.
+      LOG(WARNING) << "Process for task " << td->uid() << " did not exit "
+                   << "within " << kPerfDataTimeoutMs << "ms; its perf event "
+                   << "counts may be incomplete.";
+    }
+    if (counters->Read(&values) && values.hardware) {
+      report->set_instructions(values.instructions);
+      report->set_cycles(values.cycles);
+      report->set_llc_refs(values.llc_refs);
+      report->set_llc_misses(values.llc_misses);
     }
-  } else {
-    // TODO(malte): this is a bit of a hack -- when we don't have the perf
-    // information available, we use the executor's runtime measurements.
-    // They should be identical, however, so maybe we should just always do
-    // this. Multiplication by 1M converts from microseconds to seconds.
-    report->set_runtime(end_time / SECONDS_TO_MICROSECONDS -
-                        start_time / SECONDS_TO_MICROSECONDS);
   }
   // Now clean up any remaining state.
   CleanUpCompletedTask(*td);
 }
 
+void LocalExecutor::HandleProcessExit(TaskID_t task_id, pid_t pid,
+                                      int status) {
+  // N.B.: runs on the reaper thread
+  boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+  pid_t* task_pid = FindOrNull(task_pids_, task_id);
+  if (!task_pid || *task_pid != pid) {
+    // The task has already been cleaned up (e.g. after we killed it).
+    VLOG(1) << "Ignoring exit of process " << pid << " for task " << task_id
+            << ", which is no longer tracked";
+    return;
+  }
+  CHECK(InsertIfNotPresent(&task_exit_status_, task_id, status));
+  task_exit_condvar_.notify_all();
+}
+
 void LocalExecutor::HandleTaskEviction(TaskDescriptor* td) {
   td->set_finish_time(time_manager_->GetCurrentTimestamp());
   td->set_total_run_time(UpdateTaskTotalRunTime(*td));
@@ -244,18 +305,22 @@ void LocalExecutor::RunTask(TaskDescriptor* td,
   // Mark the start time of the task.
   td->set_start_time(start_time);
   td->set_total_unscheduled_time(UpdateTaskTotalUnscheduledTime(*td));
-  // XXX(malte): Move this over to use RunProcessAsync, instead of custom thread
-  // spawning.
-  boost::unique_lock<boost::mutex> exec_lock(exec_mutex_);
-  boost::unique_lock<boost::shared_mutex> handler_lock(handler_map_mutex_);
-  boost::thread* task_thread = new boost::thread(
-      boost::bind(&LocalExecutor::_RunTask, this, td, firmament_binary));
-  CHECK(InsertIfNotPresent(&task_handler_threads_, td->uid(), task_thread));
-  exec_condvar_.wait(exec_lock);
+  // We do not wait for the task here; the reaper records its exit, which is
+  // picked up by the next health check.
+  if (LaunchTask(td, firmament_binary, false) != 0)
+    LOG(ERROR) << "Failed to launch task " << td->uid();
 }
 
 bool LocalExecutor::_RunTask(TaskDescriptor* td,
                              bool firmament_binary) {
+  bool res = (LaunchTask(td, firmament_binary, true) == 0);
+  VLOG(1) << "Result of RunProcessSync was " << res;
+  return res;
+}
+
+int32_t LocalExecutor::LaunchTask(TaskDescriptor* td,
+                                  bool firmament_binary,
+                                  bool wait_for_exit) {
   // Convert arguments as specified in TD into a string vector that we can munge
   // into an actual argv[].
   vector<string> args;
@@ -273,13 +338,18 @@ bool LocalExecutor::_RunTask(TaskDescriptor* td,
   // arguments: binary (path + name), arguments, performance monitoring on/off,
   // debugging flags, is this a Firmament task binary? (on/off; will cause
   // default arugments to be passed)
-  bool res = (RunProcessSync(
-      td->uid(), td->binary(), args, env, FLAGS_perf_monitoring,
-      (FLAGS_debug_tasks || ((FLAGS_debug_interactively != 0) &&
-                             (td->uid() == FLAGS_debug_interactively))),
-      firmament_binary, tasklog) == 0);
-  VLOG(1) << "Result of RunProcessSync was " << res;
-  return res;
+  bool debug = (FLAGS_debug_tasks ||
+                ((FLAGS_debug_interactively != 0) &&
+                 (td->uid() == FLAGS_debug_interactively)));
+  if (wait_for_exit) {
+    return RunProcessSync(td->uid(), td->binary(), args, env,
+                          FLAGS_perf_monitoring, debug, firmament_binary,
+                          tasklog);
+  } else {
+    return RunProcessAsync(td->uid(), td->binary(), args, env,
+                           FLAGS_perf_monitoring, debug, firmament_binary,
+                           tasklog);
+  }
 }
 
 int32_t LocalExecutor::RunProcessAsync(TaskID_t task_id,
@@ -290,53 +360,21 @@ int32_t LocalExecutor::RunProcessAsync(TaskID_t task_id,
                                        bool debug,
                                        bool default_args,
                                        const string& tasklog) {
-  // TODO(malte): We lose the thread reference here, so we can never join this
-  // thread. Need to return or store if we ever need it for anythign again.
-  boost::thread async_process_thread(
-      boost::bind(&LocalExecutor::RunProcessSync, this, task_id, cmdline, args,
-                  env, perf_monitoring, debug, default_args, tasklog));
-  // We hard-code the return to zero here; maybe should return a thread
-  // reference instead.
-  return 0;
-}
-
-int32_t LocalExecutor::RunProcessSync(TaskID_t task_id,
-                                      const string& cmdline,
-                                      vector<string> args,
-                                      unordered_map<string, string> env,
-                                      bool perf_monitoring,
-                                      bool debug,
-                                      bool default_args,
-                                      const string& tasklog) {
-  pid_t pid;
-  /*int pipe_to[2];    // pipe to feed input data to task
-  int pipe_from[3];  // pipe to receive output data from task
-  if (pipe(pipe_to) != 0) {
-    PLOG(ERROR) << "Failed to create pipe to task.";
-  }
-  if (pipe(pipe_from) != 0) {
-    PLOG(ERROR) << "Failed to create pipe from task.";
-  }*/
   vector<char*> argv;
   vector<char*> envv;
   // Get paths for task logs
   string tasklog_stdout = tasklog + "-stdout";
   string tasklog_stderr = tasklog + "-stderr";
   // N.B.: only one of debug and perf_monitoring can be active at a time;
-  // debug takes priority here.
+  // debug takes priority here, as we would otherwise count the debugger.
   if (debug) {
     // task debugging is active, so reserve extra space for the
     // gdb invocation prefix.
     argv.reserve(args.size() + (default_args ? 4 : 3));
     AddDebuggingToCommandLine(&argv);
-  } else if (perf_monitoring) {
-    // performance monitoring is active, so reserve extra space for the
-    // "perf" invocation prefix.
-    argv.reserve(args.size() + (default_args ? 11 : 10));
-    AddPerfMonitoringToCommandLine(env, &argv);
+    perf_monitoring = false;
   } else {
-    // no performance monitoring, so we only need to reserve space for the
-    // default and NULL args
+    // we only need to reserve space for the default and NULL args
     argv.reserve(args.size() + (default_args ? 2 : 1));
   }
   argv.push_back((char*)(cmdline.c_str()));  // NOLINT
@@ -375,93 +413,40 @@ int32_t LocalExecutor::RunProcessSync(TaskID_t task_id,
   }
   LOG(INFO) << "COMMAND LINE for task " << task_id << ": "
             << full_cmd_line;
+  // The child must not touch the heap, so work out its working directory now.
+  string data_dir = env["FLAGS_task_data_dir"];
   VLOG(1) << "About to fork child process for task execution of "
           << task_id << "!";
-  pid = fork();
-  switch (pid) {
-    case -1:
-      // Error
-      LOG(ERROR) << "Failed to fork child process.";
-      break;
-    case 0: {
-      // Child
-      // Set up stderr and stdout log redirections to files
-      int stdout_fd = open(tasklog_stdout.c_str(),
-                           O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-      dup2(stdout_fd, STDOUT_FILENO);
-      int stderr_fd = open(tasklog_stderr.c_str(),
-                           O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-      dup2(stderr_fd, STDERR_FILENO);
-      if (close(stdout_fd) != 0)
-        PLOG(FATAL) << "Failed to close stdout FD in child";
-      if (close(stderr_fd) != 0)
-        PLOG(FATAL) << "Failed to close stderr FD in child";
-
-      // Change to task's working directory
-      CHECK_EQ(chdir(env["FLAGS_task_data_dir"].c_str()), 0);
-
-      // Close the open FDs in the child before exec-ing, so that the task does
-      // not inherit all of the coordinator's sockets and FDs.
-      // We start from 3 here in order to avoid closing stdin/stdout/stderr.
-      int fd;
-      int fds;
-      if ((fds = getdtablesize()) == -1) fds = OPEN_MAX_GUESS;
-      for (fd = 3; fd < fds; fd++) {
-        if (close(fd) == -EBADF)
-          break;
-      }
-
-      // kill child process if parent terminates
-      // SOMEDAY(adam): make this portable beyond Linux?
-#ifdef __linux__
-      prctl(PR_SET_PDEATHSIG, SIGHUP);
-#endif
-
-      // Run the task binary
-      execvpe(argv[0], &argv[0], &envv[0]);
-      // execl only returns if there was an error
-      PLOG(ERROR) << "execvp failed for task command '" << full_cmd_line << "'";
-      //ReportTaskExecutionFailure();
-      _exit(1);
-    }
-    default:
-      // Parent
-      VLOG(1) << "Task process with PID " << pid << " created.";
-      {
-        boost::unique_lock<boost::shared_mutex> handler_lock(pid_map_mutex_);
-        CHECK(InsertIfNotPresent(&task_pids_, task_id, pid));
-      }
-      // Pin the task to the appropriate resource
-      if (topology_manager_ && FLAGS_pin_tasks_to_cores)
-        topology_manager_->BindPIDToResource(pid, local_resource_id_);
-      // Notify any other threads waiting to execute processes (?)
-      exec_condvar_.notify_one();
-      // Wait for task to terminate
-      int status;
-      while (waitpid(pid, &status, 0) != pid) {
-        VLOG(3) << "Waiting for child process " << pid << " to exit...";
-      }
-      if (WIFEXITED(status)) {
-        VLOG(1) << "Task process with PID " << pid << " exited with status "
-                << WEXITSTATUS(status);
-      } else if (WIFSIGNALED(status)) {
-        VLOG(1) << "Task process with PID " << pid << " exited due to uncaught "
-                << "signal " << WTERMSIG(status);
-      } else if (WIFSTOPPED(status)) {
-        VLOG(1) << "Task process with PID " << pid << " is stopped due to "
-                << "signal " << WSTOPSIG(status);
-      } else {
-        LOG(ERROR) << "Unexpected exit status: " << hex << status;
-      }
-      return status;
-  }
-  return -1;
+  // The reaper runs ForkAndExecTask on its own thread and calls us back once
+  // the process exits; argv and friends stay alive until Spawn() returns.
+  pid_t pid = reaper_.Spawn(
+      boost::bind(&LocalExecutor::ForkAndExecTask, this, task_id,
+                  perf_monitoring, &argv[0], &envv[0], tasklog_stdout.c_str(),
+                  tasklog_stderr.c_str(), data_dir.c_str()),
+      boost::bind(&LocalExecutor::HandleProcessExit, this, task_id, _1, _2));
+  if (pid < 0)
+    return -1;
+  // Pin the task to the appropriate resource
+  if (topology_manager_ && FLAGS_pin_tasks_to_cores)
+    topology_manager_->BindPIDToResource(pid, local_resource_id_);
+  return 0;
 }
 
-string LocalExecutor::PerfDataFileName(const TaskDescriptor& td) {
-  string fname = FLAGS_task_perf_dir + "/" + (to_string(local_resource_id_)) +
-                 "-" + to_string(td.uid()) + ".perf";
-  return fname;
+int32_t LocalExecutor::RunProcessSync(TaskID_t task_id,
+                                      const string& cmdline,
+                                      vector<string> args,
+                                      unordered_map<string, string> env,
+                                      bool perf_monitoring,
+                                      bool debug,
+                                      bool default_args,
+                                      const string& tasklog) {
+  if (RunProcessAsync(task_id, cmdline, args, env, perf_monitoring, debug,
+                      default_args, tasklog) != 0)
+    return -1;
+  // Wait for task to terminate
+  int32_t status;
+  CHECK(WaitForTaskExit(task_id, -1, &status));
+  return status;
 }
 
 void LocalExecutor::SetUpEnvironmentForTask(
@@ -481,7 +466,6 @@ void LocalExecutor::SetUpEnvironmentForTask(
   InsertIfNotPresent(env, "PATH",
       "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin");
   InsertIfNotPresent(env, "FLAGS_task_id", to_string(td.uid()));
-  InsertIfNotPresent(env, "PERF_FNAME", PerfDataFileName(td));
   InsertIfNotPresent(env, "FLAGS_coordinator_uri", coordinator_uri_);
   InsertIfNotPresent(env, "FLAGS_resource_id", to_string(local_resource_id_));
   InsertIfNotPresent(env, "FLAGS_heartbeat_interval",
@@ -525,32 +509,27 @@ char* LocalExecutor::TokenizeIntoArgv(const string& str, vector<char*>* argv) {
   return str_c_string;
 }
 
-bool LocalExecutor::WaitForPerfFile(const string& file_name) {
-  // This hack is required to avoid a race between the data file being
-  // written by the perf utility and it being opened for reading.
-  // Perf creates a zero-byte file when the task starts, but only syncs
-  // data to it when it finishes.
-  struct stat st;
-  bzero(&st, sizeof(struct stat));
-  uint64_t timestamp = time_manager_->GetCurrentTimestamp();
-  // Wait at most 10s for perf file to become available
-  // TODO(malte): this is a bit of a hack to avoid us getting stuck here
-  // forever; we will want to move to a saner, locking-based scheme here.
-  if (stat(file_name.c_str(), &st) != 0)
-    return false;
-  while (st.st_size == 0 && time_manager_->GetCurrentTimestamp() <=
-         timestamp + 1 * SECONDS_TO_MICROSECONDS) {
-    if (stat(file_name.c_str(), &st) != 0) {
-      PLOG(ERROR) << "Failed to stat perf data file " << file_name;
-      return false;
+bool LocalExecutor::WaitForTaskExit(TaskID_t task_id, int64_t timeout_ms,
+                                    int32_t* status) {
+  // Blocks until the reaper reports the task's process as exited, or for at
+  // most timeout_ms milliseconds (if non-negative).
+  boost::system_time deadline = boost::get_system_time() +
+      boost::posix_time::milliseconds(timeout_ms);
+  boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+  int32_t* exit_status;
+  while ((exit_status = FindOrNull(task_exit_status_, task_id)) == NULL) {
+    if (timeout_ms < 0) {
+      task_exit_condvar_.wait(pid_lock);
+    } else if (!task_exit_condvar_.timed_wait(pid_lock, deadline)) {
+      exit_status = FindOrNull(task_exit_status_, task_id);
+      break;
     }
   }
-  if (st.st_size > 0) {
-    // The perf file exists and contains non-zero data
-    return true;
-  } else {
+  if (!exit_status)
     return false;
-  }
+  if (status)
+    *status = *exit_status;
+  return true;
 }
 
 void LocalExecutor::WriteToPipe(int fd, void* data, size_t len) {
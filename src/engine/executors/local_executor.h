@@ -2,7 +2,8 @@
 // Copyright (c) 2011-2012 Malte Schwarzkopf <malte.schwarzkopf@cl.cam.ac.uk>
 //
 // Ths implements a simple local executor. It currently simply starts processes,
-// sets their CPU affinities and runs them under perf profiling.
+// sets their CPU affinities and counts their perf events. All task processes
+// are created and reaped by a single ChildProcessReaper thread.
 //
 // This class, however, also forms the endpoint of remote executors: what they
 // do, in fact, is to send a message to a remote resource, which will then
@@ -26,14 +27,18 @@
 #include "base/common.h"
 #include "base/types.h"
 #include "base/task_final_report.pb.h"
+#include "engine/executors/child_process_reaper.h"
 #include "engine/executors/task_health_checker.h"
 #include "engine/executors/topology_manager.h"
 #include "misc/time_interface.h"
+#include "platforms/unix/perf_event_counters.h"
 
 namespace firmament {
 namespace executor {
 
 using machine::topology::TopologyManager;
+using platform_unix::PerfEventCounters;
+using platform_unix::PerfEventValues;
 
 class LocalExecutor : public ExecutorInterface {
  public:
@@ -44,6 +49,7 @@ class LocalExecutor : public ExecutorInterface {
                 const string& coordinator_uri,
                 TimeInterface* time_manager,
                 shared_ptr<TopologyManager> topology_mgr);
+  ~LocalExecutor();
   bool CheckRunningTasksHealth(vector<TaskID_t>* failed_tasks);
   void HandleTaskCompletion(TaskDescriptor* td,
                             TaskFinalReport* report);
@@ -66,13 +72,20 @@ class LocalExecutor : public ExecutorInterface {
   FRIEND_TEST(LocalExecutorTest, SimpleTaskExecutionTest);
   FRIEND_TEST(LocalExecutorTest, TaskExecutionWithArgsTest);
   ResourceID_t local_resource_id_;
-  char* AddPerfMonitoringToCommandLine(const unordered_map<string, string>&,
-                                       vector<char*>* argv);
   char* AddDebuggingToCommandLine(vector<char*>* argv);
   void CleanUpCompletedTask(const TaskDescriptor& td);
   void CreateDirectories();
-  void GetPerfDataFromLine(TaskFinalReport* report,
-                           const string& line);
+  pid_t ForkAndExecTask(TaskID_t task_id,
+                        bool perf_monitoring,
+                        char* const* argv,
+                        char* const* envv,
+                        const char* stdout_path,
+                        const char* stderr_path,
+                        const char* data_dir);
+  void HandleProcessExit(TaskID_t task_id, pid_t pid, int status);
+  int32_t LaunchTask(TaskDescriptor* td,
+                     bool firmament_binary,
+                     bool wait_for_exit);
   int32_t RunProcessAsync(TaskID_t task_id,
                           const string& cmdline,
                           vector<string> args,
@@ -91,12 +104,11 @@ class LocalExecutor : public ExecutorInterface {
                          const string& tasklog);
   bool _RunTask(TaskDescriptor* td,
                 bool firmament_binary);
-  string PerfDataFileName(const TaskDescriptor& td);
   void ReadFromPipe(int fd);
   void SetUpEnvironmentForTask(const TaskDescriptor& td,
                                unordered_map<string, string>* env);
   char* TokenizeIntoArgv(const string& str, vector<char*>* argv);
-  bool WaitForPerfFile(const string& file_name);
+  bool WaitForTaskExit(TaskID_t task_id, int64_t timeout_ms, int32_t* status);
   void WriteToPipe(int fd, void* data, size_t len);
   // This holds the currently configured URI of the coordinator for this
   // resource (which must be unique, for now).
@@ -111,13 +123,21 @@ class LocalExecutor : public ExecutorInterface {
   // Heartbeat interval for tasks running on the associated resource, in
   // nanoseconds.
   uint64_t heartbeat_interval_;
-  boost::mutex exec_mutex_;
-  boost::shared_mutex handler_map_mutex_;
+  // Protects task_pids_, task_exit_status_ and task_perf_counters_
   boost::shared_mutex pid_map_mutex_;
-  boost::condition_variable exec_condvar_;
-  // Map to each task's local handler thread
-  unordered_map<TaskID_t, boost::thread*> task_handler_threads_;
+  // Signalled whenever a task's process exits
+  boost::condition_variable_any task_exit_condvar_;
+  // Process of each task launched and not yet cleaned up (-1 if the process
+  // could not be created)
   unordered_map<TaskID_t, pid_t> task_pids_;
+  // wait(2) status of each task whose process has exited, but which has not
+  // been cleaned up yet
+  unordered_map<TaskID_t, int32_t> task_exit_status_;
+  // Perf event counters of each task launched with performance monitoring
+  unordered_map<TaskID_t, PerfEventCounters*> task_perf_counters_;
+  // Creates and reaps all task processes. N.B.: declared last, so that it is
+  // destroyed (and stops invoking our exit callbacks) first.
+  ChildProcessReaper reaper_;
 };
 
 }  // namespace executor
@@ -88,22 +88,27 @@ TEST_F(LocalExecutorTest, SyncProcessExecutionWithArgsTest) {
                              "/tmp/test"), 0);
 }*/
 
-// Tests that we can asynchronously execute a binary with arguments.
-// TODO(ionel): The test fails because the thread can still be running. Join
-// on the async thread in order to fix the test.
-/*TEST_F(LocalExecutorTest, AsyncProcessExecutionWithArgsTest) {
+// Tests that we can asynchronously execute a binary with arguments, and that
+// the health check notices once its process has exited.
+TEST_F(LocalExecutorTest, AsyncProcessExecutionWithArgsTest) {
   ResourceID_t rid;
   WallTime wall_time;
   LocalExecutor le(rid, "", &wall_time);
   vector<string> args;
   unordered_map<string, string> env;
   args.push_back("-l");
-  // We expect to get a return code of 0; this is hard-coded and independent of
-  // whether the process execution succeeds (the actual execution happens in a
-  // newly spawned thread).
+  // We expect to get a return code of 0 as soon as the process is started.
   CHECK_EQ(le.RunProcessAsync(1, "/bin/ls", args, env, false, false, false,
                               "/tmp/test"), 0);
-}*/
+  int32_t status;
+  CHECK(le.WaitForTaskExit(1, -1, &status));
+  CHECK_EQ(status, 0);
+  // The task exited without completing properly, so it counts as failed.
+  vector<TaskID_t> failed_tasks;
+  CHECK(!le.CheckRunningTasksHealth(&failed_tasks));
+  CHECK_EQ(failed_tasks.size(), 1);
+  CHECK_EQ(failed_tasks[0], 1);
+}
 
 // Tests that we can pass execution information in a task descriptor (just a
 // binary name in this case).
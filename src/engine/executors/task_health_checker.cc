@@ -6,31 +6,29 @@
 
 #include <vector>
 
-#if BOOST_VERSION <= 104800
-#include <boost/chrono.hpp>
-#endif
-
 #include "misc/map-util.h"
 #include "misc/utils.h"
 
 namespace firmament {
 
 TaskHealthChecker::TaskHealthChecker(
-    const unordered_map<TaskID_t, boost::thread*>* handler_thread_map,
-    boost::shared_mutex* handler_map_lock)
-  : handler_thread_map_(handler_thread_map),
-    handler_map_lock_(handler_map_lock) {
+    const unordered_map<TaskID_t, pid_t>* task_pid_map,
+    const unordered_map<TaskID_t, int32_t>* task_exit_status_map,
+    boost::shared_mutex* task_map_lock)
+  : task_pid_map_(task_pid_map),
+    task_exit_status_map_(task_exit_status_map),
+    task_map_lock_(task_map_lock) {
 }
 
 bool TaskHealthChecker::Run(vector<TaskID_t>* failed_tasks) {
   bool all_good = true;
-  boost::shared_lock<boost::shared_mutex> map_lock(*handler_map_lock_);
-  for (unordered_map<TaskID_t, boost::thread*>::const_iterator
-       it = handler_thread_map_->begin();
-       it != handler_thread_map_->end();
+  boost::shared_lock<boost::shared_mutex> map_lock(*task_map_lock_);
+  for (unordered_map<TaskID_t, pid_t>::const_iterator
+       it = task_pid_map_->begin();
+       it != task_pid_map_->end();
        ++it) {
     VLOG(2) << "Checking liveness of task " << it->first;
-    if (!CheckTaskLiveness(it->first, it->second)) {
+    if (!CheckTaskLiveness(it->first)) {
       all_good = false;
       LOG(ERROR) << "Task " << it->first << " has failed!";
       failed_tasks->push_back(it->first);
@@ -39,18 +37,12 @@ bool TaskHealthChecker::Run(vector<TaskID_t>* failed_tasks) {
   return all_good;
 }
 
-bool TaskHealthChecker::CheckTaskLiveness(TaskID_t task_id,
-                                          boost::thread* handler_thread) {
-  if (!handler_thread)
-    return false;
-#if BOOST_VERSION <= 104800
-  if (handler_thread->timed_join(boost::posix_time::seconds(1)))
-    return false;
-#else
-  if (handler_thread->try_join_for(boost::chrono::seconds(1)))
-    return false;
-#endif
-  return true;
+bool TaskHealthChecker::CheckTaskLiveness(TaskID_t task_id) {
+  // The child process reaper records the exit status of each task process as
+  // soon as it exits, so a task is alive exactly until it has an exit status.
+  // A task that completed properly will have been cleaned up before we get
+  // here.
+  return !ContainsKey(*task_exit_status_map_, task_id);
 }
 
 }  // namespace firmament
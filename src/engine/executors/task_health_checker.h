@@ -28,15 +28,18 @@ namespace firmament {
 class TaskHealthChecker {
  public:
   TaskHealthChecker(
-      const unordered_map<TaskID_t, boost::thread*>* handler_thread_map,
-      boost::shared_mutex* handler_map_lock);
+      const unordered_map<TaskID_t, pid_t>* task_pid_map,
+      const unordered_map<TaskID_t, int32_t>* task_exit_status_map,
+      boost::shared_mutex* task_map_lock);
   bool Run(vector<TaskID_t>* failed_tasks);
 
  protected:
-  bool CheckTaskLiveness(TaskID_t task_id, boost::thread* handler_thread);
+  bool CheckTaskLiveness(TaskID_t task_id);
 
-  const unordered_map<TaskID_t, boost::thread*>* handler_thread_map_;
-  boost::shared_mutex* handler_map_lock_;
+  const unordered_map<TaskID_t, pid_t>* task_pid_map_;
+  // Tasks whose process has exited (but which have not been cleaned up)
+  const unordered_map<TaskID_t, int32_t>* task_exit_status_map_;
+  boost::shared_mutex* task_map_lock_;
 };
 
 }  // namespace firmament
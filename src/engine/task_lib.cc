@@ -21,6 +21,7 @@
 #include "messages/task_info_message.pb.h"
 #include "messages/task_spawn_message.pb.h"
 #include "messages/task_state_message.pb.h"
+#include "misc/pb_utils.h"
 #include "misc/utils.h"
 #include "platforms/common.h"
 
@@ -35,6 +36,9 @@ DEFINE_uint64(heartbeat_interval, 1000000,
 
 DEFINE_string(tasklib_application, "",
               "The application running alongside tasklib");
+DEFINE_bool(compact_task_heartbeats, false,
+            "Send task heartbeats that only contain the statistics that "
+            "changed since the previous heartbeat.");
 
 #define SET_PROTO_IF_DICT_HAS_INT(proto, dict, member, val) \
   val = json_object_get(dict, # member); \
@@ -47,6 +51,10 @@ DEFINE_string(tasklib_application, "",
 
 namespace firmament {
 
+// In compact mode, every this many heartbeats is sent in full, so that a
+// coordinator that has lost a task's previous heartbeat catches up.
+static const uint64_t kFullHeartbeatInterval = 64;
+
 TaskLib::TaskLib()
   : m_adapter_(new StreamSocketsAdapter<BaseMessage>()),
     chan_(new StreamSocketsChannel<BaseMessage>(
@@ -56,6 +64,7 @@ TaskLib::TaskLib()
     pid_(getpid()),
     task_running_(false),
     heartbeat_seq_number_(0),
+    has_last_heartbeat_(false),
     stop_(false),
     internal_completed_(false),
     completed_(0),
@@ -335,19 +344,41 @@ void TaskLib::SendHeartbeat(
   BaseMessage bm;
   SUBMSG_WRITE(bm, task_heartbeat, task_id, task_id_);
   // Add current set of procfs statistics
-
-  TaskPerfStatisticsSample* taskperf_stats =
-      bm.mutable_task_heartbeat()->mutable_stats();
-
-  AddTaskStatisticsToHeartbeat(proc_stats, taskperf_stats);
-
-  // TODO(malte): we do not always need to send the location string; it
-  // sufficies to send it if our location changed (which should be rare).
-  SUBMSG_WRITE(bm, task_heartbeat, location, chan_->LocalEndpointString());
+  TaskPerfStatisticsSample taskperf_stats;
+  AddTaskStatisticsToHeartbeat(proc_stats, &taskperf_stats);
+  string location = chan_->LocalEndpointString();
+  if (!FLAGS_compact_task_heartbeats) {
+    bm.mutable_task_heartbeat()->mutable_stats()->Swap(&taskperf_stats);
+    SUBMSG_WRITE(bm, task_heartbeat, location, location);
+    SUBMSG_WRITE(bm, task_heartbeat, sequence_number, heartbeat_seq_number_++);
+    SendMessageToCoordinator(&bm);
+    return;
+  }
+  // Compact heartbeat: if the coordinator has our previous heartbeat, we only
+  // send what changed since, and we never resend static fields (such as the
+  // hostname) or an unchanged location.
+  bool delta = has_last_heartbeat_ &&
+    heartbeat_seq_number_ % kFullHeartbeatInterval != 0;
+  if (delta) {
+    DeltaEncodeTaskStatistics(last_heartbeat_stats_, taskperf_stats,
+                              bm.mutable_task_heartbeat()->mutable_stats());
+    if (location != last_heartbeat_location_) {
+      SUBMSG_WRITE(bm, task_heartbeat, location, location);
+    }
+  } else {
+    bm.mutable_task_heartbeat()->mutable_stats()->CopyFrom(taskperf_stats);
+    SUBMSG_WRITE(bm, task_heartbeat, location, location);
+  }
+  SUBMSG_WRITE(bm, task_heartbeat, delta, delta);
   SUBMSG_WRITE(bm, task_heartbeat, sequence_number, heartbeat_seq_number_++);
-
-  //LOG(INFO) << "Sending heartbeat message!";
-  SendMessageToCoordinator(&bm);
+  // The channel delivers heartbeats in order, so once the send has succeeded
+  // the coordinator can apply the next delta to this heartbeat. If it failed,
+  // we start over with a full heartbeat.
+  has_last_heartbeat_ = SendMessageToCoordinator(&bm);
+  if (has_last_heartbeat_) {
+    last_heartbeat_stats_.Swap(&taskperf_stats);
+    last_heartbeat_location_ = location;
+  }
 }
 
 bool TaskLib::SendMessageToCoordinator(BaseMessage* msg) {
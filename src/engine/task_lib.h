@@ -93,6 +93,11 @@ class TaskLib {
   pid_t pid_;
   volatile bool task_running_;
   uint64_t heartbeat_seq_number_;
+  // The statistics and location of the last heartbeat that was sent, which
+  // compact heartbeats are relative to.
+  bool has_last_heartbeat_;
+  TaskPerfStatisticsSample last_heartbeat_stats_;
+  string last_heartbeat_location_;
   bool use_procfs_;
   string hostname_;
   WallTime time_manager_;
@@ -0,0 +1,111 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Varint encoding and length-prefixed framing for binary streams. A frame is
+// a varint-encoded payload length followed by the payload. Signed values are
+// zig-zag encoded, so that small negative numbers are short as well.
+
+#ifndef FIRMAMENT_MISC_BINARY_FRAME_H
+#define FIRMAMENT_MISC_BINARY_FRAME_H
+
+#include <cstdio>
+#include <string>
+
+#include "base/common.h"
+
+namespace firmament {
+
+// Maximum number of bytes a varint-encoded uint64_t can take.
+#define MAX_VARINT_LENGTH 10
+// Maximum payload length of a frame we accept from a stream (1 GB).
+#define MAX_BINARY_FRAME_LENGTH (1ULL << 30)
+
+inline void AppendVarint(uint64_t value, string* buffer) {
+  char bytes[MAX_VARINT_LENGTH];
+  uint32_t length = 0;
+  while (value >= 0x80) {
+    bytes[length++] = static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  bytes[length++] = static_cast<char>(value);
+  buffer->append(bytes, length);
+}
+
+inline void AppendSignedVarint(int64_t value, string* buffer) {
+  AppendVarint((static_cast<uint64_t>(value) << 1) ^
+               static_cast<uint64_t>(value >> 63), buffer);
+}
+
+/**
+ * Decodes a varint starting at *pos and advances *pos past it.
+ * @return false if the buffer ends before the varint does
+ */
+inline bool ReadVarint(const char** pos, const char* end, uint64_t* value) {
+  uint64_t result = 0;
+  for (uint32_t shift = 0; *pos < end && shift < 64; shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(**pos);
+    (*pos)++;
+    result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool ReadSignedVarint(const char** pos, const char* end,
+                             int64_t* value) {
+  uint64_t encoded;
+  if (!ReadVarint(pos, end, &encoded)) {
+    return false;
+  }
+  *value = static_cast<int64_t>(encoded >> 1) ^
+    -static_cast<int64_t>(encoded & 1);
+  return true;
+}
+
+/**
+ * Writes a length-prefixed frame to the stream. The caller is responsible
+ * for flushing the stream.
+ * @return false if the frame could not be written (e.g., because the reader
+ * has closed the stream)
+ */
+inline bool WriteBinaryFrame(const string& payload, FILE* stream) {
+  string header;
+  AppendVarint(payload.size(), &header);
+  return fwrite(header.data(), 1, header.size(), stream) == header.size() &&
+    fwrite(payload.data(), 1, payload.size(), stream) == payload.size();
+}
+
+/**
+ * Reads a length-prefixed frame from the stream.
+ * @return false if the stream ended before a complete frame was read, or if
+ * the frame is longer than MAX_BINARY_FRAME_LENGTH
+ */
+inline bool ReadBinaryFrame(FILE* stream, string* payload) {
+  uint64_t length = 0;
+  int byte;
+  uint32_t shift = 0;
+  do {
+    if ((byte = getc(stream)) == EOF || shift >= 64) {
+      return false;
+    }
+    length |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  if (length > MAX_BINARY_FRAME_LENGTH) {
+    // Most likely a corrupted stream. We must not try to allocate a buffer
+    // for it.
+    LOG(ERROR) << "Binary frame of " << length << " bytes exceeds the "
+               << "maximum frame length";
+    return false;
+  }
+  payload->resize(length);
+  return length == 0 ||
+    fread(&(*payload)[0], 1, length, stream) == length;
+}
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_BINARY_FRAME_H
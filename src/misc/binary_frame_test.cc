@@ -0,0 +1,146 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the varint encoding and binary framing helpers.
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "misc/binary_frame.h"
+
+namespace firmament {
+
+// The fixture for testing the binary framing helpers.
+class BinaryFrameTest : public ::testing::Test {
+ protected:
+  BinaryFrameTest() {
+    FLAGS_v = 2;
+  }
+
+  uint64_t ExpectVarint(const char** pos, const char* end) {
+    uint64_t value = 0;
+    EXPECT_TRUE(ReadVarint(pos, end, &value));
+    return value;
+  }
+
+  int64_t ExpectSignedVarint(const char** pos, const char* end) {
+    int64_t value = 0;
+    EXPECT_TRUE(ReadSignedVarint(pos, end, &value));
+    return value;
+  }
+};
+
+TEST_F(BinaryFrameTest, VarintRoundTrip) {
+  vector<uint64_t> values = {0, 1, 127, 128, 300, 16383, 16384,
+                             numeric_limits<uint32_t>::max(),
+                             numeric_limits<uint64_t>::max()};
+  vector<int64_t> signed_values = {0, 1, -1, 63, -64, 64, -65,
+                                   numeric_limits<int64_t>::max(),
+                                   numeric_limits<int64_t>::min()};
+  string buffer;
+  for (auto& value : values) {
+    AppendVarint(value, &buffer);
+  }
+  for (auto& value : signed_values) {
+    AppendSignedVarint(value, &buffer);
+  }
+  const char* pos = buffer.data();
+  const char* end = pos + buffer.size();
+  for (auto& value : values) {
+    EXPECT_EQ(value, ExpectVarint(&pos, end));
+  }
+  for (auto& value : signed_values) {
+    EXPECT_EQ(value, ExpectSignedVarint(&pos, end));
+  }
+  EXPECT_EQ(pos, end);
+}
+
+TEST_F(BinaryFrameTest, VarintEncodingLength) {
+  string buffer;
+  AppendVarint(127, &buffer);
+  EXPECT_EQ(1, buffer.size());
+  buffer.clear();
+  AppendVarint(128, &buffer);
+  EXPECT_EQ(2, buffer.size());
+  buffer.clear();
+  AppendVarint(numeric_limits<uint64_t>::max(), &buffer);
+  EXPECT_EQ(MAX_VARINT_LENGTH, buffer.size());
+  // Small negative numbers are short as well.
+  buffer.clear();
+  AppendSignedVarint(-64, &buffer);
+  EXPECT_EQ(1, buffer.size());
+}
+
+TEST_F(BinaryFrameTest, TruncatedVarint) {
+  string buffer;
+  AppendVarint(16384, &buffer);
+  const char* pos = buffer.data();
+  uint64_t value;
+  EXPECT_FALSE(ReadVarint(&pos, buffer.data() + buffer.size() - 1, &value));
+  pos = buffer.data();
+  EXPECT_FALSE(ReadVarint(&pos, pos, &value));
+}
+
+TEST_F(BinaryFrameTest, FrameRoundTrip) {
+  FILE* stream = tmpfile();
+  ASSERT_TRUE(stream != NULL);
+  string payload(300, 'x');
+  payload[0] = '\0';
+  ASSERT_TRUE(WriteBinaryFrame("", stream));
+  ASSERT_TRUE(WriteBinaryFrame(payload, stream));
+  rewind(stream);
+  string frame;
+  ASSERT_TRUE(ReadBinaryFrame(stream, &frame));
+  EXPECT_TRUE(frame.empty());
+  ASSERT_TRUE(ReadBinaryFrame(stream, &frame));
+  EXPECT_EQ(payload, frame);
+  EXPECT_FALSE(ReadBinaryFrame(stream, &frame));
+  fclose(stream);
+}
+
+TEST_F(BinaryFrameTest, TruncatedFrame) {
+  FILE* stream = tmpfile();
+  ASSERT_TRUE(stream != NULL);
+  string header;
+  AppendVarint(10, &header);
+  fwrite(header.data(), 1, header.size(), stream);
+  fwrite("abc", 1, 3, stream);
+  rewind(stream);
+  string frame;
+  EXPECT_FALSE(ReadBinaryFrame(stream, &frame));
+  fclose(stream);
+}
+
+TEST_F(BinaryFrameTest, OversizedFrame) {
+  FILE* stream = tmpfile();
+  ASSERT_TRUE(stream != NULL);
+  string header;
+  AppendVarint(MAX_BINARY_FRAME_LENGTH + 1, &header);
+  fwrite(header.data(), 1, header.size(), stream);
+  rewind(stream);
+  string frame;
+  EXPECT_FALSE(ReadBinaryFrame(stream, &frame));
+  EXPECT_TRUE(frame.empty());
+  fclose(stream);
+}
+
+TEST_F(BinaryFrameTest, WriteFrameFailure) {
+  // Writing to a stream that is only open for reading fails like writing to
+  // a reader that has exited does.
+  FILE* stream = fopen("/dev/null", "r");
+  ASSERT_TRUE(stream != NULL);
+  EXPECT_FALSE(WriteBinaryFrame("payload", stream));
+  fclose(stream);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,102 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Counters for received messages, by message type.
+
+#include "misc/message_stats.h"
+
+namespace firmament {
+
+// Slot of the fields whose numbers are too large to have their own counters.
+static const int kOtherFieldsSlot = MESSAGE_STATS_MAX_FIELD_NUMBER + 1;
+
+void MessageStats::RecordMessage(const google::protobuf::Message& msg,
+                                 uint64_t bytes, bool new_message) {
+  const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
+  const google::protobuf::Reflection* reflection = msg.GetReflection();
+  bool has_field = false;
+  for (int32_t index = 0; index < descriptor->field_count(); ++index) {
+    const google::protobuf::FieldDescriptor* field = descriptor->field(index);
+    if (field->is_repeated() ? reflection->FieldSize(msg, field) == 0 :
+        !reflection->HasField(msg, field)) {
+      continue;
+    }
+    has_field = true;
+    if (field->number() > MESSAGE_STATS_MAX_FIELD_NUMBER) {
+      RecordInSlot(&counters_[kOtherFieldsSlot], bytes, new_message);
+      continue;
+    }
+    FieldCounters* counters = &counters_[field->number()];
+    // A field number always refers to the same field, as the adapter only
+    // receives messages of one type.
+    if (counters->field_.load(std::memory_order_relaxed) == NULL) {
+      counters->field_.store(field, std::memory_order_relaxed);
+    }
+    RecordInSlot(counters, bytes, new_message);
+  }
+  if (!has_field) {
+    RecordUntypedMessage(bytes, new_message);
+  }
+}
+
+void MessageStats::RecordUntypedMessage(uint64_t bytes, bool new_message) {
+  RecordInSlot(&counters_[0], bytes, new_message);
+}
+
+void MessageStats::RecordInSlot(FieldCounters* counters, uint64_t bytes,
+                                bool new_message) {
+  counters->messages_.fetch_add(1, std::memory_order_relaxed);
+  counters->bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  if (new_message) {
+    counters->new_messages_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+MessageTypeStats MessageStats::GetTypeStats(const string& type) {
+  MessageTypeStats stats;
+  const FieldCounters* counters = NULL;
+  if (type.empty()) {
+    counters = &counters_[0];
+  } else if (type == "(other)") {
+    counters = &counters_[kOtherFieldsSlot];
+  } else {
+    for (int32_t slot = 1; slot <= MESSAGE_STATS_MAX_FIELD_NUMBER; ++slot) {
+      const google::protobuf::FieldDescriptor* field =
+        counters_[slot].field_.load(std::memory_order_relaxed);
+      if (field != NULL && field->name() == type) {
+        counters = &counters_[slot];
+        break;
+      }
+    }
+    if (counters == NULL) {
+      return stats;
+    }
+  }
+  stats.messages_ = counters->messages_.load(std::memory_order_relaxed);
+  stats.bytes_ = counters->bytes_.load(std::memory_order_relaxed);
+  stats.new_messages_ = counters->new_messages_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+string MessageStats::GetStatsString() {
+  stringstream ss;
+  for (int32_t slot = 0; slot <= kOtherFieldsSlot; ++slot) {
+    const FieldCounters& counters = counters_[slot];
+    uint64_t messages = counters.messages_.load(std::memory_order_relaxed);
+    if (messages == 0) {
+      continue;
+    }
+    const google::protobuf::FieldDescriptor* field =
+      counters.field_.load(std::memory_order_relaxed);
+    uint64_t bytes = counters.bytes_.load(std::memory_order_relaxed);
+    ss << (field != NULL ? field->name() :
+           (slot == 0 ? "(untyped)" : "(other)")) << ": "
+       << messages << " messages, " << bytes << " bytes ("
+       << (bytes / messages) << " per message), "
+       << counters.new_messages_.load(std::memory_order_relaxed)
+       << " new messages; ";
+  }
+  return ss.str();
+}
+
+}  // namespace firmament
@@ -0,0 +1,81 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Counters for received messages, by message type. The type of a protobuf
+// message is the name of each of its top-level fields that is set; for a
+// BaseMessage, this is the name of the sub-message it carries (e.g.,
+// "heartbeat"). A message that carries several sub-messages is counted once
+// for each of them.
+
+#ifndef FIRMAMENT_MISC_MESSAGE_STATS_H
+#define FIRMAMENT_MISC_MESSAGE_STATS_H
+
+#include <atomic>
+#include <string>
+
+#include <google/protobuf/descriptor.h>
+
+#include "base/common.h"
+
+namespace firmament {
+
+// Fields with numbers up to this have their own counters. The fields with
+// larger numbers are counted together, as "(other)".
+#define MESSAGE_STATS_MAX_FIELD_NUMBER 63
+
+struct MessageTypeStats {
+  MessageTypeStats() : messages_(0), bytes_(0), new_messages_(0) {}
+  uint64_t messages_;
+  uint64_t bytes_;
+  // Number of messages that were decoded into a newly allocated message
+  // object rather than into a recycled one. Once the receiver's message
+  // objects have been recycled a few times, this should stop growing.
+  uint64_t new_messages_;
+};
+
+class MessageStats {
+ public:
+  /**
+   * Records the receipt of a protobuf message. Safe to call from several
+   * threads at once; it neither locks nor allocates.
+   * @param msg the decoded message
+   * @param bytes the size of the message on the wire
+   * @param new_message true if the message object was newly allocated
+   */
+  void RecordMessage(const google::protobuf::Message& msg, uint64_t bytes,
+                     bool new_message);
+  /**
+   * Records the receipt of a message that has no type (i.e., one that is not
+   * a protobuf, or one without any field set).
+   */
+  void RecordUntypedMessage(uint64_t bytes, bool new_message);
+  /**
+   * @return the counters for messages of the given type; the empty string
+   * stands for untyped messages
+   */
+  MessageTypeStats GetTypeStats(const string& type);
+  string GetStatsString();
+
+ private:
+  struct FieldCounters {
+    FieldCounters() : field_(NULL), messages_(0), bytes_(0),
+                      new_messages_(0) {}
+    // The field counted here, or NULL for the untyped and other messages
+    // and for fields that have not been seen yet.
+    std::atomic<const google::protobuf::FieldDescriptor*> field_;
+    std::atomic<uint64_t> messages_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> new_messages_;
+  };
+
+  void RecordInSlot(FieldCounters* counters, uint64_t bytes,
+                    bool new_message);
+
+  // Counters by field number. Field numbers start at 1, so slot 0 counts the
+  // untyped messages; the last slot counts the other messages.
+  FieldCounters counters_[MESSAGE_STATS_MAX_FIELD_NUMBER + 2];
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_MESSAGE_STATS_H
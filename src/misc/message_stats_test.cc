@@ -0,0 +1,101 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the received message counters.
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "base/common.h"
+#include "messages/base_message.pb.h"
+#include "misc/message_stats.h"
+
+namespace firmament {
+
+// Records the message num_messages times; the first one counts as new.
+static void RecordMessages(MessageStats* stats, const BaseMessage& bm,
+                           uint32_t num_messages) {
+  for (uint32_t i = 0; i < num_messages; ++i) {
+    stats->RecordMessage(bm, 3, i == 0);
+  }
+}
+
+class MessageStatsTest : public ::testing::Test {
+ protected:
+  MessageStatsTest() {
+    FLAGS_v = 2;
+  }
+};
+
+TEST_F(MessageStatsTest, CountsBySubMessage) {
+  MessageStats stats;
+  BaseMessage bm;
+  SUBMSG_WRITE(bm, test, test, 5);
+  stats.RecordMessage(bm, 10, true);
+  stats.RecordMessage(bm, 20, false);
+  MessageTypeStats test_stats = stats.GetTypeStats("test");
+  EXPECT_EQ(test_stats.messages_, 2);
+  EXPECT_EQ(test_stats.bytes_, 30);
+  EXPECT_EQ(test_stats.new_messages_, 1);
+  EXPECT_EQ(stats.GetTypeStats("heartbeat").messages_, 0);
+}
+
+TEST_F(MessageStatsTest, CountsEachSubMessageOfAMessage) {
+  MessageStats stats;
+  BaseMessage bm;
+  SUBMSG_WRITE(bm, test, test, 5);
+  SUBMSG_WRITE(bm, heartbeat, uuid, "foo");
+  stats.RecordMessage(bm, 10, false);
+  EXPECT_EQ(stats.GetTypeStats("test").messages_, 1);
+  EXPECT_EQ(stats.GetTypeStats("heartbeat").messages_, 1);
+  EXPECT_EQ(stats.GetTypeStats("heartbeat").bytes_, 10);
+}
+
+TEST_F(MessageStatsTest, CountsUntypedMessages) {
+  MessageStats stats;
+  stats.RecordUntypedMessage(8, true);
+  stats.RecordUntypedMessage(8, false);
+  // A message without any field set has no type either
+  BaseMessage bm;
+  stats.RecordMessage(bm, 4, false);
+  EXPECT_EQ(stats.GetTypeStats("").messages_, 3);
+  EXPECT_EQ(stats.GetTypeStats("").bytes_, 20);
+  EXPECT_EQ(stats.GetTypeStats("").new_messages_, 1);
+}
+
+TEST_F(MessageStatsTest, CountsRepeatedFields) {
+  MessageStats stats;
+  BaseMessage bm;
+  bm.add_task_heartbeats()->set_task_id(1);
+  bm.add_task_heartbeats()->set_task_id(2);
+  stats.RecordMessage(bm, 10, false);
+  stats.RecordMessage(bm, 10, false);
+  EXPECT_EQ(stats.GetTypeStats("task_heartbeats").messages_, 2);
+  EXPECT_EQ(stats.GetTypeStats("task_heartbeat").messages_, 0);
+  EXPECT_EQ(stats.GetStatsString(), "task_heartbeats: 2 messages, 20 bytes "
+            "(10 per message), 0 new messages; ");
+}
+
+TEST_F(MessageStatsTest, ConcurrentRecording) {
+  MessageStats stats;
+  BaseMessage bm;
+  SUBMSG_WRITE(bm, heartbeat, uuid, "foo");
+  boost::thread_group threads;
+  for (uint32_t i = 0; i < 4; ++i) {
+    threads.create_thread(boost::bind(&RecordMessages, &stats, bm, 1000));
+  }
+  threads.join_all();
+  MessageTypeStats heartbeat_stats = stats.GetTypeStats("heartbeat");
+  EXPECT_EQ(heartbeat_stats.messages_, 4000);
+  EXPECT_EQ(heartbeat_stats.bytes_, 12000);
+  EXPECT_EQ(heartbeat_stats.new_messages_, 4);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
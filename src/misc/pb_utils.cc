@@ -7,6 +7,11 @@
 
 #include "misc/pb_utils.h"
 
+#define SET_PROTO_IF_CHANGED(delta, prev, cur, member) \
+  if (cur.has_ ## member() && \
+      (!prev.has_ ## member() || prev.member() != cur.member())) \
+    delta->set ## _ ## member(cur.member());
+
 namespace firmament {
 
 // Overload taking a callback that itself takes a ResourceDescriptor as its
@@ -138,4 +143,18 @@ void BFSTraverseResourceProtobufTreeToHash(
   }
 }
 
+void DeltaEncodeTaskStatistics(const TaskPerfStatisticsSample& prev,
+                               const TaskPerfStatisticsSample& cur,
+                               TaskPerfStatisticsSample* delta) {
+  // The task ID and timestamp are required
+  delta->set_task_id(cur.task_id());
+  delta->set_timestamp(cur.timestamp());
+  SET_PROTO_IF_CHANGED(delta, prev, cur, vsize);
+  SET_PROTO_IF_CHANGED(delta, prev, cur, rsize);
+  SET_PROTO_IF_CHANGED(delta, prev, cur, sched_run);
+  SET_PROTO_IF_CHANGED(delta, prev, cur, sched_wait);
+  SET_PROTO_IF_CHANGED(delta, prev, cur, completed);
+  SET_PROTO_IF_CHANGED(delta, prev, cur, hostname);
+}
+
 }  // namespace firmament
@@ -11,6 +11,7 @@
 #include "base/common.h"
 #include "base/types.h"
 #include "base/resource_topology_node_desc.pb.h"
+#include "base/task_perf_statistics_sample.pb.h"
 
 namespace firmament {
 
@@ -48,6 +49,13 @@ void BFSTraverseResourceProtobufTreeToHash(
     ResourceTopologyNodeDescriptor* pb, size_t* hash,
     boost::function<void(ResourceTopologyNodeDescriptor*, size_t*)> callback);  // NOLINT
 
+// Sets the fields of cur that are unset or different in prev in delta, so
+// that merging delta into prev yields cur. Fields that are set in prev but
+// not in cur cannot be expressed, and are left out.
+void DeltaEncodeTaskStatistics(const TaskPerfStatisticsSample& prev,
+                               const TaskPerfStatisticsSample& cur,
+                               TaskPerfStatisticsSample* delta);
+
 template <typename T>
 bool RepeatedContainsPtr(RepeatedPtrField<T>* pbf, T* item) {
   // N.B.: using GNU-style RTTI
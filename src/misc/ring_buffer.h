@@ -0,0 +1,79 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Fixed-capacity FIFO that overwrites its oldest element once full. The
+// storage grows up to the capacity and is then reused, so a full ring buffer
+// does not allocate or free any memory when new elements are added.
+
+#ifndef FIRMAMENT_MISC_RING_BUFFER_H
+#define FIRMAMENT_MISC_RING_BUFFER_H
+
+#include <deque>
+#include <vector>
+
+#include "base/common.h"
+
+namespace firmament {
+
+template <typename T>
+class RingBuffer {
+ public:
+  explicit RingBuffer(uint64_t capacity) : capacity_(capacity), head_(0) {
+    CHECK_GT(capacity_, 0);
+  }
+
+  /**
+   * Appends an element. If the buffer is full, the oldest element is
+   * overwritten.
+   */
+  void push_back(const T& element) {
+    if (elements_.size() < capacity_) {
+      elements_.push_back(element);
+    } else {
+      elements_[head_] = element;
+      head_ = (head_ + 1) % capacity_;
+    }
+  }
+
+  /**
+   * @return the index-th oldest element
+   */
+  inline const T& operator[](uint64_t index) const {
+    return elements_[(head_ + index) % elements_.size()];
+  }
+
+  inline const T& back() const {
+    return (*this)[elements_.size() - 1];
+  }
+
+  inline uint64_t capacity() const {
+    return capacity_;
+  }
+
+  inline bool empty() const {
+    return elements_.empty();
+  }
+
+  inline uint64_t size() const {
+    return elements_.size();
+  }
+
+  /**
+   * Copies the elements, oldest first, to a deque.
+   */
+  void CopyTo(deque<T>* elements) const {
+    for (uint64_t index = 0; index < elements_.size(); ++index) {
+      elements->push_back((*this)[index]);
+    }
+  }
+
+ private:
+  uint64_t capacity_;
+  vector<T> elements_;
+  // Index of the oldest element in elements_.
+  uint64_t head_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_RING_BUFFER_H
@@ -0,0 +1,54 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the fixed-capacity ring buffer.
+
+#include <gtest/gtest.h>
+
+#include <deque>
+
+#include "base/common.h"
+#include "misc/ring_buffer.h"
+
+namespace firmament {
+
+class RingBufferTest : public ::testing::Test {
+ protected:
+  RingBufferTest() {
+    FLAGS_v = 2;
+  }
+};
+
+TEST_F(RingBufferTest, FillsUpToCapacity) {
+  RingBuffer<uint64_t> ring(3);
+  EXPECT_TRUE(ring.empty());
+  ring.push_back(1);
+  ring.push_back(2);
+  EXPECT_EQ(ring.size(), 2);
+  EXPECT_EQ(ring[0], 1);
+  EXPECT_EQ(ring.back(), 2);
+}
+
+TEST_F(RingBufferTest, OverwritesOldestElements) {
+  RingBuffer<uint64_t> ring(3);
+  for (uint64_t i = 0; i < 8; ++i) {
+    ring.push_back(i);
+  }
+  EXPECT_EQ(ring.size(), 3);
+  EXPECT_EQ(ring[0], 5);
+  EXPECT_EQ(ring[1], 6);
+  EXPECT_EQ(ring[2], 7);
+  EXPECT_EQ(ring.back(), 7);
+  deque<uint64_t> elements;
+  ring.CopyTo(&elements);
+  EXPECT_EQ(elements.size(), 3);
+  EXPECT_EQ(elements.front(), 5);
+  EXPECT_EQ(elements.back(), 7);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,83 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Append-only, indexable container that allocates its elements in large
+// slabs. Unlike std::vector, elements never move when the container grows,
+// so pointers to them remain valid. Unlike std::deque, the slab size is
+// under our control (libstdc++ deques use 512 byte chunks, which means one
+// heap allocation per element for large types).
+
+#ifndef FIRMAMENT_MISC_SLAB_VECTOR_H
+#define FIRMAMENT_MISC_SLAB_VECTOR_H
+
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "base/common.h"
+
+namespace firmament {
+
+template <typename T, uint32_t kSlabSize = 1024>
+class SlabVector {
+ public:
+  SlabVector() : size_(0) {
+  }
+
+  ~SlabVector() {
+    for (uint64_t index = 0; index < size_; ++index) {
+      (*this)[index].~T();
+    }
+    for (auto& slab : slabs_) {
+      ::operator delete(slab);
+    }
+  }
+
+  inline T& operator[](uint64_t index) {
+    return slabs_[index / kSlabSize][index % kSlabSize];
+  }
+
+  inline const T& operator[](uint64_t index) const {
+    return slabs_[index / kSlabSize][index % kSlabSize];
+  }
+
+  inline T& back() {
+    return (*this)[size_ - 1];
+  }
+
+  /**
+   * Constructs a new element at the end of the container.
+   * @return a reference to the new element
+   */
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    if (size_ == slabs_.size() * kSlabSize) {
+      slabs_.push_back(
+          static_cast<T*>(::operator new(sizeof(T) * kSlabSize)));
+    }
+    T* element = &slabs_[size_ / kSlabSize][size_ % kSlabSize];
+    new (element) T(std::forward<Args>(args)...);
+    size_++;
+    return *element;
+  }
+
+  inline uint64_t num_slabs() const {
+    return slabs_.size();
+  }
+
+  inline uint64_t size() const {
+    return size_;
+  }
+
+ private:
+  // Uncopyable, as we hand out pointers to the elements.
+  SlabVector(const SlabVector&);
+  SlabVector& operator=(const SlabVector&);
+
+  vector<T*> slabs_;
+  uint64_t size_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_SLAB_VECTOR_H
@@ -0,0 +1,111 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "misc/streaming_quantile.h"
+
+#include <algorithm>
+
+namespace firmament {
+
+StreamingQuantile::StreamingQuantile(double quantile)
+  : quantile_(quantile), count_(0) {
+  CHECK_GT(quantile, 0.0);
+  CHECK_LT(quantile, 1.0);
+  for (int32_t marker = 0; marker < 5; ++marker) {
+    heights_[marker] = 0.0;
+    positions_[marker] = marker;
+  }
+  desired_positions_[0] = 0.0;
+  desired_positions_[1] = 2.0 * quantile;
+  desired_positions_[2] = 4.0 * quantile;
+  desired_positions_[3] = 2.0 + 2.0 * quantile;
+  desired_positions_[4] = 4.0;
+  increments_[0] = 0.0;
+  increments_[1] = quantile / 2.0;
+  increments_[2] = quantile;
+  increments_[3] = (1.0 + quantile) / 2.0;
+  increments_[4] = 1.0;
+}
+
+void StreamingQuantile::Add(double value) {
+  if (count_ < 5) {
+    // The first five values initialize the markers.
+    heights_[count_++] = value;
+    if (count_ == 5) {
+      sort(heights_, heights_ + 5);
+    }
+    return;
+  }
+  count_++;
+  // Find the cell the value falls in, and adjust the extreme markers.
+  int32_t cell;
+  if (value < heights_[0]) {
+    heights_[0] = value;
+    cell = 0;
+  } else if (value >= heights_[4]) {
+    heights_[4] = value;
+    cell = 3;
+  } else {
+    cell = 0;
+    while (value >= heights_[cell + 1]) {
+      cell++;
+    }
+  }
+  for (int32_t marker = cell + 1; marker < 5; ++marker) {
+    positions_[marker]++;
+  }
+  for (int32_t marker = 0; marker < 5; ++marker) {
+    desired_positions_[marker] += increments_[marker];
+  }
+  // Move the middle markers towards their desired positions.
+  for (int32_t marker = 1; marker < 4; ++marker) {
+    double delta = desired_positions_[marker] - positions_[marker];
+    if ((delta >= 1.0 &&
+         positions_[marker + 1] - positions_[marker] > 1.0) ||
+        (delta <= -1.0 &&
+         positions_[marker - 1] - positions_[marker] < -1.0)) {
+      int32_t direction = delta > 0.0 ? 1 : -1;
+      double height = Parabolic(marker, direction);
+      if (heights_[marker - 1] < height && height < heights_[marker + 1]) {
+        heights_[marker] = height;
+      } else {
+        heights_[marker] = Linear(marker, direction);
+      }
+      positions_[marker] += direction;
+    }
+  }
+}
+
+double StreamingQuantile::Linear(int32_t marker, int32_t direction) const {
+  return heights_[marker] +
+    direction * (heights_[marker + direction] - heights_[marker]) /
+    (positions_[marker + direction] - positions_[marker]);
+}
+
+double StreamingQuantile::Parabolic(int32_t marker, double direction) const {
+  return heights_[marker] + direction /
+    (positions_[marker + 1] - positions_[marker - 1]) *
+    ((positions_[marker] - positions_[marker - 1] + direction) *
+     (heights_[marker + 1] - heights_[marker]) /
+     (positions_[marker + 1] - positions_[marker]) +
+     (positions_[marker + 1] - positions_[marker] - direction) *
+     (heights_[marker] - heights_[marker - 1]) /
+     (positions_[marker] - positions_[marker - 1]));
+}
+
+double StreamingQuantile::Value() const {
+  if (count_ == 0) {
+    return 0.0;
+  }
+  if (count_ < 5) {
+    // Not enough values for the markers yet. Compute the exact quantile.
+    double values[5];
+    copy(heights_, heights_ + count_, values);
+    sort(values, values + count_);
+    uint64_t index = static_cast<uint64_t>(quantile_ * (count_ - 1) + 0.5);
+    return values[index];
+  }
+  return heights_[2];
+}
+
+}  // namespace firmament
@@ -0,0 +1,51 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Constant-space estimator of a quantile of a stream of values. It
+// implements the P-square algorithm (Jain and Chlamtac, 1985), which
+// maintains five markers whose heights approximate the minimum, the
+// maximum, the quantile and two intermediate quantiles.
+
+#ifndef FIRMAMENT_MISC_STREAMING_QUANTILE_H
+#define FIRMAMENT_MISC_STREAMING_QUANTILE_H
+
+#include "base/common.h"
+
+namespace firmament {
+
+class StreamingQuantile {
+ public:
+  /**
+   * @param quantile the quantile to estimate, in (0, 1)
+   */
+  explicit StreamingQuantile(double quantile);
+  void Add(double value);
+
+  /**
+   * @return the current estimate of the quantile, or 0 if no values have
+   * been added
+   */
+  double Value() const;
+
+  inline uint64_t count() const {
+    return count_;
+  }
+
+ private:
+  double Parabolic(int32_t marker, double direction) const;
+  double Linear(int32_t marker, int32_t direction) const;
+
+  double quantile_;
+  uint64_t count_;
+  // Marker heights.
+  double heights_[5];
+  // Actual and desired marker positions.
+  double positions_[5];
+  double desired_positions_[5];
+  // Increments of the desired marker positions.
+  double increments_[5];
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_STREAMING_QUANTILE_H
@@ -20,11 +20,26 @@ DEFINE_string(generated_trace_path, "",
               "Path to where the trace will be generated");
 DEFINE_bool(generate_quincy_cost_model_trace, false,
             "A trace containing information specific to the Quincy cost model");
+DEFINE_string(generated_trace_format, "csv",
+              "Format of the generated trace: csv or binary.");
+
+static bool ValidateGeneratedTraceFormat(const char* flagname,
+                                         const string& trace_format) {
+  if (trace_format != "csv" && trace_format != "binary") {
+    LOG(ERROR) << "Unknown generated trace format " << trace_format;
+    return false;
+  }
+  return true;
+}
+
+static const bool generated_trace_format_validator =
+  google::RegisterFlagValidator(&FLAGS_generated_trace_format,
+                                &ValidateGeneratedTraceFormat);
 
 namespace firmament {
 
 TraceGenerator::TraceGenerator(TimeInterface* time_manager)
-  : time_manager_(time_manager), unscheduled_tasks_cnt_(0),
+  : time_manager_(time_manager), writer_(NULL), unscheduled_tasks_cnt_(0),
     running_tasks_cnt_(0), evicted_tasks_cnt_(0), migrated_tasks_cnt_(0),
     task_events_cnt_per_round_(0), machine_events_cnt_per_round_(0) {
   if (FLAGS_generate_trace) {
@@ -37,77 +52,34 @@ TraceGenerator::TraceGenerator(TimeInterface* time_manager)
     MkdirIfNotPresent(FLAGS_generated_trace_path + "/task_usage_stat");
     MkdirIfNotPresent(FLAGS_generated_trace_path + "/dfs_events");
     MkdirIfNotPresent(FLAGS_generated_trace_path + "/tasks_to_blocks");
-    string path =
-      FLAGS_generated_trace_path + "/machine_events/part-00000-of-00001.csv";
-    machine_events_ = fopen(path.c_str(), "w");
-    CHECK(machine_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path +
-      "/scheduler_events/scheduler_events.csv";
-    scheduler_events_ = fopen(path.c_str(), "w");
-    CHECK(scheduler_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/task_events/part-00000-of-00500.csv";
-    task_events_ = fopen(path.c_str(), "w");
-    CHECK(task_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path +
-      "/task_runtime_events/task_runtime_events.csv";
-    task_runtime_events_ = fopen(path.c_str(), "w");
-    CHECK(task_runtime_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/jobs_num_tasks/jobs_num_tasks.csv";
-    jobs_num_tasks_ = fopen(path.c_str(), "w");
-    CHECK(jobs_num_tasks_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/task_usage_stat/task_usage_stat.csv";
-    task_usage_stat_ = fopen(path.c_str(), "w");
-    CHECK(task_usage_stat_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/dfs_events/dfs_events.csv";
-    dfs_events_ = fopen(path.c_str(), "w");
-    CHECK(dfs_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/tasks_to_blocks/tasks_to_blocks.csv";
-    tasks_to_blocks_ = fopen(path.c_str(), "w");
-    CHECK(tasks_to_blocks_ != NULL) << "Failed to open: " << path;
     if (FLAGS_generate_quincy_cost_model_trace) {
       MkdirIfNotPresent(FLAGS_generated_trace_path + "/quincy_tasks");
-      path = FLAGS_generated_trace_path + "/quincy_tasks/quincy_tasks.csv";
-      quincy_tasks_ = fopen(path.c_str(), "w");
-      CHECK(quincy_tasks_ != NULL) << "Failed to open: " << path;
     }
+    writer_ = new TraceWriter(FLAGS_generated_trace_path,
+                              FLAGS_generated_trace_format == "binary",
+                              FLAGS_generate_quincy_cost_model_trace);
   }
 }
 
 TraceGenerator::~TraceGenerator() {
   if (FLAGS_generate_trace) {
-    fclose(machine_events_);
-    fclose(scheduler_events_);
-    fclose(task_events_);
     // Print runtime for service tasks or tasks that haven't completed.
     for (auto& task_id_runtime : task_to_runtime_) {
       uint64_t* job_id_ptr = FindOrNull(task_to_job_, task_id_runtime.first);
-      TaskRuntime task_runtime = task_id_runtime.second;
-      // NOTE: We are using the job id as the job logical name.
-      fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-              *job_id_ptr, task_runtime.task_id_, *job_id_ptr,
-              task_runtime.start_time_, task_runtime.total_runtime_,
-              task_runtime.runtime_, task_runtime.num_runs_);
+      WriteTaskRuntime(*job_id_ptr, task_id_runtime.second);
     }
-    fclose(task_runtime_events_);
     // Print number of tasks for service jobs or jobs that haven't completed.
     for (auto& job_to_num_tasks : job_num_tasks_) {
-      fprintf(jobs_num_tasks_, "%ju,%ju\n", job_to_num_tasks.first,
-              job_to_num_tasks.second);
+      TraceRecord* record = writer_->AllocateRecord(JOB_NUM_TASKS_RECORD);
+      if (record) {
+        record->fields_[0] = job_to_num_tasks.first;
+        record->fields_[1] = job_to_num_tasks.second;
+        writer_->CommitRecord();
+      }
     }
-    fclose(jobs_num_tasks_);
     // TODO(ionel): Collect task usage stats.
-    // for (auto& task_to_job : task_to_job_) {
-    //   uint64_t* job_id_ptr = FindOrNull(task_to_job_, task_to_job.first);
-    //   fprintf(task_usage_stat_, "%ju,%ju,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,"
-    //           "0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0\n", *job_id_ptr,
-    //           task_to_job.first);
-    // }
-    fclose(task_usage_stat_);
-    fclose(dfs_events_);
-    fclose(tasks_to_blocks_);
-    if (FLAGS_generate_quincy_cost_model_trace) {
-      fclose(quincy_tasks_);
-    }
+    // Wait for the events to be written.
+    delete writer_;
   }
   // time_manager is not owned by this class. We don't have to delete it here.
 }
@@ -119,8 +91,7 @@ void TraceGenerator::AddBlock(ResourceID_t machine_res_id,
     uint64_t* machine_id =
       FindOrNull(machine_res_id_to_trace_id_, machine_res_id);
     CHECK_NOTNULL(machine_id);
-    fprintf(dfs_events_, "%ju,%d,%ju,%ju,%ju\n", timestamp, BLOCK_ADD,
-            *machine_id, block_id, block_size);
+    WriteDFSEvent(timestamp, BLOCK_ADD, *machine_id, block_id, block_size);
   }
 }
 
@@ -132,8 +103,7 @@ void TraceGenerator::AddMachine(const ResourceDescriptor& rd) {
     CHECK(InsertIfNotPresent(&machine_res_id_to_trace_id_,
                              ResourceIDFromString(rd.uuid()),
                              machine_id));
-    fprintf(machine_events_, "%ju,%ju,%d,,,\n",
-            timestamp, machine_id, MACHINE_ADD);
+    WriteMachineEvent(timestamp, machine_id, MACHINE_ADD);
   }
 }
 
@@ -149,8 +119,13 @@ void TraceGenerator::AddTaskInputBlock(const TaskDescriptor& td,
       trace_job_id = HashString(td.job_id());
       trace_task_id = td.uid();
     }
-    fprintf(tasks_to_blocks_, "%ju,%ju,%ju\n",
-            trace_job_id, trace_task_id, block_id);
+    TraceRecord* record = writer_->AllocateRecord(TASK_INPUT_BLOCK_RECORD);
+    if (record) {
+      record->fields_[0] = trace_job_id;
+      record->fields_[1] = trace_task_id;
+      record->fields_[2] = block_id;
+      writer_->CommitRecord();
+    }
   }
 }
 
@@ -170,10 +145,20 @@ void TraceGenerator::AddTaskQuincy(
       trace_job_id = HashString(td.job_id());
       trace_task_id = td.uid();
     }
-    fprintf(quincy_tasks_, "%ju,%ju,%ju,%ju,%jd,%jd,%jd,%jd,%ju,%ju\n",
-            timestamp, trace_job_id, trace_task_id, input_size,
-            worst_cluster_cost, best_rack_cost, best_machine_cost,
-            cost_to_unsched, num_pref_machines, num_pref_racks);
+    TraceRecord* record = writer_->AllocateRecord(QUINCY_TASK_RECORD);
+    if (record) {
+      record->fields_[0] = timestamp;
+      record->fields_[1] = trace_job_id;
+      record->fields_[2] = trace_task_id;
+      record->fields_[3] = input_size;
+      record->fields_[4] = static_cast<uint64_t>(worst_cluster_cost);
+      record->fields_[5] = static_cast<uint64_t>(best_rack_cost);
+      record->fields_[6] = static_cast<uint64_t>(best_machine_cost);
+      record->fields_[7] = static_cast<uint64_t>(cost_to_unsched);
+      record->fields_[8] = num_pref_machines;
+      record->fields_[9] = num_pref_racks;
+      writer_->CommitRecord();
+    }
   }
 }
 
@@ -192,8 +177,8 @@ void TraceGenerator::RemoveBlock(ResourceID_t machine_res_id,
     uint64_t* machine_id =
       FindOrNull(machine_res_id_to_trace_id_, machine_res_id);
     CHECK_NOTNULL(machine_id);
-    fprintf(dfs_events_, "%ju,%d,%ju,%ju,%ju\n", timestamp, BLOCK_REMOVE,
-            *machine_id, block_id, block_size);
+    WriteDFSEvent(timestamp, BLOCK_REMOVE, *machine_id, block_id,
+                  block_size);
   }
 }
 
@@ -203,8 +188,7 @@ void TraceGenerator::RemoveMachine(const ResourceDescriptor& rd) {
     uint64_t timestamp = time_manager_->GetCurrentTimestamp();
     uint64_t machine_id = GetMachineId(rd);
     machine_res_id_to_trace_id_.erase(ResourceIDFromString(rd.uuid()));
-    fprintf(machine_events_, "%ju,%ju,%d,,,\n",
-            timestamp, machine_id, MACHINE_REMOVE);
+    WriteMachineEvent(timestamp, machine_id, MACHINE_REMOVE);
   }
 }
 
@@ -219,19 +203,26 @@ void TraceGenerator::SchedulerRun(
                    << "% of tasks are unscheduled";
     }
     uint64_t timestamp = time_manager_->GetCurrentTimestamp();
-    fprintf(scheduler_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%s\n",
-            timestamp, scheduler_stats.scheduler_runtime_,
-            scheduler_stats.algorithm_runtime_,
-            scheduler_stats.total_runtime_,
-            unscheduled_tasks_cnt_, evicted_tasks_cnt_, migrated_tasks_cnt_,
-            unscheduled_tasks_cnt_ + running_tasks_cnt_,
-            task_events_cnt_per_round_, machine_events_cnt_per_round_,
-            dimacs_stats.GetStatsString().c_str());
+    TraceRecord* record = writer_->AllocateRecord(SCHEDULER_EVENT_RECORD);
+    if (record) {
+      record->fields_[0] = timestamp;
+      record->fields_[1] = scheduler_stats.scheduler_runtime_;
+      record->fields_[2] = scheduler_stats.algorithm_runtime_;
+      record->fields_[3] = scheduler_stats.total_runtime_;
+      record->fields_[4] = unscheduled_tasks_cnt_;
+      record->fields_[5] = evicted_tasks_cnt_;
+      record->fields_[6] = migrated_tasks_cnt_;
+      record->fields_[7] = unscheduled_tasks_cnt_ + running_tasks_cnt_;
+      record->fields_[8] = task_events_cnt_per_round_;
+      record->fields_[9] = machine_events_cnt_per_round_;
+      record->string_field_ = dimacs_stats.GetStatsString();
+      writer_->CommitRecord();
+    }
     evicted_tasks_cnt_ = 0;
     migrated_tasks_cnt_ = 0;
     task_events_cnt_per_round_ = 0;
     machine_events_cnt_per_round_ = 0;
-    fflush(scheduler_events_);
+    writer_->ReportDroppedRecords();
   }
 }
 
@@ -266,9 +257,14 @@ void TraceGenerator::TaskSubmitted(TaskDescriptor* td_ptr) {
         *num_tasks = *num_tasks + 1;
       }
     }
-    fprintf(task_events_, "%ju,,%ju,%ju,,%d,,,,,,,\n",
-            timestamp, job_id, trace_task_id, TASK_SUBMIT_EVENT);
-    fflush(task_events_);
+    TraceRecord* record = writer_->AllocateRecord(TASK_EVENT_RECORD);
+    if (record) {
+      record->fields_[0] = timestamp;
+      record->fields_[1] = job_id;
+      record->fields_[2] = trace_task_id;
+      record->fields_[3] = TASK_SUBMIT_EVENT;
+      writer_->CommitRecord();
+    }
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     if (tr_ptr == NULL) {
       TaskRuntime task_runtime;
@@ -292,17 +288,13 @@ void TraceGenerator::TaskCompleted(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_FINISH_EVENT);
-    fflush(task_events_);
+    WriteTaskMachineEvent(timestamp, *job_id_ptr, tr_ptr->task_id_,
+                          machine_id, TASK_FINISH_EVENT);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
     tr_ptr->runtime_ = timestamp - tr_ptr->last_schedule_time_;
-    fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-            *job_id_ptr, tr_ptr->task_id_, *job_id_ptr, tr_ptr->start_time_,
-            tr_ptr->total_runtime_, tr_ptr->runtime_, tr_ptr->num_runs_);
+    WriteTaskRuntime(*job_id_ptr, *tr_ptr);
     task_to_job_.erase(task_id);
     task_to_runtime_.erase(task_id);
   }
@@ -323,10 +315,8 @@ void TraceGenerator::TaskEvicted(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_EVICT_EVENT);
-    fflush(task_events_);
+    WriteTaskMachineEvent(timestamp, *job_id_ptr, tr_ptr->task_id_,
+                          machine_id, TASK_EVICT_EVENT);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
@@ -344,16 +334,12 @@ void TraceGenerator::TaskFailed(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_FAIL_EVENT);
-    fflush(task_events_);
+    WriteTaskMachineEvent(timestamp, *job_id_ptr, tr_ptr->task_id_,
+                          machine_id, TASK_FAIL_EVENT);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
-    fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-            *job_id_ptr, tr_ptr->task_id_, *job_id_ptr, tr_ptr->start_time_,
-            tr_ptr->total_runtime_, tr_ptr->runtime_, tr_ptr->num_runs_);
+    WriteTaskRuntime(*job_id_ptr, *tr_ptr);
     task_to_job_.erase(task_id);
     task_to_runtime_.erase(task_id);
   }
@@ -370,16 +356,12 @@ void TraceGenerator::TaskKilled(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_KILL_EVENT);
-    fflush(task_events_);
+    WriteTaskMachineEvent(timestamp, *job_id_ptr, tr_ptr->task_id_,
+                          machine_id, TASK_KILL_EVENT);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
-    fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-            *job_id_ptr, tr_ptr->task_id_, *job_id_ptr, tr_ptr->start_time_,
-            tr_ptr->total_runtime_, tr_ptr->runtime_, tr_ptr->num_runs_);
+    WriteTaskRuntime(*job_id_ptr, *tr_ptr);
     task_to_job_.erase(task_id);
     task_to_runtime_.erase(task_id);
   }
@@ -408,14 +390,75 @@ void TraceGenerator::TaskScheduled(TaskID_t task_id,
     CHECK_NOTNULL(job_id_ptr);
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
-    uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%s,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, rd.friendly_name().c_str(),
-            TASK_SCHEDULE_EVENT);
-    fflush(task_events_);
+    TraceRecord* record = writer_->AllocateRecord(TASK_PLACEMENT_EVENT_RECORD);
+    if (record) {
+      record->fields_[0] = timestamp;
+      record->fields_[1] = *job_id_ptr;
+      record->fields_[2] = tr_ptr->task_id_;
+      record->fields_[3] = TASK_SCHEDULE_EVENT;
+      record->string_field_ = rd.friendly_name();
+      writer_->CommitRecord();
+    }
     tr_ptr->num_runs_++;
     tr_ptr->last_schedule_time_ = timestamp;
   }
 }
 
+void TraceGenerator::WriteDFSEvent(uint64_t timestamp, TraceDFSEvent event,
+                                   uint64_t machine_id, uint64_t block_id,
+                                   uint64_t block_size) {
+  TraceRecord* record = writer_->AllocateRecord(DFS_EVENT_RECORD);
+  if (record) {
+    record->fields_[0] = timestamp;
+    record->fields_[1] = event;
+    record->fields_[2] = machine_id;
+    record->fields_[3] = block_id;
+    record->fields_[4] = block_size;
+    writer_->CommitRecord();
+  }
+}
+
+void TraceGenerator::WriteMachineEvent(uint64_t timestamp,
+                                       uint64_t machine_id,
+                                       TraceMachineEvent event) {
+  TraceRecord* record = writer_->AllocateRecord(MACHINE_EVENT_RECORD);
+  if (record) {
+    record->fields_[0] = timestamp;
+    record->fields_[1] = machine_id;
+    record->fields_[2] = event;
+    writer_->CommitRecord();
+  }
+}
+
+void TraceGenerator::WriteTaskMachineEvent(uint64_t timestamp, uint64_t job_id,
+                                           uint64_t task_id,
+                                           uint64_t machine_id,
+                                           TraceTaskEvent event) {
+  TraceRecord* record = writer_->AllocateRecord(TASK_MACHINE_EVENT_RECORD);
+  if (record) {
+    record->fields_[0] = timestamp;
+    record->fields_[1] = job_id;
+    record->fields_[2] = task_id;
+    record->fields_[3] = machine_id;
+    record->fields_[4] = event;
+    writer_->CommitRecord();
+  }
+}
+
+void TraceGenerator::WriteTaskRuntime(uint64_t job_id,
+                                      const TaskRuntime& task_runtime) {
+  TraceRecord* record = writer_->AllocateRecord(TASK_RUNTIME_RECORD);
+  if (record) {
+    record->fields_[0] = job_id;
+    record->fields_[1] = task_runtime.task_id_;
+    // NOTE: We are using the job id as the job logical name.
+    record->fields_[2] = job_id;
+    record->fields_[3] = task_runtime.start_time_;
+    record->fields_[4] = task_runtime.total_runtime_;
+    record->fields_[5] = task_runtime.runtime_;
+    record->fields_[6] = task_runtime.num_runs_;
+    writer_->CommitRecord();
+  }
+}
+
 } // namespace firmament
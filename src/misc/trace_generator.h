@@ -8,6 +8,7 @@
 
 #include "base/types.h"
 #include "misc/time_interface.h"
+#include "misc/trace_writer.h"
 #include "scheduling/flow/dimacs_change_stats.h"
 #include "scheduling/scheduler_interface.h"
 
@@ -92,6 +93,15 @@ class TraceGenerator {
 
  private:
   uint64_t GetMachineId(const ResourceDescriptor& rd);
+  void WriteDFSEvent(uint64_t timestamp, TraceDFSEvent event,
+                     uint64_t machine_id, uint64_t block_id,
+                     uint64_t block_size);
+  void WriteMachineEvent(uint64_t timestamp, uint64_t machine_id,
+                         TraceMachineEvent event);
+  void WriteTaskMachineEvent(uint64_t timestamp, uint64_t job_id,
+                             uint64_t task_id, uint64_t machine_id,
+                             TraceTaskEvent event);
+  void WriteTaskRuntime(uint64_t job_id, const TaskRuntime& task_runtime);
 
   TimeInterface* time_manager_;
   unordered_map<TaskID_t, uint64_t> task_to_job_;
@@ -102,15 +112,8 @@ class TraceGenerator {
   unordered_map<TaskID_t, TaskRuntime> task_to_runtime_;
   unordered_map<ResourceID_t, uint64_t,
       boost::hash<ResourceID_t>> machine_res_id_to_trace_id_;
-  FILE* machine_events_;
-  FILE* scheduler_events_;
-  FILE* task_events_;
-  FILE* task_runtime_events_;
-  FILE* jobs_num_tasks_;
-  FILE* task_usage_stat_;
-  FILE* dfs_events_;
-  FILE* tasks_to_blocks_;
-  FILE* quincy_tasks_;
+  // Writes the events in the background. NULL if no trace is generated.
+  TraceWriter* writer_;
   uint64_t unscheduled_tasks_cnt_;
   uint64_t running_tasks_cnt_;
   uint64_t evicted_tasks_cnt_;
@@ -0,0 +1,260 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "misc/trace_writer.h"
+
+#include "misc/binary_frame.h"
+
+DEFINE_uint64(trace_writer_buffer_size, 65536,
+              "Number of generated trace events that can be buffered before "
+              "they are written.");
+DEFINE_bool(trace_writer_drop_when_full, false,
+            "True if generated trace events should be dropped when the "
+            "buffer is full. Otherwise, the scheduler waits for the events "
+            "to be written.");
+
+namespace firmament {
+
+// Size above which the binary records of a file are written out.
+static const uint64_t kBinaryFrameSize = 64 * 1024;
+// Time the writer thread sleeps for when there are no records to write.
+static const uint32_t kWriterIdleMicroseconds = 1000;
+
+struct TraceRecordFormat {
+  TraceFile file_;
+  uint32_t num_fields_;
+  bool has_timestamp_;
+  // Bitmask of the fields that are signed.
+  uint32_t signed_fields_;
+  bool has_string_field_;
+};
+
+// The formats of the records, indexed by TraceRecordType.
+static const TraceRecordFormat kTraceRecordFormats[] = {
+  {MACHINE_EVENTS_FILE, 3, true, 0, false},
+  {SCHEDULER_EVENTS_FILE, 10, true, 0, true},
+  {TASK_EVENTS_FILE, 4, true, 0, false},
+  {TASK_EVENTS_FILE, 5, true, 0, false},
+  {TASK_EVENTS_FILE, 4, true, 0, true},
+  {TASK_RUNTIME_EVENTS_FILE, 7, false, 0, false},
+  {JOBS_NUM_TASKS_FILE, 2, false, 0, false},
+  {DFS_EVENTS_FILE, 5, true, 0, false},
+  {TASKS_TO_BLOCKS_FILE, 3, false, 0, false},
+  {QUINCY_TASKS_FILE, 10, true, 0xF0, false},
+};
+
+static const char* kTraceFileNames[] = {
+  "machine_events/part-00000-of-00001",
+  "scheduler_events/scheduler_events",
+  "task_events/part-00000-of-00500",
+  "task_runtime_events/task_runtime_events",
+  "jobs_num_tasks/jobs_num_tasks",
+  "task_usage_stat/task_usage_stat",
+  "dfs_events/dfs_events",
+  "tasks_to_blocks/tasks_to_blocks",
+  "quincy_tasks/quincy_tasks",
+};
+
+TraceWriter::TraceWriter(const string& trace_path, bool binary,
+                         bool quincy_tasks)
+  : binary_(binary), records_(FLAGS_trace_writer_buffer_size),
+    capacity_(FLAGS_trace_writer_buffer_size), num_written_records_(0),
+    num_committed_records_(0), stop_(false), num_dropped_records_(0),
+    num_reported_dropped_records_(0), unflushed_records_(false) {
+  CHECK_GT(capacity_, 0);
+  for (uint32_t file = 0; file < NUM_TRACE_FILES; ++file) {
+    files_[file] = NULL;
+    last_timestamps_[file] = 0;
+    if (file == QUINCY_TASKS_FILE && !quincy_tasks) {
+      continue;
+    }
+    string path = trace_path + "/" + kTraceFileNames[file] +
+      (binary_ ? ".bin" : ".csv");
+    files_[file] = fopen(path.c_str(), "w");
+    CHECK(files_[file] != NULL) << "Failed to open: " << path;
+  }
+  writer_thread_ =
+    new boost::thread(boost::bind(&TraceWriter::WriteRecords, this));
+}
+
+TraceWriter::~TraceWriter() {
+  stop_.store(true, std::memory_order_release);
+  writer_thread_->join();
+  delete writer_thread_;
+  for (uint32_t file = 0; file < NUM_TRACE_FILES; ++file) {
+    if (files_[file]) {
+      fclose(files_[file]);
+    }
+  }
+  if (num_dropped_records_ > 0) {
+    LOG(WARNING) << "Dropped " << num_dropped_records_ << " trace events "
+                 << "because the trace writer could not keep up";
+  }
+}
+
+TraceRecord* TraceWriter::AllocateRecord(TraceRecordType type) {
+  uint64_t num_committed =
+    num_committed_records_.load(std::memory_order_relaxed);
+  while (num_committed - num_written_records_.load(std::memory_order_acquire)
+         == capacity_) {
+    if (FLAGS_trace_writer_drop_when_full) {
+      num_dropped_records_++;
+      return NULL;
+    }
+    boost::this_thread::yield();
+  }
+  TraceRecord* record = &records_[num_committed % capacity_];
+  record->type_ = type;
+  return record;
+}
+
+void TraceWriter::CommitRecord() {
+  num_committed_records_.store(
+      num_committed_records_.load(std::memory_order_relaxed) + 1,
+      std::memory_order_release);
+}
+
+void TraceWriter::ReportDroppedRecords() {
+  if (num_dropped_records_ > num_reported_dropped_records_) {
+    LOG(WARNING) << "Dropped "
+                 << num_dropped_records_ - num_reported_dropped_records_
+                 << " trace events because the trace writer could not keep "
+                 << "up";
+    num_reported_dropped_records_ = num_dropped_records_;
+  }
+}
+
+void TraceWriter::AppendBinaryRecord(const TraceRecord& record) {
+  const TraceRecordFormat& format = kTraceRecordFormats[record.type_];
+  string* buffer = &binary_buffers_[format.file_];
+  buffer->push_back(static_cast<char>(record.type_));
+  uint32_t field = 0;
+  if (format.has_timestamp_) {
+    AppendSignedVarint(static_cast<int64_t>(
+        record.fields_[0] - last_timestamps_[format.file_]), buffer);
+    last_timestamps_[format.file_] = record.fields_[0];
+    field++;
+  }
+  for (; field < format.num_fields_; ++field) {
+    if (format.signed_fields_ & (1 << field)) {
+      AppendSignedVarint(static_cast<int64_t>(record.fields_[field]), buffer);
+    } else {
+      AppendVarint(record.fields_[field], buffer);
+    }
+  }
+  if (format.has_string_field_) {
+    AppendVarint(record.string_field_.size(), buffer);
+    buffer->append(record.string_field_);
+  }
+  if (buffer->size() >= kBinaryFrameSize) {
+    if (!WriteBinaryFrame(*buffer, files_[format.file_])) {
+      PLOG(ERROR) << "Error while writing binary trace frame";
+    }
+    buffer->clear();
+  }
+}
+
+void TraceWriter::FlushFiles() {
+  for (uint32_t file = 0; file < NUM_TRACE_FILES; ++file) {
+    if (!binary_buffers_[file].empty()) {
+      if (!WriteBinaryFrame(binary_buffers_[file], files_[file])) {
+        PLOG(ERROR) << "Error while writing binary trace frame";
+      }
+      binary_buffers_[file].clear();
+    }
+    if (files_[file]) {
+      fflush(files_[file]);
+    }
+  }
+  unflushed_records_ = false;
+}
+
+void TraceWriter::WriteCSVRecord(const TraceRecord& record) {
+  const uint64_t* fields = record.fields_;
+  FILE* file = files_[kTraceRecordFormats[record.type_].file_];
+  switch (record.type_) {
+    case MACHINE_EVENT_RECORD:
+      fprintf(file, "%ju,%ju,%d,,,\n", fields[0], fields[1],
+              static_cast<int32_t>(fields[2]));
+      break;
+    case SCHEDULER_EVENT_RECORD:
+      fprintf(file, "%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%s\n",
+              fields[0], fields[1], fields[2], fields[3], fields[4],
+              fields[5], fields[6], fields[7], fields[8], fields[9],
+              record.string_field_.c_str());
+      break;
+    case TASK_EVENT_RECORD:
+      fprintf(file, "%ju,,%ju,%ju,,%d,,,,,,,\n", fields[0], fields[1],
+              fields[2], static_cast<int32_t>(fields[3]));
+      break;
+    case TASK_MACHINE_EVENT_RECORD:
+      fprintf(file, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n", fields[0], fields[1],
+              fields[2], fields[3], static_cast<int32_t>(fields[4]));
+      break;
+    case TASK_PLACEMENT_EVENT_RECORD:
+      fprintf(file, "%ju,,%ju,%ju,%s,%d,,,,,,,\n", fields[0], fields[1],
+              fields[2], record.string_field_.c_str(),
+              static_cast<int32_t>(fields[3]));
+      break;
+    case TASK_RUNTIME_RECORD:
+      fprintf(file, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n", fields[0], fields[1],
+              fields[2], fields[3], fields[4], fields[5], fields[6]);
+      break;
+    case JOB_NUM_TASKS_RECORD:
+      fprintf(file, "%ju,%ju\n", fields[0], fields[1]);
+      break;
+    case DFS_EVENT_RECORD:
+      fprintf(file, "%ju,%d,%ju,%ju,%ju\n", fields[0],
+              static_cast<int32_t>(fields[1]), fields[2], fields[3],
+              fields[4]);
+      break;
+    case TASK_INPUT_BLOCK_RECORD:
+      fprintf(file, "%ju,%ju,%ju\n", fields[0], fields[1], fields[2]);
+      break;
+    case QUINCY_TASK_RECORD:
+      fprintf(file, "%ju,%ju,%ju,%ju,%jd,%jd,%jd,%jd,%ju,%ju\n",
+              fields[0], fields[1], fields[2], fields[3],
+              static_cast<int64_t>(fields[4]),
+              static_cast<int64_t>(fields[5]),
+              static_cast<int64_t>(fields[6]),
+              static_cast<int64_t>(fields[7]), fields[8], fields[9]);
+      break;
+    default:
+      LOG(FATAL) << "Unexpected trace record type: " << record.type_;
+  }
+}
+
+void TraceWriter::WriteRecords() {
+  uint64_t num_written = num_written_records_.load(std::memory_order_relaxed);
+  while (true) {
+    // Read the stop flag before the committed records so that we don't miss
+    // the records committed before the writer was stopped.
+    bool stop = stop_.load(std::memory_order_acquire);
+    uint64_t num_committed =
+      num_committed_records_.load(std::memory_order_acquire);
+    if (num_written == num_committed) {
+      if (unflushed_records_) {
+        FlushFiles();
+      }
+      if (stop) {
+        break;
+      }
+      boost::this_thread::sleep(
+          boost::posix_time::microseconds(kWriterIdleMicroseconds));
+      continue;
+    }
+    for (; num_written < num_committed; ++num_written) {
+      const TraceRecord& record = records_[num_written % capacity_];
+      if (binary_) {
+        AppendBinaryRecord(record);
+      } else {
+        WriteCSVRecord(record);
+      }
+      // Hand the slot back to the producer as soon as possible.
+      num_written_records_.store(num_written + 1, std::memory_order_release);
+    }
+    unflushed_records_ = true;
+  }
+}
+
+}  // namespace firmament
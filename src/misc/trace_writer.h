@@ -0,0 +1,147 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Background writer for the traces generated by the TraceGenerator. The
+// generator fills in records in a lock-free single-producer ring, and a
+// writer thread formats the records and writes them to the trace files. The
+// scheduling thread thus neither formats nor writes any events.
+//
+// The trace is written either as CSV files with the layout of the Google
+// trace, or as binary files. Each binary file is a sequence of frames (see
+// misc/binary_frame.h) holding records of the file's type.
+// A record starts with a byte that holds its TraceRecordType, followed by a
+// varint for every CSV column that the generator sets, in CSV order. The
+// timestamps are zig-zag encoded deltas from the previous record of the file,
+// signed columns are zig-zag encoded, and the machine name of a placement
+// event and the DIMACS stats of a scheduler event are length-prefixed
+// strings.
+
+#ifndef FIRMAMENT_MISC_TRACE_WRITER_H
+#define FIRMAMENT_MISC_TRACE_WRITER_H
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "base/common.h"
+
+namespace firmament {
+
+enum TraceFile {
+  MACHINE_EVENTS_FILE = 0,
+  SCHEDULER_EVENTS_FILE = 1,
+  TASK_EVENTS_FILE = 2,
+  TASK_RUNTIME_EVENTS_FILE = 3,
+  JOBS_NUM_TASKS_FILE = 4,
+  TASK_USAGE_STAT_FILE = 5,
+  DFS_EVENTS_FILE = 6,
+  TASKS_TO_BLOCKS_FILE = 7,
+  QUINCY_TASKS_FILE = 8,
+  NUM_TRACE_FILES = 9,
+};
+
+enum TraceRecordType {
+  // timestamp, machine_id, event
+  MACHINE_EVENT_RECORD = 0,
+  // timestamp, scheduler_runtime, algorithm_runtime, total_runtime,
+  // unscheduled_tasks, evicted_tasks, migrated_tasks, tasks, task_events,
+  // machine_events and the DIMACS stats string
+  SCHEDULER_EVENT_RECORD = 1,
+  // timestamp, job_id, task_id, event
+  TASK_EVENT_RECORD = 2,
+  // timestamp, job_id, task_id, machine_id, event
+  TASK_MACHINE_EVENT_RECORD = 3,
+  // timestamp, job_id, task_id, event and the machine name string
+  TASK_PLACEMENT_EVENT_RECORD = 4,
+  // job_id, task_id, logical_job_name, start_time, total_runtime, runtime,
+  // num_runs
+  TASK_RUNTIME_RECORD = 5,
+  // job_id, num_tasks
+  JOB_NUM_TASKS_RECORD = 6,
+  // timestamp, event, machine_id, block_id, block_size
+  DFS_EVENT_RECORD = 7,
+  // job_id, task_id, block_id
+  TASK_INPUT_BLOCK_RECORD = 8,
+  // timestamp, job_id, task_id, input_size, worst_cluster_cost (signed),
+  // best_rack_cost (signed), best_machine_cost (signed), cost_to_unsched
+  // (signed), num_pref_machines, num_pref_racks
+  QUINCY_TASK_RECORD = 9,
+};
+
+// Maximum number of integer fields a record has.
+#define MAX_TRACE_RECORD_FIELDS 10
+
+struct TraceRecord {
+  TraceRecordType type_;
+  uint64_t fields_[MAX_TRACE_RECORD_FIELDS];
+  string string_field_;
+};
+
+class TraceWriter {
+ public:
+  /**
+   * Opens the trace files and starts the writer thread.
+   * @param trace_path the directory in which the trace is generated
+   * @param binary true if the trace should be written in binary
+   * @param quincy_tasks true if the Quincy tasks file should be written
+   */
+  TraceWriter(const string& trace_path, bool binary, bool quincy_tasks);
+  /**
+   * Writes the remaining records and closes the trace files.
+   */
+  ~TraceWriter();
+
+  /**
+   * Returns the record the producer should fill in next. Must be followed by
+   * CommitRecord. Only one thread at a time may add records.
+   * @return NULL if the ring is full and the record has been dropped
+   */
+  TraceRecord* AllocateRecord(TraceRecordType type);
+  /**
+   * Hands the allocated record over to the writer thread.
+   */
+  void CommitRecord();
+
+  /**
+   * Logs the number of records dropped since the last report, if any.
+   */
+  void ReportDroppedRecords();
+
+  inline uint64_t num_dropped_records() const {
+    return num_dropped_records_;
+  }
+
+ private:
+  void AppendBinaryRecord(const TraceRecord& record);
+  void FlushFiles();
+  void WriteCSVRecord(const TraceRecord& record);
+  void WriteRecords();
+
+  bool binary_;
+  FILE* files_[NUM_TRACE_FILES];
+  // The ring of records. Slot i % capacity_ holds the i-th record.
+  vector<TraceRecord> records_;
+  uint64_t capacity_;
+  // Number of records the writer thread has written, and number of records
+  // the producer has committed. The indices only increase.
+  std::atomic<uint64_t> num_written_records_;
+  std::atomic<uint64_t> num_committed_records_;
+  std::atomic<bool> stop_;
+  boost::thread* writer_thread_;
+  // The following fields are only accessed by the producer.
+  uint64_t num_dropped_records_;
+  uint64_t num_reported_dropped_records_;
+  // The following fields are only accessed by the writer thread.
+  // Binary records that haven't been written yet, by file.
+  string binary_buffers_[NUM_TRACE_FILES];
+  // Timestamp of the last record written to each binary file.
+  uint64_t last_timestamps_[NUM_TRACE_FILES];
+  bool unflushed_records_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_TRACE_WRITER_H
@@ -0,0 +1,120 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the background trace writer.
+
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <string>
+
+#include "base/common.h"
+#include "misc/binary_frame.h"
+#include "misc/trace_writer.h"
+#include "misc/utils.h"
+
+namespace firmament {
+
+class TraceWriterTest : public ::testing::Test {
+ protected:
+  TraceWriterTest() : trace_path_("/tmp/firmament_trace_writer_test") {
+    FLAGS_v = 2;
+  }
+
+  virtual void SetUp() {
+    MkdirIfNotPresent(trace_path_);
+    MkdirIfNotPresent(trace_path_ + "/machine_events");
+    MkdirIfNotPresent(trace_path_ + "/task_events");
+    MkdirIfNotPresent(trace_path_ + "/scheduler_events");
+    MkdirIfNotPresent(trace_path_ + "/task_runtime_events");
+    MkdirIfNotPresent(trace_path_ + "/jobs_num_tasks");
+    MkdirIfNotPresent(trace_path_ + "/task_usage_stat");
+    MkdirIfNotPresent(trace_path_ + "/dfs_events");
+    MkdirIfNotPresent(trace_path_ + "/tasks_to_blocks");
+  }
+
+  void AddTaskEvents(TraceWriter* writer) {
+    TraceRecord* record = writer->AllocateRecord(TASK_MACHINE_EVENT_RECORD);
+    ASSERT_TRUE(record != NULL);
+    record->fields_[0] = 600000000;
+    record->fields_[1] = 42;
+    record->fields_[2] = 7;
+    record->fields_[3] = 12;
+    record->fields_[4] = 4;
+    writer->CommitRecord();
+    record = writer->AllocateRecord(TASK_PLACEMENT_EVENT_RECORD);
+    ASSERT_TRUE(record != NULL);
+    record->fields_[0] = 599999000;
+    record->fields_[1] = 42;
+    record->fields_[2] = 8;
+    record->fields_[3] = 1;
+    record->string_field_ = "machine_12";
+    writer->CommitRecord();
+  }
+
+  string ReadFile(const string& file_name) {
+    FILE* file = fopen(file_name.c_str(), "r");
+    CHECK_NOTNULL(file);
+    string contents;
+    char buffer[1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      contents.append(buffer, length);
+    }
+    fclose(file);
+    return contents;
+  }
+
+  string trace_path_;
+};
+
+TEST_F(TraceWriterTest, WriteCSV) {
+  TraceWriter* writer = new TraceWriter(trace_path_, false, false);
+  AddTaskEvents(writer);
+  delete writer;
+  EXPECT_EQ(ReadFile(trace_path_ + "/task_events/part-00000-of-00500.csv"),
+            "600000000,,42,7,12,4,,,,,,,\n"
+            "599999000,,42,8,machine_12,1,,,,,,,\n");
+}
+
+TEST_F(TraceWriterTest, WriteBinary) {
+  TraceWriter* writer = new TraceWriter(trace_path_, true, false);
+  AddTaskEvents(writer);
+  delete writer;
+  FILE* file =
+    fopen((trace_path_ + "/task_events/part-00000-of-00500.bin").c_str(), "r");
+  ASSERT_TRUE(file != NULL);
+  string frame;
+  ASSERT_TRUE(ReadBinaryFrame(file, &frame));
+  fclose(file);
+  const char* pos = frame.data();
+  const char* end = pos + frame.size();
+  EXPECT_EQ(*pos++, TASK_MACHINE_EVENT_RECORD);
+  int64_t timestamp_delta;
+  uint64_t value;
+  ASSERT_TRUE(ReadSignedVarint(&pos, end, &timestamp_delta));
+  EXPECT_EQ(timestamp_delta, 600000000);
+  for (uint64_t expected_value : {42, 7, 12, 4}) {
+    ASSERT_TRUE(ReadVarint(&pos, end, &value));
+    EXPECT_EQ(value, expected_value);
+  }
+  EXPECT_EQ(*pos++, TASK_PLACEMENT_EVENT_RECORD);
+  ASSERT_TRUE(ReadSignedVarint(&pos, end, &timestamp_delta));
+  EXPECT_EQ(timestamp_delta, -1000);
+  for (uint64_t expected_value : {42, 8, 1}) {
+    ASSERT_TRUE(ReadVarint(&pos, end, &value));
+    EXPECT_EQ(value, expected_value);
+  }
+  ASSERT_TRUE(ReadVarint(&pos, end, &value));
+  EXPECT_EQ(string(pos, value), "machine_12");
+  EXPECT_EQ(pos + value, end);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
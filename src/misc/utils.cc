@@ -4,6 +4,7 @@
 // Miscellaneous utility functions. Descriptions with their declarations.
 
 #include <boost/functional/hash.hpp>
+#include <boost/uuid/string_generator.hpp>
 
 // N.B.: C header for gettimeofday()
 extern "C" {
@@ -230,12 +231,56 @@ DataObjectID_t DataObjectIDFromProtobuf(const ReferenceDescriptor& rd) {
 }
 
 
+#ifdef __PLATFORM_HAS_BOOST__
+// Length of the canonical form (8-4-4-4-12 hex digits).
+static const size_t kCanonicalUUIDLength = 36;
+
+static inline int32_t HexDigitValue(char digit) {
+  if (digit >= '0' && digit <= '9') {
+    return digit - '0';
+  } else if (digit >= 'a' && digit <= 'f') {
+    return digit - 'a' + 10;
+  } else if (digit >= 'A' && digit <= 'F') {
+    return digit - 'A' + 10;
+  }
+  return -1;
+}
+
+boost::uuids::uuid ParseUUID(const string& str) {
+  if (str.size() == kCanonicalUUIDLength) {
+    boost::uuids::uuid id;
+    uint32_t byte_index = 0;
+    size_t pos = 0;
+    for (; pos < kCanonicalUUIDLength; pos += 2) {
+      if (pos == 8 || pos == 13 || pos == 18 || pos == 23) {
+        if (str[pos] != '-') {
+          break;
+        }
+        pos++;
+      }
+      int32_t high = HexDigitValue(str[pos]);
+      int32_t low = HexDigitValue(str[pos + 1]);
+      if (high < 0 || low < 0) {
+        break;
+      }
+      id.data[byte_index++] = static_cast<uint8_t>((high << 4) | low);
+    }
+    if (pos == kCanonicalUUIDLength) {
+      return id;
+    }
+  }
+  // Not in the canonical form. The string generator handles braces and
+  // missing dashes, and throws if the string is not a UUID.
+  boost::uuids::string_generator gen;
+  return gen(str);
+}
+#endif
+
 JobID_t JobIDFromString(const string& str) {
   // XXX(malte): This makes assumptions about JobID_t being a Boost UUID. We
   // should have a generic "JobID_t-from-string" helper instead.
 #ifdef __PLATFORM_HAS_BOOST__
-  boost::uuids::string_generator gen;
-  boost::uuids::uuid job_uuid = gen(str);
+  boost::uuids::uuid job_uuid = ParseUUID(str);
 #else
   string job_uuid = str;
 #endif
@@ -262,8 +307,7 @@ ResourceID_t ResourceIDFromString(const string& str) {
   // XXX(malte): This makes assumptions about ResourceID_t being a Boost UUID.
   // We should have a generic "JobID_t-from-string" helper instead.
 #ifdef __PLATFORM_HAS_BOOST__
-  boost::uuids::string_generator gen;
-  boost::uuids::uuid res_uuid = gen(str);
+  boost::uuids::uuid res_uuid = ParseUUID(str);
 #else
   string res_uuid = str;
 #endif
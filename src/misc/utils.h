@@ -68,6 +68,11 @@ ResourceID_t MachineResIDForResource(shared_ptr<ResourceMap_t> resource_map,
                                      ResourceID_t res_id);
 ResourceID_t ResourceIDFromString(const string& str);
 JobID_t JobIDFromString(const string& str);
+#ifdef __PLATFORM_HAS_BOOST__
+// Parses a UUID. The canonical 36 character form is parsed directly, and any
+// other form is handed to boost's string generator.
+boost::uuids::uuid ParseUUID(const string& str);
+#endif
 uint64_t UpdateTaskTotalRunTime(const TaskDescriptor& td);
 uint64_t UpdateTaskTotalUnscheduledTime(const TaskDescriptor& td);
 void SetupResourceID(boost::mt19937 *resource_id, const char *hostname);
@@ -5,6 +5,8 @@
 
 #include <gtest/gtest.h>
 
+#include <boost/uuid/string_generator.hpp>
+
 #include "base/common.h"
 #include "base/task_desc.pb.h"
 #include "misc/utils.h"
@@ -88,6 +90,22 @@ TEST_F(UtilsTest, TaskIDFromString) {
   EXPECT_EQ(TaskIDFromString(test2), 16733209960240500155ULL);
 }
 
+// Tests that the fast UUID parser agrees with boost's string generator.
+TEST_F(UtilsTest, ParseUUID) {
+  boost::uuids::string_generator gen;
+  for (uint32_t index = 0; index < 100; ++index) {
+    string id_str = to_string(GenerateResourceID());
+    EXPECT_EQ(ParseUUID(id_str), gen(id_str));
+  }
+  string upper_case = "0123ABCD-4567-89EF-0123-456789ABCDEF";
+  EXPECT_EQ(ParseUUID(upper_case), gen(upper_case));
+  // Non-canonical forms are parsed as well.
+  string braces = "{01234567-89ab-cdef-0123-456789abcdef}";
+  EXPECT_EQ(ParseUUID(braces), gen(braces));
+  string no_dashes = "0123456789abcdef0123456789abcdef";
+  EXPECT_EQ(ParseUUID(no_dashes), gen(no_dashes));
+}
+
 
 
 }  // namespace firmament
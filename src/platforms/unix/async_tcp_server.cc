@@ -19,6 +19,12 @@ using boost::posix_time::ptime;
 using boost::posix_time::second_clock;
 using boost::posix_time::seconds;
 
+DEFINE_uint64(messaging_io_threads, 1,
+              "Number of threads that receive and handle the messages of the "
+              "TCP server's connections. The messages of a connection are "
+              "handled in order, but the messages of different connections "
+              "are handled concurrently if more than one thread is used.");
+
 namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
@@ -68,20 +74,23 @@ void AsyncTCPServer::StartAccept() {
 }
 
 void AsyncTCPServer::DropConnectionForEndpoint(const string& remote_endpoint) {
+  boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
   endpoint_connection_map_.erase(remote_endpoint);
 }
 
 void AsyncTCPServer::Run() {
   // TODO(malte): Figure out if we need to reset the io_service itself here,
   // given that it may have been stopped beforehand.
-  VLOG(2) << "Creating IO service thread";
+  CHECK_GT(FLAGS_messaging_io_threads, 0);
+  VLOG(2) << "Creating " << FLAGS_messaging_io_threads << " IO service threads";
   io_service_work_.reset(new boost::asio::io_service::work(*io_service_));
-  thread_.reset(new boost::thread(
-      boost::bind(&boost::asio::io_service::run, io_service_.get())));
-  // Wait for thread to exit
-  VLOG(2) << "IO service thread (" << thread_->get_id()
-          << ") running -- Waiting for join...";
-  thread_->join();
+  for (uint64_t i = 0; i < FLAGS_messaging_io_threads; ++i) {
+    threads_.create_thread(
+        boost::bind(&boost::asio::io_service::run, io_service_.get()));
+  }
+  // Wait for the threads to exit
+  VLOG(2) << "IO service threads running -- Waiting for join...";
+  threads_.join_all();
   VLOG(2) << "IO service terminated; TCP server's Run() method returning...";
 }
 
@@ -105,6 +114,7 @@ void AsyncTCPServer::Stop() {
   // indiscriminately invoke close() here; see CL #241942.
   if (acceptor_.is_open())
     acceptor_.close();
+  boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
   for (unordered_map<string, TCPConnection::connection_ptr>::iterator
        c_iter = endpoint_connection_map_.begin();
        c_iter != endpoint_connection_map_.end();
@@ -128,10 +138,14 @@ void AsyncTCPServer::HandleAccept(TCPConnection::connection_ptr connection,
     connection->Start(remote_endpoint);
     // Get string version of remote endpoint
     string remote_ept_str = EndpointToString(*remote_endpoint);
-    // Check we do not already have a connection for this endpoint
-    CHECK(!endpoint_connection_map_.count(remote_ept_str));
-    // Record a mapping for the connection's endpoint
-    InsertIfNotPresent(&endpoint_connection_map_, remote_ept_str, connection);
+    {
+      boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
+      // Check we do not already have a connection for this endpoint
+      CHECK(!endpoint_connection_map_.count(remote_ept_str));
+      // Record a mapping for the connection's endpoint
+      InsertIfNotPresent(&endpoint_connection_map_, remote_ept_str,
+                         connection);
+    }
     // Once the connection is up, we invoke the callback to notify the messaging
     // adapter (which will wrap the connection into a channel).
     VLOG(2) << "Invoking accept handler...";
@@ -26,7 +26,9 @@ namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
 
-// Asynchronous, multi-threaded TCP server.
+// Asynchronous, multi-threaded TCP server. The I/O service runs on
+// -messaging_io_threads threads, so the handlers of different connections may
+// run concurrently.
 // Design inspired by
 // http://www.boost.org/doc/html/boost_asio/example/http/server3/server.hpp.
 class AsyncTCPServer : public boost::enable_shared_from_this<AsyncTCPServer>,
@@ -39,6 +41,7 @@ class AsyncTCPServer : public boost::enable_shared_from_this<AsyncTCPServer>,
   void Run();
   void Stop();
   TCPConnection::connection_ptr connection(const string& endpoint) {
+    boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
     CHECK_EQ(endpoint_connection_map_.count(endpoint), 1);
     return endpoint_connection_map_[endpoint];
   }
@@ -53,8 +56,11 @@ class AsyncTCPServer : public boost::enable_shared_from_this<AsyncTCPServer>,
                     shared_ptr<tcp::endpoint> remote_endpoint);
 
   unordered_map<string, TCPConnection::connection_ptr> endpoint_connection_map_;
+  // Connections are dropped from any of the I/O service threads.
+  boost::mutex endpoint_connection_map_mutex_;
   AcceptHandler::type accept_handler_;
-  scoped_ptr<boost::thread> thread_;
+  // Threads running the I/O service.
+  boost::thread_group threads_;
   scoped_ptr<boost::asio::io_service::work> io_service_work_;
   shared_ptr<boost::asio::io_service> io_service_;
   tcp::acceptor acceptor_;
@@ -0,0 +1,125 @@
+// The Firmament project
+// Copyright (c) 2011-2015 Malte Schwarzkopf <malte.schwarzkopf@cl.cam.ac.uk>
+//
+// perf_event_open(2)-based process counters.
+
+#include "platforms/unix/perf_event_counters.h"
+
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+namespace firmament {
+namespace platform_unix {
+
+PerfEventCounters::PerfEventCounters() {
+  for (int i = 0; i < kNumCounters; ++i)
+    fds_[i] = -1;
+}
+
+PerfEventCounters::~PerfEventCounters() {
+  Close();
+}
+
+void PerfEventCounters::Close() {
+  for (int i = 0; i < kNumCounters; ++i) {
+    if (fds_[i] >= 0) {
+      close(fds_[i]);
+      fds_[i] = -1;
+    }
+  }
+}
+
+bool PerfEventCounters::Open(pid_t pid) {
+  Close();
+  // The task clock is a software counter, so it is always available (unless
+  // perf events are disabled altogether, or we may not monitor the process).
+  fds_[kTaskClock] = OpenCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,
+                                 pid, -1);
+  if (fds_[kTaskClock] < 0) {
+    PLOG(WARNING) << "Failed to open perf event counters for PID " << pid;
+    return false;
+  }
+  // The hardware counters form a group led by the cycle counter, so that
+  // they are always scheduled onto the PMU together and their ratios (e.g.
+  // CPI) remain meaningful under multiplexing.
+  fds_[kCycles] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+                              pid, -1);
+  if (fds_[kCycles] < 0) {
+    VLOG(1) << "Hardware perf events unavailable (" << strerror(errno)
+            << "); only counting CPU time for PID " << pid;
+    return true;
+  }
+  fds_[kInstructions] = OpenCounter(PERF_TYPE_HARDWARE,
+                                    PERF_COUNT_HW_INSTRUCTIONS, pid,
+                                    fds_[kCycles]);
+  fds_[kLLCRefs] = OpenCounter(PERF_TYPE_HARDWARE,
+                               PERF_COUNT_HW_CACHE_REFERENCES, pid,
+                               fds_[kCycles]);
+  fds_[kLLCMisses] = OpenCounter(PERF_TYPE_HARDWARE,
+                                 PERF_COUNT_HW_CACHE_MISSES, pid,
+                                 fds_[kCycles]);
+  return true;
+}
+
+int PerfEventCounters::OpenCounter(uint32_t type, uint64_t config, pid_t pid,
+                                   int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.inherit = 1;
+  // Counting user-space events only keeps us within the default
+  // perf_event_paranoid setting.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, pid, -1,
+                                    group_fd, PERF_FLAG_FD_CLOEXEC));
+  return fd;
+}
+
+bool PerfEventCounters::Read(PerfEventValues* values) const {
+  if (!is_open())
+    return false;
+  if (!ReadCounter(kTaskClock, &values->task_clock))
+    return false;
+  values->hardware = hardware();
+  ReadCounter(kCycles, &values->cycles);
+  ReadCounter(kInstructions, &values->instructions);
+  ReadCounter(kLLCRefs, &values->llc_refs);
+  ReadCounter(kLLCMisses, &values->llc_misses);
+  return true;
+}
+
+bool PerfEventCounters::ReadCounter(Counter counter, uint64_t* value) const {
+  if (fds_[counter] < 0)
+    return false;
+  // Layout per PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+  uint64_t data[3];
+  if (read(fds_[counter], data, sizeof(data)) != sizeof(data)) {
+    PLOG(ERROR) << "Failed to read perf event counter " << counter;
+    return false;
+  }
+  if (data[2] == 0) {
+    // Never scheduled onto the PMU
+    *value = 0;
+  } else if (data[2] < data[1]) {
+    // Multiplexed: extrapolate to the whole time the counter was enabled
+    *value = static_cast<uint64_t>(static_cast<double>(data[0]) *
+                                   data[1] / data[2]);
+  } else {
+    *value = data[0];
+  }
+  return true;
+}
+
+}  // namespace platform_unix
+}  // namespace firmament
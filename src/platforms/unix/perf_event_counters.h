@@ -0,0 +1,77 @@
+// The Firmament project
+// Copyright (c) 2011-2015 Malte Schwarzkopf <malte.schwarzkopf@cl.cam.ac.uk>
+//
+// Thin wrapper around perf_event_open(2) that counts a process's cycles,
+// instructions and last-level cache references/misses, as well as its CPU
+// time. Counters are inherited by threads and child processes created after
+// they are opened, and can be read at any time, including after the process
+// has exited.
+//
+// If the hardware counters are unavailable (e.g. in a VM without a virtual
+// PMU), only the software task-clock counter is used.
+
+#ifndef FIRMAMENT_PLATFORMS_UNIX_PERF_EVENT_COUNTERS_H
+#define FIRMAMENT_PLATFORMS_UNIX_PERF_EVENT_COUNTERS_H
+
+extern "C" {
+#include <sys/types.h>
+}
+
+#include "base/common.h"
+
+namespace firmament {
+namespace platform_unix {
+
+// Cumulative counts since the counters were opened, scaled to compensate for
+// any multiplexing of hardware counters.
+struct PerfEventValues {
+  PerfEventValues()
+    : cycles(0), instructions(0), llc_refs(0), llc_misses(0), task_clock(0),
+      hardware(false) {}
+  uint64_t cycles;
+  uint64_t instructions;
+  uint64_t llc_refs;
+  uint64_t llc_misses;
+  // CPU time in nanoseconds
+  uint64_t task_clock;
+  // False if only the software counters are available, in which case the
+  // hardware counts are all zero.
+  bool hardware;
+};
+
+class PerfEventCounters {
+ public:
+  PerfEventCounters();
+  ~PerfEventCounters();
+  void Close();
+  inline bool hardware() const { return fds_[kCycles] >= 0; }
+  inline bool is_open() const { return fds_[kTaskClock] >= 0; }
+  /**
+   * Opens the counters for a process.
+   * @param pid the process to count; N.B.: for an existing multi-threaded
+   * process, only threads created after this call are counted in addition to
+   * its main thread
+   * @return true if at least the software counters could be opened
+   */
+  bool Open(pid_t pid);
+  bool Read(PerfEventValues* values) const;
+
+ private:
+  enum Counter {
+    kCycles = 0,
+    kInstructions = 1,
+    kLLCRefs = 2,
+    kLLCMisses = 3,
+    kTaskClock = 4,
+    kNumCounters = 5,
+  };
+  int OpenCounter(uint32_t type, uint64_t config, pid_t pid, int group_fd);
+  bool ReadCounter(Counter counter, uint64_t* value) const;
+
+  int fds_[kNumCounters];
+};
+
+}  // namespace platform_unix
+}  // namespace firmament
+
+#endif  // FIRMAMENT_PLATFORMS_UNIX_PERF_EVENT_COUNTERS_H
@@ -0,0 +1,78 @@
+// The Firmament project
+// Copyright (c) 2011-2015 Malte Schwarzkopf <malte.schwarzkopf@cl.cam.ac.uk>
+//
+// perf event counter unit tests.
+
+extern "C" {
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+#include <gtest/gtest.h>
+
+#include "base/common.h"
+#include "platforms/unix/perf_event_counters.h"
+
+namespace firmament {
+namespace platform_unix {
+
+// The fixture for testing the perf event counters.
+class PerfEventCountersTest : public ::testing::Test {
+ protected:
+  // Forks a child that spins for a while before exiting.
+  pid_t ForkBusyChild() {
+    pid_t pid = fork();
+    if (pid == 0) {
+      // Give the parent time to open the counters
+      usleep(100000);
+      volatile uint64_t sum = 0;
+      for (uint64_t i = 0; i < 100000000ULL; ++i)
+        sum += i;
+      _exit(0);
+    }
+    return pid;
+  }
+};
+
+// Tests that we can count a child process and read its final counts after it
+// has exited.
+TEST_F(PerfEventCountersTest, CountExitedChild) {
+  PerfEventCounters counters;
+  pid_t pid = ForkBusyChild();
+  ASSERT_GT(pid, 0);
+  if (!counters.Open(pid)) {
+    LOG(WARNING) << "perf events are not available; skipping test.";
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return;
+  }
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  PerfEventValues values;
+  ASSERT_TRUE(counters.Read(&values));
+  EXPECT_GT(values.task_clock, 0ULL);
+  EXPECT_EQ(values.hardware, counters.hardware());
+  if (values.hardware) {
+    EXPECT_GT(values.cycles, 0ULL);
+    EXPECT_GT(values.instructions, 100000000ULL);
+  } else {
+    EXPECT_EQ(values.cycles, 0ULL);
+  }
+}
+
+// Tests that reading closed counters fails.
+TEST_F(PerfEventCountersTest, ReadClosed) {
+  PerfEventCounters counters;
+  PerfEventValues values;
+  EXPECT_FALSE(counters.is_open());
+  EXPECT_FALSE(counters.Read(&values));
+}
+
+}  // namespace platform_unix
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -13,6 +13,10 @@
 
 using boost::asio::ip::tcp;
 
+DEFINE_uint64(max_message_size, 64 * 1024 * 1024,
+              "Maximum size of a message sent or received on a stream socket "
+              "channel, in bytes. Larger incoming messages are discarded.");
+
 namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
@@ -10,6 +10,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <type_traits>
 
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
@@ -21,6 +22,7 @@
 #include "base/common.h"
 #include "messages/base_message.pb.h"
 #include "misc/map-util.h"
+#include "misc/message_stats.h"
 #include "misc/messaging_interface.h"
 #include "platforms/common.h"
 #include "platforms/unix/tcp_connection.h"
@@ -39,12 +41,20 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
  public:
   StreamSocketsAdapter() : message_recv_handler_(NULL),
     error_path_handler_(NULL),
-    message_wait_ready_(false) {
+    message_wait_ready_(false),
+    receiving_(false) {
   }
 
   virtual ~StreamSocketsAdapter() {
     VLOG(2) << "Messaging adapter is being destroyed.";
     StopListen();
+    for (typename vector<Envelope<T>*>::iterator it =
+         free_recv_envelopes_.begin();
+         it != free_recv_envelopes_.end();
+         ++it) {
+      delete (*it)->data();
+      delete *it;
+    }
   }
 
   void AwaitNextMessage() {
@@ -53,6 +63,10 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
             << " active channels in adapter " << this;
     if (VLOG_IS_ON(3))
       DumpActiveChannels();
+    // From now on, channels receive messages asynchronously: every channel
+    // starts its next receive as soon as it has handled a message, and new
+    // channels start receiving when they are added.
+    receiving_ = true;
     // If we have no active channels, we cannot receive any messages, so we
     // return immediately.
     if (endpoint_channel_map_.size() == 0)
@@ -65,34 +79,9 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
              endpoint_channel_map_.begin();
            chan_iter != endpoint_channel_map_.end();
            ++chan_iter) {
-        StreamSocketsChannel<T>* chan = chan_iter->second;
-        if (!channel_recv_envelopes_.count(chan)) {
-          // No outstanding receive request for this channel, so create one
-          Envelope<T>* envelope = new Envelope<T>();
-          CHECK(InsertIfNotPresent(&channel_recv_envelopes_, chan, envelope));
-          VLOG(2) << "MA replenishing envelope for channel " << chan
-                  << " at " << envelope;
-          chan->RecvA(envelope,
-                      boost::bind(&StreamSocketsAdapter::HandleAsyncMessageRecv,
-                                  this,
-                                  boost::asio::placeholders::error,
-                                  boost::asio::placeholders::bytes_transferred,
-                                  chan));
-        }
+        StartReceive(chan_iter->second);
       }
     }
-    /*if (any_outstanding) {
-    // Block until we receive a message somewhere
-    VLOG(3) << "About to lock mutex...";
-    boost::unique_lock<boost::mutex> lock(message_wait_mutex_);
-    VLOG(3) << "Locked!...";
-    while (!message_wait_ready_) {
-    VLOG(3) << "Waiting for condvar...";
-    message_wait_condvar_.wait(lock);
-    }
-    VLOG(3) << "Message arrived, condvar signalled!";
-    message_wait_ready_ = false;
-    }*/
   }
 
   void AddChannelForConnection(TCPConnection::connection_ptr connection) {
@@ -106,6 +95,10 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     InsertIfNotPresent(&endpoint_channel_map_, endpoint_name, channel);
     if (VLOG_IS_ON(3))
       DumpActiveChannels();
+    if (receiving_) {
+      boost::lock_guard<boost::mutex> envel_lock(channel_recv_envelopes_mutex_);
+      StartReceive(channel);
+    }
     // Unblock any waiters, since there's now an additional connection
     message_wait_ready_ = true;
     message_wait_condvar_.notify_all();
@@ -201,6 +194,12 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
 
   void StopListen() {
     if (tcp_server_) {
+      // We stop the TCP server's I/O threads before closing the channels, so
+      // that no receive handler runs on a channel while it is closed.
+      VLOG(2) << "Stopping async TCP server at " << tcp_server_ << "...";
+      tcp_server_->Stop();
+      tcp_server_thread_->join();
+      VLOG(2) << "TCP server thread joined.";
       for (__typeof__(endpoint_channel_map_.begin()) chan_iter =
              endpoint_channel_map_.begin();
            chan_iter != endpoint_channel_map_.end();
@@ -208,17 +207,19 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
         VLOG(2) << "Closing associated channel at " << chan_iter->second;
         chan_iter->second->Close();
       }
-      VLOG(2) << "Stopping async TCP server at " << tcp_server_ << "...";
-      CHECK(tcp_server_);
-      tcp_server_->Stop();
-      tcp_server_thread_->join();
-      VLOG(2) << "TCP server thread joined.";
     }
     message_wait_condvar_.notify_all();
     // XXX(malte): We would prefer if channels cleared up after themselves, but
     // for the moment, this is a sledgehammer approach.
     VLOG(1) << "Dropping channels and outstanding requests...";
     endpoint_channel_map_.clear();
+    boost::lock_guard<boost::mutex> envel_lock(channel_recv_envelopes_mutex_);
+    for (__typeof__(channel_recv_envelopes_.begin()) envel_iter =
+           channel_recv_envelopes_.begin();
+         envel_iter != channel_recv_envelopes_.end();
+         ++envel_iter) {
+      ReleaseRecvEnvelope(envel_iter->second);
+    }
     channel_recv_envelopes_.clear();
   }
 
@@ -227,11 +228,18 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
                    << ",num_channels=" << endpoint_channel_map_.size() << ")";
   }
 
+  MessageStats* message_stats() {
+    return &message_stats_;
+  }
+
   uint32_t NumActiveChannels() {
+    boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
     return endpoint_channel_map_.size();
   }
+  // N.B.: must be called with endpoint_channel_map_mutex_ held.
   void DumpActiveChannels() {
-    LOG(INFO) << NumActiveChannels() << " active channels at " << *this;
+    LOG(INFO) << endpoint_channel_map_.size() << " active channels at "
+              << *this;
     for (__typeof__(endpoint_channel_map_.begin()) chan_iter =
          endpoint_channel_map_.begin();
          chan_iter != endpoint_channel_map_.end();
@@ -259,7 +267,10 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
         boost::lock_guard<boost::mutex> envel_lock(
             channel_recv_envelopes_mutex_);
         CHECK(endpoint_channel_map_.erase(remote_endpoint));
-        CHECK(channel_recv_envelopes_.erase(chan));
+        Envelope<T>* envelope = FindPtrOrNull(channel_recv_envelopes_, chan);
+        CHECK_NOTNULL(envelope);
+        channel_recv_envelopes_.erase(chan);
+        ReleaseRecvEnvelope(envelope);
       } else {
         LOG(ERROR) << "Failed to receive on channel at " << chan
                    << ", which no longer has an endpoint set. Cannot remove "
@@ -285,20 +296,32 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
                    << remote_endpoint;
       return;
     }
-    CHECK_GT(channel_recv_envelopes_.count(chan), 0)
-      << "No envelopes around when we expected to have at least one.";
-    Envelope<T>* envelope = FindPtrOrNull(channel_recv_envelopes_, chan);
+    Envelope<T>* envelope;
+    bool allocated;
+    {
+      boost::lock_guard<boost::mutex> lock(channel_recv_envelopes_mutex_);
+      CHECK_GT(channel_recv_envelopes_.count(chan), 0)
+        << "No envelopes around when we expected to have at least one.";
+      envelope = FindPtrOrNull(channel_recv_envelopes_, chan);
+      allocated = new_recv_envelopes_.erase(envelope) > 0;
+    }
     CHECK_NOTNULL(envelope);
     VLOG(2) << "Received in MA: " << *envelope << " ("
             << bytes_transferred << ")";
-    // Invoke message receipt callback, if any registered
+    RecordMessage(envelope->data(), bytes_transferred, allocated,
+                  std::is_base_of<google::protobuf::Message, T>());
+    // Invoke message receipt callback, if any registered. The callback runs
+    // on the thread that received the message; callbacks for different
+    // channels may run concurrently.
     CHECK(message_recv_handler_ != NULL);
     message_recv_handler_(envelope->data(), chan->RemoteEndpointString());
-    // We've finished dealing with this message, so clean up now.
+    // We've finished dealing with this message, so recycle its envelope and
+    // start receiving the channel's next message.
     {
       boost::lock_guard<boost::mutex> lock(channel_recv_envelopes_mutex_);
       channel_recv_envelopes_.erase(chan);
-      delete envelope;
+      ReleaseRecvEnvelope(envelope);
+      StartReceive(chan);
     }
     {
       boost::lock_guard<boost::mutex> lock(message_wait_mutex_);
@@ -311,6 +334,68 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     message_wait_condvar_.notify_all();
   }
 
+  /**
+   * Starts an asynchronous receive on a channel, unless the channel already
+   * has one outstanding. Must be called with channel_recv_envelopes_mutex_
+   * held.
+   */
+  void StartReceive(StreamSocketsChannel<T>* chan) {
+    if (channel_recv_envelopes_.count(chan)) {
+      return;
+    }
+    // No outstanding receive request for this channel, so create one
+    Envelope<T>* envelope = AcquireRecvEnvelope();
+    CHECK(InsertIfNotPresent(&channel_recv_envelopes_, chan, envelope));
+    VLOG(2) << "MA replenishing envelope for channel " << chan
+            << " at " << envelope;
+    if (!chan->RecvA(envelope,
+                     boost::bind(&StreamSocketsAdapter::HandleAsyncMessageRecv,
+                                 this,
+                                 boost::asio::placeholders::error,
+                                 boost::asio::placeholders::bytes_transferred,
+                                 chan))) {
+      // The channel is not ready; the next AwaitNextMessage will try again.
+      channel_recv_envelopes_.erase(chan);
+      ReleaseRecvEnvelope(envelope);
+    }
+  }
+
+  /**
+   * Returns an envelope, and the message inside it, for a receive. Envelopes
+   * are recycled once their message has been handled, so that decoding a
+   * message reuses the memory of the sub-messages and strings of a previous
+   * one. Must be called with channel_recv_envelopes_mutex_ held.
+   */
+  Envelope<T>* AcquireRecvEnvelope() {
+    if (free_recv_envelopes_.empty()) {
+      Envelope<T>* envelope = new Envelope<T>(new T());
+      new_recv_envelopes_.insert(envelope);
+      return envelope;
+    }
+    Envelope<T>* envelope = free_recv_envelopes_.back();
+    free_recv_envelopes_.pop_back();
+    return envelope;
+  }
+
+  /**
+   * Returns an envelope to the free list. Must be called with
+   * channel_recv_envelopes_mutex_ held.
+   */
+  void ReleaseRecvEnvelope(Envelope<T>* envelope) {
+    new_recv_envelopes_.erase(envelope);
+    free_recv_envelopes_.push_back(envelope);
+  }
+
+  void RecordMessage(T* message, uint64_t bytes, bool allocated,
+                     std::true_type is_protobuf) {
+    message_stats_.RecordMessage(*message, bytes, allocated);
+  }
+
+  void RecordMessage(T* message, uint64_t bytes, bool allocated,
+                     std::false_type is_protobuf) {
+    message_stats_.RecordUntypedMessage(bytes, allocated);
+  }
+
   bool _EstablishChannel(const string& endpoint_uri,
                          StreamSocketsChannel<T>* chan) {
     VLOG(1) << "Establishing channel to endpoint " << endpoint_uri
@@ -318,6 +403,10 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     bool result = chan->Establish(endpoint_uri);
     boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
     InsertIfNotPresent(&endpoint_channel_map_, endpoint_uri, chan);
+    if (result && receiving_) {
+      boost::lock_guard<boost::mutex> envel_lock(channel_recv_envelopes_mutex_);
+      StartReceive(chan);
+    }
     return result;
   }
 
@@ -328,12 +417,21 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
   //set<shared_ptr<StreamSocketsChannel<T> > > active_channels_;
   unordered_map<string, StreamSocketsChannel<T>*> endpoint_channel_map_;
   unordered_map<StreamSocketsChannel<T>*, Envelope<T>*> channel_recv_envelopes_;
+  // Envelopes (and their messages) that are ready to be reused, and envelopes
+  // that have been allocated but not yet used for a message. Protected by
+  // channel_recv_envelopes_mutex_.
+  vector<Envelope<T>*> free_recv_envelopes_;
+  unordered_set<Envelope<T>*> new_recv_envelopes_;
+  MessageStats message_stats_;
   // Synchronization variables, locks tec.
   boost::mutex message_wait_mutex_;
   boost::condition_variable message_wait_condvar_;
   boost::mutex channel_recv_envelopes_mutex_;
   boost::mutex endpoint_channel_map_mutex_;
   bool message_wait_ready_;
+  // True once AwaitNextMessage has been called. Until then, channels are only
+  // used for synchronous receives. Protected by endpoint_channel_map_mutex_.
+  bool receiving_;
 };
 
 }  // namespace streamsockets
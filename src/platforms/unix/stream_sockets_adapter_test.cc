@@ -24,6 +24,7 @@ using firmament::misc::Envelope;
 
 DEFINE_uint64(heartbeat_interval, 1000000,
               "Heartbeat interval in microseconds.");
+DECLARE_uint64(messaging_io_threads);
 
 namespace firmament {
 namespace platform_unix {
@@ -57,6 +58,25 @@ class StreamSocketsAdapterTest : public ::testing::Test {
   }
 
   // Objects declared here can be used by all tests.
+
+ public:
+  void RecordMessage(BaseMessage* bm, const string& remote_endpoint) {
+    boost::lock_guard<boost::mutex> lock(received_lock_);
+    received_[remote_endpoint].push_back(bm->test().test());
+  }
+
+  uint64_t NumReceived() {
+    boost::lock_guard<boost::mutex> lock(received_lock_);
+    uint64_t num_received = 0;
+    for (map<string, vector<int64_t> >::iterator it = received_.begin();
+         it != received_.end(); ++it) {
+      num_received += it->second.size();
+    }
+    return num_received;
+  }
+
+  boost::mutex received_lock_;
+  map<string, vector<int64_t> > received_;
 };
 
 // Tests channel establishment.
@@ -192,6 +212,64 @@ TEST_F(StreamSocketsAdapterTest, BackchannelEstablishment) {
   channel->Close();
 }
 
+// Tests that the messages of several channels are received by a pool of I/O
+// threads without further calls to AwaitNextMessage, and that the messages of
+// each channel are handled in order.
+TEST_F(StreamSocketsAdapterTest, ParallelAsyncReceive) {
+  string uri = "tcp:127.0.0.1:7780";
+  const uint64_t kNumChannels = 4;
+  const int64_t kNumMessages = 50;
+  FLAGS_messaging_io_threads = 4;
+  StreamSocketsAdapter<BaseMessage>* mess_adapter1 =
+      new StreamSocketsAdapter<BaseMessage>();
+  StreamSocketsAdapter<BaseMessage>* mess_adapter2 =
+      new StreamSocketsAdapter<BaseMessage>();
+  mess_adapter1->RegisterAsyncMessageReceiptCallback(
+      boost::bind(&StreamSocketsAdapterTest::RecordMessage, this, _1, _2));
+  mess_adapter1->ListenURI(uri);
+  while (!mess_adapter1->ListenReady()) {
+    VLOG(3) << "Waiting for adapter to be ready...";
+  }
+  // Start receiving; the channels established below start receiving as soon
+  // as they are added.
+  mess_adapter1->AwaitNextMessage();
+  vector<StreamSocketsChannel<BaseMessage>*> channels;
+  for (uint64_t i = 0; i < kNumChannels; ++i) {
+    StreamSocketsChannel<BaseMessage>* channel =
+      new StreamSocketsChannel<BaseMessage>(
+          StreamSocketsChannel<BaseMessage>::SS_TCP);
+    mess_adapter2->EstablishChannel(uri, channel);
+    while (!channel->Ready()) {
+      VLOG(3) << "Waiting for channel to be ready...";
+    }
+    channels.push_back(channel);
+  }
+  for (int64_t value = 0; value < kNumMessages; ++value) {
+    for (uint64_t i = 0; i < kNumChannels; ++i) {
+      BaseMessage s_tm;
+      SUBMSG_WRITE(s_tm, test, test, value);
+      Envelope<BaseMessage> s_envelope(&s_tm);
+      CHECK(channels[i]->SendS(s_envelope));
+    }
+  }
+  while (NumReceived() < kNumChannels * kNumMessages) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+  }
+  EXPECT_EQ(received_.size(), kNumChannels);
+  for (map<string, vector<int64_t> >::iterator it = received_.begin();
+       it != received_.end(); ++it) {
+    EXPECT_EQ(it->second.size(), kNumMessages);
+    for (int64_t value = 0; value < kNumMessages; ++value) {
+      EXPECT_EQ(it->second[value], value);
+    }
+  }
+  for (uint64_t i = 0; i < kNumChannels; ++i) {
+    channels[i]->Close();
+  }
+  mess_adapter1->StopListen();
+  FLAGS_messaging_io_threads = 1;
+}
+
 }  // namespace streamsockets
 }  // namespace platform_unix
 }  // namespace firmament
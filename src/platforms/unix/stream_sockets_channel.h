@@ -23,6 +23,8 @@
 #include "platforms/unix/tcp_connection.h"
 #include "platforms/unix/async_tcp_server.h"
 
+DECLARE_uint64(max_message_size);
+
 namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
@@ -41,12 +43,15 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
   typedef shared_ptr<type> ptr_type;
 
   explicit StreamSocketsChannel(StreamSocketType type)
-    : async_recv_buffer_(NULL),
+    : send_in_progress_(false),
+      async_recv_buffer_(NULL),
       async_recv_buffer_vec_(NULL),
+      async_recv_busy_(false),
       client_io_service_(new io_service),
       client_socket_(NULL),
       channel_ready_(false),
       type_(type) {
+    strand_.reset(new io_service::strand(*client_io_service_));
     switch (type) {
     case SS_TCP:
       VLOG(2) << "Setup for TCP endpoints";
@@ -60,13 +65,16 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
   }
 
   explicit StreamSocketsChannel(TCPConnection::connection_ptr connection)
-    : async_recv_buffer_(NULL),
+    : send_in_progress_(false),
+      async_recv_buffer_(NULL),
       async_recv_buffer_vec_(NULL),
+      async_recv_busy_(false),
       client_socket_(connection->socket()),
       client_connection_(connection),
       channel_ready_(false),
       type_(SS_TCP) {
     VLOG(2) << "Creating new channel around socket at " << client_socket_;
+    strand_.reset(new io_service::strand(*connection->get_io_service()));
     if (client_socket_->is_open()) {
       channel_ready_ = true;
     }
@@ -210,8 +218,8 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
                    << ", which is not ready; read failed.";
       return false;
     }
-    // Obtain the lock on the async receive buffer.
-    async_recv_lock_.lock();
+    // Obtain the async receive buffer.
+    AcquireAsyncRecvBuffer();
     CHECK_EQ(async_recv_buffer_vec_, static_cast<char*>(NULL));
     CHECK_EQ(async_recv_buffer_,
              static_cast<boost::asio::mutable_buffers_1*>(NULL));
@@ -223,11 +231,11 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     // second stage of the receive call once we have it.
     async_read(*client_socket_, *async_recv_buffer_,
                boost::asio::transfer_exactly(sizeof(uint64_t)),
-               boost::bind(&StreamSocketsChannel<T>::RecvASecondStage,
-                           this,
-                           boost::asio::placeholders::error,
-                           boost::asio::placeholders::bytes_transferred,
-                           message, callback));
+               strand_->wrap(boost::bind(
+                   &StreamSocketsChannel<T>::RecvASecondStage, this,
+                   boost::asio::placeholders::error,
+                   boost::asio::placeholders::bytes_transferred,
+                   message, callback)));
     // First stage of RecvA always succeeds.
     return true;
   }
@@ -244,14 +252,14 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
       return false;
     }
     uint64_t len;
-    vector<char> size_buf(sizeof(uint64_t));
-    boost::asio::mutable_buffers_1 size_m_buf(
-        reinterpret_cast<char*>(&size_buf[0]), sizeof(uint64_t));
+    uint64_t msg_size_endian;
     boost::system::error_code error;
     // Read the incoming protobuf message length
     // N.B.: read() blocks until the buffer has been filled, i.e. an entire
     // uint64_t has been read.
-    len = read(*client_socket_, size_m_buf,
+    len = read(*client_socket_,
+               boost::asio::buffer(reinterpret_cast<char*>(&msg_size_endian),
+                                   sizeof(msg_size_endian)),
                boost::asio::transfer_exactly(sizeof(uint64_t)), error);
     if (error || len != sizeof(uint64_t)) {
       LOG(ERROR) << "Error reading from connection on channel " << *this
@@ -264,16 +272,25 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     // ... we can get away with a simple CHECK here and assume that we have some
     // incoming data available.
     CHECK_EQ(sizeof(uint64_t), len);
-    uint64_t msg_size = be64toh(*reinterpret_cast<uint64_t*>(&size_buf[0]));
+    uint64_t msg_size = be64toh(msg_size_endian);
     CHECK_GT(msg_size, 0);
     VLOG(3) << "RecvS: size of incoming protobuf from" << RemoteEndpointString()
             << "is " << msg_size << " bytes.";
-    // XXX(malte): This is a nasty hack to highlight bugs in the channel logic.
-    CHECK_LT(msg_size, 35000) << "Received implausibly large message size "
-                              << "from " << RemoteEndpointString();
-    vector<char> buf(msg_size);
+    if (msg_size > FLAGS_max_message_size) {
+      // Skip over the message, so that the next receive starts at a message
+      // boundary.
+      LOG(ERROR) << "Discarding message of " << msg_size << " bytes from "
+                 << RemoteEndpointString() << ", which exceeds the limit of "
+                 << FLAGS_max_message_size << " bytes.";
+      DiscardIncoming(msg_size);
+      return false;
+    }
+    // The receive buffer is kept across calls, so that it only grows to the
+    // largest message received.
+    if (sync_recv_buf_.size() < msg_size)
+      sync_recv_buf_.resize(msg_size);
     len = read(*client_socket_,
-               boost::asio::mutable_buffers_1(&buf[0], msg_size),
+               boost::asio::buffer(&sync_recv_buf_[0], msg_size),
                boost::asio::transfer_exactly(msg_size), error);
     VLOG(2) << "Read " << len << " bytes.";
 
@@ -290,8 +307,7 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     }
     CHECK_GT(len, 0);
     CHECK_EQ(len, msg_size);
-    // XXX(malte): data copy here -- optimize away if possible.
-    return (message->Parse(&buf[0], len));
+    return (message->Parse(&sync_recv_buf_[0], len));
   }
 
   /**
@@ -308,43 +324,61 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
       return EndpointToString(ept);
   }
 
+  /**
+   * Synchronous send -- blocks until the message has been written to the
+   * socket. The message is serialized, together with its length preamble, into
+   * the channel's send queue. If another thread is already writing, the
+   * message waits for that write to finish, and all messages queued in the
+   * meantime are then written with a single write call.
+   * N.B.: messages are only coalesced if several threads send on the channel
+   * at the same time. A single thread that sends one message after the other
+   * still issues one write per message.
+   */
   bool SendS(const misc::Envelope<T>& message) {
-    boost::lock_guard<boost::mutex> lock(sync_send_lock_);
-    VLOG(2) << "Trying to send message of size " << message.size()
-            << " on channel " << *this;
     uint64_t msg_size = message.size();
-    vector<char> buf(msg_size);
-    CHECK(message.Serialize(&buf[0], message.size()));
-    // Send data size
-    boost::system::error_code error;
-    uint64_t msg_size_endian = htobe64(msg_size);
-
-    uint64_t len = boost::asio::write(
-        *client_socket_, boost::asio::buffer(
-            reinterpret_cast<char*>(&msg_size_endian), sizeof(msg_size_endian)),
-        boost::asio::transfer_exactly(sizeof(uint64_t)), error);
-    if (error || len != sizeof(uint64_t)) {
-      LOG(ERROR) << "Error sending size preamble on connection: "
-                 << error.message();
-      if (error)
-        HandleIOError(error);
+    VLOG(2) << "Trying to send message of size " << msg_size
+            << " on channel " << *this;
+    if (msg_size > FLAGS_max_message_size) {
+      LOG(ERROR) << "Refusing to send message of " << msg_size << " bytes on "
+                 << "channel " << *this << ", which exceeds the limit of "
+                 << FLAGS_max_message_size << " bytes.";
       return false;
     }
-    // Send the data
-    len = boost::asio::write(
-        *client_socket_, boost::asio::buffer(buf, msg_size),
-        boost::asio::transfer_exactly(msg_size), error);
-    if (error || len != msg_size) {
-      LOG(ERROR) << "Error sending message on connection: "
-                 << error.message();
-      if (error)
-        HandleIOError(error);
+    boost::unique_lock<boost::mutex> lock(send_queue_lock_);
+    if (!send_queue_)
+      send_queue_ = NewSendBatch();
+    shared_ptr<SendBatch> batch = send_queue_;
+    // Append the length preamble and the message data to the batch
+    uint64_t offset = batch->buf.size();
+    uint64_t msg_size_endian = htobe64(msg_size);
+    batch->buf.resize(offset + sizeof(uint64_t) + msg_size);
+    memcpy(&batch->buf[offset], &msg_size_endian, sizeof(uint64_t));
+    if (!message.Serialize(&batch->buf[offset + sizeof(uint64_t)], msg_size)) {
+      LOG(ERROR) << "Failed to serialize message of size " << msg_size
+                 << " on channel " << *this;
+      batch->buf.resize(offset);
       return false;
-    } else {
-      VLOG(2) << "Sent " << len << " bytes of protobuf data: "
-              << message;
     }
-    return true;
+    batch->num_messages++;
+    // Wait until either our batch has been written by another thread, or no
+    // write is in progress, in which case we write the batch ourselves.
+    while (!batch->done && send_in_progress_)
+      send_queue_cond_.wait(lock);
+    if (!batch->done) {
+      send_in_progress_ = true;
+      // Subsequent messages go into a new batch
+      send_queue_.reset();
+      lock.unlock();
+      bool ok = WriteSendBatch(*batch);
+      lock.lock();
+      batch->ok = ok;
+      batch->done = true;
+      send_in_progress_ = false;
+      if (!spare_send_batch_)
+        spare_send_batch_ = batch;
+      send_queue_cond_.notify_all();
+    }
+    return batch->ok;
   }
 
   /**
@@ -402,10 +436,101 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     }
   }
 
+  // A batch of serialized messages, each preceded by its length, that is
+  // written to the socket in one go.
+  struct SendBatch {
+    vector<char> buf;
+    uint64_t num_messages;
+    bool done;
+    bool ok;
+  };
+
+  /**
+   * Returns an empty send batch, reusing the buffer of a previous batch if no
+   * sender still refers to it. Must be called with send_queue_lock_ held.
+   */
+  shared_ptr<SendBatch> NewSendBatch() {
+    shared_ptr<SendBatch> batch;
+    if (spare_send_batch_ && spare_send_batch_.unique()) {
+      batch.swap(spare_send_batch_);
+      batch->buf.clear();
+    } else {
+      batch.reset(new SendBatch);
+    }
+    batch->num_messages = 0;
+    batch->done = false;
+    batch->ok = false;
+    return batch;
+  }
+
+  /**
+   * Writes out all messages in a send batch with a single write call.
+   */
+  bool WriteSendBatch(const SendBatch& batch) {
+    boost::lock_guard<boost::mutex> lock(sync_send_lock_);
+    boost::system::error_code error;
+    uint64_t len = boost::asio::write(
+        *client_socket_, boost::asio::buffer(batch.buf),
+        boost::asio::transfer_all(), error);
+    if (error || len != batch.buf.size()) {
+      LOG(ERROR) << "Error sending " << batch.num_messages << " messages on "
+                 << "connection: " << error.message();
+      if (error)
+        HandleIOError(error);
+      return false;
+    }
+    VLOG(2) << "Sent " << batch.num_messages << " messages (" << len
+            << " bytes) on channel " << *this;
+    return true;
+  }
+
+  /**
+   * Reads and drops the given number of bytes from the socket.
+   */
+  void DiscardIncoming(uint64_t num_bytes) {
+    const uint64_t kChunkSize = 64 * 1024;
+    if (sync_recv_buf_.size() < kChunkSize)
+      sync_recv_buf_.resize(kChunkSize);
+    boost::system::error_code error;
+    while (num_bytes > 0) {
+      uint64_t chunk = min(num_bytes, kChunkSize);
+      uint64_t len = read(*client_socket_,
+                          boost::asio::buffer(&sync_recv_buf_[0], chunk),
+                          boost::asio::transfer_exactly(chunk), error);
+      if (error) {
+        HandleIOError(error);
+        return;
+      }
+      num_bytes -= len;
+    }
+  }
+
+  /**
+   * Waits until no other asynchronous receive is using the async receive
+   * buffer, and takes it. The buffer is released by the last stage of the
+   * receive, which may run on another thread; hence, we cannot simply hold a
+   * mutex for the duration of the receive.
+   */
+  void AcquireAsyncRecvBuffer() {
+    boost::unique_lock<boost::mutex> lock(async_recv_lock_);
+    while (async_recv_busy_) {
+      async_recv_cond_.wait(lock);
+    }
+    async_recv_busy_ = true;
+  }
+
+  void ReleaseAsyncRecvBuffer() {
+    {
+      boost::lock_guard<boost::mutex> lock(async_recv_lock_);
+      async_recv_busy_ = false;
+    }
+    async_recv_cond_.notify_one();
+  }
+
   /**
    * Second stage of asynchronous receive, which calls async_recv again in order
    * to get the actual message data.
-   * Called with the async_recv_lock_ mutex held. It is either released before
+   * Called with the async receive buffer held. It is either released before
    * returning (error path) or maintained for RecvAThirdStage to release.
    */
   void RecvASecondStage(const boost::system::error_code& error,
@@ -420,7 +545,7 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
       }
       if (error)
         HandleIOError(error);
-      async_recv_lock_.unlock();
+      ReleaseAsyncRecvBuffer();
       final_callback(error, bytes_read, final_envelope);
       return;
     }
@@ -433,12 +558,18 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
       be64toh(*reinterpret_cast<uint64_t*>(async_recv_buffer_vec_));
     CHECK_GT(msg_size, 0) << "Received message of length 0 from "
                           << RemoteEndpointString();
-    // XXX(malte): This is a nasty hack to highlight bugs in the channel logic.
-    CHECK_LT(msg_size, 1024*1024) << "Received implausibly large message "
-                                  << "from " << RemoteEndpointString();
+    if (msg_size > FLAGS_max_message_size) {
+      LOG(ERROR) << "Received message of " << msg_size << " bytes from "
+                 << RemoteEndpointString() << ", which exceeds the limit of "
+                 << FLAGS_max_message_size << " bytes.";
+      ReleaseAsyncRecvBuffer();
+      final_callback(boost::asio::error::message_size, bytes_read,
+                     final_envelope);
+      return;
+    }
     VLOG(2) << "RecvA: size of incoming protobuf from" << RemoteEndpointString()
             << "is " << msg_size << " bytes.";
-    // We still hold the async_recv_lock_ mutex here.
+    // We still hold the async receive buffer here.
     free(async_recv_buffer_vec_);
     async_recv_buffer_vec_ = reinterpret_cast<char*>(malloc(msg_size));
     VLOG(2) << "New async recv buffer is at "
@@ -448,18 +579,18 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
       new boost::asio::mutable_buffers_1(async_recv_buffer_vec_, msg_size);
     async_read(*client_socket_, *async_recv_buffer_,
                boost::asio::transfer_exactly(msg_size),
-               boost::bind(&StreamSocketsChannel<T>::RecvAThirdStage,
-                           this,
-                           boost::asio::placeholders::error,
-                           boost::asio::placeholders::bytes_transferred,
-                           msg_size, final_envelope, final_callback));
+               strand_->wrap(boost::bind(
+                   &StreamSocketsChannel<T>::RecvAThirdStage, this,
+                   boost::asio::placeholders::error,
+                   boost::asio::placeholders::bytes_transferred,
+                   msg_size, final_envelope, final_callback)));
   }
 
   /**
    * Third stage of asynchronous receive, which finalizes the message reception
    * by parsing the received data.
-   * Called with the async_recv_lock_ mutex held, but releases it before
-   * returning.
+   * Called with the async receive buffer held, but releases it before
+   * invoking the callback.
    */
   void RecvAThirdStage(const boost::system::error_code& error,
                        const size_t bytes_read, uint64_t message_size,
@@ -468,7 +599,7 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     VLOG(2) << "Read " << bytes_read << " bytes.";
     if (error == boost::asio::error::eof) {
       VLOG(1) << "Received EOF, connection terminating!";
-      async_recv_lock_.unlock();
+      ReleaseAsyncRecvBuffer();
       final_callback(error, bytes_read, final_envelope);
       return;
     } else if (error) {
@@ -477,7 +608,7 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
                  << " bytes, expected " << message_size;
       if (error)
         HandleIOError(error);
-      async_recv_lock_.unlock();
+      ReleaseAsyncRecvBuffer();
       final_callback(error, bytes_read, final_envelope);
       return;
     } else {
@@ -494,28 +625,42 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     delete async_recv_buffer_;
     async_recv_buffer_vec_ = NULL;
     async_recv_buffer_ = NULL;
+    // Release the buffer before invoking the callback, as the callback may
+    // start the next receive on this channel.
+    VLOG(2) << "Unlocking async receive buffer";
+    ReleaseAsyncRecvBuffer();
     // Invoke the original callback
-    // XXX(malte): potential race condition -- someone else may finish and
-    // invoke the callback before we do (although this is very unlikely).
     VLOG(2) << "About to invoke final async recv callback!";
     final_callback(error, bytes_read, final_envelope);
-    // Drop the lock
-    VLOG(2) << "Unlocking async receive buffer";
-    async_recv_lock_.unlock();
   }
 
  private:
   boost::mutex sync_recv_lock_;
   boost::mutex sync_send_lock_;
+  // Buffer for synchronous receives
+  vector<char> sync_recv_buf_;
+  // Send queue: the batch currently being filled, a spare batch whose buffer
+  // can be reused, and whether a sender is currently writing a batch.
+  boost::mutex send_queue_lock_;
+  boost::condition_variable send_queue_cond_;
+  shared_ptr<SendBatch> send_queue_;
+  shared_ptr<SendBatch> spare_send_batch_;
+  bool send_in_progress_;
   // Async receive buffer data structures and lock
   boost::mutex async_recv_lock_;
+  boost::condition_variable async_recv_cond_;
   //scoped_ptr<boost::asio::mutable_buffers_1> async_recv_buffer_;
   boost::asio::mutable_buffers_1* async_recv_buffer_;
   //scoped_ptr<vector<char> > async_recv_buffer_vec_;
   char* async_recv_buffer_vec_;
+  // True while an asynchronous receive uses the buffer.
+  bool async_recv_busy_;
   // TCP and io_service data structures
   shared_ptr<boost::asio::io_service> client_io_service_;
   scoped_ptr<boost::asio::io_service::work> io_service_work_;
+  // The receive handlers of the channel run on this strand, so that they
+  // never run concurrently even if the I/O service has several threads.
+  scoped_ptr<boost::asio::io_service::strand> strand_;
   // This cannot be a shared_ptr, since the client socket may disappear under
   // the channel's feet at any point in time.
   boost::asio::ip::tcp::socket* client_socket_;
@@ -25,6 +25,7 @@ using ::google::protobuf::Message;
 
 DEFINE_uint64(heartbeat_interval, 1000000,
               "Heartbeat interval in microseconds.");
+DECLARE_uint64(max_message_size);
 
 namespace firmament {
 namespace platform_unix {
@@ -77,6 +78,16 @@ class StreamSocketsChannelTest : public ::testing::Test {
     local_adapter_->StopListen();
   }
 
+ public:
+  void SendTestMessages(int64_t num_messages) {
+    for (int64_t value = 0; value < num_messages; ++value) {
+      BaseMessage tm;
+      SUBMSG_WRITE(tm, test, test, value);
+      Envelope<BaseMessage> envelope(&tm);
+      CHECK(channel_->SendS(envelope));
+    }
+  }
+
   // Objects declared here can be used by all tests.
   StreamSocketsAdapter<BaseMessage>* local_adapter_;
   StreamSocketsAdapter<BaseMessage>* remote_adapter_;
@@ -210,6 +221,56 @@ TEST_F(StreamSocketsChannelTest, TCPAsyncProtobufSend) {
   CHECK_EQ(SUBMSG_READ(r_tm, test, test), 5);
 }
 
+// Tests that messages sent concurrently from several threads (and hence
+// possibly coalesced into one write) all arrive intact.
+TEST_F(StreamSocketsChannelTest, TCPSyncProtobufSendConcurrent) {
+  const uint64_t kNumThreads = 4;
+  const int64_t kNumMessages = 100;
+  while (!channel_->Ready()) {
+    VLOG(3) << "Waiting for adapter to be ready...";
+  }
+  while (remote_adapter_->NumActiveChannels() == 0) {
+    VLOG(3) << "Waiting for back-channel to appear...";
+  }
+  MessagingChannelInterface<BaseMessage>* backchannel =
+      remote_adapter_->GetChannelForEndpoint(channel_->LocalEndpointString());
+  while (!backchannel->Ready()) {
+    VLOG(3) << "Waiting for back-channel to be ready...";
+  }
+  boost::thread_group senders;
+  for (uint64_t i = 0; i < kNumThreads; ++i) {
+    senders.create_thread(
+        boost::bind(&StreamSocketsChannelTest::SendTestMessages, this,
+                    kNumMessages));
+  }
+  vector<int64_t> counts(kNumMessages, 0);
+  for (uint64_t i = 0; i < kNumThreads * kNumMessages; ++i) {
+    BaseMessage r_tm;
+    Envelope<BaseMessage> recv_env(&r_tm);
+    CHECK(backchannel->RecvS(&recv_env));
+    counts[SUBMSG_READ(r_tm, test, test)]++;
+  }
+  senders.join_all();
+  for (int64_t value = 0; value < kNumMessages; ++value) {
+    EXPECT_EQ(counts[value], kNumThreads);
+  }
+}
+
+// Tests that a message larger than the size limit is not sent.
+TEST_F(StreamSocketsChannelTest, TCPSyncSendTooLarge) {
+  BaseMessage tm;
+  SUBMSG_WRITE(tm, test, test, 5);
+  Envelope<BaseMessage> envelope(&tm);
+  while (!channel_->Ready()) {
+    VLOG(3) << "Waiting for adapter to be ready...";
+  }
+  uint64_t max_message_size = FLAGS_max_message_size;
+  FLAGS_max_message_size = 1;
+  EXPECT_FALSE(channel_->SendS(envelope));
+  FLAGS_max_message_size = max_message_size;
+  EXPECT_TRUE(channel_->SendS(envelope));
+}
+
 }  // namespace streamsockets
 }  // namespace platform_unix
 }  // namespace firmament
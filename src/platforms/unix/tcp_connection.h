@@ -43,6 +43,9 @@ class TCPConnection : public boost::enable_shared_from_this<TCPConnection>,
   tcp::socket* socket() {
     return &socket_;
   }
+  shared_ptr<io_service> get_io_service() {
+    return io_service_;
+  }
   const string LocalEndpointString();
   bool Ready() { return ready_; }
   const string RemoteEndpointString();
@@ -0,0 +1,174 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "scheduling/equiv_class_stats.h"
+
+#include <cmath>
+#include <limits>
+
+DEFINE_double(tec_stats_decay_factor, 0.1,
+              "Weight of the most recent report in the exponentially decayed "
+              "per equivalence class averages");
+
+namespace firmament {
+
+// Per-report metrics, as used by the equivalence class averages.
+static double ReportCPI(const TaskFinalReport& report) {
+  return static_cast<double>(report.cycles()) /
+    static_cast<double>(report.instructions());
+}
+
+static double ReportIPMA(const TaskFinalReport& report) {
+  return static_cast<double>(report.instructions()) /
+    static_cast<double>(report.llc_refs());
+}
+
+static double ReportPsPI(const TaskFinalReport& report) {
+  return static_cast<double>(report.runtime() * 10000000000.0) /
+    static_cast<double>(report.instructions());
+}
+
+static double ReportRuntime(const TaskFinalReport& report) {
+  // Runtime is in seconds, but a double -- so convert into ms here
+  return report.runtime() * 1000.0;
+}
+
+WindowSum::WindowSum() {
+  Clear();
+}
+
+void WindowSum::Add(double value) {
+  if (std::isnan(value)) {
+    num_nan_++;
+  } else if (std::isinf(value)) {
+    if (value > 0) {
+      num_pos_inf_++;
+    } else {
+      num_neg_inf_++;
+    }
+  } else {
+    sum_ += value;
+  }
+}
+
+void WindowSum::Clear() {
+  sum_ = 0.0;
+  num_nan_ = 0;
+  num_pos_inf_ = 0;
+  num_neg_inf_ = 0;
+}
+
+void WindowSum::Remove(double value) {
+  if (std::isnan(value)) {
+    CHECK_GT(num_nan_, 0);
+    num_nan_--;
+  } else if (std::isinf(value)) {
+    if (value > 0) {
+      CHECK_GT(num_pos_inf_, 0);
+      num_pos_inf_--;
+    } else {
+      CHECK_GT(num_neg_inf_, 0);
+      num_neg_inf_--;
+    }
+  } else {
+    sum_ -= value;
+  }
+}
+
+double WindowSum::Value() const {
+  if (num_nan_ > 0 || (num_pos_inf_ > 0 && num_neg_inf_ > 0)) {
+    return numeric_limits<double>::quiet_NaN();
+  } else if (num_pos_inf_ > 0) {
+    return numeric_limits<double>::infinity();
+  } else if (num_neg_inf_ > 0) {
+    return -numeric_limits<double>::infinity();
+  }
+  return sum_;
+}
+
+// Moves the exponentially decayed mean towards the value. Non-finite values
+// (e.g., the CPI of a task that reported no instructions) are skipped, as the
+// mean would otherwise never recover from them.
+static void UpdateDecayedMean(double value, uint64_t* num_values,
+                              double* mean) {
+  if (!std::isfinite(value)) {
+    return;
+  }
+  if (*num_values == 0) {
+    *mean = value;
+  } else {
+    *mean += FLAGS_tec_stats_decay_factor * (value - *mean);
+  }
+  (*num_values)++;
+}
+
+EquivClassStats::EquivClassStats()
+  : num_reports_(0), total_reports_(0), num_decayed_cpi_(0),
+    num_decayed_runtime_(0), decayed_cpi_(0.0), decayed_runtime_(0.0),
+    runtime_p50_(0.5), runtime_p99_(0.99) {
+}
+
+void EquivClassStats::AddReport(const TaskFinalReport& report) {
+  AddToWindow(report);
+  double runtime = ReportRuntime(report);
+  UpdateDecayedMean(ReportCPI(report), &num_decayed_cpi_, &decayed_cpi_);
+  UpdateDecayedMean(runtime, &num_decayed_runtime_, &decayed_runtime_);
+  if (std::isfinite(runtime)) {
+    runtime_p50_.Add(runtime);
+    runtime_p99_.Add(runtime);
+  }
+  total_reports_++;
+}
+
+void EquivClassStats::AddToWindow(const TaskFinalReport& report) {
+  cpi_sum_.Add(ReportCPI(report));
+  ipma_sum_.Add(ReportIPMA(report));
+  pspi_sum_.Add(ReportPsPI(report));
+  runtime_sum_.Add(ReportRuntime(report));
+  num_reports_++;
+}
+
+double EquivClassStats::AvgCPI() const {
+  return WindowMean(cpi_sum_);
+}
+
+double EquivClassStats::AvgIPMA() const {
+  return WindowMean(ipma_sum_);
+}
+
+double EquivClassStats::AvgPsPI() const {
+  return WindowMean(pspi_sum_);
+}
+
+double EquivClassStats::AvgRuntime() const {
+  return WindowMean(runtime_sum_);
+}
+
+void EquivClassStats::EvictReport(const TaskFinalReport& report) {
+  CHECK_GT(num_reports_, 0);
+  cpi_sum_.Remove(ReportCPI(report));
+  ipma_sum_.Remove(ReportIPMA(report));
+  pspi_sum_.Remove(ReportPsPI(report));
+  runtime_sum_.Remove(ReportRuntime(report));
+  num_reports_--;
+}
+
+void EquivClassStats::RecomputeWindow(
+    const RingBuffer<TaskFinalReport>& reports) {
+  cpi_sum_.Clear();
+  ipma_sum_.Clear();
+  pspi_sum_.Clear();
+  runtime_sum_.Clear();
+  num_reports_ = 0;
+  for (uint64_t index = 0; index < reports.size(); ++index) {
+    AddToWindow(reports[index]);
+  }
+}
+
+double EquivClassStats::WindowMean(const WindowSum& sum) const {
+  if (num_reports_ == 0)
+    return 0;
+  return sum.Value() / num_reports_;
+}
+
+}  // namespace firmament
@@ -0,0 +1,111 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Statistics of the final reports of the tasks in an equivalence class. The
+// statistics are updated as reports arrive, so that they can be read in
+// constant time.
+
+#ifndef FIRMAMENT_SCHEDULING_EQUIV_CLASS_STATS_H
+#define FIRMAMENT_SCHEDULING_EQUIV_CLASS_STATS_H
+
+#include "base/common.h"
+#include "base/task_final_report.pb.h"
+#include "misc/ring_buffer.h"
+#include "misc/streaming_quantile.h"
+
+namespace firmament {
+
+/**
+ * Sum of a sliding window of values. Non-finite values (e.g., the CPI of a
+ * task that reported no instructions) are counted separately so that they
+ * can be removed from the window again.
+ */
+class WindowSum {
+ public:
+  WindowSum();
+  void Add(double value);
+  void Clear();
+  void Remove(double value);
+  double Value() const;
+
+ private:
+  double sum_;
+  uint64_t num_nan_;
+  uint64_t num_pos_inf_;
+  uint64_t num_neg_inf_;
+};
+
+class EquivClassStats {
+ public:
+  EquivClassStats();
+
+  /**
+   * Updates the statistics with a new report.
+   */
+  void AddReport(const TaskFinalReport& report);
+
+  /**
+   * Removes a report from the window of recent reports. It must be called
+   * when the report is dropped from the knowledge base.
+   */
+  void EvictReport(const TaskFinalReport& report);
+
+  /**
+   * Recomputes the window statistics from the reports currently in the
+   * window, which discards any accumulated rounding errors.
+   */
+  void RecomputeWindow(const RingBuffer<TaskFinalReport>& reports);
+
+  // Means over the window of recent reports.
+  double AvgCPI() const;
+  double AvgIPMA() const;
+  double AvgPsPI() const;
+  // Runtime in milliseconds.
+  double AvgRuntime() const;
+  // Exponentially decayed means over all the reports with a finite value of
+  // the metric.
+  inline double DecayedAvgCPI() const {
+    return decayed_cpi_;
+  }
+  inline double DecayedAvgRuntime() const {
+    return decayed_runtime_;
+  }
+  // Runtime quantiles, in milliseconds, over all the reports with a finite
+  // runtime.
+  inline double RuntimeP50() const {
+    return runtime_p50_.Value();
+  }
+  inline double RuntimeP99() const {
+    return runtime_p99_.Value();
+  }
+  // Number of reports in the window.
+  inline uint64_t num_reports() const {
+    return num_reports_;
+  }
+  // Number of reports ever added.
+  inline uint64_t total_reports() const {
+    return total_reports_;
+  }
+
+ private:
+  void AddToWindow(const TaskFinalReport& report);
+  double WindowMean(const WindowSum& sum) const;
+
+  uint64_t num_reports_;
+  uint64_t total_reports_;
+  WindowSum cpi_sum_;
+  WindowSum ipma_sum_;
+  WindowSum pspi_sum_;
+  WindowSum runtime_sum_;
+  // Number of values that have been folded into the decayed means.
+  uint64_t num_decayed_cpi_;
+  uint64_t num_decayed_runtime_;
+  double decayed_cpi_;
+  double decayed_runtime_;
+  StreamingQuantile runtime_p50_;
+  StreamingQuantile runtime_p99_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_EQUIV_CLASS_STATS_H
@@ -0,0 +1,63 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "scheduling/flow/binary_exporter.h"
+
+#include <cstdio>
+#include <string>
+
+#include "scheduling/flow/binary_wire_format.h"
+#include "scheduling/flow/dimacs_add_node.h"
+
+namespace firmament {
+
+// Upper bound on the number of bytes needed to encode a node or an arc
+// record. We use it to reserve buffer space ahead of the export.
+#define MAX_RECORD_LENGTH (1 + 6 * MAX_VARINT_LENGTH)
+
+BinaryExporter::BinaryExporter() {
+}
+
+bool BinaryExporter::Export(const FlowGraph& graph, FILE* stream) {
+  buffer_.clear();
+  buffer_.reserve((graph.NumNodes() + graph.NumArcs() + 1) *
+                  MAX_RECORD_LENGTH);
+  AppendRecordTag(BINARY_PROBLEM, &buffer_);
+  AppendVarint(graph.NumNodes(), &buffer_);
+  AppendVarint(graph.NumArcs(), &buffer_);
+  for (const auto& node : graph.Nodes()) {
+    GenerateNode(*node);
+  }
+  for (const auto& arc : graph.Arcs()) {
+    GenerateArc(*arc);
+  }
+  return WriteBinaryFrame(buffer_, stream);
+}
+
+bool BinaryExporter::ExportIncremental(const vector<DIMACSChange*>& changes,
+                                       FILE* stream) {
+  buffer_.clear();
+  for (const auto& change : changes) {
+    change->GenerateBinaryChange(&buffer_);
+  }
+  return WriteBinaryFrame(buffer_, stream);
+}
+
+inline void BinaryExporter::GenerateArc(const FlowGraphArc& arc) {
+  AppendRecordTag(BINARY_ARC, &buffer_);
+  AppendVarint(arc.src_, &buffer_);
+  AppendVarint(arc.dst_, &buffer_);
+  AppendVarint(arc.cap_lower_bound_, &buffer_);
+  AppendVarint(arc.cap_upper_bound_, &buffer_);
+  AppendSignedVarint(arc.cost_, &buffer_);
+  AppendVarint(arc.type_, &buffer_);
+}
+
+inline void BinaryExporter::GenerateNode(const FlowGraphNode& node) {
+  AppendRecordTag(BINARY_NODE, &buffer_);
+  AppendVarint(node.id_, &buffer_);
+  AppendSignedVarint(node.excess_, &buffer_);
+  AppendVarint(DIMACSAddNode::GetNodeType(node.type_), &buffer_);
+}
+
+}  // namespace firmament
@@ -0,0 +1,47 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Export utility that writes the flow graph (or the changes to it) using the
+// compact binary wire format described in binary_wire_format.h.
+
+#ifndef FIRMAMENT_SCHEDULING_FLOW_BINARY_EXPORTER_H
+#define FIRMAMENT_SCHEDULING_FLOW_BINARY_EXPORTER_H
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "scheduling/flow/dimacs_change.h"
+#include "scheduling/flow/flow_graph.h"
+#include "scheduling/flow/flow_graph_arc.h"
+#include "scheduling/flow/flow_graph_node.h"
+
+namespace firmament {
+
+class BinaryExporter {
+ public:
+  BinaryExporter();
+  /**
+   * Writes the entire graph to the stream as a single frame.
+   * @return false if writing to the stream failed
+   */
+  bool Export(const FlowGraph& graph, FILE* stream);
+  /**
+   * Writes the graph changes to the stream as a single frame.
+   * @return false if writing to the stream failed
+   */
+  bool ExportIncremental(const vector<DIMACSChange*>& changes, FILE* stream);
+
+ private:
+  inline void GenerateArc(const FlowGraphArc& arc);
+  inline void GenerateNode(const FlowGraphNode& node);
+
+  // Buffer into which we encode an entire round. The buffer is re-used
+  // across rounds in order to avoid re-allocating it.
+  string buffer_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_FLOW_BINARY_EXPORTER_H
@@ -0,0 +1,148 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the binary exporter.
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "scheduling/flow/binary_exporter.h"
+#include "scheduling/flow/binary_wire_format.h"
+#include "scheduling/flow/dimacs_add_node.h"
+#include "scheduling/flow/dimacs_change_arc.h"
+#include "scheduling/flow/dimacs_remove_node.h"
+#include "scheduling/flow/flow_graph.h"
+
+namespace firmament {
+
+// The fixture for testing the binary exporter.
+class BinaryExporterTest : public ::testing::Test {
+ protected:
+  BinaryExporterTest() {
+    FLAGS_v = 2;
+  }
+
+  // Reads back the single frame that has been written to the stream.
+  string ReadFrame(FILE* stream) {
+    string frame;
+    rewind(stream);
+    CHECK(ReadBinaryFrame(stream, &frame));
+    string next_frame;
+    CHECK(!ReadBinaryFrame(stream, &next_frame));
+    return frame;
+  }
+
+  uint64_t ExpectVarint(const char** pos, const char* end) {
+    uint64_t value = 0;
+    EXPECT_TRUE(ReadVarint(pos, end, &value));
+    return value;
+  }
+
+  int64_t ExpectSignedVarint(const char** pos, const char* end) {
+    int64_t value = 0;
+    EXPECT_TRUE(ReadSignedVarint(pos, end, &value));
+    return value;
+  }
+};
+
+TEST_F(BinaryExporterTest, ExportFailure) {
+  // Writing to a stream that is only open for reading fails like writing to
+  // a solver that has exited does.
+  FILE* stream = fopen("/dev/null", "r");
+  ASSERT_TRUE(stream != NULL);
+  FlowGraph graph;
+  graph.AddNode();
+  BinaryExporter exporter;
+  EXPECT_FALSE(exporter.Export(graph, stream));
+  fclose(stream);
+}
+
+TEST_F(BinaryExporterTest, ExportGraph) {
+  FlowGraph graph;
+  FlowGraphNode* sink = graph.AddNode();
+  sink->type_ = FlowNodeType::SINK;
+  sink->excess_ = -1;
+  FlowGraphNode* task = graph.AddNode();
+  task->type_ = FlowNodeType::UNSCHEDULED_TASK;
+  task->excess_ = 1;
+  FlowGraphArc* arc = graph.AddArc(task, sink);
+  graph.ChangeArc(arc, 0, 1, -42);
+  FILE* stream = tmpfile();
+  ASSERT_TRUE(stream != NULL);
+  BinaryExporter exporter;
+  ASSERT_TRUE(exporter.Export(graph, stream));
+  string frame = ReadFrame(stream);
+  const char* pos = frame.data();
+  const char* end = pos + frame.size();
+  ASSERT_EQ(BINARY_PROBLEM, *pos++);
+  EXPECT_EQ(graph.NumNodes(), ExpectVarint(&pos, end));
+  EXPECT_EQ(graph.NumArcs(), ExpectVarint(&pos, end));
+  for (const auto& node : graph.Nodes()) {
+    ASSERT_EQ(BINARY_NODE, *pos++);
+    EXPECT_EQ(node->id_, ExpectVarint(&pos, end));
+    EXPECT_EQ(node->excess_, ExpectSignedVarint(&pos, end));
+    EXPECT_EQ(DIMACSAddNode::GetNodeType(node->type_),
+              ExpectVarint(&pos, end));
+  }
+  ASSERT_EQ(BINARY_ARC, *pos++);
+  EXPECT_EQ(task->id_, ExpectVarint(&pos, end));
+  EXPECT_EQ(sink->id_, ExpectVarint(&pos, end));
+  EXPECT_EQ(0, ExpectVarint(&pos, end));
+  EXPECT_EQ(1, ExpectVarint(&pos, end));
+  EXPECT_EQ(-42, ExpectSignedVarint(&pos, end));
+  EXPECT_EQ(arc->type_, ExpectVarint(&pos, end));
+  EXPECT_EQ(pos, end);
+  fclose(stream);
+}
+
+TEST_F(BinaryExporterTest, ExportIncremental) {
+  FlowGraph graph;
+  FlowGraphNode* sink = graph.AddNode();
+  FlowGraphNode* task = graph.AddNode();
+  FlowGraphArc* arc = graph.AddArc(task, sink);
+  graph.ChangeArc(arc, 0, 1, 7);
+  DIMACSChangeArc change_arc(*arc, 3);
+  DIMACSRemoveNode remove_node(*task);
+  vector<DIMACSChange*> changes;
+  changes.push_back(&change_arc);
+  changes.push_back(&remove_node);
+  FILE* stream = tmpfile();
+  ASSERT_TRUE(stream != NULL);
+  BinaryExporter exporter;
+  ASSERT_TRUE(exporter.ExportIncremental(changes, stream));
+  string frame = ReadFrame(stream);
+  const char* pos = frame.data();
+  const char* end = pos + frame.size();
+  ASSERT_EQ(BINARY_CHANGE_ARC, *pos++);
+  EXPECT_EQ(task->id_, ExpectVarint(&pos, end));
+  EXPECT_EQ(sink->id_, ExpectVarint(&pos, end));
+  EXPECT_EQ(0, ExpectVarint(&pos, end));
+  EXPECT_EQ(1, ExpectVarint(&pos, end));
+  EXPECT_EQ(7, ExpectSignedVarint(&pos, end));
+  EXPECT_EQ(arc->type_, ExpectVarint(&pos, end));
+  EXPECT_EQ(3, ExpectSignedVarint(&pos, end));
+  ASSERT_EQ(BINARY_REMOVE_NODE, *pos++);
+  EXPECT_EQ(task->id_, ExpectVarint(&pos, end));
+  EXPECT_EQ(pos, end);
+  // An empty change set is still sent as a frame, which marks the end of the
+  // iteration.
+  changes.clear();
+  rewind(stream);
+  ASSERT_TRUE(exporter.ExportIncremental(changes, stream));
+  string empty_frame;
+  rewind(stream);
+  ASSERT_TRUE(ReadBinaryFrame(stream, &empty_frame));
+  EXPECT_TRUE(empty_frame.empty());
+  fclose(stream);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
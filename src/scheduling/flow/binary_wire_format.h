@@ -0,0 +1,52 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Helpers for the compact binary protocol used as an alternative to DIMACS
+// when exchanging flow graphs and flows with a solver.
+//
+// Each scheduling round is sent as a single frame (see misc/binary_frame.h).
+// The payload is a sequence of records, each starting with a one-byte tag
+// (mirroring the DIMACS line types) and followed by varint-encoded fields.
+// Signed fields are zig-zag encoded.
+//
+//   p num_nodes num_arcs
+//   n node_id excess node_type
+//   a src dst cap_lower_bound cap_upper_bound cost arc_type
+//   x src dst cap_lower_bound cap_upper_bound cost arc_type old_cost
+//   r node_id
+//   f src dst flow
+//   m task_node_id pu_node_id
+//   s cost
+//   t algorithm_runtime
+//
+// The end of a frame marks the end of the iteration (i.e., "c EOI").
+
+#ifndef FIRMAMENT_SCHEDULING_FLOW_BINARY_WIRE_FORMAT_H
+#define FIRMAMENT_SCHEDULING_FLOW_BINARY_WIRE_FORMAT_H
+
+#include <string>
+
+#include "base/common.h"
+#include "misc/binary_frame.h"
+
+namespace firmament {
+
+enum BinaryRecordTag {
+  BINARY_PROBLEM = 'p',
+  BINARY_NODE = 'n',
+  BINARY_ARC = 'a',
+  BINARY_CHANGE_ARC = 'x',
+  BINARY_REMOVE_NODE = 'r',
+  BINARY_FLOW = 'f',
+  BINARY_TASK_MAPPING = 'm',
+  BINARY_COST = 's',
+  BINARY_ALGORITHM_TIME = 't',
+};
+
+inline void AppendRecordTag(BinaryRecordTag tag, string* buffer) {
+  buffer->push_back(static_cast<char>(tag));
+}
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_FLOW_BINARY_WIRE_FORMAT_H
@@ -384,16 +384,6 @@ vector<EquivClass_t>* CocoCostModel::GetTaskEquivClasses(TaskID_t task_id) {
   // of the job id.
   EquivClass_t task_agg = static_cast<EquivClass_t>(HashJobID(td));
   equiv_classes->push_back(task_agg);
-  task_aggs_.insert(task_agg);
-  unordered_map<EquivClass_t, unordered_set<TaskID_t> >::iterator task_ec_it =
-    task_ec_to_set_task_id_.find(task_agg);
-  if (task_ec_it != task_ec_to_set_task_id_.end()) {
-    task_ec_it->second.insert(task_id);
-  } else {
-    unordered_set<TaskID_t> task_set;
-    task_set.insert(task_id);
-    CHECK(InsertIfNotPresent(&task_ec_to_set_task_id_, task_agg, task_set));
-  }
   return equiv_classes;
 }
 
@@ -770,9 +760,14 @@ void CocoCostModel::AddMachine(ResourceTopologyNodeDescriptor* rtnd_ptr) {
 }
 
 void CocoCostModel::AddTask(TaskID_t task_id) {
+  // N.B.: We record the task's ECs here rather than in GetTaskEquivClasses
+  // because the flow graph manager may call the latter concurrently for
+  // different tasks.
   vector<EquivClass_t>* equiv_classes = GetTaskEquivClasses(task_id);
   const TaskDescriptor& td = GetTask(task_id);
   for (auto& equiv_class : *equiv_classes) {
+    task_aggs_.insert(equiv_class);
+    task_ec_to_set_task_id_[equiv_class].insert(task_id);
     // NOTE: The code assumes that all the task connected to an
     // equivalence class request the same amount of resources.
     InsertIfNotPresent(&task_ec_to_resource_request_, equiv_class,
@@ -1116,4 +1111,8 @@ FlowGraphNode* CocoCostModel::UpdateStats(FlowGraphNode* accumulator,
   return accumulator;
 }
 
+bool CocoCostModel::SupportsConcurrentQueries() const {
+  return true;
+}
+
 }  // namespace firmament
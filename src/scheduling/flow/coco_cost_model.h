@@ -81,6 +81,7 @@ class CocoCostModel : public CostModelInterface {
   FlowGraphNode* GatherStats(FlowGraphNode* accumulator, FlowGraphNode* other);
   void PrepareStats(FlowGraphNode* accumulator);
   FlowGraphNode* UpdateStats(FlowGraphNode* accumulator, FlowGraphNode* other);
+  bool SupportsConcurrentQueries() const;
 
  private:
   // Fixed value for OMEGA, the normalization ceiling for each dimension's cost
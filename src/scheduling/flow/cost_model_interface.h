@@ -139,6 +139,10 @@ class CostModelInterface {
   /**
    * Gathers statistics during reverse traversal of resource topology (from
    * sink upwards). Called on pairs of connected nodes.
+   * N.B.: The traversal may call PrepareStats, GatherStats and UpdateStats
+   * concurrently for nodes that belong to different machines (see
+   * FLAGS_topology_stats_threads). The methods must only modify the
+   * accumulator's state.
    */
   virtual FlowGraphNode* GatherStats(FlowGraphNode* accumulator,
                                      FlowGraphNode* other) = 0;
@@ -155,6 +159,20 @@ class CostModelInterface {
   virtual FlowGraphNode* UpdateStats(FlowGraphNode* accumulator,
                                      FlowGraphNode* other) = 0;
 
+  /**
+   * Returns true if the methods the flow graph manager calls to update an
+   * unscheduled task's arcs (i.e. TaskToUnscheduledAggCost,
+   * GetTaskEquivClasses, TaskToEquivClassAggregator, GetTaskPreferenceArcs and
+   * TaskToResourceNodeCost) and an equivalence class' arcs (i.e.
+   * GetEquivClassToEquivClassesArcs, EquivClassToEquivClass,
+   * GetOutgoingEquivClassPrefArcs and EquivClassToResourceNode) can be called
+   * concurrently with each other, for different tasks and equivalence classes.
+   * Cost models that update their state in these methods must return false.
+   */
+  virtual bool SupportsConcurrentQueries() const {
+    return false;
+  }
+
   /**
    * Handle to pull debug information from cost model; return string.
    */
@@ -176,6 +194,36 @@ class CostModelInterface {
   shared_ptr<FlowGraphManager> flow_graph_manager_;
 };
 
+/**
+ * Visitor that forwards the resource topology statistics callbacks to a cost
+ * model. CostModel must be a concrete cost model class: the calls are bound
+ * statically and can thus be inlined in the topology traversal.
+ */
+template <typename CostModel>
+class CostModelStatsVisitor {
+ public:
+  explicit CostModelStatsVisitor(CostModel* cost_model)
+    : cost_model_(cost_model) {
+  }
+
+  inline void Prepare(FlowGraphNode* accumulator) {
+    cost_model_->CostModel::PrepareStats(accumulator);
+  }
+
+  inline FlowGraphNode* Gather(FlowGraphNode* accumulator,
+                               FlowGraphNode* other) {
+    return cost_model_->CostModel::GatherStats(accumulator, other);
+  }
+
+  inline FlowGraphNode* Update(FlowGraphNode* accumulator,
+                               FlowGraphNode* other) {
+    return cost_model_->CostModel::UpdateStats(accumulator, other);
+  }
+
+ private:
+  CostModel* cost_model_;
+};
+
 }  // namespace firmament
 
 #endif  // FIRMAMENT_SCHEDULING_FLOW_COST_MODEL_INTERFACE_H
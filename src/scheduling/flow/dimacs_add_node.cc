@@ -6,24 +6,13 @@
 
 #include "scheduling/flow/dimacs_add_node.h"
 
-namespace firmament {
-
-// Node type is used to construct the mapping of tasks to PUs in the solver.
-// NOTE: Do not reorder types because it will affect the communication with
-// the solver.
+#include "scheduling/flow/binary_wire_format.h"
 
-enum NodeType {
-  DIMACS_NODE_OTHER = 0,
-  DIMACS_NODE_TASK = 1,
-  DIMACS_NODE_PU = 2,
-  DIMACS_NODE_SINK = 3,
-  DIMACS_NODE_MACHINE = 4,
-  DIMACS_NODE_INTERMEDIATE_RES = 5
-};
+namespace firmament {
 
 DIMACSAddNode::DIMACSAddNode(const FlowGraphNode& node,
                              const vector<FlowGraphArc*>& arcs) :
-     DIMACSChange(), id_(node.id_), excess_(node.excess_), type_(node.type_) {
+     DIMACSChange(DIMACS_ADD_NODE_CHANGE), id_(node.id_), excess_(node.excess_), type_(node.type_) {
   for (FlowGraphArc* arc : arcs) {
     // NOTE: The DIMACS stats for these new arcs have already been updated when
     // the arcs were created.
@@ -31,6 +20,16 @@ DIMACSAddNode::DIMACSAddNode(const FlowGraphNode& node,
   }
 }
 
+void DIMACSAddNode::GenerateBinaryChange(string* buffer) const {
+  AppendRecordTag(BINARY_NODE, buffer);
+  AppendVarint(id_, buffer);
+  AppendSignedVarint(excess_, buffer);
+  AppendVarint(GetNodeType(), buffer);
+  for (const DIMACSNewArc &new_arc : arc_additions_) {
+    new_arc.GenerateBinaryChange(buffer);
+  }
+}
+
 const string DIMACSAddNode::GenerateChange() const {
   stringstream ss;
   ss << DIMACSChange::GenerateChangeDescription();
@@ -42,20 +41,24 @@ const string DIMACSAddNode::GenerateChange() const {
 }
 
 uint32_t DIMACSAddNode::GetNodeType() const {
-  if (type_ == FlowNodeType::PU) {
+  return GetNodeType(type_);
+}
+
+uint32_t DIMACSAddNode::GetNodeType(FlowNodeType type) {
+  if (type == FlowNodeType::PU) {
     return DIMACS_NODE_PU;
-  } else if (type_ == FlowNodeType::MACHINE) {
+  } else if (type == FlowNodeType::MACHINE) {
     return DIMACS_NODE_MACHINE;
-  } else if (type_ == FlowNodeType::NUMA_NODE ||
-             type_ == FlowNodeType::SOCKET ||
-             type_ == FlowNodeType::CACHE ||
-             type_ == FlowNodeType::CORE) {
+  } else if (type == FlowNodeType::NUMA_NODE ||
+             type == FlowNodeType::SOCKET ||
+             type == FlowNodeType::CACHE ||
+             type == FlowNodeType::CORE) {
     return DIMACS_NODE_INTERMEDIATE_RES;
-  } else if (type_ == FlowNodeType::SINK) {
+  } else if (type == FlowNodeType::SINK) {
     return DIMACS_NODE_SINK;
-  } else if (type_ == FlowNodeType::UNSCHEDULED_TASK ||
-             type_ == FlowNodeType::SCHEDULED_TASK ||
-             type_ == FlowNodeType::ROOT_TASK) {
+  } else if (type == FlowNodeType::UNSCHEDULED_TASK ||
+             type == FlowNodeType::SCHEDULED_TASK ||
+             type == FlowNodeType::ROOT_TASK) {
     return DIMACS_NODE_TASK;
   } else {
     return DIMACS_NODE_OTHER;
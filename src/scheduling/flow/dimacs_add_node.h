@@ -16,12 +16,26 @@
 
 namespace firmament {
 
+// Node type is used to construct the mapping of tasks to PUs in the solver.
+// NOTE: Do not reorder types because it will affect the communication with
+// the solver.
+enum NodeType {
+  DIMACS_NODE_OTHER = 0,
+  DIMACS_NODE_TASK = 1,
+  DIMACS_NODE_PU = 2,
+  DIMACS_NODE_SINK = 3,
+  DIMACS_NODE_MACHINE = 4,
+  DIMACS_NODE_INTERMEDIATE_RES = 5
+};
+
 class DIMACSAddNode : public DIMACSChange {
  public:
   DIMACSAddNode(const FlowGraphNode& node, const vector<FlowGraphArc*>& arcs);
   ~DIMACSAddNode() {}
+  void GenerateBinaryChange(string* buffer) const;
   const string GenerateChange() const;
   uint32_t GetNodeType() const;
+  static uint32_t GetNodeType(FlowNodeType type);
   const uint64_t id_;
   const int64_t excess_;
   const FlowNodeType type_;
@@ -0,0 +1,36 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Common base of the changes that add or modify an arc. The arc fields are
+// laid out identically for both kinds of change, so the change manager can
+// merge and compare arc changes without knowing their concrete type.
+
+#ifndef FIRMAMENT_SCHEDULING_FLOW_DIMACS_ARC_CHANGE_H
+#define FIRMAMENT_SCHEDULING_FLOW_DIMACS_ARC_CHANGE_H
+
+#include "base/types.h"
+#include "scheduling/flow/dimacs_change.h"
+#include "scheduling/flow/flow_graph_arc.h"
+
+namespace firmament {
+
+class DIMACSArcChange : public DIMACSChange {
+ public:
+  DIMACSArcChange(DIMACSChangeKind kind, const FlowGraphArc& arc)
+    : DIMACSChange(kind), src_(arc.src_), dst_(arc.dst_),
+      cap_lower_bound_(arc.cap_lower_bound_),
+      cap_upper_bound_(arc.cap_upper_bound_), cost_(arc.cost_),
+      type_(arc.type_) {
+  }
+
+  uint64_t src_;
+  uint64_t dst_;
+  uint64_t cap_lower_bound_;
+  uint64_t cap_upper_bound_;
+  int64_t cost_;
+  FlowGraphArcType type_;
+};
+
+} // namespace firmament
+
+#endif // FIRMAMENT_SCHEDULING_FLOW_DIMACS_ARC_CHANGE_H
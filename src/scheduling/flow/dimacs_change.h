@@ -10,21 +10,41 @@
 
 namespace firmament {
 
+// Tag that identifies the concrete type of a change. The change manager uses
+// it to classify changes without RTTI.
+enum DIMACSChangeKind {
+  DIMACS_ADD_NODE_CHANGE = 0,
+  DIMACS_REMOVE_NODE_CHANGE = 1,
+  DIMACS_NEW_ARC_CHANGE = 2,
+  DIMACS_CHANGE_ARC_CHANGE = 3
+};
+
 class DIMACSChange {
  public:
+  explicit DIMACSChange(DIMACSChangeKind kind)
+    : comment_(NULL), kind_(kind) {
+  }
   virtual ~DIMACSChange() {
   }
-  virtual const string& comment() const {
+  virtual const char* comment() const {
     return comment_;
   }
+  /**
+   * Sets the comment of the change. The comment is not copied, and hence it
+   * must outlive the change. The FlowGraphChangeManager interns the comments
+   * of the changes it records in its change arena.
+   */
   virtual void set_comment(const char* comment) {
     if (comment) {
       comment_ = comment;
     }
   }
+  inline DIMACSChangeKind kind() const {
+    return kind_;
+  }
 
   const string GenerateChangeDescription() const {
-    if (!comment_.empty()) {
+    if (comment_ && *comment_) {
       stringstream ss;
       ss << "c " << comment_ << "\n";
       return ss.str();
@@ -34,9 +54,15 @@ class DIMACSChange {
   }
 
   virtual const std::string GenerateChange() const = 0;
+  /**
+   * Appends the change to buffer using the binary wire format (see
+   * binary_wire_format.h).
+   */
+  virtual void GenerateBinaryChange(string* buffer) const = 0;
 
  protected:
-  string comment_;
+  const char* comment_;
+  DIMACSChangeKind kind_;
 };
 
 } // namespace firmament
@@ -5,14 +5,24 @@
 
 #include "scheduling/flow/dimacs_change_arc.h"
 
+#include "scheduling/flow/binary_wire_format.h"
+
 namespace firmament {
 
 DIMACSChangeArc::DIMACSChangeArc(const FlowGraphArc& arc,
                                  const int64_t old_cost)
-  : DIMACSChange(), src_(arc.src_), dst_(arc.dst_),
-    cap_lower_bound_(arc.cap_lower_bound_),
-    cap_upper_bound_(arc.cap_upper_bound_), cost_(arc.cost_), type_(arc.type_),
-    old_cost_(old_cost) {
+  : DIMACSArcChange(DIMACS_CHANGE_ARC_CHANGE, arc), old_cost_(old_cost) {
+}
+
+void DIMACSChangeArc::GenerateBinaryChange(string* buffer) const {
+  AppendRecordTag(BINARY_CHANGE_ARC, buffer);
+  AppendVarint(src_, buffer);
+  AppendVarint(dst_, buffer);
+  AppendVarint(cap_lower_bound_, buffer);
+  AppendVarint(cap_upper_bound_, buffer);
+  AppendSignedVarint(cost_, buffer);
+  AppendVarint(type_, buffer);
+  AppendSignedVarint(old_cost_, buffer);
 }
 
 const string DIMACSChangeArc::GenerateChange() const {
@@ -7,23 +7,18 @@
 #include <string>
 
 #include "base/types.h"
-#include "scheduling/flow/dimacs_change.h"
+#include "scheduling/flow/dimacs_arc_change.h"
 #include "scheduling/flow/dimacs_change_stats.h"
 #include "scheduling/flow/flow_graph_arc.h"
 
 namespace firmament {
 
-class DIMACSChangeArc : public DIMACSChange {
+class DIMACSChangeArc : public DIMACSArcChange {
  public:
   explicit DIMACSChangeArc(const FlowGraphArc& arc, int64_t old_cost);
+  void GenerateBinaryChange(string* buffer) const;
   const string GenerateChange() const;
 
-  uint64_t src_;
-  uint64_t dst_;
-  uint64_t cap_lower_bound_;
-  uint64_t cap_upper_bound_;
-  int64_t cost_;
-  FlowGraphArcType type_;
   int64_t old_cost_;
 
   friend DIMACSChangeStats;
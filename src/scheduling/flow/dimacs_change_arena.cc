@@ -0,0 +1,61 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "scheduling/flow/dimacs_change_arena.h"
+
+#include <cstring>
+
+namespace firmament {
+
+// Size of the blocks the arena allocates. A block fits a few thousand
+// changes.
+static const uint64_t kArenaBlockSize = 256 * 1024;
+// All the changes are allocated at this alignment.
+static const uint64_t kArenaAlignment = 16;
+
+DIMACSChangeArena::DIMACSChangeArena(DIMACSChangeStats* dimacs_stats)
+  : dimacs_stats_(dimacs_stats), current_block_(0), current_offset_(0) {
+}
+
+DIMACSChangeArena::~DIMACSChangeArena() {
+  Reset();
+  for (auto& block : blocks_) {
+    delete[] block;
+  }
+}
+
+void* DIMACSChangeArena::Allocate(size_t size) {
+  CHECK_LE(size, kArenaBlockSize);
+  size = (size + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+  if (current_block_ < blocks_.size() &&
+      current_offset_ + size > kArenaBlockSize) {
+    // The change doesn't fit in the current block. Move to the next one.
+    current_block_++;
+    current_offset_ = 0;
+  }
+  if (current_block_ == blocks_.size()) {
+    blocks_.push_back(new char[kArenaBlockSize]);
+    dimacs_stats_->change_arena_blocks_allocated_++;
+  }
+  void* memory = blocks_[current_block_] + current_offset_;
+  current_offset_ += size;
+  return memory;
+}
+
+const char* DIMACSChangeArena::CopyString(const char* str) {
+  size_t length = strlen(str);
+  char* copy = static_cast<char*>(Allocate(length + 1));
+  memcpy(copy, str, length + 1);
+  return copy;
+}
+
+void DIMACSChangeArena::Reset() {
+  for (auto& change : changes_) {
+    change->~DIMACSChange();
+  }
+  changes_.clear();
+  current_block_ = 0;
+  current_offset_ = 0;
+}
+
+}  // namespace firmament
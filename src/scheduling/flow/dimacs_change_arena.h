@@ -0,0 +1,72 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Arena from which the FlowGraphChangeManager allocates the DIMACS changes of
+// a scheduling round. The changes are bump-allocated in large blocks and are
+// all destroyed at once when the round ends. The blocks are kept across
+// rounds, so once the arena has grown to the size of a round it does not
+// allocate any more memory.
+
+#ifndef FIRMAMENT_SCHEDULING_FLOW_DIMACS_CHANGE_ARENA_H
+#define FIRMAMENT_SCHEDULING_FLOW_DIMACS_CHANGE_ARENA_H
+
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "base/common.h"
+#include "scheduling/flow/dimacs_change.h"
+#include "scheduling/flow/dimacs_change_stats.h"
+
+namespace firmament {
+
+class DIMACSChangeArena {
+ public:
+  /**
+   * @param dimacs_stats stats in which to record the arena's allocations
+   */
+  explicit DIMACSChangeArena(DIMACSChangeStats* dimacs_stats);
+  ~DIMACSChangeArena();
+
+  /**
+   * Constructs a change in the arena. The change is owned by the arena and
+   * must not be deleted by the caller.
+   */
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    T* change = new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    changes_.push_back(change);
+    dimacs_stats_->change_records_allocated_++;
+    return change;
+  }
+
+  /**
+   * Copies a string into the arena. The copy lives until the next reset.
+   * @param str the NUL-terminated string to copy
+   * @return the copy
+   */
+  const char* CopyString(const char* str);
+
+  /**
+   * Destroys all the changes allocated since the last reset, but retains the
+   * memory for future use.
+   */
+  void Reset();
+
+ private:
+  void* Allocate(size_t size);
+
+  DIMACSChangeStats* dimacs_stats_;
+  vector<char*> blocks_;
+  // Index of the block we are currently allocating from, and offset of the
+  // first free byte in it.
+  uint64_t current_block_;
+  uint64_t current_offset_;
+  // The changes allocated since the last reset. We need them in order to
+  // call their destructors.
+  vector<DIMACSChange*> changes_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_FLOW_DIMACS_CHANGE_ARENA_H
@@ -10,19 +10,19 @@
 namespace firmament {
 
 DIMACSChangeStats::DIMACSChangeStats() {
-  nodes_added_ = 0;
-  nodes_removed_ = 0;
-  arcs_added_ = 0;
-  arcs_changed_ = 0;
-  arcs_removed_ = 0;
-  for (uint32_t chg_index = 0; chg_index < NUM_CHANGE_TYPES; ++chg_index) {
-    num_changes_of_type_[chg_index] = 0;
-  }
+  ResetStats();
 }
 
 DIMACSChangeStats::~DIMACSChangeStats() {
 }
 
+string DIMACSChangeStats::GetAllocationStatsString() const {
+  return boost::lexical_cast<string>(change_records_allocated_) + "," +
+    boost::lexical_cast<string>(change_arena_blocks_allocated_) + "," +
+    boost::lexical_cast<string>(node_slabs_allocated_) + "," +
+    boost::lexical_cast<string>(arc_slabs_allocated_);
+}
+
 string DIMACSChangeStats::GetStatsString() const {
   string stats = boost::lexical_cast<string>(nodes_added_) + "," +
     boost::lexical_cast<string>(nodes_removed_) + "," +
@@ -44,6 +44,10 @@ void DIMACSChangeStats::ResetStats() {
   for (uint32_t index = 0; index < NUM_CHANGE_TYPES; index++) {
     num_changes_of_type_[index] = 0;
   }
+  change_records_allocated_ = 0;
+  change_arena_blocks_allocated_ = 0;
+  node_slabs_allocated_ = 0;
+  arc_slabs_allocated_ = 0;
 }
 
 void DIMACSChangeStats::UpdateStats(DIMACSChangeType change_type) {
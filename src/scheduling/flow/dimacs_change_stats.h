@@ -63,8 +63,16 @@ struct DIMACSChangeStats {
   uint64_t arcs_changed_;
   uint64_t arcs_removed_;
   uint64_t num_changes_of_type_[NUM_CHANGE_TYPES];
+  // Allocation counters. In steady state (i.e., once the graph and the
+  // change arena have grown to their working size) the slab and block
+  // counters should remain zero.
+  uint64_t change_records_allocated_;
+  uint64_t change_arena_blocks_allocated_;
+  uint64_t node_slabs_allocated_;
+  uint64_t arc_slabs_allocated_;
   DIMACSChangeStats();
   ~DIMACSChangeStats();
+  string GetAllocationStatsString() const;
   string GetStatsString() const;
   void ResetStats();
   void UpdateStats(DIMACSChangeType change_type);
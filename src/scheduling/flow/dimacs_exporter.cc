@@ -17,38 +17,34 @@ namespace firmament {
 DIMACSExporter::DIMACSExporter() {
 }
 
+// N.B.: the export methods do not flush the stream. The stream is buffered
+// and the caller flushes it once the entire graph (or change set) has been
+// written, rather than issuing a write for every line.
+
 void DIMACSExporter::Export(const FlowGraph& graph, FILE* stream) {
   fprintf(stream, "c ===========================\n");
-  fflush(stream);
   fprintf(stream, "p min %" PRIu64 " %" PRIu64 "\n",
           graph.NumNodes(), graph.NumArcs());
-  fflush(stream);
   fprintf(stream, "c ===========================\n");
-  fflush(stream);
   fprintf(stream, "c === ALL NODES FOLLOW ===\n");
-  fflush(stream);
-  for (auto& id_node : graph.Nodes()) {
-    GenerateNode(*id_node.second, stream);
+  for (const auto& node : graph.Nodes()) {
+    GenerateNode(*node, stream);
   }
   fprintf(stream, "c === ALL ARCS FOLLOW ===\n");
-  fflush(stream);
   for (const auto& arc : graph.Arcs()) {
     GenerateArc(*arc, stream);
   }
   // Add end of iteration comment.
   fprintf(stream, "c EOI\n");
-  fflush(stream);
 }
 
 void DIMACSExporter::ExportIncremental(const vector<DIMACSChange*>& changes,
                                        FILE* stream) {
   for (const auto& change : changes) {
     fprintf(stream, "%s", change->GenerateChange().c_str());
-    fflush(stream);
   }
   // Add end of iteration comment.
   fprintf(stream, "c EOI\n");
-  fflush(stream);
 }
 
 inline void DIMACSExporter::GenerateArc(const FlowGraphArc& arc, FILE* stream) {
@@ -56,7 +52,6 @@ inline void DIMACSExporter::GenerateArc(const FlowGraphArc& arc, FILE* stream) {
           "a %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRId64 "\n",
           arc.src_, arc.dst_, arc.cap_lower_bound_, arc.cap_upper_bound_,
           arc.cost_);
-  fflush(stream);
 }
 
 inline void DIMACSExporter::GenerateNode(const FlowGraphNode& node,
@@ -91,7 +86,6 @@ inline void DIMACSExporter::GenerateNode(const FlowGraphNode& node,
   }
   fprintf(stream, "n %" PRIu64 " %" PRId64 " %d\n",
           node.id_, node.excess_, node_type);
-  fflush(stream);
 }
 
 }  // namespace firmament
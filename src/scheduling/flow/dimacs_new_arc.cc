@@ -5,13 +5,22 @@
 
 #include "scheduling/flow/dimacs_new_arc.h"
 
+#include "scheduling/flow/binary_wire_format.h"
+
 namespace firmament {
 
 DIMACSNewArc::DIMACSNewArc(const FlowGraphArc& arc)
-  : DIMACSChange(), src_(arc.src_), dst_(arc.dst_),
-    cap_lower_bound_(arc.cap_lower_bound_),
-    cap_upper_bound_(arc.cap_upper_bound_), cost_(arc.cost_),
-    type_(arc.type_) {
+  : DIMACSArcChange(DIMACS_NEW_ARC_CHANGE, arc) {
+}
+
+void DIMACSNewArc::GenerateBinaryChange(string* buffer) const {
+  AppendRecordTag(BINARY_ARC, buffer);
+  AppendVarint(src_, buffer);
+  AppendVarint(dst_, buffer);
+  AppendVarint(cap_lower_bound_, buffer);
+  AppendVarint(cap_upper_bound_, buffer);
+  AppendSignedVarint(cost_, buffer);
+  AppendVarint(type_, buffer);
 }
 
 const string DIMACSNewArc::GenerateChange() const {
@@ -7,22 +7,16 @@
 #include <string>
 
 #include "base/types.h"
-#include "scheduling/flow/dimacs_change.h"
+#include "scheduling/flow/dimacs_arc_change.h"
 #include "scheduling/flow/flow_graph_arc.h"
 
 namespace firmament {
 
-class DIMACSNewArc : public DIMACSChange {
+class DIMACSNewArc : public DIMACSArcChange {
  public:
   explicit DIMACSNewArc(const FlowGraphArc& arc);
+  void GenerateBinaryChange(string* buffer) const;
   const string GenerateChange() const;
-
-  uint64_t src_;
-  uint64_t dst_;
-  uint64_t cap_lower_bound_;
-  uint64_t cap_upper_bound_;
-  int64_t cost_;
-  FlowGraphArcType type_;
 };
 
 } // namespace firmament
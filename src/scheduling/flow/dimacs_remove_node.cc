@@ -3,10 +3,17 @@
 
 #include "scheduling/flow/dimacs_remove_node.h"
 
+#include "scheduling/flow/binary_wire_format.h"
+
 namespace firmament {
 
 DIMACSRemoveNode::DIMACSRemoveNode(const FlowGraphNode& node)
-  : DIMACSChange(), node_id_(node.id_) {
+  : DIMACSChange(DIMACS_REMOVE_NODE_CHANGE), node_id_(node.id_) {
+}
+
+void DIMACSRemoveNode::GenerateBinaryChange(string* buffer) const {
+  AppendRecordTag(BINARY_REMOVE_NODE, buffer);
+  AppendVarint(node_id_, buffer);
 }
 
 const string DIMACSRemoveNode::GenerateChange() const {
@@ -17,6 +17,7 @@ namespace firmament {
 class DIMACSRemoveNode : public DIMACSChange {
  public:
   explicit DIMACSRemoveNode(const FlowGraphNode& node);
+  void GenerateBinaryChange(string* buffer) const;
   const string GenerateChange() const;
 
   const uint64_t node_id_;
@@ -3,6 +3,8 @@
 
 #include "scheduling/flow/flow_graph.h"
 
+#include <limits>
+
 DEFINE_bool(randomize_flow_graph_node_ids, false,
             "If true the the flow graph will not generate node ids in order");
 
@@ -17,38 +19,46 @@ FlowGraph::FlowGraph() : current_id_(1) {
 }
 
 FlowGraph::~FlowGraph() {
-  for (unordered_map<uint64_t, FlowGraphNode*>::iterator it = node_map_.begin();
-       it != node_map_.end(); ) {
-    unordered_map<uint64_t, FlowGraphNode*>::iterator it_tmp = it;
-    ++it;
-    DeleteNode(it_tmp->second);
-  }
+  // The nodes and arcs are owned by the slot vectors and get released with
+  // them.
 }
 
 FlowGraphArc* FlowGraph::AddArc(FlowGraphNode* src,
                                 FlowGraphNode* dst) {
-  FlowGraphArc* arc = new FlowGraphArc(src->id_, dst->id_, src, dst);
-  CHECK(arc_set_.insert(arc).second);
-  src->AddArc(arc);
-  return arc;
+  return AddArc(src->id_, dst->id_);
 }
 
 FlowGraphArc* FlowGraph::AddArc(uint64_t src, uint64_t dst) {
-  FlowGraphNode* src_node = FindPtrOrNull(node_map_, src);
+  FlowGraphNode* src_node = NodeOrNull(src);
   CHECK_NOTNULL(src_node);
-  FlowGraphNode* dst_node = FindPtrOrNull(node_map_, dst);
+  FlowGraphNode* dst_node = NodeOrNull(dst);
   CHECK_NOTNULL(dst_node);
-  FlowGraphArc* arc = new FlowGraphArc(src, dst, src_node, dst_node);
-  arc_set_.insert(arc);
+  FlowGraphArc* arc;
+  if (unused_arcs_.empty()) {
+    arc_slots_.emplace_back(src, dst, src_node, dst_node);
+    arc = &arc_slots_.back();
+  } else {
+    arc = unused_arcs_.back();
+    unused_arcs_.pop_back();
+    *arc = FlowGraphArc(src, dst, src_node, dst_node);
+  }
+  CHECK_LT(arcs_.size(), numeric_limits<uint32_t>::max());
+  arc->graph_index_ = static_cast<uint32_t>(arcs_.size());
+  arcs_.push_back(arc);
   src_node->AddArc(arc);
   return arc;
 }
 
 FlowGraphNode* FlowGraph::AddNode() {
   uint64_t id = NextId();
-  FlowGraphNode* node = new FlowGraphNode(id);
-  CHECK_NOTNULL(node);
-  CHECK(InsertIfNotPresent(&node_map_, id, node));
+  while (node_slots_.size() <= id) {
+    node_slots_.emplace_back(node_slots_.size());
+  }
+  FlowGraphNode* node = &node_slots_[id];
+  CHECK(NodeOrNull(id) == NULL);
+  CHECK_LT(nodes_.size(), numeric_limits<uint32_t>::max());
+  node->graph_index_ = static_cast<uint32_t>(nodes_.size());
+  nodes_.push_back(node);
   return node;
 }
 
@@ -65,55 +75,46 @@ void FlowGraph::ChangeArcCost(FlowGraphArc* arc, int64_t cost) {
 
 void FlowGraph::DeleteArc(FlowGraphArc* arc) {
   // Remove the arc from the incoming and outgoing collections.
-  arc->src_node_->outgoing_arc_map_.erase(arc->dst_node_->id_);
-  arc->dst_node_->incoming_arc_map_.erase(arc->src_node_->id_);
-  // First remove various meta-data relating to this arc
-  arc_set_.erase(arc);
-  // Then delete the arc itself
-  delete arc;
+  arc->src_node_->outgoing_arc_map_.Erase(arc);
+  arc->dst_node_->incoming_arc_map_.Erase(arc);
+  // Then remove it from the arc vector by moving the last arc in its place.
+  uint32_t graph_index = arc->graph_index_;
+  CHECK_EQ(arcs_[graph_index], arc);
+  arcs_[graph_index] = arcs_.back();
+  arcs_[graph_index]->graph_index_ = graph_index;
+  arcs_.pop_back();
+  unused_arcs_.push_back(arc);
 }
 
 void FlowGraph::DeleteNode(FlowGraphNode* node) {
-  unused_ids_.push(node->id_);
-  // First remove all outgoing arcs
-  for (unordered_map<uint64_t, FlowGraphArc*>::iterator it =
-         node->outgoing_arc_map_.begin();
-       it != node->outgoing_arc_map_.end();) {
-    CHECK_EQ(it->first, it->second->dst_);
-    CHECK_EQ(node->id_, it->second->src_);
-    CHECK_EQ(it->second->dst_node_->incoming_arc_map_.erase(it->second->src_),
-             1);
-    unordered_map<uint64_t, FlowGraphArc*>::iterator it_tmp = it;
-    ++it;
-    DeleteArc(it_tmp->second);
+  uint64_t id = node->id_;
+  CHECK_EQ(NodeOrNull(id), node);
+  unused_ids_.push(id);
+  // First remove all outgoing arcs. DeleteArc removes the arc from the
+  // collection, so we always delete the last arc.
+  while (!node->outgoing_arc_map_.empty()) {
+    FlowGraphArc* arc = (node->outgoing_arc_map_.end() - 1)->second;
+    CHECK_EQ(id, arc->src_);
+    DeleteArc(arc);
   }
-  node->outgoing_arc_map_.clear();
   // Remove all incoming arcs.
-  for (unordered_map<uint64_t, FlowGraphArc*>::iterator it =
-         node->incoming_arc_map_.begin();
-       it != node->incoming_arc_map_.end();) {
-    CHECK_EQ(node->id_, it->second->dst_);
-    CHECK_EQ(it->first, it->second->src_);
-    CHECK_EQ(it->second->src_node_->outgoing_arc_map_.erase(it->second->dst_),
-             1);
-    unordered_map<uint64_t, FlowGraphArc*>::iterator it_tmp = it;
-    ++it;
-    DeleteArc(it_tmp->second);
+  while (!node->incoming_arc_map_.empty()) {
+    FlowGraphArc* arc = (node->incoming_arc_map_.end() - 1)->second;
+    CHECK_EQ(id, arc->dst_);
+    DeleteArc(arc);
   }
-  node->incoming_arc_map_.clear();
-  node_map_.erase(node->id_);
-  delete node;
+  uint32_t graph_index = node->graph_index_;
+  nodes_[graph_index] = nodes_.back();
+  nodes_[graph_index]->graph_index_ = graph_index;
+  nodes_.pop_back();
+  // Reset the slot so that it can be re-used by a new node.
+  *node = FlowGraphNode(id);
 }
 
 FlowGraphArc* FlowGraph::GetArc(FlowGraphNode* src, FlowGraphNode* dst) {
   CHECK_NOTNULL(src);
   CHECK_NOTNULL(dst);
-  unordered_map<uint64_t, FlowGraphArc*>::iterator arc_it =
-    src->outgoing_arc_map_.find(dst->id_);
-  if (arc_it == src->outgoing_arc_map_.end()) {
-    return NULL;
-  }
-  return arc_it->second;
+  return src->outgoing_arc_map_.Find(dst->id_);
 }
 
 uint64_t FlowGraph::NextId() {
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "misc/map-util.h"
+#include "misc/slab_vector.h"
 #include "scheduling/flow/flow_graph_arc.h"
 #include "scheduling/flow/flow_graph_node.h"
 
@@ -28,19 +29,20 @@ class FlowGraph {
   void DeleteArc(FlowGraphArc* arc);
   void DeleteNode(FlowGraphNode* node);
   FlowGraphArc* GetArc(FlowGraphNode* src, FlowGraphNode* dst);
-  inline const unordered_set<FlowGraphArc*>& Arcs() const { return arc_set_; }
-  inline const unordered_map<uint64_t, FlowGraphNode*>& Nodes() const {
-    return node_map_;
-  }
+  inline const vector<FlowGraphArc*>& Arcs() const { return arcs_; }
+  inline const vector<FlowGraphNode*>& Nodes() const { return nodes_; }
   inline const FlowGraphNode& Node(uint64_t id) const {
-    FlowGraphNode* node = FindPtrOrNull(node_map_, id);
+    const FlowGraphNode* node = NodeOrNull(id);
     CHECK_NOTNULL(node);
     return *node;
   }
-  inline uint64_t NumArcs() const { return arc_set_.size(); }
+  inline uint64_t NumArcs() const { return arcs_.size(); }
+  // Number of slabs allocated for storing arcs and nodes, respectively.
+  inline uint64_t NumArcSlabs() const { return arc_slots_.num_slabs(); }
+  inline uint64_t NumNodeSlabs() const { return node_slots_.num_slabs(); }
   inline uint64_t NumNodes() const {
     if (!FLAGS_flow_scheduling_solver.compare("flowlessly")) {
-      return node_map_.size();
+      return nodes_.size();
     } else {
       // TODO(malte): This is a work-around as cs2 and Relax IV do not allow
       // sparse node IDs, and will get tripped up
@@ -57,14 +59,43 @@ class FlowGraph {
   FRIEND_TEST(FlowGraphManagerTest, TraverseAndRemoveTopology);
 
   uint64_t NextId();
+  inline FlowGraphNode* NodeOrNull(uint64_t id) {
+    return const_cast<FlowGraphNode*>(
+        static_cast<const FlowGraph*>(this)->NodeOrNull(id));
+  }
+  inline const FlowGraphNode* NodeOrNull(uint64_t id) const {
+    if (id >= node_slots_.size()) {
+      return NULL;
+    }
+    const FlowGraphNode* node = &node_slots_[id];
+    // The slot is in use iff the node is in the vector of live nodes.
+    if (node->graph_index_ >= nodes_.size() ||
+        nodes_[node->graph_index_] != node) {
+      return NULL;
+    }
+    return node;
+  }
   void PopulateUnusedIds(uint64_t new_current_id);
 
-  unordered_set<FlowGraphArc*> arc_set_;
+  // The nodes and arcs are stored in slabs (SlabVector doesn't move its
+  // elements when it grows, so pointers to them remain valid). Node slots are
+  // indexed by node id. Slots of removed nodes and arcs are reused, so the
+  // graph only allocates memory when it grows beyond its previous size.
+  SlabVector<FlowGraphNode> node_slots_;
+  SlabVector<FlowGraphArc> arc_slots_;
+  // Dense vectors of the nodes and arcs currently in the graph. Each node and
+  // arc stores its position in these vectors (graph_index_).
+  vector<FlowGraphNode*> nodes_;
+  vector<FlowGraphArc*> arcs_;
   // Graph structure containers and helper fields
   uint64_t current_id_;
-  unordered_map<uint64_t, FlowGraphNode*> node_map_;
-  // Queue storing the ids of the nodes we've previously removed.
+  // Queue storing the ids of the nodes we've previously removed. The ids are
+  // re-used in FIFO order, so that an id is re-used as late as possible; the
+  // solver may still report flow for a removed node (see
+  // FlowGraphChangeManager::removed_node_ids).
   queue<uint64_t> unused_ids_;
+  // Free-list of the arc slots we've previously removed.
+  vector<FlowGraphArc*> unused_arcs_;
 };
 
 }  // namespace firmament
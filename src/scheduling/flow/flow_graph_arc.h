@@ -35,6 +35,12 @@ struct FlowGraphArc {
   FlowGraphNode* src_node_;
   FlowGraphNode* dst_node_;
   FlowGraphArcType type_;
+  // Positions of the arc in the graph's arc vector and in the adjacency
+  // collections of its endpoints. They are maintained by FlowGraph and
+  // FlowGraphArcMap, and allow the arc to be removed in O(1).
+  uint32_t graph_index_;
+  uint32_t outgoing_index_;
+  uint32_t incoming_index_;
 };
 
 } // namespace firmament
@@ -0,0 +1,79 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "scheduling/flow/flow_graph_arc_map.h"
+
+#include <limits>
+
+#include "misc/map-util.h"
+
+namespace firmament {
+
+// Number of arcs above which we build a hash index for node id lookups.
+static const uint64_t kArcMapIndexThreshold = 16;
+
+FlowGraphArcMap::FlowGraphArcMap(bool outgoing) : outgoing_(outgoing) {
+}
+
+void FlowGraphArcMap::Clear() {
+  arcs_.clear();
+  index_.reset();
+}
+
+void FlowGraphArcMap::Erase(FlowGraphArc* arc) {
+  uint32_t position = *Position(arc);
+  CHECK_LT(position, arcs_.size());
+  CHECK_EQ(arcs_[position].second, arc);
+  if (index_) {
+    index_->erase(arcs_[position].first);
+  }
+  // Move the last arc into the freed slot.
+  if (position != arcs_.size() - 1) {
+    arcs_[position] = arcs_.back();
+    *Position(arcs_[position].second) = position;
+    if (index_) {
+      (*index_)[arcs_[position].first] = position;
+    }
+  }
+  arcs_.pop_back();
+}
+
+FlowGraphArc* FlowGraphArcMap::Find(uint64_t node_id) const {
+  if (index_) {
+    const uint32_t* position = FindOrNull(*index_, node_id);
+    return position ? arcs_[*position].second : NULL;
+  }
+  for (const auto& node_arc : arcs_) {
+    if (node_arc.first == node_id) {
+      return node_arc.second;
+    }
+  }
+  return NULL;
+}
+
+bool FlowGraphArcMap::Insert(FlowGraphArc* arc) {
+  uint64_t node_id = outgoing_ ? arc->dst_ : arc->src_;
+  // We only look for duplicates in the outgoing collections. An arc is
+  // always inserted in the outgoing collection of its source first, which
+  // already guarantees that there are no parallel arcs.
+  if (outgoing_ && Find(node_id)) {
+    return false;
+  }
+  CHECK_LT(arcs_.size(), numeric_limits<uint32_t>::max());
+  uint32_t position = static_cast<uint32_t>(arcs_.size());
+  *Position(arc) = position;
+  arcs_.push_back(make_pair(node_id, arc));
+  if (outgoing_) {
+    if (index_) {
+      (*index_)[node_id] = position;
+    } else if (arcs_.size() > kArcMapIndexThreshold) {
+      index_.reset(new unordered_map<uint64_t, uint32_t>());
+      for (uint32_t i = 0; i < arcs_.size(); ++i) {
+        (*index_)[arcs_[i].first] = i;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace firmament
@@ -0,0 +1,82 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Adjacency collection of a flow graph node. The arcs are stored in a
+// contiguous vector of (neighbour node id, arc) pairs rather than in a hash
+// map. Iteration is a linear scan and removal is O(1) because every arc
+// remembers its position in the adjacency vectors of its endpoints.
+//
+// Outgoing collections also support lookups by destination node id. Small
+// collections are scanned linearly; once a collection grows beyond
+// kArcMapIndexThreshold arcs we additionally maintain a hash index (e.g., for
+// equivalence class nodes that connect to many resources). The index is only
+// allocated once it is needed so that the many low-degree nodes (e.g., task
+// nodes) do not pay for an empty hash map.
+
+#ifndef FIRMAMENT_SCHEDULING_FLOW_FLOW_GRAPH_ARC_MAP_H
+#define FIRMAMENT_SCHEDULING_FLOW_FLOW_GRAPH_ARC_MAP_H
+
+#include <utility>
+#include <vector>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "scheduling/flow/flow_graph_arc.h"
+
+namespace firmament {
+
+class FlowGraphArcMap {
+ public:
+  typedef vector<pair<uint64_t, FlowGraphArc*>>::iterator iterator;
+  typedef vector<pair<uint64_t, FlowGraphArc*>>::const_iterator
+    const_iterator;
+
+  /**
+   * @param outgoing true if the collection stores the outgoing arcs of a
+   * node (keyed by destination), false if it stores the incoming arcs (keyed
+   * by source)
+   */
+  explicit FlowGraphArcMap(bool outgoing);
+  inline iterator begin() { return arcs_.begin(); }
+  inline iterator end() { return arcs_.end(); }
+  inline const_iterator begin() const { return arcs_.begin(); }
+  inline const_iterator end() const { return arcs_.end(); }
+  inline bool empty() const { return arcs_.empty(); }
+  inline uint64_t size() const { return arcs_.size(); }
+  void Clear();
+  /**
+   * Removes the arc from the collection.
+   * @param arc the arc to remove; it must be in the collection
+   */
+  void Erase(FlowGraphArc* arc);
+  /**
+   * Looks up the arc connecting to the given node.
+   * @param node_id the id of the destination (outgoing collection) or of the
+   * source (incoming collection) node
+   * @return the arc or NULL if there is no such arc
+   */
+  FlowGraphArc* Find(uint64_t node_id) const;
+  /**
+   * Adds the arc to the collection.
+   * @return false if the collection already has an arc to/from the same node
+   */
+  bool Insert(FlowGraphArc* arc);
+  inline FlowGraphArc* operator[](uint64_t node_id) const {
+    return Find(node_id);
+  }
+
+ private:
+  inline uint32_t* Position(FlowGraphArc* arc) const {
+    return outgoing_ ? &arc->outgoing_index_ : &arc->incoming_index_;
+  }
+
+  bool outgoing_;
+  vector<pair<uint64_t, FlowGraphArc*>> arcs_;
+  // Maps node id to position in arcs_. Only allocated for large outgoing
+  // collections.
+  unique_ptr<unordered_map<uint64_t, uint32_t>> index_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_FLOW_FLOW_GRAPH_ARC_MAP_H
@@ -3,6 +3,8 @@
 
 #include "scheduling/flow/flow_graph_change_manager.h"
 
+#include <algorithm>
+
 #include "scheduling/flow/dimacs_add_node.h"
 #include "scheduling/flow/dimacs_change_arc.h"
 #include "scheduling/flow/dimacs_new_arc.h"
@@ -20,17 +22,35 @@ DECLARE_bool(incremental_flow);
 
 namespace firmament {
 
+// Minimum number of slots of the arc change table.
+static const uint64_t kMinArcChangeTableSize = 1024;
+
+// Returns true if the two arc changes would make the same modification.
+static bool SameArcChange(const DIMACSArcChange& change,
+                          const DIMACSArcChange& other) {
+  if (change.kind() != other.kind() ||
+      change.cap_lower_bound_ != other.cap_lower_bound_ ||
+      change.cap_upper_bound_ != other.cap_upper_bound_ ||
+      change.cost_ != other.cost_ || change.type_ != other.type_) {
+    return false;
+  }
+  if (change.kind() == DIMACS_CHANGE_ARC_CHANGE) {
+    return static_cast<const DIMACSChangeArc&>(change).old_cost_ ==
+      static_cast<const DIMACSChangeArc&>(other).old_cost_;
+  }
+  return true;
+}
+
 FlowGraphChangeManager::FlowGraphChangeManager(
     DIMACSChangeStats* dimacs_stats)
-  : flow_graph_(new FlowGraph), dimacs_stats_(dimacs_stats) {
+  : flow_graph_(new FlowGraph), dimacs_stats_(dimacs_stats),
+    change_arena_(dimacs_stats), optimization_round_(0) {
 }
 
 FlowGraphChangeManager::~FlowGraphChangeManager() {
   // We don't delete dimacs_stats_ because it is owned by the FlowScheduler.
   delete flow_graph_;
   ResetChanges();
-  // XXX(malte): N.B. this leaks memory as we haven't destroyed all of the
-  // nodes and arcs in the flow graph (which are allocated on the heap)
 }
 
 FlowGraphArc* FlowGraphChangeManager::AddArc(FlowGraphNode* src,
@@ -53,13 +73,16 @@ FlowGraphArc* FlowGraphChangeManager::AddArc(uint64_t src_node_id,
                                              FlowGraphArcType arc_type,
                                              DIMACSChangeType change_type,
                                              const char* comment) {
+  uint64_t num_arc_slabs = flow_graph_->NumArcSlabs();
   FlowGraphArc* arc = flow_graph_->AddArc(src_node_id, dst_node_id);
+  dimacs_stats_->arc_slabs_allocated_ +=
+    flow_graph_->NumArcSlabs() - num_arc_slabs;
   arc->cap_lower_bound_ = cap_lower_bound;
   arc->cap_upper_bound_ = cap_upper_bound;
   arc->cost_ = cost;
   arc->type_ = arc_type;
   if (FLAGS_incremental_flow) {
-    DIMACSChange* chg = new DIMACSNewArc(*arc);
+    DIMACSChange* chg = change_arena_.New<DIMACSNewArc>(*arc);
     chg->set_comment(comment);
     AddGraphChange(chg);
   }
@@ -68,8 +91,13 @@ FlowGraphArc* FlowGraphChangeManager::AddArc(uint64_t src_node_id,
 }
 
 void FlowGraphChangeManager::AddGraphChange(DIMACSChange* change) {
-  if (change->comment().empty()) {
+  if (!change->comment() || !*change->comment()) {
     change->set_comment("AddGraphChange: anonymous caller");
+  } else {
+    // The callers may pass comments that only live for the duration of the
+    // call (e.g., built from resource names), so the change gets a copy that
+    // lives as long as the change itself.
+    change->set_comment(change_arena_.CopyString(change->comment()));
   }
   graph_changes_.push_back(change);
 }
@@ -79,12 +107,16 @@ FlowGraphNode* FlowGraphChangeManager::AddNode(
     int64_t excess,
     DIMACSChangeType change_type,
     const char* comment) {
+  uint64_t num_node_slabs = flow_graph_->NumNodeSlabs();
   FlowGraphNode* node = flow_graph_->AddNode();
+  dimacs_stats_->node_slabs_allocated_ +=
+    flow_graph_->NumNodeSlabs() - num_node_slabs;
   node->type_ = node_type;
   node->excess_ = excess;
   node->comment_ = comment;
   if (FLAGS_incremental_flow) {
-    DIMACSChange* chg = new DIMACSAddNode(*node, vector<FlowGraphArc*>());
+    DIMACSChange* chg = change_arena_.New<DIMACSAddNode>(
+        *node, vector<FlowGraphArc*>());
     chg->set_comment(comment);
     AddGraphChange(chg);
   }
@@ -106,7 +138,7 @@ void FlowGraphChangeManager::ChangeArc(FlowGraphArc* arc,
       arc->cap_upper_bound_ != cap_upper_bound) {
     flow_graph_->ChangeArc(arc, cap_lower_bound, cap_upper_bound, cost);
     if (FLAGS_incremental_flow) {
-      DIMACSChange* chg = new DIMACSChangeArc(*arc, old_cost);
+      DIMACSChange* chg = change_arena_.New<DIMACSChangeArc>(*arc, old_cost);
       chg->set_comment(comment);
       AddGraphChange(chg);
     }
@@ -123,7 +155,8 @@ void FlowGraphChangeManager::ChangeArcCapacity(FlowGraphArc* arc,
   if (old_capacity != capacity) {
     flow_graph_->ChangeArc(arc, arc->cap_lower_bound_, capacity, arc->cost_);
     if (FLAGS_incremental_flow) {
-      DIMACSChange* chg = new DIMACSChangeArc(*arc, arc->cost_);
+      DIMACSChange* chg = change_arena_.New<DIMACSChangeArc>(*arc,
+                                                             arc->cost_);
       chg->set_comment(comment);
       AddGraphChange(chg);
     }
@@ -140,7 +173,7 @@ void FlowGraphChangeManager::ChangeArcCost(FlowGraphArc* arc,
   if (old_cost != cost) {
     flow_graph_->ChangeArcCost(arc, cost);
     if (FLAGS_incremental_flow) {
-      DIMACSChange* chg = new DIMACSChangeArc(*arc, old_cost);
+      DIMACSChange* chg = change_arena_.New<DIMACSChangeArc>(*arc, old_cost);
       chg->set_comment(comment);
       AddGraphChange(chg);
     }
@@ -154,7 +187,8 @@ void FlowGraphChangeManager::DeleteArc(FlowGraphArc* arc,
   arc->cap_lower_bound_ = 0;
   arc->cap_upper_bound_ = 0;
   if (FLAGS_incremental_flow) {
-    DIMACSChange *chg = new DIMACSChangeArc(*arc, arc->cost_);
+    DIMACSChange *chg = change_arena_.New<DIMACSChangeArc>(*arc,
+                                                           arc->cost_);
     chg->set_comment(comment);
     AddGraphChange(chg);
   }
@@ -166,293 +200,148 @@ void FlowGraphChangeManager::DeleteNode(FlowGraphNode* node,
                                         DIMACSChangeType change_type,
                                         const char* comment) {
   if (FLAGS_incremental_flow) {
-    DIMACSChange *chg = new DIMACSRemoveNode(*node);
+    DIMACSChange *chg = change_arena_.New<DIMACSRemoveNode>(*node);
     chg->set_comment(comment);
     AddGraphChange(chg);
   }
   dimacs_stats_->UpdateStats(change_type);
+  removed_node_ids_.insert(node->id_);
   flow_graph_->DeleteNode(node);
 }
 
-void FlowGraphChangeManager::MergeChangesToSameArcHelper(
-    uint64_t src_id, uint64_t dst_id, uint64_t cap_lower_bound,
-    uint64_t cap_upper_bound, int64_t cost, FlowGraphArcType type,
-    DIMACSChange* change, vector<DIMACSChange*>* new_graph_changes,
-    unordered_map<uint64_t, unordered_map<uint64_t, DIMACSChange*>>*
-    arcs_src_changes,
-    unordered_map<uint64_t, unordered_map<uint64_t, DIMACSChange*>>*
-    arcs_dst_changes) {
-  CHECK_NOTNULL(change);
-  unordered_map<uint64_t, DIMACSChange*>* dst_to_change =
-    FindOrNull(*arcs_src_changes, src_id);
-  if (dst_to_change) {
-    // We already have at least one arc starting at src.
-    DIMACSChange* chg = FindPtrOrNull(*dst_to_change, dst_id);
-    if (chg) {
-      // Update the existing entry.
-      if (DIMACSChangeArc* chg_arc = dynamic_cast<DIMACSChangeArc*>(chg)) {
-        chg_arc->cap_lower_bound_ = cap_lower_bound;
-        chg_arc->cap_upper_bound_ = cap_upper_bound;
-        chg_arc->cost_ = cost;
-        chg_arc->type_ = type;
-        // We don't update the old_cost on a merge because we want to keep the
-        // first recorded old cost value which is the value that the solver
-        // currently has for the arc.
-      } else if (DIMACSNewArc* new_arc = dynamic_cast<DIMACSNewArc*>(chg)) {
-        new_arc->cap_lower_bound_ = cap_lower_bound;
-        new_arc->cap_upper_bound_ = cap_upper_bound;
-        new_arc->cost_ = cost;
-        new_arc->type_ = type;
-      } else {
-        LOG(FATAL) << "Unexpected type of change";
-      }
-    } else {
-      // We don't have an entry for the arc.
-      CHECK(InsertIfNotPresent(dst_to_change, dst_id, change));
-      new_graph_changes->push_back(change);
+FlowGraphChangeManager::ArcChangeSlot*
+FlowGraphChangeManager::FindArcChangeSlot(uint64_t src_id, uint64_t dst_id) {
+  uint64_t mask = arc_change_table_.size() - 1;
+  uint64_t hash = src_id * 0x9E3779B97F4A7C15ULL + dst_id;
+  uint64_t index = (hash ^ (hash >> 32)) & mask;
+  // The table is at least twice as large as the number of changes, so the
+  // probing always ends at an unused slot.
+  while (true) {
+    ArcChangeSlot* slot = &arc_change_table_[index];
+    if (slot->round_ != optimization_round_ ||
+        (slot->src_ == src_id && slot->dst_ == dst_id)) {
+      return slot;
     }
-  } else {
-    // No arc starting at source has been changed.
-    unordered_map<uint64_t, DIMACSChange*> new_dst_to_change;
-    InsertIfNotPresent(&new_dst_to_change, dst_id, change);
-    InsertIfNotPresent(arcs_src_changes, src_id, new_dst_to_change);
-    // Append the change to the change list because it's the first time we
-    // update this arc.
-    new_graph_changes->push_back(change);
-  }
-  unordered_map<uint64_t, DIMACSChange*>* src_to_change =
-    FindOrNull(*arcs_dst_changes, dst_id);
-  if (src_to_change) {
-    // Only insert the change if we don't already have one for the arc.
-    InsertIfNotPresent(src_to_change, src_id, change);
-  } else {
-    unordered_map<uint64_t, DIMACSChange*> new_src_to_change;
-    InsertIfNotPresent(&new_src_to_change, src_id, change);
-    InsertIfNotPresent(arcs_dst_changes, dst_id, new_src_to_change);
+    index = (index + 1) & mask;
   }
 }
 
-void FlowGraphChangeManager::MergeChangesToSameArc() {
-  vector<DIMACSChange*> new_graph_changes;
-  // For each arc change we have an entry in arcs_src_changes and one in
-  // arcs_dst_changes. arcs_src_changes is indexed by src_id and then by
-  // dst_id. arcs_dst_changes is indexed by dst_id and then by src_id.
-  // These two maps allow us to get all the arcs that have a particular
-  // node as a source or destination.
-  unordered_map<uint64_t, unordered_map<uint64_t, DIMACSChange*>>
-    arcs_src_changes;
-  unordered_map<uint64_t, unordered_map<uint64_t, DIMACSChange*>>
-    arcs_dst_changes;
-  for (auto& change : graph_changes_) {
-    if (DIMACSChangeArc* chg_arc = dynamic_cast<DIMACSChangeArc*>(change)) {
-      // Check if we can merge the arc change.
-      MergeChangesToSameArcHelper(
-          chg_arc->src_, chg_arc->dst_, chg_arc->cap_lower_bound_,
-          chg_arc->cap_upper_bound_, chg_arc->cost_, chg_arc->type_, change,
-          &new_graph_changes, &arcs_src_changes, &arcs_dst_changes);
-    } else if (DIMACSNewArc* new_arc = dynamic_cast<DIMACSNewArc*>(change)) {
-      // Check if we can merge the arc change.
-      MergeChangesToSameArcHelper(
-          new_arc->src_, new_arc->dst_, new_arc->cap_lower_bound_,
-          new_arc->cap_upper_bound_, new_arc->cost_, new_arc->type_, change,
-          &new_graph_changes, &arcs_src_changes, &arcs_dst_changes);
-    } else if (DIMACSAddNode* new_node = dynamic_cast<DIMACSAddNode*>(change)) {
-      // Remove all the arcs that have new_node->id_ as source or destination.
-      unordered_map<uint64_t, DIMACSChange*>* dst_to_change =
-        FindOrNull(arcs_src_changes, new_node->id_);
-      if (dst_to_change) {
-        for (auto& dst_change : *dst_to_change) {
-          unordered_map<uint64_t, DIMACSChange*>* src_to_change =
-            FindOrNull(arcs_dst_changes, dst_change.first);
-          CHECK_NOTNULL(src_to_change);
-          src_to_change->erase(new_node->id_);
-        }
-      }
-      arcs_src_changes.erase(new_node->id_);
-      arcs_dst_changes.erase(new_node->id_);
-      new_graph_changes.push_back(change);
-    } else if (dynamic_cast<DIMACSRemoveNode*>(change)) {
-      new_graph_changes.push_back(change);
-    } else {
-      LOG(FATAL) << "Unexpected type of change";
-    }
+FlowGraphChangeManager::NodeChangeState*
+FlowGraphChangeManager::MutableNodeChangeState(uint64_t node_id) {
+  if (node_id >= node_change_states_.size()) {
+    node_change_states_.resize(node_id + 1);
   }
-  graph_changes_.clear();
-  graph_changes_.insert(graph_changes_.begin(), new_graph_changes.begin(),
-                        new_graph_changes.end());
+  NodeChangeState* state = &node_change_states_[node_id];
+  if (state->round_ != optimization_round_) {
+    state->round_ = optimization_round_;
+    state->epoch_ = 0;
+    state->removed_ = false;
+  }
+  return state;
 }
 
 void FlowGraphChangeManager::OptimizeChanges() {
-  if (FLAGS_remove_duplicate_changes) {
-    RemoveDuplicateChanges();
-  }
-  if (FLAGS_merge_changes_to_same_arc) {
-    MergeChangesToSameArc();
+  bool merge = FLAGS_merge_changes_to_same_arc;
+  // Merging the changes to an arc also removes the duplicate changes.
+  bool remove_duplicates = FLAGS_remove_duplicate_changes && !merge;
+  bool purge = FLAGS_purge_changes_before_node_removal;
+  if (!merge && !remove_duplicates && !purge) {
+    return;
   }
-  if (FLAGS_purge_changes_before_node_removal) {
-    PurgeChangesBeforeNodeRemoval();
+  optimization_round_++;
+  if (arc_change_table_.size() < 2 * graph_changes_.size()) {
+    uint64_t table_size = kMinArcChangeTableSize;
+    while (table_size < 2 * graph_changes_.size()) {
+      table_size *= 2;
+    }
+    arc_change_table_.assign(table_size, ArcChangeSlot());
   }
-}
-
-void FlowGraphChangeManager::PurgeChangesBeforeNodeRemoval() {
-  // Set in which we store the ids of the nodes that are removed. We process
-  // the changes from the last to the first one. Whenever we encounter a
-  // remove node change we put its node id to the set. Similarly, whenever
-  // we encounter an add node change we remove its node id from the set.
-  // In this way we make sure we handle the case when ids are re-used upon
-  // node addition.
-  unordered_set<uint64_t> nodes_removed;
-  list<DIMACSChange*> new_graph_changes;
-  for (vector<DIMACSChange*>::reverse_iterator rev_it = graph_changes_.rbegin();
-       rev_it != graph_changes_.rend(); ++rev_it) {
-    if (DIMACSRemoveNode* rem_node =
-        dynamic_cast<DIMACSRemoveNode*>(*rev_it)) {
-      if (nodes_removed.insert(rem_node->node_id_).second) {
-        // Only add the change if the node has not been previosly inserted into
-        // nodes_removed. It if has been inserted then there's no point to add
-        // the change because the node is going to be removed in a future
-        // change.
-        new_graph_changes.push_front(rem_node);
+  // We process the changes from the last to the first one, and we set the
+  // changes we drop to NULL. Processing the changes backwards allows us to
+  // know if a node is removed later on when we see a change to one of its
+  // arcs.
+  for (uint64_t index = graph_changes_.size(); index-- > 0;) {
+    DIMACSChange* change = graph_changes_[index];
+    switch (change->kind()) {
+      case DIMACS_ADD_NODE_CHANGE: {
+        NodeChangeState* state =
+          MutableNodeChangeState(static_cast<DIMACSAddNode*>(change)->id_);
+        // The earlier changes refer to a different node that used the id.
+        state->epoch_++;
+        state->removed_ = false;
+        break;
       }
-    } else if (DIMACSAddNode* new_node =
-               dynamic_cast<DIMACSAddNode*>(*rev_it)) {
-      nodes_removed.erase(new_node->id_);
-      new_graph_changes.push_front(new_node);
-    } else if (DIMACSNewArc* new_arc =
-               dynamic_cast<DIMACSNewArc*>(*rev_it)) {
-      if (nodes_removed.find(new_arc->src_) == nodes_removed.end() &&
-          nodes_removed.find(new_arc->dst_) == nodes_removed.end()) {
-        // Only add the change if neither of its arc source or destination
-        // nodes are going to be removed.
-        new_graph_changes.push_front(new_arc);
-      }
-    } else if (DIMACSChangeArc* chg_arc =
-               dynamic_cast<DIMACSChangeArc*>(*rev_it)) {
-      if (nodes_removed.find(chg_arc->src_) == nodes_removed.end() &&
-          nodes_removed.find(chg_arc->dst_) == nodes_removed.end()) {
-        // Only add the change if neither of its arc source or destination
-        // nodes are going to be removed.
-        new_graph_changes.push_front(chg_arc);
+      case DIMACS_REMOVE_NODE_CHANGE: {
+        NodeChangeState* state = MutableNodeChangeState(
+            static_cast<DIMACSRemoveNode*>(change)->node_id_);
+        if (purge) {
+          if (state->removed_) {
+            // The node is removed again by a later change.
+            graph_changes_[index] = NULL;
+          }
+          state->removed_ = true;
+        }
+        break;
       }
-    } else {
-      LOG(FATAL) << "Unexpected type of change";
-    }
-  }
-  graph_changes_.clear();
-  graph_changes_.insert(graph_changes_.begin(), new_graph_changes.begin(),
-                        new_graph_changes.end());
-}
-
-void FlowGraphChangeManager::RemoveDuplicateChanges() {
-  vector<DIMACSChange*> new_graph_changes;
-  // For each arc change we have two entries in node_to_change. One entry
-  // which is indexed by src_id and another one with is indexed by dst_id.
-  // Thus, whenever we re-use a node id we can make sure to remove from the
-  // state all the arcs that connect the previously removed node that was
-  // using the same id.
-  unordered_map<uint64_t, unordered_map<string, DIMACSChange*>> node_to_change;
-  for (auto& change : graph_changes_) {
-    if (DIMACSChangeArc* chg_arc = dynamic_cast<DIMACSChangeArc*>(change)) {
-      RemoveDuplicateChangesHelper(chg_arc->src_, chg_arc->dst_, change,
-                                   &new_graph_changes, &node_to_change);
-    } else if (DIMACSNewArc* new_arc = dynamic_cast<DIMACSNewArc*>(change)) {
-      RemoveDuplicateChangesHelper(new_arc->src_, new_arc->dst_, change,
-                                   &new_graph_changes, &node_to_change);
-    } else if (DIMACSAddNode* new_node = dynamic_cast<DIMACSAddNode*>(change)) {
-      // Remove from the state the arc changes that connect a node with the
-      // same id as the node we're adding.
-      unordered_map<string, DIMACSChange*>* desc_to_change =
-        FindOrNull(node_to_change, new_node->id_);
-      if (desc_to_change) {
-        for (auto& desc_change : *desc_to_change) {
-          if (DIMACSNewArc* new_arc =
-              dynamic_cast<DIMACSNewArc*>(desc_change.second)) {
-            RemoveDuplicateCleanState(new_node->id_, new_arc->src_,
-                                      new_arc->dst_, desc_change.first,
-                                      &node_to_change);
-          } else if (DIMACSChangeArc* chg_arc =
-                     dynamic_cast<DIMACSChangeArc*>(desc_change.second)) {
-            RemoveDuplicateCleanState(new_node->id_, chg_arc->src_,
-                                      chg_arc->dst_, desc_change.first,
-                                      &node_to_change);
-          } else {
-            LOG(FATAL) << "Unexpected change type";
+      case DIMACS_NEW_ARC_CHANGE:
+      case DIMACS_CHANGE_ARC_CHANGE: {
+        DIMACSArcChange* arc_change = static_cast<DIMACSArcChange*>(change);
+        NodeChangeState* src_state = MutableNodeChangeState(arc_change->src_);
+        uint32_t src_epoch = src_state->epoch_;
+        bool src_removed = src_state->removed_;
+        NodeChangeState* dst_state = MutableNodeChangeState(arc_change->dst_);
+        if (purge && (src_removed || dst_state->removed_)) {
+          graph_changes_[index] = NULL;
+          break;
+        }
+        if (!merge && !remove_duplicates) {
+          break;
+        }
+        ArcChangeSlot* slot =
+          FindArcChangeSlot(arc_change->src_, arc_change->dst_);
+        if (slot->round_ == optimization_round_ &&
+            slot->src_epoch_ == src_epoch &&
+            slot->dst_epoch_ == dst_state->epoch_) {
+          DIMACSArcChange* later_change =
+            static_cast<DIMACSArcChange*>(graph_changes_[slot->change_index_]);
+          if (merge) {
+            // Keep the first change, but with the values of the last change.
+            // We don't update the old_cost_ of an arc change because the
+            // first recorded old cost is the one the solver currently has.
+            arc_change->cap_lower_bound_ = later_change->cap_lower_bound_;
+            arc_change->cap_upper_bound_ = later_change->cap_upper_bound_;
+            arc_change->cost_ = later_change->cost_;
+            arc_change->type_ = later_change->type_;
+            graph_changes_[slot->change_index_] = NULL;
+          } else if (SameArcChange(*arc_change, *later_change)) {
+            graph_changes_[index] = NULL;
+            break;
           }
         }
+        slot->round_ = optimization_round_;
+        slot->src_ = arc_change->src_;
+        slot->dst_ = arc_change->dst_;
+        slot->src_epoch_ = src_epoch;
+        slot->dst_epoch_ = dst_state->epoch_;
+        slot->change_index_ = index;
+        break;
       }
-      node_to_change.erase(new_node->id_);
-      new_graph_changes.push_back(change);
-    } else if (dynamic_cast<DIMACSRemoveNode*>(change)) {
-      new_graph_changes.push_back(change);
-    }
-  }
-  graph_changes_.clear();
-  graph_changes_.insert(graph_changes_.begin(), new_graph_changes.begin(),
-                        new_graph_changes.end());
-}
-
-void FlowGraphChangeManager::RemoveDuplicateChangesHelper(
-    uint64_t src_id, uint64_t dst_id, DIMACSChange* change,
-    vector<DIMACSChange*>* new_graph_changes,
-    unordered_map<uint64_t, unordered_map<string, DIMACSChange*>>*
-    node_to_change) {
-  if (RemoveDuplicateChangesUpdateState(src_id, change, node_to_change) &&
-      RemoveDuplicateChangesUpdateState(dst_id, change, node_to_change)) {
-    new_graph_changes->push_back(change);
-  }
-}
-
-bool FlowGraphChangeManager::RemoveDuplicateChangesUpdateState(
-    uint64_t node_id, DIMACSChange* change,
-    unordered_map<uint64_t, unordered_map<string, DIMACSChange*>>*
-    node_to_change) {
-  string change_desc = change->GenerateChange();
-  unordered_map<string, DIMACSChange*>* changes =
-    FindOrNull(*node_to_change, node_id);
-  if (changes) {
-    if (!InsertIfNotPresent(changes, change_desc, change)) {
-      // The change is already in the map.
-      return false;
-    }
-  } else {
-    unordered_map<string, DIMACSChange*> new_changes;
-    InsertIfNotPresent(&new_changes, change_desc, change);
-    InsertIfNotPresent(node_to_change, node_id, new_changes);
-  }
-  return true;
-}
-
-void FlowGraphChangeManager::RemoveDuplicateCleanState(
-    uint64_t new_node_id, uint64_t src, uint64_t dst, const string& change_desc,
-    unordered_map<uint64_t, unordered_map<string, DIMACSChange*>>*
-    node_to_change) {
-  if (new_node_id == src) {
-    auto dst_change_map = FindOrNull(*node_to_change, dst);
-    CHECK_NOTNULL(dst_change_map);
-    dst_change_map->erase(change_desc);
-    if (dst_change_map->size() == 0) {
-      node_to_change->erase(dst);
+      default:
+        LOG(FATAL) << "Unexpected type of change: " << change->kind();
     }
-  } else if (new_node_id == dst) {
-    auto src_change_map = FindOrNull(*node_to_change, src);
-    CHECK_NOTNULL(src_change_map);
-    src_change_map->erase(change_desc);
-    if (src_change_map->size() == 0) {
-      node_to_change->erase(src);
-    }
-  } else {
-    LOG(FATAL) << "New node id is not equal to the source or destination ids";
   }
+  graph_changes_.erase(
+      remove(graph_changes_.begin(), graph_changes_.end(),
+             static_cast<DIMACSChange*>(NULL)),
+      graph_changes_.end());
 }
 
 void FlowGraphChangeManager::ResetChanges() {
-  for (vector<DIMACSChange*>::iterator it = graph_changes_.begin();
-       it != graph_changes_.end(); ) {
-    vector<DIMACSChange*>::iterator it_tmp = it;
-    ++it;
-    delete *it_tmp;
-  }
   graph_changes_.clear();
+  removed_node_ids_.clear();
+  // This also destroys the changes the optimizations dropped from
+  // graph_changes_.
+  change_arena_.Reset();
 }
 
 }  // namespace firmament
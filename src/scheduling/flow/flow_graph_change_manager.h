@@ -13,6 +13,7 @@
 #define FIRMAMENT_SCHEDULING_FLOW_FLOW_GRAPH_CHANGE_MANAGER_H
 
 #include "base/types.h"
+#include "scheduling/flow/dimacs_change_arena.h"
 #include "scheduling/flow/dimacs_change_stats.h"
 #include "scheduling/flow/flow_graph.h"
 
@@ -61,6 +62,13 @@ class FlowGraphChangeManager {
     return graph_changes_;
   }
   void ResetChanges();
+  /**
+   * @return the ids of the nodes that have been removed since the changes
+   * were last reset
+   */
+  inline const unordered_set<uint64_t>& removed_node_ids() const {
+    return removed_node_ids_;
+  }
   inline bool CheckNodeType(uint64_t node_id, FlowNodeType type) {
     return flow_graph_->Node(node_id).type_ == type;
   }
@@ -75,56 +83,71 @@ class FlowGraphChangeManager {
   }
 
  private:
+  FRIEND_TEST(FlowGraphChangeManagerTest, CompactChangesInOnePass);
   FRIEND_TEST(FlowGraphChangeManagerTest, MergeChangesToSameArc);
   FRIEND_TEST(FlowGraphChangeManagerTest, PurgeChangesBeforeNodeRemoval);
   FRIEND_TEST(FlowGraphChangeManagerTest, RemoveDuplicateChanges);
 
+  // Slot of the open-addressing table in which OptimizeChanges indexes the
+  // arc changes by (src, dst). A slot is in use only if its round_ is the
+  // current optimization round.
+  struct ArcChangeSlot {
+    ArcChangeSlot() : round_(0) {
+    }
+    uint64_t round_;
+    uint64_t src_;
+    uint64_t dst_;
+    // Epochs of the arc's endpoints when the change was indexed.
+    uint32_t src_epoch_;
+    uint32_t dst_epoch_;
+    // Index of the change in graph_changes_.
+    uint64_t change_index_;
+  };
+
+  // State OptimizeChanges keeps for a node id. The epoch is incremented
+  // every time a node that uses the id is added, so that arc changes to a
+  // node that had the same id are not merged with changes to the new node.
+  struct NodeChangeState {
+    NodeChangeState() : round_(0) {
+    }
+    uint64_t round_;
+    uint32_t epoch_;
+    // True if the node is removed by a later change.
+    bool removed_;
+  };
+
   void AddGraphChange(DIMACSChange* change);
-  void OptimizeChanges();
-  void MergeChangesToSameArc();
-  /**
-   * Checks if there's already a change for the (src_id, dst_id) arc.
-   * If there's no change then it adds one to the state, otherwise
-   * it updates the existing change.
-   */
-  void MergeChangesToSameArcHelper(
-      uint64_t src_id, uint64_t dst_id, uint64_t cap_lower_bound,
-      uint64_t cap_upper_bound, int64_t cost, FlowGraphArcType type,
-      DIMACSChange* change, vector<DIMACSChange*>* new_graph_changes,
-      unordered_map<uint64_t, unordered_map<uint64_t, DIMACSChange*>>*
-      arcs_src_changes,
-      unordered_map<uint64_t, unordered_map<uint64_t, DIMACSChange*>>*
-      arcs_dst_changes);
-  void PurgeChangesBeforeNodeRemoval();
-  void RemoveDuplicateChanges();
   /**
-   * Checks if there's already an identical change for the (src_id, dst_id) arc.
-   * If there's no change the it updates the state, otherwise it just ignores
-   * the change we're currently processing because it's duplicate.
+   * Returns the slot of the (src_id, dst_id) arc. The slot is either unused
+   * or holds the latest change to the arc seen so far.
    */
-  void RemoveDuplicateChangesHelper(
-      uint64_t src_id, uint64_t dst_id, DIMACSChange* change,
-      vector<DIMACSChange*>* new_graph_changes,
-      unordered_map<uint64_t, unordered_map<string, DIMACSChange*>>*
-      node_to_change);
-  bool RemoveDuplicateChangesUpdateState(
-      uint64_t node_id, DIMACSChange* change,
-      unordered_map<uint64_t, unordered_map<string, DIMACSChange*>>*
-      node_to_change);
+  ArcChangeSlot* FindArcChangeSlot(uint64_t src_id, uint64_t dst_id);
+  NodeChangeState* MutableNodeChangeState(uint64_t node_id);
   /**
-   * Method to be called upon node addition. This method makes sure that the
-   * state is cleaned when we re-use a node id.
+   * Compacts the changes in a single pass, from the last change to the
+   * first one. Depending on the flags, the pass:
+   * 1) merges the changes to the same arc into the first of them,
+   * 2) removes the arc changes that duplicate the following change to the
+   * same arc (subsumed by 1),
+   * 3) removes the changes to arcs whose endpoints are later removed.
    */
-  void RemoveDuplicateCleanState(
-      uint64_t new_node_id, uint64_t src, uint64_t dst,
-      const string& change_desc,
-      unordered_map<uint64_t, unordered_map<string, DIMACSChange*>>*
-      node_to_change);
+  void OptimizeChanges();
 
   FlowGraph* flow_graph_;
   // Vector storing the graph changes occured since the last scheduling round.
   vector<DIMACSChange*> graph_changes_;
+  // Ids of the nodes removed since the last scheduling round. The ids may
+  // already have been re-used by new nodes.
+  unordered_set<uint64_t> removed_node_ids_;
   DIMACSChangeStats* dimacs_stats_;
+  // Arena owning the graph changes. It is reset at the end of every round.
+  DIMACSChangeArena change_arena_;
+  // The table and the node states are kept across rounds so that
+  // OptimizeChanges doesn't allocate memory once they have grown to the
+  // size of a round.
+  vector<ArcChangeSlot> arc_change_table_;
+  vector<NodeChangeState> node_change_states_;
+  uint64_t optimization_round_;
 };
 
 }  // namespace firmament
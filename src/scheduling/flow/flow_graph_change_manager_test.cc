@@ -10,6 +10,11 @@
 #include "scheduling/flow/dimacs_remove_node.h"
 #include "scheduling/flow/flow_graph_change_manager.h"
 
+DECLARE_bool(incremental_flow);
+DECLARE_bool(merge_changes_to_same_arc);
+DECLARE_bool(purge_changes_before_node_removal);
+DECLARE_bool(remove_duplicate_changes);
+
 namespace firmament {
 
 class FlowGraphChangeManagerTest : public ::testing::Test {
@@ -64,10 +69,16 @@ TEST_F(FlowGraphChangeManagerTest, MergeChangesToSameArc) {
       new DIMACSAddNode(node1, vector<FlowGraphArc*>()));
   change_manager_->graph_changes_.push_back(new DIMACSNewArc(arc12));
   EXPECT_EQ(change_manager_->graph_changes_.size(), 7);
-  change_manager_->MergeChangesToSameArc();
+  FLAGS_remove_duplicate_changes = false;
+  FLAGS_merge_changes_to_same_arc = true;
+  FLAGS_purge_changes_before_node_removal = false;
+  change_manager_->OptimizeChanges();
+  FLAGS_remove_duplicate_changes = true;
+  FLAGS_purge_changes_before_node_removal = true;
   EXPECT_EQ(change_manager_->graph_changes_.size(), 6);
+  ASSERT_EQ(change_manager_->graph_changes_[2]->kind(), DIMACS_NEW_ARC_CHANGE);
   DIMACSNewArc* new_arc =
-    dynamic_cast<DIMACSNewArc*>(change_manager_->graph_changes_[2]);
+    static_cast<DIMACSNewArc*>(change_manager_->graph_changes_[2]);
   EXPECT_EQ(new_arc->src_, 1);
   EXPECT_EQ(new_arc->dst_, 2);
   EXPECT_EQ(new_arc->cap_upper_bound_, 2);
@@ -90,7 +101,12 @@ TEST_F(FlowGraphChangeManagerTest, PurgeChangesBeforeNodeRemoval) {
       new DIMACSAddNode(node1, vector<FlowGraphArc*>()));
   change_manager_->graph_changes_.push_back(new DIMACSNewArc(arc12));
   EXPECT_EQ(change_manager_->graph_changes_.size(), 6);
-  change_manager_->PurgeChangesBeforeNodeRemoval();
+  FLAGS_remove_duplicate_changes = false;
+  FLAGS_merge_changes_to_same_arc = false;
+  FLAGS_purge_changes_before_node_removal = true;
+  change_manager_->OptimizeChanges();
+  FLAGS_remove_duplicate_changes = true;
+  FLAGS_merge_changes_to_same_arc = true;
   EXPECT_EQ(change_manager_->graph_changes_.size(), 5);
 }
 
@@ -113,10 +129,111 @@ TEST_F(FlowGraphChangeManagerTest, RemoveDuplicateChanges) {
   // Add again change to arc (1,2), but this one should not be removed.
   change_manager_->graph_changes_.push_back(new DIMACSChangeArc(arc12, 42));
   EXPECT_EQ(change_manager_->graph_changes_.size(), 9);
-  change_manager_->RemoveDuplicateChanges();
+  FLAGS_remove_duplicate_changes = true;
+  FLAGS_merge_changes_to_same_arc = false;
+  FLAGS_purge_changes_before_node_removal = false;
+  change_manager_->OptimizeChanges();
+  FLAGS_merge_changes_to_same_arc = true;
+  FLAGS_purge_changes_before_node_removal = true;
   EXPECT_EQ(change_manager_->graph_changes_.size(), 8);
 }
 
+TEST_F(FlowGraphChangeManagerTest, CompactChangesInOnePass) {
+  FlowGraphNode node1(1);
+  FlowGraphNode node2(2);
+  FlowGraphNode node3(3);
+  FlowGraphArc arc12(1, 2, 0, 1, 42, &node1, &node2);
+  FlowGraphArc arc13(1, 3, 0, 1, 7, &node1, &node3);
+  change_manager_->graph_changes_.push_back(
+      new DIMACSAddNode(node1, vector<FlowGraphArc*>()));
+  change_manager_->graph_changes_.push_back(
+      new DIMACSAddNode(node2, vector<FlowGraphArc*>()));
+  change_manager_->graph_changes_.push_back(
+      new DIMACSAddNode(node3, vector<FlowGraphArc*>()));
+  change_manager_->graph_changes_.push_back(new DIMACSNewArc(arc12));
+  change_manager_->graph_changes_.push_back(new DIMACSNewArc(arc13));
+  // Change arc (1,2) back and forth. The new arc change must end up with the
+  // values of the last change, and not with the values of the first
+  // identical change.
+  arc12.cost_ = 43;
+  change_manager_->graph_changes_.push_back(new DIMACSChangeArc(arc12, 42));
+  arc12.cost_ = 42;
+  change_manager_->graph_changes_.push_back(new DIMACSChangeArc(arc12, 43));
+  // Arc (1,3) is purged because node 3 is removed.
+  change_manager_->graph_changes_.push_back(new DIMACSChangeArc(arc13, 7));
+  change_manager_->graph_changes_.push_back(new DIMACSRemoveNode(node3));
+  EXPECT_EQ(change_manager_->graph_changes_.size(), 9);
+  change_manager_->OptimizeChanges();
+  ASSERT_EQ(change_manager_->graph_changes_.size(), 5);
+  EXPECT_EQ(change_manager_->graph_changes_[2]->kind(),
+            DIMACS_ADD_NODE_CHANGE);
+  ASSERT_EQ(change_manager_->graph_changes_[3]->kind(), DIMACS_NEW_ARC_CHANGE);
+  DIMACSNewArc* new_arc =
+    static_cast<DIMACSNewArc*>(change_manager_->graph_changes_[3]);
+  EXPECT_EQ(new_arc->dst_, 2);
+  EXPECT_EQ(new_arc->cost_, 42);
+  EXPECT_EQ(change_manager_->graph_changes_[4]->kind(),
+            DIMACS_REMOVE_NODE_CHANGE);
+}
+
+TEST_F(FlowGraphChangeManagerTest, TrackRemovedNodesUntilReset) {
+  FlowGraphNode* task_node =
+    change_manager_->AddNode(UNSCHEDULED_TASK, 1, ADD_TASK_NODE, "Task");
+  uint64_t task_node_id = task_node->id_;
+  EXPECT_TRUE(change_manager_->removed_node_ids().empty());
+  change_manager_->DeleteNode(task_node, DEL_TASK_NODE, "Delete task");
+  // The new node re-uses the id of the removed node, but the id must still be
+  // reported as removed.
+  FlowGraphNode* new_task_node =
+    change_manager_->AddNode(UNSCHEDULED_TASK, 1, ADD_TASK_NODE, "Task");
+  EXPECT_EQ(new_task_node->id_, task_node_id);
+  EXPECT_EQ(change_manager_->removed_node_ids().count(task_node_id), 1);
+  change_manager_->ResetChanges();
+  EXPECT_TRUE(change_manager_->removed_node_ids().empty());
+}
+
+TEST_F(FlowGraphChangeManagerTest, CopyChangeComments) {
+  FLAGS_incremental_flow = true;
+  {
+    string comment = "Resource node " + to_string(42);
+    change_manager_->AddNode(PU, 0, ADD_RESOURCE_NODE, comment.c_str());
+    // Overwrite the comment before the string is freed.
+    comment.assign(comment.size(), 'x');
+  }
+  const vector<DIMACSChange*>& changes = change_manager_->GetGraphChanges();
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_STREQ(changes[0]->comment(), "Resource node 42");
+  EXPECT_EQ(changes[0]->GenerateChangeDescription(), "c Resource node 42\n");
+  change_manager_->ResetChanges();
+  FLAGS_incremental_flow = false;
+}
+
+TEST_F(FlowGraphChangeManagerTest, ReuseMemoryAcrossRounds) {
+  FLAGS_incremental_flow = true;
+  FlowGraphNode* sink_node =
+    change_manager_->AddNode(SINK, -1, ADD_SINK_NODE, "Sink");
+  FlowGraphNode* task_node =
+    change_manager_->AddNode(UNSCHEDULED_TASK, 1, ADD_TASK_NODE, "Task");
+  for (uint32_t round = 0; round < 3; ++round) {
+    dimacs_stats_.ResetStats();
+    for (uint32_t index = 0; index < 10000; ++index) {
+      FlowGraphArc* arc = change_manager_->AddArc(
+          task_node, sink_node, 0, 1, index, OTHER, ADD_ARC_TO_UNSCHED,
+          "Add arc");
+      change_manager_->DeleteArc(arc, DEL_ARC_TASK_TO_RES, "Delete arc");
+    }
+    EXPECT_EQ(dimacs_stats_.change_records_allocated_, 20000);
+    if (round > 0) {
+      // The change records and the arc fit in the memory allocated in the
+      // first round.
+      EXPECT_EQ(dimacs_stats_.change_arena_blocks_allocated_, 0);
+      EXPECT_EQ(dimacs_stats_.arc_slabs_allocated_, 0);
+    }
+    change_manager_->ResetChanges();
+  }
+  FLAGS_incremental_flow = false;
+}
+
 }  // namespace firmament
 
 int main(int argc, char **argv) {
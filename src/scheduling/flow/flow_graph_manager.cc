@@ -32,12 +32,54 @@ DEFINE_bool(preemption, false, "Enable preemption and migration of tasks");
 DEFINE_bool(update_preferences_running_task, false,
             "True if the preferences of a running task should be updated before"
             " each scheduling round");
+DEFINE_uint64(topology_stats_threads, 1,
+              "Number of threads to use to compute the statistics of the "
+              "machines' resource topologies. The cost model's statistics "
+              "methods must be safe to call concurrently for different "
+              "machines. Takes effect for flow graph managers created after "
+              "it is set.");
+DEFINE_uint64(flow_graph_update_threads, 1,
+              "Number of threads to use to query the cost model when the "
+              "task nodes are updated. The queries are only run in parallel "
+              "if the cost model supports concurrent task queries. Takes "
+              "effect for flow graph managers created after it is set.");
 
 DECLARE_string(flow_scheduling_solver);
 DECLARE_uint64(max_tasks_per_pu);
 
 namespace firmament {
 
+// Adapts the boost::function statistics callbacks to the visitor interface
+// ComputeTopologyStatistics expects.
+class FunctionStatsVisitor {
+ public:
+  FunctionStatsVisitor(
+      boost::function<void(FlowGraphNode*)> prepare,
+      boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> gather,
+      boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> update)
+    : prepare_(prepare), gather_(gather), update_(update) {
+  }
+
+  void Prepare(FlowGraphNode* accumulator) {
+    if (prepare_) {
+      prepare_(accumulator);
+    }
+  }
+
+  FlowGraphNode* Gather(FlowGraphNode* accumulator, FlowGraphNode* other) {
+    return gather_(accumulator, other);
+  }
+
+  FlowGraphNode* Update(FlowGraphNode* accumulator, FlowGraphNode* other) {
+    return update_(accumulator, other);
+  }
+
+ private:
+  boost::function<void(FlowGraphNode*)> prepare_;
+  boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> gather_;
+  boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> update_;
+};
+
 FlowGraphManager::FlowGraphManager(
     CostModelInterface *cost_model,
     unordered_set<ResourceID_t,
@@ -50,7 +92,23 @@ FlowGraphManager::FlowGraphManager(
       leaf_res_ids_(leaf_res_ids),
       trace_generator_(trace_generator),
       dimacs_stats_(dimacs_stats),
-      cur_traversal_counter_(0) {
+      cur_traversal_counter_(0),
+      worker_io_service_(new boost::asio::io_service),
+      num_pending_batches_(0) {
+  // Start the worker threads; the calling thread processes one batch of each
+  // parallel step itself. The cost queries and the topology statistics share
+  // the workers.
+  uint64_t num_threads =
+    max(FLAGS_flow_graph_update_threads, FLAGS_topology_stats_threads);
+  if (num_threads > 1) {
+    worker_io_service_work_.reset(
+        new boost::asio::io_service::work(*worker_io_service_));
+    for (uint64_t i = 1; i < num_threads; ++i) {
+      worker_threads_.create_thread(
+          boost::bind(&boost::asio::io_service::run,
+                      worker_io_service_.get()));
+    }
+  }
   // Add sink node.
   sink_node_ = graph_change_manager_->AddNode(
       FlowNodeType::SINK, 0, ADD_SINK_NODE, "SINK");
@@ -62,6 +120,9 @@ FlowGraphManager::FlowGraphManager(
 FlowGraphManager::~FlowGraphManager() {
   // We don't delete cost_model_, leaf_res_ids_, trace_generator_ and
   // dimacs_stats_ because they are owned by the FlowScheduler.
+  worker_io_service_work_.reset();
+  worker_io_service_->stop();
+  worker_threads_.join_all();
   delete graph_change_manager_;
 }
 
@@ -261,37 +322,8 @@ void FlowGraphManager::ComputeTopologyStatistics(
     boost::function<void(FlowGraphNode*)> prepare,
     boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> gather,
     boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> update) {
-  // XXX(ionel): The function only works correctly as long as the topology is a
-  // tree. If the topology is a DAG then it does not work correctly! It does
-  // not work in the DAG case because the function implements BFS. Hence,
-  // we may pop a not of the queue and propagate its statistics via its incoming
-  // arcs before we've received all the statistics at the node.
-  queue<FlowGraphNode*> to_visit;
-  // We maintain a value that is used to mark visited nodes. Before each
-  // visit we increment the mark to make sure that nodes visited in previous
-  // traversal are not going to be treated as marked. By using the mark
-  // variable we avoid having to reset the visited state of each node before
-  // of a traversal.
-  cur_traversal_counter_++;
-  to_visit.push(node);
-  node->visited_ = cur_traversal_counter_;
-  while (!to_visit.empty()) {
-    FlowGraphNode* cur_node = to_visit.front();
-    to_visit.pop();
-    for (auto& incoming_arc : cur_node->incoming_arc_map_) {
-      if (incoming_arc.second->src_node_->visited_ != cur_traversal_counter_) {
-        if (prepare) {
-          prepare(incoming_arc.second->src_node_);
-        }
-        to_visit.push(incoming_arc.second->src_node_);
-        incoming_arc.second->src_node_->visited_ = cur_traversal_counter_;
-      }
-      incoming_arc.second->src_node_ =
-        gather(incoming_arc.second->src_node_, cur_node);
-      incoming_arc.second->src_node_ =
-        update(incoming_arc.second->src_node_, cur_node);
-    }
-  }
+  FunctionStatsVisitor visitor(prepare, gather, update);
+  ComputeTopologyStatistics(node, &visitor);
 }
 
 void FlowGraphManager::JobCompleted(JobID_t job_id) {
@@ -382,12 +414,14 @@ void FlowGraphManager::NodeBindingToSchedulingDeltas(
 void FlowGraphManager::PinTaskToNode(FlowGraphNode* task_node,
                                      FlowGraphNode* res_node) {
   bool added_running_arc = false;
-  // Remove all arcs apart from the task -> resource mapping.
-  for (unordered_map<uint64_t, FlowGraphArc*>::iterator it =
-         task_node->outgoing_arc_map_.begin();
-       it != task_node->outgoing_arc_map_.end(); ) {
-    FlowGraphArc* arc = it->second;
-    ++it;
+  // Remove all arcs apart from the task -> resource mapping. We copy the arcs
+  // because deleting an arc changes the node's arc collection.
+  vector<FlowGraphArc*> task_arcs;
+  task_arcs.reserve(task_node->outgoing_arc_map_.size());
+  for (auto& dst_arc : task_node->outgoing_arc_map_) {
+    task_arcs.push_back(dst_arc.second);
+  }
+  for (auto& arc : task_arcs) {
     if (arc->dst_node_->id_ == res_node->id_) {
       // This preference arc connects the same nodes as the running arc. Hence,
       // we just transform it into the running arc.
@@ -452,6 +486,88 @@ void FlowGraphManager::PurgeUnconnectedEquivClassNodes() {
   }
 }
 
+void FlowGraphManager::QueryCostsForNodes(
+    const vector<TDOrNodeWrapper*>* nodes, uint64_t begin, uint64_t end,
+    vector<TaskCostQueries>* task_queries,
+    vector<EquivClassCostQueries>* ec_queries) {
+  for (uint64_t index = begin; index < end; ++index) {
+    FlowGraphNode* node = (*nodes)[index]->node_;
+    if (!node) {
+      continue;
+    }
+    if (node->IsTaskNode() && !node->IsTaskAssignedOrRunning()) {
+      QueryTaskCosts(node->td_ptr_->uid(), &(*task_queries)[index]);
+    } else if (node->IsEquivalenceClassNode()) {
+      // N.B.: We query the cost model in the same order as
+      // UpdateEquivClassNode does.
+      QueryEquivToEquivCosts(node->ec_id_, &(*ec_queries)[index]);
+      QueryEquivToResCosts(node->ec_id_, &(*ec_queries)[index]);
+    }
+  }
+}
+
+void FlowGraphManager::QueryEquivToEquivCosts(EquivClass_t ec,
+                                              EquivClassCostQueries* queries) {
+  vector<EquivClass_t>* pref_ec =
+    cost_model_->GetEquivClassToEquivClassesArcs(ec);
+  if (pref_ec) {
+    queries->pref_ecs_.swap(*pref_ec);
+    delete pref_ec;
+    for (auto& pref_ec_id : queries->pref_ecs_) {
+      queries->pref_ec_costs_.push_back(
+          cost_model_->EquivClassToEquivClass(ec, pref_ec_id));
+    }
+  }
+}
+
+void FlowGraphManager::QueryEquivToResCosts(EquivClass_t ec,
+                                            EquivClassCostQueries* queries) {
+  vector<ResourceID_t>* pref_res =
+    cost_model_->GetOutgoingEquivClassPrefArcs(ec);
+  if (pref_res) {
+    queries->pref_res_.swap(*pref_res);
+    delete pref_res;
+    for (auto& pref_res_id : queries->pref_res_) {
+      queries->pref_res_costs_.push_back(
+          cost_model_->EquivClassToResourceNode(ec, pref_res_id));
+    }
+  }
+}
+
+void FlowGraphManager::QueryTaskCosts(TaskID_t task_id,
+                                      TaskCostQueries* queries) {
+  // N.B.: We query the cost model in the same order as UpdateTaskNode does.
+  queries->unsched_agg_cost_ = cost_model_->TaskToUnscheduledAggCost(task_id);
+  QueryTaskToEquivCosts(task_id, queries);
+  QueryTaskToResCosts(task_id, queries);
+}
+
+void FlowGraphManager::QueryTaskToEquivCosts(TaskID_t task_id,
+                                             TaskCostQueries* queries) {
+  vector<EquivClass_t>* pref_ec = cost_model_->GetTaskEquivClasses(task_id);
+  if (pref_ec) {
+    queries->pref_ecs_.swap(*pref_ec);
+    delete pref_ec;
+    for (auto& pref_ec_id : queries->pref_ecs_) {
+      queries->pref_ec_costs_.push_back(
+          cost_model_->TaskToEquivClassAggregator(task_id, pref_ec_id));
+    }
+  }
+}
+
+void FlowGraphManager::QueryTaskToResCosts(TaskID_t task_id,
+                                           TaskCostQueries* queries) {
+  vector<ResourceID_t>* pref_res = cost_model_->GetTaskPreferenceArcs(task_id);
+  if (pref_res) {
+    queries->pref_res_.swap(*pref_res);
+    delete pref_res;
+    for (auto& pref_res_id : queries->pref_res_) {
+      queries->pref_res_costs_.push_back(
+          cost_model_->TaskToResourceNodeCost(task_id, pref_res_id));
+    }
+  }
+}
+
 void FlowGraphManager::RemoveEquivClassNode(FlowGraphNode* ec_node) {
   CHECK_NOTNULL(ec_node);
   tec_to_node_map_.erase(ec_node->ec_id_);
@@ -511,13 +627,14 @@ void FlowGraphManager::RemoveResourceTopology(const ResourceDescriptor& rd,
   FlowGraphNode* res_node = NodeForResourceID(res_id);
   CHECK_NOTNULL(res_node);
   int64_t cap_delta = 0;
-  // Delete the children nodes. We use an iterator because we change the
+  // Delete the children nodes. We copy the arcs because we change the
   // collection while we iterate over it.
-  for (unordered_map<uint64_t, FlowGraphArc*>::iterator
-         it = res_node->outgoing_arc_map_.begin();
-       it != res_node->outgoing_arc_map_.end();) {
-    FlowGraphArc* arc = it->second;
-    ++it;
+  vector<FlowGraphArc*> res_arcs;
+  res_arcs.reserve(res_node->outgoing_arc_map_.size());
+  for (auto& dst_arc : res_node->outgoing_arc_map_) {
+    res_arcs.push_back(dst_arc.second);
+  }
+  for (auto& arc : res_arcs) {
     cap_delta -=  arc->cap_upper_bound_;
     if (!arc->dst_node_->resource_id_.is_nil()) {
       TraverseAndRemoveTopology(arc->dst_node_, pus_removed);
@@ -574,6 +691,45 @@ void FlowGraphManager::RemoveUnscheduledAggNode(JobID_t job_id) {
                                     "RemoveUnscheduledAggNode");
 }
 
+void FlowGraphManager::RunInWorkers(
+    uint64_t num_items, uint64_t num_batches,
+    boost::function<void(uint64_t, uint64_t)> process_batch) {
+  num_batches = min(min(num_batches, num_items),
+                    static_cast<uint64_t>(worker_threads_.size() + 1));
+  if (num_batches <= 1) {
+    process_batch(0, num_items);
+    return;
+  }
+  uint64_t items_per_batch = (num_items + num_batches - 1) / num_batches;
+  {
+    boost::lock_guard<boost::mutex> lock(worker_batches_lock_);
+    num_pending_batches_ = (num_items - 1) / items_per_batch;
+  }
+  // The calling thread processes the first batch, and the worker threads the
+  // others.
+  for (uint64_t begin = items_per_batch; begin < num_items;
+       begin += items_per_batch) {
+    worker_io_service_->post(
+        boost::bind(&FlowGraphManager::RunWorkerBatch, this, process_batch,
+                    begin, min(begin + items_per_batch, num_items)));
+  }
+  process_batch(0, items_per_batch);
+  boost::unique_lock<boost::mutex> lock(worker_batches_lock_);
+  while (num_pending_batches_ > 0) {
+    worker_batches_done_.wait(lock);
+  }
+}
+
+void FlowGraphManager::RunWorkerBatch(
+    const boost::function<void(uint64_t, uint64_t)>& process_batch,
+    uint64_t begin, uint64_t end) {
+  process_batch(begin, end);
+  boost::lock_guard<boost::mutex> lock(worker_batches_lock_);
+  if (--num_pending_batches_ == 0) {
+    worker_batches_done_.notify_one();
+  }
+}
+
 uint64_t FlowGraphManager::TaskCompleted(TaskID_t task_id) {
   FlowGraphNode* task_node = NodeForTaskID(task_id);
   CHECK_NOTNULL(task_node);
@@ -658,13 +814,14 @@ void FlowGraphManager::TaskScheduled(TaskID_t task_id, ResourceID_t res_id) {
 
 void FlowGraphManager::TraverseAndRemoveTopology(FlowGraphNode* res_node,
                                                  set<uint64_t>* pus_removed) {
-  // We use an iterator because we change the collection while we iterate over
+  // We copy the arcs because we change the collection while we iterate over
   // it.
-  for (unordered_map<uint64_t, FlowGraphArc*>::iterator
-         it = res_node->outgoing_arc_map_.begin();
-       it != res_node->outgoing_arc_map_.end();) {
-    FlowGraphArc* arc = it->second;
-    ++it;
+  vector<FlowGraphArc*> res_arcs;
+  res_arcs.reserve(res_node->outgoing_arc_map_.size());
+  for (auto& dst_arc : res_node->outgoing_arc_map_) {
+    res_arcs.push_back(dst_arc.second);
+  }
+  for (auto& arc : res_arcs) {
     if (!arc->dst_node_->resource_id_.is_nil()) {
       // The arc is pointing to a resource node.
       TraverseAndRemoveTopology(arc->dst_node_, pus_removed);
@@ -764,104 +921,118 @@ void FlowGraphManager::UpdateChildrenTasks(
 
 void FlowGraphManager::UpdateEquivClassNode(
     FlowGraphNode* ec_node,
+    const EquivClassCostQueries* queries,
     queue<TDOrNodeWrapper*>* node_queue,
     unordered_set<uint64_t>* marked_nodes) {
   CHECK_NOTNULL(ec_node);
   CHECK_NOTNULL(node_queue);
   CHECK_NOTNULL(marked_nodes);
-  UpdateEquivToEquivArcs(ec_node, node_queue, marked_nodes);
-  UpdateEquivToResArcs(ec_node, node_queue, marked_nodes);
+  if (queries) {
+    UpdateEquivToEquivArcs(ec_node, *queries, node_queue, marked_nodes);
+    UpdateEquivToResArcs(ec_node, *queries, node_queue, marked_nodes);
+  } else {
+    UpdateEquivToEquivArcs(ec_node, node_queue, marked_nodes);
+    UpdateEquivToResArcs(ec_node, node_queue, marked_nodes);
+  }
+}
+
+void FlowGraphManager::UpdateEquivToEquivArcs(
+    FlowGraphNode* ec_node,
+    queue<TDOrNodeWrapper*>* node_queue,
+    unordered_set<uint64_t>* marked_nodes) {
+  CHECK_NOTNULL(ec_node);
+  EquivClassCostQueries queries;
+  QueryEquivToEquivCosts(ec_node->ec_id_, &queries);
+  UpdateEquivToEquivArcs(ec_node, queries, node_queue, marked_nodes);
 }
 
 void FlowGraphManager::UpdateEquivToEquivArcs(
     FlowGraphNode* ec_node,
+    const EquivClassCostQueries& queries,
     queue<TDOrNodeWrapper*>* node_queue,
     unordered_set<uint64_t>* marked_nodes) {
   CHECK_NOTNULL(ec_node);
   CHECK_NOTNULL(node_queue);
   CHECK_NOTNULL(marked_nodes);
-  vector<EquivClass_t>* pref_ec =
-    cost_model_->GetEquivClassToEquivClassesArcs(ec_node->ec_id_);
-  if (pref_ec) {
-    for (auto& pref_ec_id : *pref_ec) {
-      FlowGraphNode* pref_ec_node = NodeForEquivClass(pref_ec_id);
-      if (!pref_ec_node) {
-        pref_ec_node = AddEquivClassNode(pref_ec_id);
-      }
-      pair<Cost_t, uint64_t> cost_and_cap =
-        cost_model_->EquivClassToEquivClass(ec_node->ec_id_, pref_ec_id);
-      FlowGraphArc* pref_ec_arc =
-        graph_change_manager_->mutable_flow_graph()->GetArc(ec_node,
-                                                            pref_ec_node);
-      if (!pref_ec_arc) {
-        graph_change_manager_->AddArc(
-            ec_node, pref_ec_node, 0, cost_and_cap.second, cost_and_cap.first,
-            OTHER, ADD_ARC_BETWEEN_EQUIV_CLASS, "UpdateEquivClassNode");
-      } else {
-        graph_change_manager_->ChangeArc(
-            pref_ec_arc, pref_ec_arc->cap_lower_bound_, cost_and_cap.second,
-            cost_and_cap.first, CHG_ARC_BETWEEN_EQUIV_CLASS,
-            "UpdateEquivClassNode");
-      }
-      if (marked_nodes->find(pref_ec_node->id_) == marked_nodes->end()) {
-        // Add the EC node to the queue if it hasn't been marked yet.
-        marked_nodes->insert(pref_ec_node->id_);
-        node_queue->push(
-            new TDOrNodeWrapper(pref_ec_node, pref_ec_node->td_ptr_));
-      }
+  for (uint64_t index = 0; index < queries.pref_ecs_.size(); ++index) {
+    EquivClass_t pref_ec_id = queries.pref_ecs_[index];
+    FlowGraphNode* pref_ec_node = NodeForEquivClass(pref_ec_id);
+    if (!pref_ec_node) {
+      pref_ec_node = AddEquivClassNode(pref_ec_id);
+    }
+    const pair<Cost_t, uint64_t>& cost_and_cap = queries.pref_ec_costs_[index];
+    FlowGraphArc* pref_ec_arc =
+      graph_change_manager_->mutable_flow_graph()->GetArc(ec_node,
+                                                          pref_ec_node);
+    if (!pref_ec_arc) {
+      graph_change_manager_->AddArc(
+          ec_node, pref_ec_node, 0, cost_and_cap.second, cost_and_cap.first,
+          OTHER, ADD_ARC_BETWEEN_EQUIV_CLASS, "UpdateEquivClassNode");
+    } else {
+      graph_change_manager_->ChangeArc(
+          pref_ec_arc, pref_ec_arc->cap_lower_bound_, cost_and_cap.second,
+          cost_and_cap.first, CHG_ARC_BETWEEN_EQUIV_CLASS,
+          "UpdateEquivClassNode");
+    }
+    if (marked_nodes->find(pref_ec_node->id_) == marked_nodes->end()) {
+      // Add the EC node to the queue if it hasn't been marked yet.
+      marked_nodes->insert(pref_ec_node->id_);
+      node_queue->push(
+          new TDOrNodeWrapper(pref_ec_node, pref_ec_node->td_ptr_));
     }
-    RemoveInvalidECPrefArcs(*ec_node, *pref_ec, DEL_ARC_BETWEEN_EQUIV_CLASS);
-    delete pref_ec;
-  } else {
-    vector<EquivClass_t> no_pref_ec;
-    RemoveInvalidECPrefArcs(*ec_node, no_pref_ec, DEL_ARC_BETWEEN_EQUIV_CLASS);
   }
+  RemoveInvalidECPrefArcs(*ec_node, queries.pref_ecs_,
+                          DEL_ARC_BETWEEN_EQUIV_CLASS);
+}
+
+void FlowGraphManager::UpdateEquivToResArcs(
+    FlowGraphNode* ec_node,
+    queue<TDOrNodeWrapper*>* node_queue,
+    unordered_set<uint64_t>* marked_nodes) {
+  CHECK_NOTNULL(ec_node);
+  EquivClassCostQueries queries;
+  QueryEquivToResCosts(ec_node->ec_id_, &queries);
+  UpdateEquivToResArcs(ec_node, queries, node_queue, marked_nodes);
 }
 
 void FlowGraphManager::UpdateEquivToResArcs(
     FlowGraphNode* ec_node,
+    const EquivClassCostQueries& queries,
     queue<TDOrNodeWrapper*>* node_queue,
     unordered_set<uint64_t>* marked_nodes) {
   CHECK_NOTNULL(ec_node);
   CHECK_NOTNULL(node_queue);
   CHECK_NOTNULL(marked_nodes);
-  vector<ResourceID_t>* pref_res =
-    cost_model_->GetOutgoingEquivClassPrefArcs(ec_node->ec_id_);
-  if (pref_res) {
-    for (auto& pref_res_id : *pref_res) {
-      FlowGraphNode* pref_res_node = NodeForResourceID(pref_res_id);
-      // The resource node should already exist because the cost models cannot
-      // prefer a resource before it is added to the graph.
-      CHECK_NOTNULL(pref_res_node);
-      pair<Cost_t, uint64_t> cost_and_cap =
-        cost_model_->EquivClassToResourceNode(ec_node->ec_id_, pref_res_id);
-      FlowGraphArc* pref_res_arc =
-        graph_change_manager_->mutable_flow_graph()->GetArc(ec_node,
-                                                            pref_res_node);
-      if (!pref_res_arc) {
-        graph_change_manager_->AddArc(
-            ec_node, pref_res_node, 0, cost_and_cap.second, cost_and_cap.first,
-            OTHER, ADD_ARC_EQUIV_CLASS_TO_RES, "UpdateEquivToResArcs");
+  for (uint64_t index = 0; index < queries.pref_res_.size(); ++index) {
+    FlowGraphNode* pref_res_node = NodeForResourceID(queries.pref_res_[index]);
+    // The resource node should already exist because the cost models cannot
+    // prefer a resource before it is added to the graph.
+    CHECK_NOTNULL(pref_res_node);
+    const pair<Cost_t, uint64_t>& cost_and_cap =
+      queries.pref_res_costs_[index];
+    FlowGraphArc* pref_res_arc =
+      graph_change_manager_->mutable_flow_graph()->GetArc(ec_node,
+                                                          pref_res_node);
+    if (!pref_res_arc) {
+      graph_change_manager_->AddArc(
+          ec_node, pref_res_node, 0, cost_and_cap.second, cost_and_cap.first,
+          OTHER, ADD_ARC_EQUIV_CLASS_TO_RES, "UpdateEquivToResArcs");
 
-      } else {
-        graph_change_manager_->ChangeArc(
-            pref_res_arc, pref_res_arc->cap_lower_bound_, cost_and_cap.second,
-            cost_and_cap.first, CHG_ARC_EQUIV_CLASS_TO_RES,
-            "UpdateEquivToResArcs");
-      }
-      if (marked_nodes->find(pref_res_node->id_) == marked_nodes->end()) {
-        // Add the res node to the queue if it hasn't been marked yet.
-        marked_nodes->insert(pref_res_node->id_);
-        node_queue->push(
-            new TDOrNodeWrapper(pref_res_node, pref_res_node->td_ptr_));
-      }
+    } else {
+      graph_change_manager_->ChangeArc(
+          pref_res_arc, pref_res_arc->cap_lower_bound_, cost_and_cap.second,
+          cost_and_cap.first, CHG_ARC_EQUIV_CLASS_TO_RES,
+          "UpdateEquivToResArcs");
+    }
+    if (marked_nodes->find(pref_res_node->id_) == marked_nodes->end()) {
+      // Add the res node to the queue if it hasn't been marked yet.
+      marked_nodes->insert(pref_res_node->id_);
+      node_queue->push(
+          new TDOrNodeWrapper(pref_res_node, pref_res_node->td_ptr_));
     }
-    RemoveInvalidPrefResArcs(*ec_node, *pref_res, DEL_ARC_EQUIV_CLASS_TO_RES);
-    delete pref_res;
-  } else {
-    vector<ResourceID_t> no_pref_res;
-    RemoveInvalidPrefResArcs(*ec_node, no_pref_res, DEL_ARC_EQUIV_CLASS_TO_RES);
   }
+  RemoveInvalidPrefResArcs(*ec_node, queries.pref_res_,
+                           DEL_ARC_EQUIV_CLASS_TO_RES);
 }
 
 void FlowGraphManager::UpdateFlowGraph(
@@ -869,26 +1040,55 @@ void FlowGraphManager::UpdateFlowGraph(
     unordered_set<uint64_t>* marked_nodes) {
   CHECK_NOTNULL(node_queue);
   CHECK_NOTNULL(marked_nodes);
+  bool parallel_queries = worker_threads_.size() > 0 &&
+    cost_model_->SupportsConcurrentQueries();
+  vector<TDOrNodeWrapper*> level_nodes;
+  vector<TaskCostQueries> level_task_queries;
+  vector<EquivClassCostQueries> level_ec_queries;
   while (!node_queue->empty()) {
-    TDOrNodeWrapper* cur_node = node_queue->front();
-    node_queue->pop();
-    if (!cur_node->node_) {
-      // We're handling a task that doesn't have an associated flow graph node.
-      UpdateChildrenTasks(cur_node->td_ptr_, node_queue, marked_nodes);
-      delete cur_node;
-      continue;
+    // We process the nodes one BFS level at a time. The nodes we add to the
+    // queue while processing a level are only processed after all the nodes
+    // of the level. Hence, the order is the same as that of a plain BFS.
+    level_nodes.clear();
+    while (!node_queue->empty()) {
+      level_nodes.push_back(node_queue->front());
+      node_queue->pop();
     }
-    if (cur_node->node_->IsTaskNode()) {
-      UpdateTaskNode(cur_node->node_, node_queue, marked_nodes);
-      UpdateChildrenTasks(cur_node->td_ptr_, node_queue, marked_nodes);
-    } else if (cur_node->node_->IsEquivalenceClassNode()) {
-      UpdateEquivClassNode(cur_node->node_, node_queue, marked_nodes);
-    } else if (cur_node->node_->IsResourceNode()) {
-      UpdateResourceNode(cur_node->node_, node_queue, marked_nodes);
-    } else {
-      LOG(FATAL) << "Unexpected node type: " << cur_node->node_->type_;
+    if (parallel_queries) {
+      level_task_queries.clear();
+      level_task_queries.resize(level_nodes.size());
+      level_ec_queries.clear();
+      level_ec_queries.resize(level_nodes.size());
+      RunInWorkers(level_nodes.size(), FLAGS_flow_graph_update_threads,
+                   boost::bind(&FlowGraphManager::QueryCostsForNodes, this,
+                               &level_nodes, _1, _2, &level_task_queries,
+                               &level_ec_queries));
+    }
+    for (uint64_t index = 0; index < level_nodes.size(); ++index) {
+      TDOrNodeWrapper* cur_node = level_nodes[index];
+      if (!cur_node->node_) {
+        // We're handling a task that doesn't have an associated flow graph
+        // node.
+        UpdateChildrenTasks(cur_node->td_ptr_, node_queue, marked_nodes);
+        delete cur_node;
+        continue;
+      }
+      if (cur_node->node_->IsTaskNode()) {
+        UpdateTaskNode(cur_node->node_,
+                       parallel_queries ? &level_task_queries[index] : NULL,
+                       node_queue, marked_nodes);
+        UpdateChildrenTasks(cur_node->td_ptr_, node_queue, marked_nodes);
+      } else if (cur_node->node_->IsEquivalenceClassNode()) {
+        UpdateEquivClassNode(cur_node->node_,
+                             parallel_queries ? &level_ec_queries[index] : NULL,
+                             node_queue, marked_nodes);
+      } else if (cur_node->node_->IsResourceNode()) {
+        UpdateResourceNode(cur_node->node_, node_queue, marked_nodes);
+      } else {
+        LOG(FATAL) << "Unexpected node type: " << cur_node->node_->type_;
+      }
+      delete cur_node;
     }
-    delete cur_node;
   }
 }
 
@@ -1012,11 +1212,8 @@ void FlowGraphManager::UpdateResOutgoingArcs(
   CHECK_NOTNULL(res_node);
   CHECK_NOTNULL(node_queue);
   CHECK_NOTNULL(marked_nodes);
-  for (unordered_map<uint64_t, FlowGraphArc*>::iterator it =
-         res_node->outgoing_arc_map_.begin();
-       it != res_node->outgoing_arc_map_.end(); ) {
-    FlowGraphArc* arc = it->second;
-    ++it;
+  for (auto& dst_arc : res_node->outgoing_arc_map_) {
+    FlowGraphArc* arc = dst_arc.second;
     if (!arc->dst_node_->resource_id_.is_nil()) {
       graph_change_manager_->ChangeArcCost(
           arc,
@@ -1098,12 +1295,17 @@ void FlowGraphManager::UpdateRunningTaskToUnscheduledAggArc(
 }
 
 void FlowGraphManager::UpdateTaskNode(FlowGraphNode* task_node,
+                                      const TaskCostQueries* queries,
                                       queue<TDOrNodeWrapper*>* node_queue,
                                       unordered_set<uint64_t>* marked_nodes) {
   CHECK_NOTNULL(task_node);
   if (task_node->IsTaskAssignedOrRunning()) {
     UpdateRunningTaskNode(task_node, FLAGS_update_preferences_running_task,
                           node_queue, marked_nodes);
+  } else if (queries) {
+    UpdateTaskToUnscheduledAggArc(task_node, queries->unsched_agg_cost_);
+    UpdateTaskToEquivArcs(task_node, *queries, node_queue, marked_nodes);
+    UpdateTaskToResArcs(task_node, *queries, node_queue, marked_nodes);
   } else {
     UpdateTaskToUnscheduledAggArc(task_node);
     UpdateTaskToEquivArcs(task_node, node_queue, marked_nodes);
@@ -1116,47 +1318,49 @@ void FlowGraphManager::UpdateTaskToEquivArcs(
     queue<TDOrNodeWrapper*>* node_queue,
     unordered_set<uint64_t>* marked_nodes) {
   CHECK_NOTNULL(task_node);
+  TaskCostQueries queries;
+  QueryTaskToEquivCosts(task_node->td_ptr_->uid(), &queries);
+  UpdateTaskToEquivArcs(task_node, queries, node_queue, marked_nodes);
+}
+
+void FlowGraphManager::UpdateTaskToEquivArcs(
+    FlowGraphNode* task_node,
+    const TaskCostQueries& queries,
+    queue<TDOrNodeWrapper*>* node_queue,
+    unordered_set<uint64_t>* marked_nodes) {
+  CHECK_NOTNULL(task_node);
   CHECK_NOTNULL(node_queue);
   CHECK_NOTNULL(marked_nodes);
-  vector<EquivClass_t>* pref_ec =
-    cost_model_->GetTaskEquivClasses(task_node->td_ptr_->uid());
-  if (pref_ec) {
-    for (auto& pref_ec_id : *pref_ec) {
-      FlowGraphNode* pref_ec_node = NodeForEquivClass(pref_ec_id);
-      if (!pref_ec_node) {
-        pref_ec_node = AddEquivClassNode(pref_ec_id);
-      }
-      Cost_t new_cost =
-        cost_model_->TaskToEquivClassAggregator(task_node->td_ptr_->uid(),
-                                                pref_ec_id);
-      FlowGraphArc* pref_ec_arc =
-        graph_change_manager_->mutable_flow_graph()->GetArc(task_node,
-                                                            pref_ec_node);
-      if (!pref_ec_arc) {
-        graph_change_manager_->AddArc(
-          task_node, pref_ec_node, 0, 1, new_cost, OTHER,
-          ADD_ARC_TASK_TO_EQUIV_CLASS, "UpdateTaskToEquivArcs");
+  for (uint64_t index = 0; index < queries.pref_ecs_.size(); ++index) {
+    EquivClass_t pref_ec_id = queries.pref_ecs_[index];
+    FlowGraphNode* pref_ec_node = NodeForEquivClass(pref_ec_id);
+    if (!pref_ec_node) {
+      pref_ec_node = AddEquivClassNode(pref_ec_id);
+    }
+    Cost_t new_cost = queries.pref_ec_costs_[index];
+    FlowGraphArc* pref_ec_arc =
+      graph_change_manager_->mutable_flow_graph()->GetArc(task_node,
+                                                          pref_ec_node);
+    if (!pref_ec_arc) {
+      graph_change_manager_->AddArc(
+        task_node, pref_ec_node, 0, 1, new_cost, OTHER,
+        ADD_ARC_TASK_TO_EQUIV_CLASS, "UpdateTaskToEquivArcs");
 
-      } else {
-        graph_change_manager_->ChangeArc(
-            pref_ec_arc, pref_ec_arc->cap_lower_bound_,
-            pref_ec_arc->cap_upper_bound_, new_cost,
-            CHG_ARC_TASK_TO_EQUIV_CLASS, "UpdateTaskToEquivArcs");
-      }
-      if (marked_nodes->find(pref_ec_node->id_) == marked_nodes->end()) {
-        // Add the EC node to the queue if it hasn't been marked yet.
-        marked_nodes->insert(pref_ec_node->id_);
-        node_queue->push(
-            new TDOrNodeWrapper(pref_ec_node, pref_ec_node->td_ptr_));
-      }
+    } else {
+      graph_change_manager_->ChangeArc(
+          pref_ec_arc, pref_ec_arc->cap_lower_bound_,
+          pref_ec_arc->cap_upper_bound_, new_cost,
+          CHG_ARC_TASK_TO_EQUIV_CLASS, "UpdateTaskToEquivArcs");
+    }
+    if (marked_nodes->find(pref_ec_node->id_) == marked_nodes->end()) {
+      // Add the EC node to the queue if it hasn't been marked yet.
+      marked_nodes->insert(pref_ec_node->id_);
+      node_queue->push(
+          new TDOrNodeWrapper(pref_ec_node, pref_ec_node->td_ptr_));
     }
-    RemoveInvalidECPrefArcs(*task_node, *pref_ec, DEL_ARC_TASK_TO_EQUIV_CLASS);
-    delete pref_ec;
-  } else {
-    vector<EquivClass_t> no_pref_ec;
-    RemoveInvalidECPrefArcs(*task_node, no_pref_ec,
-                            DEL_ARC_TASK_TO_EQUIV_CLASS);
   }
+  RemoveInvalidECPrefArcs(*task_node, queries.pref_ecs_,
+                          DEL_ARC_TASK_TO_EQUIV_CLASS);
 }
 
 void FlowGraphManager::UpdateTaskToResArcs(
@@ -1164,58 +1368,65 @@ void FlowGraphManager::UpdateTaskToResArcs(
     queue<TDOrNodeWrapper*>* node_queue,
     unordered_set<uint64_t>* marked_nodes) {
   CHECK_NOTNULL(task_node);
+  TaskCostQueries queries;
+  QueryTaskToResCosts(task_node->td_ptr_->uid(), &queries);
+  UpdateTaskToResArcs(task_node, queries, node_queue, marked_nodes);
+}
+
+void FlowGraphManager::UpdateTaskToResArcs(
+    FlowGraphNode* task_node,
+    const TaskCostQueries& queries,
+    queue<TDOrNodeWrapper*>* node_queue,
+    unordered_set<uint64_t>* marked_nodes) {
+  CHECK_NOTNULL(task_node);
   CHECK_NOTNULL(node_queue);
   CHECK_NOTNULL(marked_nodes);
-  vector<ResourceID_t>* pref_res =
-    cost_model_->GetTaskPreferenceArcs(task_node->td_ptr_->uid());
-  if (pref_res) {
-    for (auto& pref_res_id : *pref_res) {
-      FlowGraphNode* pref_res_node = NodeForResourceID(pref_res_id);
-      // The resource node should already exist because the cost models cannot
-      // prefer a resource before it is added to the graph.
-      CHECK_NOTNULL(pref_res_node);
-      Cost_t new_cost =
-        cost_model_->TaskToResourceNodeCost(task_node->td_ptr_->uid(),
-                                            pref_res_id);
-      FlowGraphArc* pref_res_arc =
-        graph_change_manager_->mutable_flow_graph()->GetArc(task_node,
-                                                            pref_res_node);
-      if (!pref_res_arc) {
-        graph_change_manager_->AddArc(
-            task_node, pref_res_node, 0, 1, new_cost, OTHER,
-            ADD_ARC_TASK_TO_RES, "UpdateTaskToResArcs");
-      } else if (pref_res_arc->type_ != FlowGraphArcType::RUNNING) {
-        // We don't change the cost of the arc if it's a running arc because
-        // the arc is updated somewhere else. Moreover, the cost of running
-        // arcs is returned by TaskContinuationCost.
-        graph_change_manager_->ChangeArcCost(pref_res_arc, new_cost,
-                                             CHG_ARC_TASK_TO_RES,
-                                             "UpdateTaskToResArcs");
-      }
-      if (marked_nodes->find(pref_res_node->id_) == marked_nodes->end()) {
-        // Add the res node to the queue if it hasn't been marked yet.
-        marked_nodes->insert(pref_res_node->id_);
-        node_queue->push(
-            new TDOrNodeWrapper(pref_res_node, pref_res_node->td_ptr_));
-      }
+  for (uint64_t index = 0; index < queries.pref_res_.size(); ++index) {
+    FlowGraphNode* pref_res_node = NodeForResourceID(queries.pref_res_[index]);
+    // The resource node should already exist because the cost models cannot
+    // prefer a resource before it is added to the graph.
+    CHECK_NOTNULL(pref_res_node);
+    Cost_t new_cost = queries.pref_res_costs_[index];
+    FlowGraphArc* pref_res_arc =
+      graph_change_manager_->mutable_flow_graph()->GetArc(task_node,
+                                                          pref_res_node);
+    if (!pref_res_arc) {
+      graph_change_manager_->AddArc(
+          task_node, pref_res_node, 0, 1, new_cost, OTHER,
+          ADD_ARC_TASK_TO_RES, "UpdateTaskToResArcs");
+    } else if (pref_res_arc->type_ != FlowGraphArcType::RUNNING) {
+      // We don't change the cost of the arc if it's a running arc because
+      // the arc is updated somewhere else. Moreover, the cost of running
+      // arcs is returned by TaskContinuationCost.
+      graph_change_manager_->ChangeArcCost(pref_res_arc, new_cost,
+                                           CHG_ARC_TASK_TO_RES,
+                                           "UpdateTaskToResArcs");
+    }
+    if (marked_nodes->find(pref_res_node->id_) == marked_nodes->end()) {
+      // Add the res node to the queue if it hasn't been marked yet.
+      marked_nodes->insert(pref_res_node->id_);
+      node_queue->push(
+          new TDOrNodeWrapper(pref_res_node, pref_res_node->td_ptr_));
     }
-    RemoveInvalidPrefResArcs(*task_node, *pref_res, DEL_ARC_TASK_TO_RES);
-    delete pref_res;
-  } else {
-    vector<ResourceID_t> no_pref_res;
-    RemoveInvalidPrefResArcs(*task_node, no_pref_res, DEL_ARC_TASK_TO_RES);
   }
+  RemoveInvalidPrefResArcs(*task_node, queries.pref_res_, DEL_ARC_TASK_TO_RES);
 }
 
 FlowGraphNode* FlowGraphManager::UpdateTaskToUnscheduledAggArc(
     FlowGraphNode* task_node) {
   CHECK_NOTNULL(task_node);
+  return UpdateTaskToUnscheduledAggArc(
+      task_node,
+      cost_model_->TaskToUnscheduledAggCost(task_node->td_ptr_->uid()));
+}
+
+FlowGraphNode* FlowGraphManager::UpdateTaskToUnscheduledAggArc(
+    FlowGraphNode* task_node, Cost_t new_cost) {
+  CHECK_NOTNULL(task_node);
   FlowGraphNode* unsched_agg_node = UnschedAggNodeForJobID(task_node->job_id_);
   if (!unsched_agg_node) {
     unsched_agg_node = AddUnscheduledAggNode(task_node->job_id_);
   }
-  Cost_t new_cost =
-    cost_model_->TaskToUnscheduledAggCost(task_node->td_ptr_->uid());
   FlowGraphArc* to_unsched_arc =
     graph_change_manager_->mutable_flow_graph()->GetArc(task_node,
                                                         unsched_agg_node);
@@ -9,6 +9,9 @@
 #include <set>
 #include <string>
 #include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 #include "base/common.h"
 #include "base/types.h"
@@ -25,6 +28,8 @@
 #include "scheduling/flow/flow_graph_node.h"
 
 DECLARE_bool(preemption);
+DECLARE_uint64(topology_stats_threads);
+DECLARE_uint64(flow_graph_update_threads);
 DECLARE_string(flow_scheduling_solver);
 
 namespace firmament {
@@ -39,6 +44,37 @@ struct TDOrNodeWrapper {
   TaskDescriptor* td_ptr_;
 };
 
+/**
+ * The cost model's answers to the queries needed to update the arcs of an
+ * unscheduled task. The answers can be computed ahead of the graph update,
+ * and concurrently for different tasks.
+ */
+struct TaskCostQueries {
+  TaskCostQueries() : unsched_agg_cost_(0) {
+  }
+  Cost_t unsched_agg_cost_;
+  // The task's ECs and the costs of the arcs to them.
+  vector<EquivClass_t> pref_ecs_;
+  vector<Cost_t> pref_ec_costs_;
+  // The task's preferred resources and the costs of the arcs to them.
+  vector<ResourceID_t> pref_res_;
+  vector<Cost_t> pref_res_costs_;
+};
+
+/**
+ * The cost model's answers to the queries needed to update the outgoing arcs
+ * of an equivalence class. Like the task queries, they can be computed ahead
+ * of the graph update and concurrently for different equivalence classes.
+ */
+struct EquivClassCostQueries {
+  // The preferred ECs and the costs and capacities of the arcs to them.
+  vector<EquivClass_t> pref_ecs_;
+  vector<pair<Cost_t, uint64_t>> pref_ec_costs_;
+  // The preferred resources and the costs and capacities of the arcs to them.
+  vector<ResourceID_t> pref_res_;
+  vector<pair<Cost_t, uint64_t>> pref_res_costs_;
+};
+
 class FlowGraphManager {
  public:
   explicit FlowGraphManager(CostModelInterface* cost_model,
@@ -63,6 +99,19 @@ class FlowGraphManager {
       boost::function<void(FlowGraphNode*)> prepare,
       boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> gather,
       boost::function<FlowGraphNode*(FlowGraphNode*, FlowGraphNode*)> update);
+
+  /**
+   * Traverses the graph backwards from node and calls the visitor's
+   * Prepare(node) once for every node it reaches, and Gather(src, dst) and
+   * Update(src, dst) for every arc it traverses. If the traversal starts from
+   * the sink and FLAGS_topology_stats_threads is greater than one, then the
+   * statistics of the machine subtrees are computed in parallel on the worker
+   * threads before the rest of the graph is traversed.
+   * @param node the node from which to start the traversal
+   * @param visitor object providing the Prepare, Gather and Update methods
+   */
+  template <typename StatsVisitor>
+  void ComputeTopologyStatistics(FlowGraphNode* node, StatsVisitor* visitor);
   void JobCompleted(JobID_t job_id);
   void NodeBindingToSchedulingDeltas(
       uint64_t task_node_id, uint64_t resource_node_id,
@@ -129,6 +178,7 @@ class FlowGraphManager {
   FRIEND_TEST(FlowGraphManagerTest, AddResourceTopologyDFS);
   FRIEND_TEST(FlowGraphManagerTest, AddTaskNode);
   FRIEND_TEST(FlowGraphManagerTest, AddUnscheduledAggNode);
+  FRIEND_TEST(FlowGraphManagerTest, ComputeTopologyStatisticsParallel);
   FRIEND_TEST(FlowGraphManagerTest, PinTaskToNode);
   FRIEND_TEST(FlowGraphManagerTest, RemoveEquivClassNode);
   FRIEND_TEST(FlowGraphManagerTest, RemoveInvalidECPrefArcs);
@@ -140,6 +190,7 @@ class FlowGraphManager {
   FRIEND_TEST(FlowGraphManagerTest, UpdateEquivClassNode);
   FRIEND_TEST(FlowGraphManagerTest, UpdateEquivToEquivArcs);
   FRIEND_TEST(FlowGraphManagerTest, UpdateEquivToResArcs);
+  FRIEND_TEST(FlowGraphManagerTest, UpdateFlowGraphParallel);
   FRIEND_TEST(FlowGraphManagerTest, UpdateFlowGraph);
   FRIEND_TEST(FlowGraphManagerTest, UpdateResourceStatsUpToRoot);
   FRIEND_TEST(FlowGraphManagerTest, UpdateResOutgoingArcs);
@@ -168,6 +219,23 @@ class FlowGraphManager {
   FlowGraphNode* AddTaskNode(JobID_t job_id, TaskDescriptor* td_ptr);
   FlowGraphNode* AddUnscheduledAggNode(JobID_t job_id);
   uint64_t CapacityFromResNodeToParent(const ResourceDescriptor& rd);
+
+  /**
+   * Computes the statistics of the machines in machine_nodes[begin, end).
+   */
+  template <typename StatsVisitor>
+  void ComputeMachinesStatistics(const vector<FlowGraphNode*>* machine_nodes,
+                                 uint64_t begin, uint64_t end,
+                                 StatsVisitor* visitor);
+
+  /**
+   * Computes the statistics of the resource subtree rooted at res_node in
+   * post-order, i.e. a node's statistics are gathered only after the
+   * statistics of all its children are complete.
+   */
+  template <typename StatsVisitor>
+  void ComputeResourceSubtreeStatistics(FlowGraphNode* res_node,
+                                        StatsVisitor* visitor);
   void PinTaskToNode(FlowGraphNode* task_node, FlowGraphNode* res_node);
   void RemoveEquivClassNode(FlowGraphNode* ec_node);
 
@@ -196,6 +264,18 @@ class FlowGraphManager {
   uint64_t RemoveTaskNode(FlowGraphNode* task_node);
   void RemoveUnscheduledAggNode(JobID_t job_id);
 
+  /**
+   * Splits [0, num_items) into at most num_batches contiguous batches and
+   * calls process_batch(begin, end) for each of them. The calling thread
+   * processes the first batch and the worker threads the others. The method
+   * returns once all the batches have been processed.
+   */
+  void RunInWorkers(uint64_t num_items, uint64_t num_batches,
+                    boost::function<void(uint64_t, uint64_t)> process_batch);
+  void RunWorkerBatch(
+      const boost::function<void(uint64_t, uint64_t)>& process_batch,
+      uint64_t begin, uint64_t end);
+
   /**
    * Remove the resource topology rooted at res_node.
    * @param res_node the root of the topology tree to remove
@@ -228,7 +308,13 @@ class FlowGraphManager {
                            queue<TDOrNodeWrapper*>* node_queue,
                            unordered_set<uint64_t>* marked_nodes);
 
+  /**
+   * Updates an EC's outgoing arcs.
+   * @param queries the precomputed cost queries of the EC, or NULL if the
+   * method should query the cost model
+   */
   void UpdateEquivClassNode(FlowGraphNode* ec_node,
+                            const EquivClassCostQueries* queries,
                             queue<TDOrNodeWrapper*>* node_queue,
                             unordered_set<uint64_t>* marked_nodes);
 
@@ -240,6 +326,10 @@ class FlowGraphManager {
   void UpdateEquivToEquivArcs(FlowGraphNode* ec_node,
                               queue<TDOrNodeWrapper*>* node_queue,
                               unordered_set<uint64_t>* marked_nodes);
+  void UpdateEquivToEquivArcs(FlowGraphNode* ec_node,
+                              const EquivClassCostQueries& queries,
+                              queue<TDOrNodeWrapper*>* node_queue,
+                              unordered_set<uint64_t>* marked_nodes);
 
   /**
    * Updates the resource preference arcs an equivalence class has.
@@ -248,7 +338,19 @@ class FlowGraphManager {
   void UpdateEquivToResArcs(FlowGraphNode* ec_node,
                             queue<TDOrNodeWrapper*>* node_queue,
                             unordered_set<uint64_t>* marked_nodes);
+  void UpdateEquivToResArcs(FlowGraphNode* ec_node,
+                            const EquivClassCostQueries& queries,
+                            queue<TDOrNodeWrapper*>* node_queue,
+                            unordered_set<uint64_t>* marked_nodes);
 
+  /**
+   * Updates the nodes in the queue, and the nodes reachable from them, in BFS
+   * order. If FLAGS_flow_graph_update_threads is greater than one and the cost
+   * model supports it, then the cost queries of the unscheduled tasks and of
+   * the equivalence classes at each BFS level are computed by the worker
+   * threads before the level is updated. The graph changes are still made by
+   * the calling thread, in BFS order.
+   */
   void UpdateFlowGraph(queue<TDOrNodeWrapper*>* node_queue,
                        unordered_set<uint64_t>* marked_nodes);
 
@@ -300,7 +402,39 @@ class FlowGraphManager {
    */
   void UpdateRunningTaskToUnscheduledAggArc(FlowGraphNode* task_node);
 
+  /**
+   * Computes the cost queries of the unscheduled tasks and of the equivalence
+   * classes in nodes[begin, end). The queries of nodes[index] are stored in
+   * (*task_queries)[index] or (*ec_queries)[index], respectively.
+   */
+  void QueryCostsForNodes(const vector<TDOrNodeWrapper*>* nodes,
+                          uint64_t begin, uint64_t end,
+                          vector<TaskCostQueries>* task_queries,
+                          vector<EquivClassCostQueries>* ec_queries);
+
+  /**
+   * Asks the cost model for the preferred ECs and resources of an equivalence
+   * class, and for the costs and capacities of the arcs to them.
+   */
+  void QueryEquivToEquivCosts(EquivClass_t ec,
+                              EquivClassCostQueries* queries);
+  void QueryEquivToResCosts(EquivClass_t ec, EquivClassCostQueries* queries);
+
+  /**
+   * Asks the cost model for the ECs and the preferred resources of a task,
+   * and for the costs of the arcs to them and to the unscheduled aggregator.
+   */
+  void QueryTaskCosts(TaskID_t task_id, TaskCostQueries* queries);
+  void QueryTaskToEquivCosts(TaskID_t task_id, TaskCostQueries* queries);
+  void QueryTaskToResCosts(TaskID_t task_id, TaskCostQueries* queries);
+
+  /**
+   * Updates a task's arcs.
+   * @param queries the precomputed cost queries of the task, or NULL if the
+   * method should query the cost model
+   */
   void UpdateTaskNode(FlowGraphNode* task_node,
+                      const TaskCostQueries* queries,
                       queue<TDOrNodeWrapper*>* node_queue,
                       unordered_set<uint64_t>* marked_nodes);
 
@@ -312,6 +446,10 @@ class FlowGraphManager {
   void UpdateTaskToEquivArcs(FlowGraphNode* task_node,
                              queue<TDOrNodeWrapper*>* node_queue,
                              unordered_set<uint64_t>* marked_nodes);
+  void UpdateTaskToEquivArcs(FlowGraphNode* task_node,
+                             const TaskCostQueries& queries,
+                             queue<TDOrNodeWrapper*>* node_queue,
+                             unordered_set<uint64_t>* marked_nodes);
 
   /**
    * Updates a task's preferences to resources.
@@ -320,6 +458,10 @@ class FlowGraphManager {
   void UpdateTaskToResArcs(FlowGraphNode* task_node,
                            queue<TDOrNodeWrapper*>* node_queue,
                            unordered_set<uint64_t>* marked_nodes);
+  void UpdateTaskToResArcs(FlowGraphNode* task_node,
+                           const TaskCostQueries& queries,
+                           queue<TDOrNodeWrapper*>* node_queue,
+                           unordered_set<uint64_t>* marked_nodes);
 
   /**
    * Updates the arc from a task to its unscheduled aggregator. The method
@@ -328,6 +470,8 @@ class FlowGraphManager {
    * @return the unscheduled aggregator node
    */
   FlowGraphNode* UpdateTaskToUnscheduledAggArc(FlowGraphNode* task_node);
+  FlowGraphNode* UpdateTaskToUnscheduledAggArc(FlowGraphNode* task_node,
+                                               Cost_t new_cost);
 
   /**
    * Adjusts the capacity of the arc connecting the unscheduled agg to the sink
@@ -340,6 +484,12 @@ class FlowGraphManager {
 
   void VisitTopologyChildren(ResourceTopologyNodeDescriptor* rtnd_ptr);
 
+  /**
+   * Returns true if the node is a machine or a resource below a machine.
+   */
+  inline bool IsInMachineSubtree(const FlowGraphNode& node) {
+    return node.IsResourceNode() && node.type_ != FlowNodeType::COORDINATOR;
+  }
   inline FlowGraphNode* NodeForEquivClass(const EquivClass_t& ec) {
     return FindPtrOrNull(tec_to_node_map_, ec);
   }
@@ -383,8 +533,108 @@ class FlowGraphManager {
   // used as a marker in the resource topology traversal. It helps us to avoid
   // having to reset the visited state before each traversal.
   uint32_t cur_traversal_counter_;
+  // Worker threads that run batches of cost queries and of machine statistics
+  // alongside the calling thread. They are started once and wait for work on
+  // the io_service.
+  shared_ptr<boost::asio::io_service> worker_io_service_;
+  scoped_ptr<boost::asio::io_service::work> worker_io_service_work_;
+  boost::thread_group worker_threads_;
+  // Number of batches that the worker threads have not processed yet.
+  boost::mutex worker_batches_lock_;
+  boost::condition_variable worker_batches_done_;
+  uint64_t num_pending_batches_;
 };
 
+template <typename StatsVisitor>
+void FlowGraphManager::ComputeTopologyStatistics(FlowGraphNode* node,
+                                                 StatsVisitor* visitor) {
+  // XXX(ionel): The function only works correctly as long as the topology is a
+  // tree. If the topology is a DAG then it does not work correctly! It does
+  // not work in the DAG case because the function implements BFS. Hence,
+  // we may pop a not of the queue and propagate its statistics via its incoming
+  // arcs before we've received all the statistics at the node.
+  // The machine subtrees are independent of each other. When running in
+  // parallel mode we compute their statistics first, and only then traverse
+  // the rest of the graph. The traversal skips the arcs inside the machine
+  // subtrees because their statistics are already complete.
+  bool machines_done = false;
+  if (FLAGS_topology_stats_threads > 1 && worker_threads_.size() > 0 &&
+      node == sink_node_) {
+    vector<FlowGraphNode*> machine_nodes;
+    for (auto& res_id_node : resource_to_node_map_) {
+      if (res_id_node.second->type_ == FlowNodeType::MACHINE) {
+        machine_nodes.push_back(res_id_node.second);
+      }
+    }
+    if (machine_nodes.size() > 1) {
+      RunInWorkers(
+          machine_nodes.size(), FLAGS_topology_stats_threads,
+          boost::bind(
+              &FlowGraphManager::ComputeMachinesStatistics<StatsVisitor>,
+              this, &machine_nodes, _1, _2, visitor));
+      machines_done = true;
+    }
+  }
+  queue<FlowGraphNode*> to_visit;
+  // We maintain a value that is used to mark visited nodes. Before each
+  // visit we increment the mark to make sure that nodes visited in previous
+  // traversal are not going to be treated as marked. By using the mark
+  // variable we avoid having to reset the visited state of each node before
+  // of a traversal.
+  cur_traversal_counter_++;
+  to_visit.push(node);
+  node->visited_ = cur_traversal_counter_;
+  while (!to_visit.empty()) {
+    FlowGraphNode* cur_node = to_visit.front();
+    to_visit.pop();
+    bool cur_done = machines_done &&
+      (cur_node == sink_node_ || IsInMachineSubtree(*cur_node));
+    for (auto& incoming_arc : cur_node->incoming_arc_map_) {
+      FlowGraphNode* src_node = incoming_arc.second->src_node_;
+      bool src_done = machines_done && IsInMachineSubtree(*src_node);
+      if (src_node->visited_ != cur_traversal_counter_) {
+        if (!src_done) {
+          visitor->Prepare(src_node);
+        }
+        to_visit.push(src_node);
+        src_node->visited_ = cur_traversal_counter_;
+      }
+      if (src_done && cur_done) {
+        continue;
+      }
+      incoming_arc.second->src_node_ = visitor->Gather(src_node, cur_node);
+      incoming_arc.second->src_node_ =
+        visitor->Update(incoming_arc.second->src_node_, cur_node);
+    }
+  }
+}
+
+template <typename StatsVisitor>
+void FlowGraphManager::ComputeMachinesStatistics(
+    const vector<FlowGraphNode*>* machine_nodes, uint64_t begin, uint64_t end,
+    StatsVisitor* visitor) {
+  for (uint64_t index = begin; index < end; ++index) {
+    ComputeResourceSubtreeStatistics((*machine_nodes)[index], visitor);
+  }
+}
+
+template <typename StatsVisitor>
+void FlowGraphManager::ComputeResourceSubtreeStatistics(
+    FlowGraphNode* res_node,
+    StatsVisitor* visitor) {
+  visitor->Prepare(res_node);
+  for (auto& outgoing_arc : res_node->outgoing_arc_map_) {
+    FlowGraphNode* child_node = outgoing_arc.second->dst_node_;
+    if (IsInMachineSubtree(*child_node)) {
+      ComputeResourceSubtreeStatistics(child_node, visitor);
+    } else if (child_node != sink_node_) {
+      continue;
+    }
+    res_node = visitor->Gather(res_node, child_node);
+    res_node = visitor->Update(res_node, child_node);
+  }
+}
+
 }  // namespace firmament
 
 #endif  // FIRMAMENT_SCHEDULING_FLOW_FLOW_GRAPH_MANAGER_H
@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include "base/common.h"
+#include "base/resource_status.h"
 #include "misc/map-util.h"
 #include "misc/wall_time.h"
 #include "misc/utils.h"
@@ -22,6 +23,9 @@
 
 DECLARE_string(flow_scheduling_solver);
 DECLARE_uint64(num_pref_arcs_task_to_res);
+DECLARE_uint64(topology_stats_threads);
+DECLARE_uint64(flow_graph_update_threads);
+DECLARE_bool(incremental_flow);
 
 using ::testing::_;
 
@@ -272,6 +276,63 @@ TEST_F(FlowGraphManagerTest, AddResourceTopologyDFS) {
             0);
 }
 
+// Checks that computing the machines' statistics in parallel gives the same
+// results as the sequential traversal.
+TEST_F(FlowGraphManagerTest, ComputeTopologyStatisticsParallel) {
+  // The graph manager starts its worker threads when it is created.
+  FLAGS_topology_stats_threads = 4;
+  FlowGraphManager* graph_manager = CreateGraphManagerUsingTrivialCost();
+  EXPECT_EQ(graph_manager->worker_threads_.size(), 3);
+  ResourceTopologyNodeDescriptor rtnd;
+  ResourceID_t root_res_id = GenerateResourceID("test");
+  rtnd.mutable_resource_desc()->set_uuid(to_string(root_res_id));
+  rtnd.mutable_resource_desc()->set_type(
+      ResourceDescriptor::RESOURCE_COORDINATOR);
+  vector<ResourceDescriptor*> machine_rds;
+  for (uint32_t machine_index = 0; machine_index < 10; ++machine_index) {
+    ResourceTopologyNodeDescriptor* rtn_machine = rtnd.add_children();
+    machine_rds.push_back(
+        CreateMachine(rtn_machine, "machine" + to_string(machine_index)));
+    rtn_machine->set_parent_id(to_string(root_res_id));
+    for (uint32_t pu_index = 0; pu_index < 2; ++pu_index) {
+      ResourceTopologyNodeDescriptor* rtn_pu = rtn_machine->add_children();
+      ResourceID_t pu_res_id = GenerateResourceID(
+          "machine" + to_string(machine_index) + "-pu" + to_string(pu_index));
+      ResourceDescriptor* pu_rd_ptr = rtn_pu->mutable_resource_desc();
+      pu_rd_ptr->set_uuid(to_string(pu_res_id));
+      pu_rd_ptr->set_type(ResourceDescriptor::RESOURCE_PU);
+      if (pu_index < machine_index % 3) {
+        pu_rd_ptr->add_current_running_tasks(machine_index * 2 + pu_index);
+      }
+      rtn_pu->set_parent_id(rtn_machine->resource_desc().uuid());
+    }
+  }
+  graph_manager->AddResourceTopology(&rtnd);
+  CostModelStatsVisitor<TrivialCostModel> visitor(
+      static_cast<TrivialCostModel*>(graph_manager->cost_model_));
+  FLAGS_topology_stats_threads = 1;
+  graph_manager->ComputeTopologyStatistics(graph_manager->sink_node_,
+                                           &visitor);
+  EXPECT_EQ(rtnd.resource_desc().num_slots_below(), 20);
+  EXPECT_EQ(rtnd.resource_desc().num_running_tasks_below(), 9);
+  vector<uint64_t> running_tasks_below;
+  for (auto& rd_ptr : machine_rds) {
+    running_tasks_below.push_back(rd_ptr->num_running_tasks_below());
+  }
+  FLAGS_topology_stats_threads = 4;
+  graph_manager->ComputeTopologyStatistics(graph_manager->sink_node_,
+                                           &visitor);
+  FLAGS_topology_stats_threads = 1;
+  EXPECT_EQ(rtnd.resource_desc().num_slots_below(), 20);
+  EXPECT_EQ(rtnd.resource_desc().num_running_tasks_below(), 9);
+  for (uint32_t index = 0; index < machine_rds.size(); ++index) {
+    EXPECT_EQ(machine_rds[index]->num_slots_below(), 2);
+    EXPECT_EQ(machine_rds[index]->num_running_tasks_below(),
+              running_tasks_below[index]);
+  }
+  delete graph_manager;
+}
+
 TEST_F(FlowGraphManagerTest, PinTaskToNode) {
   MockCostModel mock_cost_model;
   FlowGraphManager* graph_manager =
@@ -660,11 +721,13 @@ TEST_F(FlowGraphManagerTest, UpdateEquivClassNode) {
   queue<TDOrNodeWrapper*> node_queue;
   unordered_set<uint64_t> marked_nodes;
   EXPECT_DEATH(
-       graph_manager->UpdateEquivClassNode(NULL, &node_queue, &marked_nodes),
+       graph_manager->UpdateEquivClassNode(NULL, NULL, &node_queue,
+                                           &marked_nodes),
        "");
   EXPECT_CALL(mock_cost_model, GetEquivClassToEquivClassesArcs(_)).Times(1);
   EXPECT_CALL(mock_cost_model, GetOutgoingEquivClassPrefArcs(_)).Times(1);
-  graph_manager->UpdateEquivClassNode(ec_node, &node_queue, &marked_nodes);
+  graph_manager->UpdateEquivClassNode(ec_node, NULL, &node_queue,
+                                      &marked_nodes);
   CHECK_EQ(flow_graph.NumArcs(), 0);
 }
 
@@ -767,6 +830,67 @@ TEST_F(FlowGraphManagerTest, UpdateEquivToResArcs) {
   EXPECT_EQ(ec_node->outgoing_arc_map_.size(), 0);
 }
 
+TEST_F(FlowGraphManagerTest, UpdateFlowGraphParallel) {
+  FLAGS_incremental_flow = true;
+  ResourceTopologyNodeDescriptor rtnd;
+  ResourceID_t root_res_id = GenerateResourceID("test");
+  rtnd.mutable_resource_desc()->set_uuid(to_string(root_res_id));
+  rtnd.mutable_resource_desc()->set_type(
+      ResourceDescriptor::RESOURCE_COORDINATOR);
+  for (uint32_t machine_index = 0; machine_index < 4; ++machine_index) {
+    ResourceTopologyNodeDescriptor* rtn_machine = rtnd.add_children();
+    CreateMachine(rtn_machine, "machine" + to_string(machine_index));
+    rtn_machine->set_parent_id(to_string(root_res_id));
+    ResourceTopologyNodeDescriptor* rtn_pu = rtn_machine->add_children();
+    ResourceDescriptor* pu_rd_ptr = rtn_pu->mutable_resource_desc();
+    pu_rd_ptr->set_uuid(to_string(GenerateResourceID(
+        "machine" + to_string(machine_index) + "-pu")));
+    pu_rd_ptr->set_type(ResourceDescriptor::RESOURCE_PU);
+    rtn_pu->set_parent_id(rtn_machine->resource_desc().uuid());
+    InsertIfNotPresent(
+        resource_map_.get(),
+        ResourceIDFromString(rtn_machine->resource_desc().uuid()),
+        new ResourceStatus(rtn_machine->mutable_resource_desc(), rtn_machine,
+                           "", 0));
+    InsertIfNotPresent(resource_map_.get(),
+                       ResourceIDFromString(pu_rd_ptr->uuid()),
+                       new ResourceStatus(pu_rd_ptr, rtn_pu, "", 0));
+  }
+  JobDescriptor test_job;
+  TaskDescriptor* root_td_ptr = CreateTask(&test_job, 42);
+  root_td_ptr->set_state(TaskDescriptor::RUNNABLE);
+  root_td_ptr->set_binary("root");
+  InsertIfNotPresent(task_map_.get(), root_td_ptr->uid(), root_td_ptr);
+  for (uint32_t index = 0; index < 100; ++index) {
+    TaskDescriptor* child_td_ptr = root_td_ptr->add_spawned();
+    child_td_ptr->set_uid(GenerateTaskID(*root_td_ptr));
+    child_td_ptr->set_job_id(root_td_ptr->job_id());
+    child_td_ptr->set_state(TaskDescriptor::RUNNABLE);
+    child_td_ptr->set_binary("child" + to_string(index % 3));
+    InsertIfNotPresent(task_map_.get(), child_td_ptr->uid(), child_td_ptr);
+  }
+  vector<JobDescriptor*> jobs {&test_job};
+  // The serial and the parallel update must make the same graph changes, in
+  // the same order.
+  vector<string> changes[2];
+  for (uint32_t run = 0; run < 2; ++run) {
+    FLAGS_flow_graph_update_threads = run == 0 ? 1 : 4;
+    FlowGraphManager* graph_manager = CreateGraphManagerUsingTrivialCost();
+    graph_manager->AddResourceTopology(&rtnd);
+    graph_manager->graph_change_manager_->ResetChanges();
+    graph_manager->AddOrUpdateJobNodes(jobs);
+    for (auto& change :
+           graph_manager->graph_change_manager_->GetGraphChanges()) {
+      changes[run].push_back(change->GenerateChange());
+    }
+    delete graph_manager;
+  }
+  FLAGS_flow_graph_update_threads = 1;
+  FLAGS_incremental_flow = false;
+  EXPECT_GT(changes[0].size(), 100);
+  EXPECT_EQ(changes[0], changes[1]);
+}
+
 TEST_F(FlowGraphManagerTest, UpdateResourceStatsUpToRoot) {
   FlowGraphManager* graph_manager = CreateGraphManagerUsingTrivialCost();
   ResourceTopologyNodeDescriptor rtnd;
@@ -927,7 +1051,8 @@ TEST_F(FlowGraphManagerTest, UpdateTaskNode) {
   unordered_set<uint64_t> marked_nodes;
   // Tries to update running task but there's no running arc.
   EXPECT_DEATH(
-      graph_manager->UpdateTaskNode(task_node, &node_queue, &marked_nodes), "");
+      graph_manager->UpdateTaskNode(task_node, NULL, &node_queue,
+                                    &marked_nodes), "");
   EXPECT_EQ(flow_graph.NumNodes(), num_nodes + 1);
   EXPECT_EQ(flow_graph.NumArcs(), 0);
   // Updates a runnable task.
@@ -935,12 +1060,12 @@ TEST_F(FlowGraphManagerTest, UpdateTaskNode) {
   EXPECT_CALL(mock_cost_model, TaskToUnscheduledAggCost(_)).Times(1);
   EXPECT_CALL(mock_cost_model, GetTaskPreferenceArcs(_)).Times(1);
   EXPECT_CALL(mock_cost_model, GetTaskEquivClasses(_)).Times(1);
-  graph_manager->UpdateTaskNode(task_node, &node_queue, &marked_nodes);
+  graph_manager->UpdateTaskNode(task_node, NULL, &node_queue, &marked_nodes);
   // The code added an unscheduled aggregator node and an arc to id.
   EXPECT_EQ(flow_graph.NumNodes(), num_nodes + 2);
   EXPECT_EQ(flow_graph.NumArcs(), 1);
-  EXPECT_DEATH(graph_manager->UpdateTaskNode(NULL, &node_queue, &marked_nodes),
-               "");
+  EXPECT_DEATH(graph_manager->UpdateTaskNode(NULL, NULL, &node_queue,
+                                             &marked_nodes), "");
 }
 
 TEST_F(FlowGraphManagerTest, UpdateTaskToEquivArcs) {
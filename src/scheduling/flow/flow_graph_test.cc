@@ -76,6 +76,72 @@ TEST_F(FlowGraphTest, ChangeArc) {
   CHECK_EQ(graph.NumArcs(), num_arcs - 1);
 }
 
+// Delete a node and check its id and arcs are cleaned up and re-used.
+TEST_F(FlowGraphTest, DeleteNodeReusesId) {
+  FlowGraph graph;
+  FlowGraphNode* n0 = graph.AddNode();
+  FlowGraphNode* n1 = graph.AddNode();
+  FlowGraphNode* n2 = graph.AddNode();
+  graph.AddArc(n0, n1);
+  graph.AddArc(n1, n2);
+  graph.AddArc(n0, n2);
+  uint64_t n1_id = n1->id_;
+  graph.DeleteNode(n1);
+  EXPECT_EQ(graph.NumArcs(), 1);
+  EXPECT_EQ(graph.Nodes().size(), 2);
+  EXPECT_EQ(n0->outgoing_arc_map_.size(), 1);
+  EXPECT_EQ(n2->incoming_arc_map_.size(), 1);
+  EXPECT_EQ(n2->incoming_arc_map_.begin()->second->src_, n0->id_);
+  FlowGraphNode* n3 = graph.AddNode();
+  EXPECT_EQ(n3->id_, n1_id);
+  EXPECT_EQ(n3->outgoing_arc_map_.size(), 0);
+  EXPECT_EQ(graph.Nodes().size(), 3);
+}
+
+// Check that the ids of removed nodes are re-used in the order in which the
+// nodes were removed.
+TEST_F(FlowGraphTest, ReuseIdsInRemovalOrder) {
+  FlowGraph graph;
+  FlowGraphNode* n0 = graph.AddNode();
+  FlowGraphNode* n1 = graph.AddNode();
+  FlowGraphNode* n2 = graph.AddNode();
+  uint64_t n0_id = n0->id_;
+  uint64_t n1_id = n1->id_;
+  uint64_t n2_id = n2->id_;
+  graph.DeleteNode(n1);
+  graph.DeleteNode(n0);
+  graph.DeleteNode(n2);
+  EXPECT_EQ(graph.AddNode()->id_, n1_id);
+  EXPECT_EQ(graph.AddNode()->id_, n0_id);
+  EXPECT_EQ(graph.AddNode()->id_, n2_id);
+  EXPECT_EQ(graph.AddNode()->id_, n2_id + 1);
+}
+
+// Check arc lookups and removals on a node with many outgoing arcs.
+TEST_F(FlowGraphTest, HighDegreeNode) {
+  FlowGraph graph;
+  FlowGraphNode* src = graph.AddNode();
+  vector<FlowGraphNode*> dst_nodes;
+  for (uint32_t i = 0; i < 100; ++i) {
+    dst_nodes.push_back(graph.AddNode());
+    graph.AddArc(src, dst_nodes.back());
+  }
+  for (uint32_t i = 0; i < 100; i += 2) {
+    graph.DeleteArc(graph.GetArc(src, dst_nodes[i]));
+  }
+  EXPECT_EQ(graph.NumArcs(), 50);
+  EXPECT_EQ(src->outgoing_arc_map_.size(), 50);
+  for (uint32_t i = 0; i < 100; ++i) {
+    FlowGraphArc* arc = graph.GetArc(src, dst_nodes[i]);
+    if (i % 2 == 0) {
+      EXPECT_TRUE(arc == NULL);
+    } else {
+      CHECK_NOTNULL(arc);
+      EXPECT_EQ(arc->dst_, dst_nodes[i]->id_);
+    }
+  }
+}
+
 }  // namespace firmament
 
 int main(int argc, char **argv) {
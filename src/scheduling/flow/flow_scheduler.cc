@@ -48,6 +48,12 @@ DEFINE_uint64(max_tasks_per_pu, 1,
 DEFINE_string(solver_runtime_accounting_mode, "algorithm",
               "Options: algorithm | solver | firmament. Modes to account for "
               "scheduling duration in simulations");
+DEFINE_bool(pipeline_scheduling_rounds, false, "True if the solver should run "
+            "in the background while the flow graph is updated for the next "
+            "scheduling round. N.B.: the placements of a round are only "
+            "applied by the next call to the scheduler, i.e. they lag by one "
+            "round. Hence, this is only useful for callers that invoke the "
+            "scheduler periodically (e.g., the simulator).");
 
 DECLARE_string(flow_scheduling_solver);
 DECLARE_bool(flowlessly_flip_algorithms);
@@ -81,7 +87,7 @@ FlowScheduler::FlowScheduler(
       leaf_res_ids_(new unordered_set<ResourceID_t,
                       boost::hash<boost::uuids::uuid>>),
       dimacs_stats_(new DIMACSChangeStats),
-      solver_run_cnt_(0) {
+      solver_run_cnt_(0), pipelined_run_start_timestamp_(0) {
   // Select the cost model to use
   VLOG(1) << "Set cost model to use in flow graph to \""
           << FLAGS_flow_scheduling_cost_model << "\"";
@@ -377,16 +383,27 @@ uint64_t FlowScheduler::ScheduleJobs(const vector<JobDescriptor*>& jd_ptr_vect,
   // runnable jobs. However, we also run the scheduler when we've
   // set the flowlessly_flip_algorithms flag in order to speed up
   // simulators and make sure different simulations are synchronous.
-  if (jds_with_runnables.size() > 0 ||
-      (FLAGS_flowlessly_flip_algorithms &&
-       time_manager_->GetCurrentTimestamp() >= SIMULATION_START_TIME)) {
+  bool run_solver = jds_with_runnables.size() > 0 ||
+    (FLAGS_flowlessly_flip_algorithms &&
+     time_manager_->GetCurrentTimestamp() >= SIMULATION_START_TIME);
+  // In pipelined mode, we must also collect the results of the solver run
+  // that is still in flight. N.B.: we only collect them here, even if the run
+  // completed long ago. Applying them from the solver thread would make the
+  // placements race with the changes made by the caller of the scheduler
+  // (e.g., the simulator's event replay).
+  if (run_solver || solver_dispatcher_->run_in_flight()) {
     // First, we update the cost model's resource topology statistics
     // (e.g. based on machine load and prior decisions); these need to be
     // known before AddOrUpdateJobNodes is invoked below, as it may add arcs
     // depending on these metrics.
     UpdateCostModelResourceStats();
     flow_graph_manager_->AddOrUpdateJobNodes(jds_with_runnables);
-    num_scheduled_tasks += RunSchedulingIteration(scheduler_stats, deltas);
+    if (FLAGS_pipeline_scheduling_rounds) {
+      num_scheduled_tasks +=
+        RunPipelinedSchedulingIteration(scheduler_stats, deltas, run_solver);
+    } else {
+      num_scheduled_tasks += RunSchedulingIteration(scheduler_stats, deltas);
+    }
     VLOG(1) << "STOP SCHEDULING, placed " << num_scheduled_tasks << " tasks";
     // If we have cost model debug logging turned on, write some debugging
     // information now.
@@ -395,6 +412,8 @@ uint64_t FlowScheduler::ScheduleJobs(const vector<JobDescriptor*>& jd_ptr_vect,
     }
     // We reset the DIMACS stats here because all the graph changes we make
     // from now on are going to be included in the next scheduler run.
+    VLOG(1) << "DIMACS change allocations (records, arena blocks, node slabs, "
+            << "arc slabs): " << dimacs_stats_->GetAllocationStatsString();
     DIMACSChangeStats current_run_dimacs_stats = *dimacs_stats_;
     dimacs_stats_->ResetStats();
     scheduler_stats->total_runtime_ =
@@ -416,9 +435,7 @@ void FlowScheduler::RegisterResource(ResourceTopologyNodeDescriptor* rtnd_ptr,
   }
 }
 
-uint64_t FlowScheduler::RunSchedulingIteration(
-    SchedulerStats* scheduler_stats,
-    vector<SchedulingDelta>* deltas_output) {
+void FlowScheduler::PrepareSchedulingIteration() {
   // If it's time to revisit time-dependent costs, do so now, just before
   // we run the solver.
   uint64_t cur_time = time_manager_->GetCurrentTimestamp();
@@ -450,10 +467,52 @@ uint64_t FlowScheduler::RunSchedulingIteration(
   }
   pus_removed_during_solver_run_.clear();
   tasks_completed_during_solver_run_.clear();
+}
+
+uint64_t FlowScheduler::RunPipelinedSchedulingIteration(
+    SchedulerStats* scheduler_stats,
+    vector<SchedulingDelta>* deltas_output,
+    bool start_next_run) {
+  uint64_t num_scheduled = 0;
+  if (solver_dispatcher_->run_in_flight()) {
+    // The solver has been running on the previous round's graph while we
+    // updated the graph for this round. Apply its results first; the
+    // placements become graph changes for the run we start below.
+    uint64_t cur_timestamp = time_manager_->GetCurrentTimestamp();
+    multimap<uint64_t, uint64_t>* task_mappings =
+      solver_dispatcher_->FinishRun(scheduler_stats);
+    num_scheduled = ProcessSolverResults(task_mappings,
+                                         pipelined_run_start_timestamp_,
+                                         cur_timestamp, scheduler_stats,
+                                         deltas_output);
+  }
+  if (start_next_run) {
+    PrepareSchedulingIteration();
+    pipelined_run_start_timestamp_ = time_manager_->GetCurrentTimestamp();
+    solver_dispatcher_->StartRun();
+  }
+  return num_scheduled;
+}
+
+uint64_t FlowScheduler::RunSchedulingIteration(
+    SchedulerStats* scheduler_stats,
+    vector<SchedulingDelta>* deltas_output) {
+  PrepareSchedulingIteration();
   uint64_t scheduler_start_timestamp = time_manager_->GetCurrentTimestamp();
   // Run the flow solver! This is where all the juicy goodness happens :)
   multimap<uint64_t, uint64_t>* task_mappings =
     solver_dispatcher_->Run(scheduler_stats);
+  return ProcessSolverResults(task_mappings, scheduler_start_timestamp,
+                              scheduler_start_timestamp, scheduler_stats,
+                              deltas_output);
+}
+
+uint64_t FlowScheduler::ProcessSolverResults(
+    multimap<uint64_t, uint64_t>* task_mappings,
+    uint64_t scheduler_start_timestamp,
+    uint64_t restore_timestamp,
+    SchedulerStats* scheduler_stats,
+    vector<SchedulingDelta>* deltas_output) {
   solver_run_cnt_++;
   CHECK_LE(scheduler_stats->scheduler_runtime_, FLAGS_max_solver_runtime)
     << "Solver took longer than limit of "
@@ -499,7 +558,18 @@ uint64_t FlowScheduler::RunSchedulingIteration(
   flow_graph_manager_->SchedulingDeltasForPreemptedTasks(*task_mappings,
                                                          resource_map_,
                                                          &deltas);
+  // Nodes removed since the solver started may have had their ids re-used.
+  const unordered_set<uint64_t>& removed_node_ids =
+    flow_graph_manager_->flow_graph_change_manager()->removed_node_ids();
   for (it = task_mappings->begin(); it != task_mappings->end(); it++) {
+    if (removed_node_ids.find(it->first) != removed_node_ids.end() ||
+        removed_node_ids.find(it->second) != removed_node_ids.end()) {
+      // The mapping refers to a node that doesn't exist anymore or that
+      // now represents a different task or resource.
+      VLOG(1) << "Node " << it->first << " or " << it->second
+              << " was removed while the solver was running";
+      continue;
+    }
     if (tasks_completed_during_solver_run_.find(it->first) !=
         tasks_completed_during_solver_run_.end()) {
       // Ignore the task because it has already completed while the solver
@@ -560,7 +630,7 @@ uint64_t FlowScheduler::RunSchedulingIteration(
   }
   // Makes sure the deltas get correctly freed.
   deltas.clear();
-  time_manager_->UpdateCurrentTimestamp(scheduler_start_timestamp);
+  time_manager_->UpdateCurrentTimestamp(restore_timestamp);
   if (FLAGS_update_resource_topology_capacities) {
     for (auto& rtnd_ptr : resource_roots_) {
       flow_graph_manager_->UpdateResourceTopology(rtnd_ptr);
@@ -571,11 +641,40 @@ uint64_t FlowScheduler::RunSchedulingIteration(
 
 void FlowScheduler::UpdateCostModelResourceStats() {
   VLOG(2) << "Updating resource statistics in flow graph";
-  flow_graph_manager_->ComputeTopologyStatistics(
-      flow_graph_manager_->sink_node(),
-      boost::bind(&CostModelInterface::PrepareStats, cost_model_, _1),
-      boost::bind(&CostModelInterface::GatherStats, cost_model_, _1, _2),
-      boost::bind(&CostModelInterface::UpdateStats, cost_model_, _1, _2));
+  // We instantiate the traversal for the concrete cost model type so that the
+  // statistics callbacks are not dispatched via virtual calls.
+  switch (FLAGS_flow_scheduling_cost_model) {
+    case CostModelType::COST_MODEL_TRIVIAL:
+      ComputeTopologyStatistics<TrivialCostModel>();
+      break;
+    case CostModelType::COST_MODEL_RANDOM:
+      ComputeTopologyStatistics<RandomCostModel>();
+      break;
+    case CostModelType::COST_MODEL_COCO:
+      ComputeTopologyStatistics<CocoCostModel>();
+      break;
+    case CostModelType::COST_MODEL_SJF:
+      ComputeTopologyStatistics<SJFCostModel>();
+      break;
+    case CostModelType::COST_MODEL_QUINCY:
+      ComputeTopologyStatistics<QuincyCostModel>();
+      break;
+    case CostModelType::COST_MODEL_WHARE:
+      ComputeTopologyStatistics<WhareMapCostModel>();
+      break;
+    case CostModelType::COST_MODEL_OCTOPUS:
+      ComputeTopologyStatistics<OctopusCostModel>();
+      break;
+    case CostModelType::COST_MODEL_VOID:
+      ComputeTopologyStatistics<VoidCostModel>();
+      break;
+    case CostModelType::COST_MODEL_NET:
+      ComputeTopologyStatistics<NetCostModel>();
+      break;
+    default:
+      LOG(FATAL) << "Unknown flow scheduling cost model specificed "
+                 << "(" << FLAGS_flow_scheduling_cost_model << ")";
+  }
 }
 
 }  // namespace scheduler
@@ -97,11 +97,51 @@ class FlowScheduler : public EventDrivenScheduler {
 
  private:
   uint64_t ApplySchedulingDeltas(const vector<SchedulingDelta*>& deltas);
+
+  /**
+   * Computes the resource topology statistics using CostModel's statistics
+   * methods. cost_model_ must be an instance of CostModel.
+   */
+  template <typename CostModel>
+  void ComputeTopologyStatistics() {
+    CostModelStatsVisitor<CostModel> visitor(
+        static_cast<CostModel*>(cost_model_));
+    flow_graph_manager_->ComputeTopologyStatistics(
+        flow_graph_manager_->sink_node(), &visitor);
+  }
+
   void EvictTasksFromResource(ResourceTopologyNodeDescriptor* rtnd_ptr);
   void LogDebugCostModel();
+  void PrepareSchedulingIteration();
+  /**
+   * Generates and applies the scheduling deltas for the task mappings the
+   * solver returned. Mappings of tasks or PUs that have been removed since
+   * the solver started are ignored.
+   * @param scheduler_start_timestamp the time at which the solver started
+   * @param restore_timestamp the time to reset the clock to once the deltas
+   * have been applied
+   * @return the number of tasks placed
+   */
+  uint64_t ProcessSolverResults(multimap<uint64_t, uint64_t>* task_mappings,
+                                uint64_t scheduler_start_timestamp,
+                                uint64_t restore_timestamp,
+                                SchedulerStats* scheduler_stats,
+                                vector<SchedulingDelta>* deltas_output);
   TaskDescriptor* ProducingTaskForDataObjectID(DataObjectID_t id);
   void RegisterLocalResource(ResourceID_t res_id);
   void RegisterRemoteResource(ResourceID_t res_id);
+  /**
+   * Pipelined version of RunSchedulingIteration. Applies the results of the
+   * solver run started in the previous round, and starts a new run in the
+   * background. The placements of a run thus only take effect in the round
+   * after the one that started it, once the scheduler is invoked again.
+   * @param start_next_run true if a new solver run should be started
+   * @return the number of tasks placed by the previous round's run
+   */
+  uint64_t RunPipelinedSchedulingIteration(
+      SchedulerStats* scheduler_stats,
+      vector<SchedulingDelta>* deltas_output,
+      bool start_next_run);
   uint64_t RunSchedulingIteration(SchedulerStats* scheduler_stats,
                                   vector<SchedulingDelta>* deltas_output);
   void UpdateCostModelResourceStats();
@@ -129,6 +169,9 @@ class FlowScheduler : public EventDrivenScheduler {
   set<uint64_t> tasks_completed_during_solver_run_;
   DIMACSChangeStats* dimacs_stats_;
   uint64_t solver_run_cnt_;
+  // Time at which the solver run in flight was started (only used when
+  // scheduling rounds are pipelined).
+  uint64_t pipelined_run_start_timestamp_;
   unordered_set<ResourceTopologyNodeDescriptor*> resource_roots_;
 };
 
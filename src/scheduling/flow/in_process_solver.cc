@@ -0,0 +1,294 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "scheduling/flow/in_process_solver.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <boost/timer/timer.hpp>
+
+#include "base/units.h"
+
+namespace firmament {
+
+// Used as the distance of nodes that have not been reached. It is smaller
+// than the maximum int64_t value so that adding an arc cost to it does not
+// overflow.
+static const int64_t kInfinity = numeric_limits<int64_t>::max() / 4;
+
+InProcessSolver::InProcessSolver() : source_(0), target_(0), num_nodes_(0) {
+}
+
+vector<unordered_map<uint64_t, uint64_t>>* InProcessSolver::Solve(
+    const FlowGraph& graph,
+    uint64_t* algorithm_runtime) {
+  boost::timer::cpu_timer algorithm_timer;
+  BuildResidualNetwork(graph);
+  int64_t total_supply = 0;
+  for (uint32_t arc = first_arc_[source_]; arc < first_arc_[source_ + 1];
+       ++arc) {
+    total_supply += arc_capacity_[arc];
+  }
+  InitializePotentials();
+  int64_t total_flow = 0;
+  // Each iteration computes the shortest paths from the super source in the
+  // residual network and then saturates all the shortest paths to the super
+  // sink. The algorithm terminates when the super sink is not reachable.
+  while (UpdatePotentials()) {
+    while (BuildAdmissibleLevels()) {
+      int64_t pushed_flow = 0;
+      while ((pushed_flow = AugmentFlow(source_, kInfinity)) > 0) {
+        total_flow += pushed_flow;
+      }
+    }
+  }
+  if (total_flow != total_supply) {
+    LOG(FATAL) << "Flow network is infeasible: could only route "
+               << total_flow << " out of " << total_supply << " flow units";
+  }
+  vector<unordered_map<uint64_t, uint64_t>>* extracted_flow =
+    ExtractFlow(graph);
+  *algorithm_runtime =
+    static_cast<uint64_t>(algorithm_timer.elapsed().wall) /
+    NANOSECONDS_IN_MICROSECOND;
+  VLOG(1) << "In-process solver routed " << total_flow << " flow units in "
+          << *algorithm_runtime << " u-sec";
+  return extracted_flow;
+}
+
+void InProcessSolver::AddResidualArc(uint32_t src, uint32_t dst,
+                                     int64_t capacity, int64_t cost,
+                                     const FlowGraphArc* arc) {
+  uint32_t forward_arc = next_free_arc_[src]++;
+  uint32_t reverse_arc = next_free_arc_[dst]++;
+  arc_tail_[forward_arc] = src;
+  arc_head_[forward_arc] = dst;
+  arc_reverse_[forward_arc] = reverse_arc;
+  arc_capacity_[forward_arc] = capacity;
+  arc_residual_[forward_arc] = capacity;
+  arc_cost_[forward_arc] = cost;
+  arc_origin_[forward_arc] = arc;
+  arc_tail_[reverse_arc] = dst;
+  arc_head_[reverse_arc] = src;
+  arc_reverse_[reverse_arc] = forward_arc;
+  arc_capacity_[reverse_arc] = 0;
+  arc_residual_[reverse_arc] = 0;
+  arc_cost_[reverse_arc] = -cost;
+  arc_origin_[reverse_arc] = NULL;
+}
+
+int64_t InProcessSolver::AugmentFlow(uint32_t node, int64_t flow_limit) {
+  if (node == target_) {
+    return flow_limit;
+  }
+  // current_arc_ makes sure that we do not re-examine arcs that can't
+  // carry any more flow in the current blocking flow computation.
+  for (uint32_t& arc = current_arc_[node]; arc < first_arc_[node + 1];
+       ++arc) {
+    uint32_t head = arc_head_[arc];
+    if (arc_residual_[arc] > 0 && level_[head] == level_[node] + 1 &&
+        ReducedCost(arc) == 0) {
+      int64_t pushed_flow =
+        AugmentFlow(head, min(flow_limit, arc_residual_[arc]));
+      if (pushed_flow > 0) {
+        arc_residual_[arc] -= pushed_flow;
+        arc_residual_[arc_reverse_[arc]] += pushed_flow;
+        return pushed_flow;
+      }
+    }
+  }
+  return 0;
+}
+
+bool InProcessSolver::BuildAdmissibleLevels() {
+  // Breadth-first search over the admissible arcs (i.e., arcs with residual
+  // capacity and zero reduced cost).
+  level_.assign(num_nodes_, -1);
+  current_arc_.assign(first_arc_.begin(), first_arc_.end() - 1);
+  queue<uint32_t> to_visit;
+  level_[source_] = 0;
+  to_visit.push(source_);
+  while (!to_visit.empty()) {
+    uint32_t node = to_visit.front();
+    to_visit.pop();
+    for (uint32_t arc = first_arc_[node]; arc < first_arc_[node + 1]; ++arc) {
+      uint32_t head = arc_head_[arc];
+      if (level_[head] < 0 && arc_residual_[arc] > 0 &&
+          ReducedCost(arc) == 0) {
+        level_[head] = level_[node] + 1;
+        to_visit.push(head);
+      }
+    }
+  }
+  return level_[target_] >= 0;
+}
+
+void InProcessSolver::BuildResidualNetwork(const FlowGraph& graph) {
+  // We index the residual network nodes directly by flow graph node id. The
+  // node ids are dense (removed ids are reused), so the few holes don't cost
+  // us much.
+  uint64_t max_node_id = 0;
+  for (const auto& node : graph.Nodes()) {
+    max_node_id = max(max_node_id, node->id_);
+  }
+  CHECK_LT(max_node_id + 3, numeric_limits<uint32_t>::max());
+  source_ = static_cast<uint32_t>(max_node_id + 1);
+  target_ = static_cast<uint32_t>(max_node_id + 2);
+  num_nodes_ = static_cast<uint32_t>(max_node_id + 3);
+  excess_.assign(num_nodes_, 0);
+  for (const auto& node : graph.Nodes()) {
+    excess_[node->id_] = node->excess_;
+  }
+  // Count the number of residual arcs out of every node. We remove the lower
+  // bound from every arc by forcing the flow through the arc and adjusting
+  // the excess of its endpoints accordingly.
+  first_arc_.assign(num_nodes_ + 1, 0);
+  for (const auto& arc : graph.Arcs()) {
+    CHECK_GE(arc->cap_upper_bound_, arc->cap_lower_bound_);
+    int64_t lower_bound = static_cast<int64_t>(arc->cap_lower_bound_);
+    excess_[arc->src_] -= lower_bound;
+    excess_[arc->dst_] += lower_bound;
+    first_arc_[arc->src_ + 1]++;
+    first_arc_[arc->dst_ + 1]++;
+  }
+  for (uint32_t node = 0; node < source_; ++node) {
+    if (excess_[node] > 0) {
+      first_arc_[source_ + 1]++;
+      first_arc_[node + 1]++;
+    } else if (excess_[node] < 0) {
+      first_arc_[node + 1]++;
+      first_arc_[target_ + 1]++;
+    }
+  }
+  for (uint32_t node = 0; node < num_nodes_; ++node) {
+    first_arc_[node + 1] += first_arc_[node];
+  }
+  uint32_t num_arcs = first_arc_[num_nodes_];
+  arc_tail_.resize(num_arcs);
+  arc_head_.resize(num_arcs);
+  arc_reverse_.resize(num_arcs);
+  arc_capacity_.resize(num_arcs);
+  arc_residual_.resize(num_arcs);
+  arc_cost_.resize(num_arcs);
+  arc_origin_.resize(num_arcs);
+  next_free_arc_.assign(first_arc_.begin(), first_arc_.end() - 1);
+  for (const auto& arc : graph.Arcs()) {
+    AddResidualArc(static_cast<uint32_t>(arc->src_),
+                   static_cast<uint32_t>(arc->dst_),
+                   static_cast<int64_t>(arc->cap_upper_bound_ -
+                                        arc->cap_lower_bound_),
+                   arc->cost_, arc);
+  }
+  for (uint32_t node = 0; node < source_; ++node) {
+    if (excess_[node] > 0) {
+      AddResidualArc(source_, node, excess_[node], 0, NULL);
+    } else if (excess_[node] < 0) {
+      AddResidualArc(node, target_, -excess_[node], 0, NULL);
+    }
+  }
+}
+
+vector<unordered_map<uint64_t, uint64_t>>* InProcessSolver::ExtractFlow(
+    const FlowGraph& graph) {
+  vector<unordered_map<uint64_t, uint64_t>>* extracted_flow =
+    new vector<unordered_map<uint64_t, uint64_t>>(
+        max(graph.NumNodes() + 1, static_cast<uint64_t>(source_)));
+  for (uint32_t arc = 0; arc < first_arc_[num_nodes_]; ++arc) {
+    const FlowGraphArc* flow_arc = arc_origin_[arc];
+    if (!flow_arc) {
+      continue;
+    }
+    uint64_t flow = flow_arc->cap_lower_bound_ +
+      static_cast<uint64_t>(arc_capacity_[arc] - arc_residual_[arc]);
+    if (flow > 0) {
+      (*extracted_flow)[flow_arc->dst_].insert(make_pair(flow_arc->src_,
+                                                         flow));
+    }
+  }
+  return extracted_flow;
+}
+
+void InProcessSolver::InitializePotentials() {
+  // The flow graph can have arcs with negative costs. Hence, we use
+  // Bellman-Ford (queue-based) to compute initial potentials that give
+  // non-negative reduced costs on all the arcs with residual capacity.
+  potential_.assign(num_nodes_, kInfinity);
+  vector<bool> in_queue(num_nodes_, false);
+  vector<uint32_t> num_relaxations(num_nodes_, 0);
+  queue<uint32_t> to_visit;
+  potential_[source_] = 0;
+  to_visit.push(source_);
+  in_queue[source_] = true;
+  while (!to_visit.empty()) {
+    uint32_t node = to_visit.front();
+    to_visit.pop();
+    in_queue[node] = false;
+    for (uint32_t arc = first_arc_[node]; arc < first_arc_[node + 1]; ++arc) {
+      uint32_t head = arc_head_[arc];
+      if (arc_residual_[arc] > 0 &&
+          potential_[node] + arc_cost_[arc] < potential_[head]) {
+        potential_[head] = potential_[node] + arc_cost_[arc];
+        CHECK_LT(++num_relaxations[head], num_nodes_)
+          << "Flow graph contains a negative cost cycle";
+        if (!in_queue[head]) {
+          to_visit.push(head);
+          in_queue[head] = true;
+        }
+      }
+    }
+  }
+  // Nodes that are not reachable from the super source can never get any
+  // flow. Their potential does not matter.
+  for (auto& node_potential : potential_) {
+    if (node_potential == kInfinity) {
+      node_potential = 0;
+    }
+  }
+}
+
+bool InProcessSolver::UpdatePotentials() {
+  // Dijkstra on the reduced costs. We stop as soon as the super sink is
+  // settled; the unsettled nodes get their potential increased by the
+  // distance to the super sink, which keeps all reduced costs non-negative.
+  distance_.assign(num_nodes_, kInfinity);
+  settled_.assign(num_nodes_, false);
+  priority_queue<pair<int64_t, uint32_t>, vector<pair<int64_t, uint32_t>>,
+                 greater<pair<int64_t, uint32_t>>> to_visit;
+  distance_[source_] = 0;
+  to_visit.push(make_pair(0, source_));
+  while (!to_visit.empty()) {
+    uint32_t node = to_visit.top().second;
+    to_visit.pop();
+    if (settled_[node]) {
+      continue;
+    }
+    settled_[node] = true;
+    if (node == target_) {
+      break;
+    }
+    for (uint32_t arc = first_arc_[node]; arc < first_arc_[node + 1]; ++arc) {
+      uint32_t head = arc_head_[arc];
+      if (arc_residual_[arc] > 0 && !settled_[head]) {
+        int64_t head_distance = distance_[node] + ReducedCost(arc);
+        if (head_distance < distance_[head]) {
+          distance_[head] = head_distance;
+          to_visit.push(make_pair(head_distance, head));
+        }
+      }
+    }
+  }
+  if (!settled_[target_]) {
+    return false;
+  }
+  int64_t target_distance = distance_[target_];
+  for (uint32_t node = 0; node < num_nodes_; ++node) {
+    potential_[node] += settled_[node] ? distance_[node] : target_distance;
+  }
+  return true;
+}
+
+}  // namespace firmament
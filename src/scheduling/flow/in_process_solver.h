@@ -0,0 +1,87 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// In-process min-cost flow solver. Unlike the external solvers (cs2,
+// Flowlessly), it reads the FlowGraph directly and hence avoids exporting the
+// graph as DIMACS, forking a solver process and parsing its output.
+//
+// The solver implements the primal-dual algorithm: it computes shortest paths
+// in the residual network using Dijkstra with node potentials, and then pushes
+// a blocking flow (a la Dinic) along all the arcs that have zero reduced cost.
+
+#ifndef FIRMAMENT_SCHEDULING_FLOW_IN_PROCESS_SOLVER_H
+#define FIRMAMENT_SCHEDULING_FLOW_IN_PROCESS_SOLVER_H
+
+#include <vector>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "scheduling/flow/flow_graph.h"
+
+namespace firmament {
+
+class InProcessSolver {
+ public:
+  InProcessSolver();
+
+  /**
+   * Computes a min-cost flow for the graph.
+   * @param graph the flow graph to solve
+   * @param algorithm_runtime set to the time (in u-sec) the algorithm took
+   * @return vector indexed by node id that contains, for every node, the
+   * incoming arcs with positive flow keyed by source node id. This is the
+   * same representation SolverDispatcher builds from the external solvers'
+   * output. The caller owns the returned vector.
+   */
+  vector<unordered_map<uint64_t, uint64_t>>* Solve(
+      const FlowGraph& graph,
+      uint64_t* algorithm_runtime);
+
+ private:
+  void AddResidualArc(uint32_t src, uint32_t dst, int64_t capacity,
+                      int64_t cost, const FlowGraphArc* arc);
+  int64_t AugmentFlow(uint32_t node, int64_t flow_limit);
+  bool BuildAdmissibleLevels();
+  void BuildResidualNetwork(const FlowGraph& graph);
+  vector<unordered_map<uint64_t, uint64_t>>* ExtractFlow(
+      const FlowGraph& graph);
+  void InitializePotentials();
+  inline int64_t ReducedCost(uint32_t arc) const {
+    return arc_cost_[arc] + potential_[arc_tail_[arc]] -
+      potential_[arc_head_[arc]];
+  }
+  bool UpdatePotentials();
+
+  // Index of the super source and super sink in the residual network. The
+  // super source connects to all the nodes that have supply (e.g., tasks) and
+  // the super sink is connected to all the nodes that have demand (e.g., the
+  // sink).
+  uint32_t source_;
+  uint32_t target_;
+  uint32_t num_nodes_;
+  // Residual network in compressed sparse row form. The outgoing arcs of node
+  // n are stored in [first_arc_[n], first_arc_[n + 1]). The vectors are reused
+  // across solver runs to avoid re-allocating them every round.
+  vector<uint32_t> first_arc_;
+  vector<uint32_t> next_free_arc_;
+  vector<uint32_t> arc_tail_;
+  vector<uint32_t> arc_head_;
+  vector<uint32_t> arc_reverse_;
+  vector<int64_t> arc_capacity_;
+  vector<int64_t> arc_residual_;
+  vector<int64_t> arc_cost_;
+  // Flow graph arc each forward residual arc corresponds to (NULL for reverse
+  // arcs and for the arcs adjacent to the super source and super sink).
+  vector<const FlowGraphArc*> arc_origin_;
+  // Per-node algorithm state.
+  vector<int64_t> excess_;
+  vector<int64_t> potential_;
+  vector<int64_t> distance_;
+  vector<int32_t> level_;
+  vector<uint32_t> current_arc_;
+  vector<bool> settled_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_FLOW_IN_PROCESS_SOLVER_H
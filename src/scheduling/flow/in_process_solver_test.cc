@@ -0,0 +1,109 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the in-process min-cost flow solver.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "base/common.h"
+#include "scheduling/flow/flow_graph.h"
+#include "scheduling/flow/in_process_solver.h"
+
+namespace firmament {
+
+// The fixture for testing the InProcessSolver class.
+class InProcessSolverTest : public ::testing::Test {
+ protected:
+  InProcessSolverTest() {
+    FLAGS_v = 2;
+  }
+
+  // Builds a graph with two tasks that can each be placed on one of two PUs
+  // or be left unscheduled.
+  void BuildTwoTaskGraph(FlowGraph* graph) {
+    sink_ = graph->AddNode();
+    sink_->excess_ = -2;
+    unsched_agg_ = graph->AddNode();
+    pu0_ = graph->AddNode();
+    pu1_ = graph->AddNode();
+    task0_ = graph->AddNode();
+    task0_->excess_ = 1;
+    task1_ = graph->AddNode();
+    task1_->excess_ = 1;
+    graph->ChangeArc(graph->AddArc(unsched_agg_, sink_), 0, 2, 0);
+    graph->ChangeArc(graph->AddArc(pu0_, sink_), 0, 1, 0);
+    graph->ChangeArc(graph->AddArc(pu1_, sink_), 0, 1, 0);
+    graph->ChangeArc(graph->AddArc(task0_, unsched_agg_), 0, 1, 100);
+    graph->ChangeArc(graph->AddArc(task1_, unsched_agg_), 0, 1, 100);
+    graph->ChangeArc(graph->AddArc(task0_, pu0_), 0, 1, 1);
+    graph->ChangeArc(graph->AddArc(task0_, pu1_), 0, 1, 5);
+    graph->ChangeArc(graph->AddArc(task1_, pu0_), 0, 1, 2);
+    graph->ChangeArc(graph->AddArc(task1_, pu1_), 0, 1, 3);
+  }
+
+  FlowGraphNode* sink_;
+  FlowGraphNode* unsched_agg_;
+  FlowGraphNode* pu0_;
+  FlowGraphNode* pu1_;
+  FlowGraphNode* task0_;
+  FlowGraphNode* task1_;
+};
+
+TEST_F(InProcessSolverTest, MinCostAssignment) {
+  FlowGraph graph;
+  BuildTwoTaskGraph(&graph);
+  InProcessSolver solver;
+  uint64_t algorithm_runtime = 0;
+  vector<unordered_map<uint64_t, uint64_t>>* flow =
+    solver.Solve(graph, &algorithm_runtime);
+  // Cost 1 + 3 is cheaper than 5 + 2.
+  EXPECT_EQ(1, FindWithDefault((*flow)[pu0_->id_], task0_->id_, 0));
+  EXPECT_EQ(1, FindWithDefault((*flow)[pu1_->id_], task1_->id_, 0));
+  EXPECT_EQ(0, FindWithDefault((*flow)[pu1_->id_], task0_->id_, 0));
+  EXPECT_EQ(0, FindWithDefault((*flow)[pu0_->id_], task1_->id_, 0));
+  EXPECT_EQ(0, (*flow)[unsched_agg_->id_].size());
+  EXPECT_EQ(1, FindWithDefault((*flow)[sink_->id_], pu0_->id_, 0));
+  EXPECT_EQ(1, FindWithDefault((*flow)[sink_->id_], pu1_->id_, 0));
+  delete flow;
+}
+
+TEST_F(InProcessSolverTest, LowerBoundForcesAssignment) {
+  FlowGraph graph;
+  BuildTwoTaskGraph(&graph);
+  // Pin task0 to pu1 as if it were running there.
+  graph.ChangeArc(graph.GetArc(task0_, pu1_), 1, 1, 5);
+  InProcessSolver solver;
+  uint64_t algorithm_runtime = 0;
+  vector<unordered_map<uint64_t, uint64_t>>* flow =
+    solver.Solve(graph, &algorithm_runtime);
+  EXPECT_EQ(1, FindWithDefault((*flow)[pu1_->id_], task0_->id_, 0));
+  EXPECT_EQ(1, FindWithDefault((*flow)[pu0_->id_], task1_->id_, 0));
+  EXPECT_EQ(0, FindWithDefault((*flow)[pu0_->id_], task0_->id_, 0));
+  delete flow;
+}
+
+TEST_F(InProcessSolverTest, UnscheduledWhenCheaper) {
+  FlowGraph graph;
+  BuildTwoTaskGraph(&graph);
+  // Only one PU is left and task1 prefers to stay unscheduled rather than
+  // displace task0.
+  graph.DeleteArc(graph.GetArc(pu1_, sink_));
+  graph.ChangeArc(graph.GetArc(task1_, unsched_agg_), 0, 1, 50);
+  InProcessSolver solver;
+  uint64_t algorithm_runtime = 0;
+  vector<unordered_map<uint64_t, uint64_t>>* flow =
+    solver.Solve(graph, &algorithm_runtime);
+  EXPECT_EQ(1, FindWithDefault((*flow)[pu0_->id_], task0_->id_, 0));
+  EXPECT_EQ(1, FindWithDefault((*flow)[unsched_agg_->id_], task1_->id_, 0));
+  EXPECT_EQ(1, FindWithDefault((*flow)[sink_->id_], unsched_agg_->id_, 0));
+  delete flow;
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
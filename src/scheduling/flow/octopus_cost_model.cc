@@ -193,4 +193,8 @@ FlowGraphNode* OctopusCostModel::UpdateStats(FlowGraphNode* accumulator,
   return accumulator;
 }
 
+bool OctopusCostModel::SupportsConcurrentQueries() const {
+  return true;
+}
+
 }  // namespace firmament
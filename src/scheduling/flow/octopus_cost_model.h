@@ -50,6 +50,7 @@ class OctopusCostModel : public CostModelInterface {
   FlowGraphNode* GatherStats(FlowGraphNode* accumulator, FlowGraphNode* other);
   void PrepareStats(FlowGraphNode* accumulator);
   FlowGraphNode* UpdateStats(FlowGraphNode* accumulator, FlowGraphNode* other);
+  bool SupportsConcurrentQueries() const;
 
  private:
   // Cost to cluster aggregator EC
@@ -127,29 +127,32 @@ Cost_t QuincyCostModel::TaskToResourceNodeCost(TaskID_t task_id,
 Cost_t QuincyCostModel::GetTransferCostToNotPreferredRes(
     TaskID_t task_id,
     ResourceID_t res_id) {
-  pair<ResourceID_t, Cost_t>* machine_transfer_cost =
-    FindOrNull(task_running_arcs_, task_id);
-  if (!machine_transfer_cost || machine_transfer_cost->first != res_id) {
-    // The running arc did not exist previously or was pointing to a
-    // different resource.
-    TaskDescriptor* td_ptr = GetMutableTask(task_id);
-    ResourceID_t machine_res_id =
-      MachineResIDForResource(resource_map_, res_id);
-    uint64_t data_on_rack = 0;
-    uint64_t data_on_machine = 0;
-    uint64_t input_size =
-      ComputeDataStatsForMachine(td_ptr, machine_res_id, &data_on_rack,
-                                 &data_on_machine);
-    Cost_t transfer_cost =
-      ComputeTransferCostToMachine(input_size - data_on_machine,
-                                   data_on_rack - data_on_machine);
-    // Cache the transfer cost.
-    InsertOrUpdate(&task_running_arcs_, task_id,
-                   pair<ResourceID_t, Cost_t>(res_id, transfer_cost));
-    return transfer_cost;
-  } else {
-    return machine_transfer_cost->second;
+  {
+    boost::lock_guard<boost::mutex> lock(task_running_arcs_lock_);
+    pair<ResourceID_t, Cost_t>* machine_transfer_cost =
+      FindOrNull(task_running_arcs_, task_id);
+    if (machine_transfer_cost && machine_transfer_cost->first == res_id) {
+      return machine_transfer_cost->second;
+    }
   }
+  // The running arc did not exist previously or was pointing to a different
+  // resource.
+  TaskDescriptor* td_ptr = GetMutableTask(task_id);
+  ResourceID_t machine_res_id =
+    MachineResIDForResource(resource_map_, res_id);
+  uint64_t data_on_rack = 0;
+  uint64_t data_on_machine = 0;
+  uint64_t input_size =
+    ComputeDataStatsForMachine(td_ptr, machine_res_id, &data_on_rack,
+                               &data_on_machine);
+  Cost_t transfer_cost =
+    ComputeTransferCostToMachine(input_size - data_on_machine,
+                                 data_on_rack - data_on_machine);
+  // Cache the transfer cost.
+  boost::lock_guard<boost::mutex> lock(task_running_arcs_lock_);
+  InsertOrUpdate(&task_running_arcs_, task_id,
+                 pair<ResourceID_t, Cost_t>(res_id, transfer_cost));
+  return transfer_cost;
 }
 
 Cost_t QuincyCostModel::ResourceNodeToResourceNodeCost(
@@ -385,6 +388,10 @@ FlowGraphNode* QuincyCostModel::UpdateStats(FlowGraphNode* accumulator,
   return accumulator;
 }
 
+bool QuincyCostModel::SupportsConcurrentQueries() const {
+  return true;
+}
+
 uint64_t QuincyCostModel::ComputeClusterDataStatistics(
     TaskDescriptor* td_ptr,
     unordered_map<ResourceID_t, uint64_t,
@@ -12,6 +12,7 @@
 #include <unordered_map>
 #include <utility>
 #include <vector>
+#include <boost/thread/mutex.hpp>
 
 #include "base/common.h"
 #include "base/types.h"
@@ -69,6 +70,7 @@ class QuincyCostModel : public CostModelInterface {
   FlowGraphNode* GatherStats(FlowGraphNode* accumulator, FlowGraphNode* other);
   void PrepareStats(FlowGraphNode* accumulator);
   FlowGraphNode* UpdateStats(FlowGraphNode* accumulator, FlowGraphNode* other);
+  bool SupportsConcurrentQueries() const;
 
  private:
   uint64_t ComputeClusterDataStatistics(
@@ -189,7 +191,11 @@ class QuincyCostModel : public CostModelInterface {
     unordered_map<ResourceID_t, Cost_t, boost::hash<ResourceID_t>>>
     task_preferred_machines_;
   // Map storing the data transfer cost and the resource for each running task.
+  // The map is a cache that TaskToResourceNodeCost may update, which can be
+  // called concurrently for different tasks; task_running_arcs_lock_ protects
+  // it.
   unordered_map<TaskID_t, pair<ResourceID_t, Cost_t>> task_running_arcs_;
+  boost::mutex task_running_arcs_lock_;
   TraceGenerator* trace_generator_;
   TimeInterface* time_manager_;
   DataLayerManagerInterface* data_layer_manager_;
@@ -235,4 +235,8 @@ FlowGraphNode* SJFCostModel::UpdateStats(FlowGraphNode* accumulator,
   return accumulator;
 }
 
+bool SJFCostModel::SupportsConcurrentQueries() const {
+  return true;
+}
+
 }  // namespace firmament
@@ -60,6 +60,7 @@ class SJFCostModel : public CostModelInterface {
   FlowGraphNode* GatherStats(FlowGraphNode* accumulator, FlowGraphNode* other);
   void PrepareStats(FlowGraphNode* accumulator);
   FlowGraphNode* UpdateStats(FlowGraphNode* accumulator, FlowGraphNode* other);
+  bool SupportsConcurrentQueries() const;
 
  private:
   const TaskDescriptor& GetTask(TaskID_t task_id);
@@ -5,6 +5,7 @@
 
 #include <sys/stat.h>
 #include <pthread.h>
+#include <signal.h>
 #include <utility>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -14,13 +15,16 @@
 #include "base/units.h"
 #include "misc/string_utils.h"
 #include "misc/utils.h"
+#include "scheduling/flow/binary_wire_format.h"
 
 DEFINE_bool(debug_flow_graph, false, "Write out a debug copy of the scheduling"
             " flow graph to the debug directory.");
 DEFINE_string(flow_scheduling_solver, "cs2",
               "Solver to use for flow network optimization. Possible values:"
               "\"cs2\": Goldberg solver, \"flowlessly\": local Flowlessly "
-              "solver reimplementation; \"custom\": specify custom solver. "
+              "solver reimplementation; \"inprocess\": min-cost flow solver "
+              "linked into Firmament (no graph export or solver process); "
+              "\"custom\": specify custom solver. "
               "with -flow_scheduling_binary and -flow_scheduling_args.");
 DEFINE_string(flow_scheduling_binary, "", "Path to flow solving executable. "
               "If specified, overrides default path. "
@@ -28,6 +32,10 @@ DEFINE_string(flow_scheduling_binary, "", "Path to flow solving executable. "
 DEFINE_string(custom_flow_scheduling_args, "", "Arguments for custom solver. "
               "Defaults to no arguments.");
 DEFINE_bool(incremental_flow, false, "Generate incremental graph changes.");
+DEFINE_string(flow_graph_wire_format, "dimacs", "Format used to send the flow "
+              "graph to the solver and to read the flows back. Options: "
+              "dimacs | binary. The binary format requires a custom solver "
+              "that speaks the protocol described in binary_wire_format.h.");
 DEFINE_bool(only_read_assignment_changes, false, "Read only changes in task"
             " assignments.");
 DEFINE_string(flowlessly_binary,
@@ -52,6 +60,9 @@ DEFINE_bool(flowlessly_run_cost_scaling_and_relax, false, "True if Flowlessly "
             "should run both algorithms");
 DEFINE_int64(flowlessly_alpha_factor, 9, "Alpha factor to be used by "
              "Flowlessly's cost scaling");
+DEFINE_uint64(max_solver_restarts, 3, "Number of times the solver is "
+              "restarted in a scheduling round after it crashes before we give "
+              "up. The restarted solver is sent the full flow graph.");
 
 namespace firmament {
 namespace scheduler {
@@ -66,7 +77,12 @@ SolverDispatcher::SolverDispatcher(
   : flow_graph_manager_(flow_graph_manager),
     solver_ran_once_(solver_ran_once),
     debug_seq_num_(0), to_solver_(NULL), from_solver_(NULL),
-    from_solver_stderr_(NULL) {
+    from_solver_stderr_(NULL), solver_pid_(0),
+    solver_logger_thread_(static_cast<pthread_t>(-1)),
+    solver_write_failed_(false), graph_export_runtime_(0),
+    run_in_flight_(false), solver_thread_(NULL), run_solver_failed_(false),
+    snapshot_num_nodes_(0), run_task_mappings_(NULL),
+    run_extracted_flow_(NULL) {
   // Set up debug directory if it doesn't exist
   struct stat st;
   if (!FLAGS_debug_output_dir.empty() &&
@@ -82,11 +98,17 @@ SolverDispatcher::SolverDispatcher(
 }
 
 SolverDispatcher::~SolverDispatcher() {
+  if (run_in_flight_) {
+    delete FinishRun(NULL);
+  }
   if (to_solver_ != NULL) {
-    // Print EOS to Make sure the solver closes gracefully when running
-    // in daemon mode.
-    fprintf(to_solver_, "c EOS\n");
-    fflush(to_solver_);
+    if (FLAGS_flow_graph_wire_format == "dimacs") {
+      // Print EOS to Make sure the solver closes gracefully when running
+      // in daemon mode. Solvers using the binary format just see the end of
+      // the stream.
+      fprintf(to_solver_, "c EOS\n");
+      fflush(to_solver_);
+    }
     CHECK_EQ(fclose(to_solver_), 0);
   }
   if (from_solver_ != NULL) {
@@ -104,17 +126,26 @@ void SolverDispatcher::ExportJSON(string* output) const {
 
 void *ExportToSolver(void *x) {
   SolverDispatcher* solver_dispatcher = reinterpret_cast<SolverDispatcher*>(x);
-  solver_dispatcher->ExportGraph(solver_dispatcher->to_solver_);
+  boost::timer::cpu_timer export_timer;
+  bool exported = solver_dispatcher->ExportGraph(solver_dispatcher->to_solver_);
   solver_dispatcher->flow_graph_manager_->
     flow_graph_change_manager()->ResetChanges();
-  if (fflush(solver_dispatcher->to_solver_)) {
-    PLOG(FATAL) << "Error while flushing";
+  if (!exported || fflush(solver_dispatcher->to_solver_)) {
+    // The solver has most likely crashed. The reader notices it as well, and
+    // the solver is restarted.
+    PLOG(WARNING) << "Error while sending the graph to the solver";
+    solver_dispatcher->solver_write_failed_ = true;
   }
   if (!FLAGS_incremental_flow) {
     // We need to close the stream because that's what cs expects.
-    CHECK_EQ(fclose(solver_dispatcher->to_solver_), 0);
+    if (fclose(solver_dispatcher->to_solver_)) {
+      solver_dispatcher->solver_write_failed_ = true;
+    }
     solver_dispatcher->to_solver_ = NULL;
   }
+  solver_dispatcher->graph_export_runtime_ =
+    static_cast<uint64_t>(export_timer.elapsed().wall) /
+    NANOSECONDS_IN_MICROSECOND;
   return NULL;
 }
 
@@ -129,25 +160,32 @@ void *ProcessStderrJustlog(void *x) {
   return NULL;
 }
 
-void SolverDispatcher::ExportGraph(FILE* stream) {
+bool SolverDispatcher::ExportGraph(FILE* stream) {
   // Note dimacs_exporter_ is the full graph iff solver is running for the first
   // time, or is non-incremental. Otherwise, dimacs_exporter_ is the incremental
   // delta.
   FlowGraphChangeManager* change_manager =
     flow_graph_manager_->flow_graph_change_manager();
+  bool binary_format = FLAGS_flow_graph_wire_format == "binary";
   if (solver_ran_once_ && FLAGS_incremental_flow) {
+    if (binary_format) {
+      return binary_exporter_.ExportIncremental(
+          change_manager->GetOptimizedGraphChanges(), stream);
+    }
     dimacs_exporter_.ExportIncremental(
         change_manager->GetOptimizedGraphChanges(), stream);
-  }
-  if (!solver_ran_once_ || !FLAGS_incremental_flow) {
+  } else {
     // Always export full flow graph when running first time. If algorithm
     // is non-incremental, must do it for subsequent iterations too.
+    if (binary_format) {
+      return binary_exporter_.Export(change_manager->flow_graph(), stream);
+    }
     dimacs_exporter_.Export(change_manager->flow_graph(), stream);
   }
+  return !ferror(stream);
 }
 
-multimap<uint64_t, uint64_t>* SolverDispatcher::Run(
-    SchedulerStats* scheduler_stats) {
+void SolverDispatcher::PrepareRun() {
   // Adjusts the costs on the arcs from tasks to unsched aggs.
   if (solver_ran_once_) {
     flow_graph_manager_->UpdateAllCostsToUnscheduledAggs();
@@ -180,106 +218,327 @@ multimap<uint64_t, uint64_t>* SolverDispatcher::Run(
       fclose(incremental_file);
     }
   }
+}
 
-  // Now run the solver
-  vector<string> args;
-  pid_t solver_pid = 0;
-  pthread_t logger_thread = static_cast<pthread_t>(-1);
-  // If the solver hasn't executed or if we're not running in incremental mode.
-  if (!solver_ran_once_ || !FLAGS_incremental_flow) {
-    // Pipe setup
-    // errfd[0] == PARENT_READ
-    // errfd[1] == CHILD_WRITE
-    // outfd[0] == PARENT_READ
-    // outfd[1] == CHILD_WRITE
-    // infd[0] == CHILD_READ
-    // infd[1] == PARENT_WRITE
-    string binary;
-    SolverConfiguration(FLAGS_flow_scheduling_solver, &binary, &args);
-    solver_pid = ExecCommandSync(binary, args, infd_, outfd_, errfd_);
-    VLOG(2) << "Solver running " << "(PID: " << solver_pid << ")"
-            << ", CHILD_READ: " << infd_[0]
-            << ", CHILD_WRITE_STD: " << outfd_[1]
-            << ", CHILD_WRITE_ERR: " << errfd_[1]
-            << ", PARENT_WRITE: " << infd_[1]
-            << ", PARENT_READ_STD: " << outfd_[0]
-            << ", PARENT_READ_ERR: " << errfd_[0];
-
-    if ((from_solver_stderr_ = fdopen(errfd_[0], "r")) == NULL) {
-      LOG(ERROR) << "Failed to open FD for reading solver's output. FD "
-                 << errfd_[0];
-    }
-    if ((from_solver_ = fdopen(outfd_[0], "r")) == NULL) {
-      LOG(ERROR) << "Failed to open FD for reading solver's output. FD "
-                 << outfd_[0];
-    }
-    if ((to_solver_ = fdopen(infd_[1], "w")) == NULL) {
-      LOG(ERROR) << "Failed to open FD to solver for writing. FD: "
-                 << infd_[1];
+multimap<uint64_t, uint64_t>* SolverDispatcher::Run(
+    SchedulerStats* scheduler_stats) {
+  PrepareRun();
+
+  if (FLAGS_flow_scheduling_solver == "inprocess") {
+    return RunInProcessSolver(scheduler_stats);
+  }
+
+  return RunExternalSolver(scheduler_stats);
+}
+
+multimap<uint64_t, uint64_t>* SolverDispatcher::RunExternalSolver(
+    SchedulerStats* scheduler_stats) {
+  boost::timer::cpu_timer flowsolver_timer;
+  uint64_t algorithm_runtime = numeric_limits<uint64_t>::max();
+  multimap<uint64_t, uint64_t>* task_mappings = NULL;
+  uint64_t num_restarts = 0;
+  while (true) {
+    // If the solver hasn't executed or if we're not running in incremental
+    // mode.
+    if (!solver_ran_once_ || !FLAGS_incremental_flow) {
+      solver_pid_ = StartSolver(&solver_logger_thread_);
     }
+    solver_write_failed_ = false;
 
-    if (pthread_create(&logger_thread, NULL,
-                       ProcessStderrJustlog, from_solver_stderr_)) {
+    // We must export graph and read from STDOUT/STDERR in parallel
+    // Otherwise, the solver might block if STDOUT/STDERR buffer gets full.
+    // (For example, if it outputs lots of warnings on STDERR.)
+
+    // Create thread to write the DIMACS
+    pthread_t exporter_thread;
+    if (pthread_create(&exporter_thread, NULL, ExportToSolver, this)) {
       PLOG(FATAL) << "Error creating thread";
     }
-  }
 
-  boost::timer::cpu_timer flowsolver_timer;
+    task_mappings = ReadOutput(&algorithm_runtime);
 
-  // We must export graph and read from STDOUT/STDERR in parallel
-  // Otherwise, the solver might block if STDOUT/STDERR buffer gets full.
-  // (For example, if it outputs lots of warnings on STDERR.)
+    // Wait for exporter to complete. (Should already have happened when we
+    // get here, given we've finished reading the output.)
+    if (pthread_join(exporter_thread, NULL)) {
+      PLOG(FATAL) << "Error joining thread";
+    }
 
-  // Create thread to write the DIMACS
-  pthread_t exporter_thread;
-  if (pthread_create(&exporter_thread, NULL, ExportToSolver, this)) {
-    PLOG(FATAL) << "Error creating thread";
+    bool solver_failed = task_mappings == NULL || solver_write_failed_;
+    if (!FLAGS_incremental_flow) {
+      // We're done with the solver and can let it terminate here.
+      if (!StopSolver(solver_pid_, solver_logger_thread_)) {
+        solver_failed = true;
+      }
+    }
+    if (!solver_failed) {
+      break;
+    }
+    delete task_mappings;
+    CHECK_LT(num_restarts, FLAGS_max_solver_restarts)
+      << "The solver failed " << num_restarts + 1 << " times in a row";
+    RecoverSolver();
+    num_restarts++;
   }
 
-  uint64_t algorithm_runtime = numeric_limits<uint64_t>::max();
-  multimap<uint64_t, uint64_t>* task_mappings =
-    ReadOutput(&algorithm_runtime);
+  solver_ran_once_ = true;
 
-  // Wait for exporter to complete. (Should already have happened when we
-  // get here, given we've finished reading the output.)
-  if (pthread_join(exporter_thread, NULL)) {
-    PLOG(FATAL) << "Error joining thread";
+  if (scheduler_stats != NULL) {
+    scheduler_stats->scheduler_runtime_ =
+      static_cast<uint64_t>(flowsolver_timer.elapsed().wall) /
+      NANOSECONDS_IN_MICROSECOND;
+    scheduler_stats->algorithm_runtime_ = algorithm_runtime;
+    scheduler_stats->graph_export_runtime_ = graph_export_runtime_;
+    scheduler_stats->solver_restarts_ = num_restarts;
   }
+  debug_seq_num_++;
+  return task_mappings;
+}
 
+multimap<uint64_t, uint64_t>* SolverDispatcher::RunInProcessSolver(
+    SchedulerStats* scheduler_stats) {
+  FlowGraphChangeManager* change_manager =
+    flow_graph_manager_->flow_graph_change_manager();
+  boost::timer::cpu_timer flowsolver_timer;
+  uint64_t algorithm_runtime = numeric_limits<uint64_t>::max();
+  vector<unordered_map<uint64_t, uint64_t>>* extracted_flow =
+    in_process_solver_.Solve(change_manager->flow_graph(), &algorithm_runtime);
+  multimap<uint64_t, uint64_t>* task_mappings =
+    GetMappings(extracted_flow, flow_graph_manager_->leaf_node_ids(),
+                flow_graph_manager_->sink_node()->id_);
+  delete extracted_flow;
+  // The solver works directly on the flow graph. Hence, we just have to
+  // drop the changes we've accumulated since the previous run.
+  change_manager->ResetChanges();
   solver_ran_once_ = true;
-
   if (scheduler_stats != NULL) {
     scheduler_stats->scheduler_runtime_ =
       static_cast<uint64_t>(flowsolver_timer.elapsed().wall) /
       NANOSECONDS_IN_MICROSECOND;
     scheduler_stats->algorithm_runtime_ = algorithm_runtime;
   }
+  debug_seq_num_++;
+  return task_mappings;
+}
 
-  if (!FLAGS_incremental_flow) {
-    // We're done with the solver and can let it terminate here.
-    int status = WaitForFinish(solver_pid);
+pid_t SolverDispatcher::StartSolver(pthread_t* logger_thread) {
+  // Pipe setup
+  // errfd[0] == PARENT_READ
+  // errfd[1] == CHILD_WRITE
+  // outfd[0] == PARENT_READ
+  // outfd[1] == CHILD_WRITE
+  // infd[0] == CHILD_READ
+  // infd[1] == PARENT_WRITE
+  vector<string> args;
+  string binary;
+  SolverConfiguration(FLAGS_flow_scheduling_solver, &binary, &args);
+  // Writing to a solver that has crashed must fail with EPIPE rather than
+  // kill us, so that we can restart the solver.
+  signal(SIGPIPE, SIG_IGN);
+  pid_t solver_pid = ExecCommandSync(binary, args, infd_, outfd_, errfd_);
+  VLOG(2) << "Solver running " << "(PID: " << solver_pid << ")"
+          << ", CHILD_READ: " << infd_[0]
+          << ", CHILD_WRITE_STD: " << outfd_[1]
+          << ", CHILD_WRITE_ERR: " << errfd_[1]
+          << ", PARENT_WRITE: " << infd_[1]
+          << ", PARENT_READ_STD: " << outfd_[0]
+          << ", PARENT_READ_ERR: " << errfd_[0];
+
+  if ((from_solver_stderr_ = fdopen(errfd_[0], "r")) == NULL) {
+    LOG(ERROR) << "Failed to open FD for reading solver's output. FD "
+               << errfd_[0];
+  }
+  if ((from_solver_ = fdopen(outfd_[0], "r")) == NULL) {
+    LOG(ERROR) << "Failed to open FD for reading solver's output. FD "
+               << outfd_[0];
+  }
+  if ((to_solver_ = fdopen(infd_[1], "w")) == NULL) {
+    LOG(ERROR) << "Failed to open FD to solver for writing. FD: "
+               << infd_[1];
+  }
 
-    CHECK_EQ(fclose(from_solver_), 0);
-    from_solver_ = NULL;
-    CHECK_EQ(fclose(from_solver_stderr_), 0);
-    from_solver_stderr_ = NULL;
-    // N.B.: we DON'T close to_solver_ here, as the export thread already does
-    // this (cs2 expects stdin to be closed before it terminates, so we can't do
-    // it here)
+  if (pthread_create(logger_thread, NULL,
+                     ProcessStderrJustlog, from_solver_stderr_)) {
+    PLOG(FATAL) << "Error creating thread";
+  }
+  return solver_pid;
+}
 
-    // wait for logger thread
-    if (pthread_join(logger_thread, NULL)) {
-      PLOG(FATAL) << "Error joining thread";
+bool SolverDispatcher::StopSolver(pid_t solver_pid, pthread_t logger_thread) {
+  int status = WaitForFinish(solver_pid);
+
+  CHECK_EQ(fclose(from_solver_), 0);
+  from_solver_ = NULL;
+  CHECK_EQ(fclose(from_solver_stderr_), 0);
+  from_solver_stderr_ = NULL;
+  // N.B.: we DON'T close to_solver_ here, as the export thread already does
+  // this (cs2 expects stdin to be closed before it terminates, so we can't do
+  // it here)
+
+  // wait for logger thread
+  if (pthread_join(logger_thread, NULL)) {
+    PLOG(FATAL) << "Error joining thread";
+  }
+
+  if (!(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+    LOG(ERROR) << "Solver terminated abnormally";
+    return false;
+  }
+  return true;
+}
+
+void SolverDispatcher::RecoverSolver() {
+  LOG(WARNING) << "Solver (PID: " << solver_pid_ << ") failed. Restarting it "
+               << "and sending it the full flow graph";
+  if (FLAGS_incremental_flow) {
+    // The solver may still be running if it only sent corrupted output.
+    kill(solver_pid_, SIGKILL);
+    if (to_solver_ != NULL) {
+      // The stream may contain data that can't be written anymore. Hence,
+      // closing it can fail.
+      fclose(to_solver_);
+      to_solver_ = NULL;
     }
+    StopSolver(solver_pid_, solver_logger_thread_);
+  }
+  // The new solver doesn't have any state.
+  solver_ran_once_ = false;
+}
+
+void SolverDispatcher::StartRun() {
+  CHECK(!run_in_flight_) << "The previous solver run has not finished";
+  run_in_flight_ = true;
+  run_stats_ = SchedulerStats();
+  PrepareRun();
+  if (FLAGS_flow_scheduling_solver == "inprocess") {
+    // The in-process solver works directly on the flow graph. Hence, it
+    // can't run while the graph changes, and we complete the run here.
+    run_task_mappings_ = RunInProcessSolver(&run_stats_);
+    return;
+  }
+  // We export the changes into a memory buffer rather than directly to the
+  // solver. Once the buffer is written, the graph and the change manager are
+  // free to change while the solver runs.
+  boost::timer::cpu_timer export_timer;
+  char* snapshot = NULL;
+  size_t snapshot_size = 0;
+  FILE* snapshot_stream = open_memstream(&snapshot, &snapshot_size);
+  CHECK_NOTNULL(snapshot_stream);
+  CHECK(ExportGraph(snapshot_stream)) << "Failed to export the graph snapshot";
+  CHECK_EQ(fclose(snapshot_stream), 0);
+  graph_snapshot_.assign(snapshot, snapshot_size);
+  free(snapshot);
+  run_stats_.graph_export_runtime_ =
+    static_cast<uint64_t>(export_timer.elapsed().wall) /
+    NANOSECONDS_IN_MICROSECOND;
+  snapshot_num_nodes_ =
+    flow_graph_manager_->flow_graph_change_manager()->flow_graph().NumNodes();
+  flow_graph_manager_->flow_graph_change_manager()->ResetChanges();
+  run_timer_.start();
+  if (!solver_ran_once_ || !FLAGS_incremental_flow) {
+    solver_pid_ = StartSolver(&solver_logger_thread_);
+  }
+  run_solver_failed_ = false;
+  solver_thread_ =
+    new boost::thread(boost::bind(&SolverDispatcher::RunOnSnapshot, this));
+}
 
-    if (!(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
-      LOG(FATAL) << "Solver terminated abnormally";
+multimap<uint64_t, uint64_t>* SolverDispatcher::FinishRun(
+    SchedulerStats* scheduler_stats) {
+  CHECK(run_in_flight_) << "No solver run has been started";
+  run_in_flight_ = false;
+  if (solver_thread_ != NULL) {
+    solver_thread_->join();
+    delete solver_thread_;
+    solver_thread_ = NULL;
+    if (run_solver_failed_) {
+      delete run_task_mappings_;
+      run_task_mappings_ = NULL;
+      delete run_extracted_flow_;
+      run_extracted_flow_ = NULL;
+      // The snapshot is stale by now. We send the current graph to the new
+      // solver instead, and hence the mappings it returns are for the current
+      // graph. The graph is prepared for the run like any other.
+      RecoverSolver();
+      uint64_t graph_export_runtime = run_stats_.graph_export_runtime_;
+      run_task_mappings_ = Run(&run_stats_);
+      run_stats_.graph_export_runtime_ += graph_export_runtime;
+      run_stats_.solver_restarts_++;
+    } else {
+      if (run_extracted_flow_ != NULL) {
+        // The graph may have changed since the snapshot, but the nodes that
+        // have been removed do not have flow on their arcs. The caller must
+        // ignore the mappings of removed nodes.
+        run_task_mappings_ =
+          GetMappings(run_extracted_flow_,
+                      flow_graph_manager_->leaf_node_ids(),
+                      flow_graph_manager_->sink_node()->id_);
+        delete run_extracted_flow_;
+        run_extracted_flow_ = NULL;
+      }
+      solver_ran_once_ = true;
+      debug_seq_num_++;
     }
   }
-  debug_seq_num_++;
+  if (scheduler_stats != NULL) {
+    scheduler_stats->scheduler_runtime_ = run_stats_.scheduler_runtime_;
+    scheduler_stats->algorithm_runtime_ = run_stats_.algorithm_runtime_;
+    scheduler_stats->graph_export_runtime_ = run_stats_.graph_export_runtime_;
+    scheduler_stats->solver_restarts_ = run_stats_.solver_restarts_;
+  }
+  multimap<uint64_t, uint64_t>* task_mappings = run_task_mappings_;
+  run_task_mappings_ = NULL;
   return task_mappings;
 }
 
+void SolverDispatcher::RunOnSnapshot() {
+  // N.B.: This method runs on solver_thread_ and must not access the flow
+  // graph.
+  if (fwrite(graph_snapshot_.data(), 1, graph_snapshot_.size(), to_solver_) !=
+      graph_snapshot_.size() || fflush(to_solver_)) {
+    // FinishRun restarts the solver.
+    PLOG(WARNING) << "Error while writing the graph to the solver";
+    run_solver_failed_ = true;
+  }
+  if (!FLAGS_incremental_flow) {
+    // We need to close the stream because that's what cs expects.
+    if (fclose(to_solver_)) {
+      run_solver_failed_ = true;
+    }
+    to_solver_ = NULL;
+  }
+  bool binary_format = FLAGS_flow_graph_wire_format == "binary";
+  uint64_t algorithm_runtime = numeric_limits<uint64_t>::max();
+  if (FLAGS_only_read_assignment_changes) {
+    if (binary_format) {
+      run_task_mappings_ =
+        ReadBinaryTaskMappingChanges(from_solver_, &algorithm_runtime);
+    } else {
+      run_task_mappings_ =
+        ReadTaskMappingChanges(from_solver_, &algorithm_runtime);
+    }
+  } else {
+    if (binary_format) {
+      run_extracted_flow_ = ReadBinaryFlowGraph(from_solver_,
+                                                &algorithm_runtime,
+                                                snapshot_num_nodes_);
+    } else {
+      run_extracted_flow_ = ReadFlowGraph(from_solver_, &algorithm_runtime,
+                                          snapshot_num_nodes_);
+    }
+  }
+  run_stats_.scheduler_runtime_ =
+    static_cast<uint64_t>(run_timer_.elapsed().wall) /
+    NANOSECONDS_IN_MICROSECOND;
+  run_stats_.algorithm_runtime_ = algorithm_runtime;
+  if (run_task_mappings_ == NULL && run_extracted_flow_ == NULL) {
+    run_solver_failed_ = true;
+  }
+  if (!FLAGS_incremental_flow &&
+      !StopSolver(solver_pid_, solver_logger_thread_)) {
+    run_solver_failed_ = true;
+  }
+}
+
 void SolverDispatcher::SolverConfiguration(const string& solver,
                                            string* binary,
                                            vector<string> *args) {
@@ -304,6 +563,16 @@ void SolverDispatcher::SolverConfiguration(const string& solver,
     }
   }
 
+  if (FLAGS_flow_graph_wire_format == "binary") {
+    if (solver != "custom") {
+      LOG(FATAL) << "The binary wire format is only supported with a custom "
+                 << "solver";
+    }
+  } else if (FLAGS_flow_graph_wire_format != "dimacs") {
+    LOG(FATAL) << "Unknown flow graph wire format: "
+               << FLAGS_flow_graph_wire_format;
+  }
+
   if (solver == "custom") {
     boost::split(*args, FLAGS_custom_flow_scheduling_args,
                  boost::is_any_of(" "));
@@ -359,8 +628,12 @@ multimap<uint64_t, uint64_t>* SolverDispatcher::GetMappings(
     new multimap<uint64_t, uint64_t>();
   const FlowGraph& flow_graph =
     flow_graph_manager_->flow_graph_change_manager()->flow_graph();
-  vector<vector<uint64_t>> pu_ids(flow_graph.NumNodes() + 1);
-  vector<bool> visited(flow_graph.NumNodes() + 1, false);
+  // The flow may have been extracted from a snapshot of the graph that had
+  // more nodes than the graph has now (see StartRun).
+  uint64_t num_node_slots = max(flow_graph.NumNodes() + 1,
+                                static_cast<uint64_t>(extracted_flow->size()));
+  vector<vector<uint64_t>> pu_ids(num_node_slots);
+  vector<bool> visited(num_node_slots, false);
   queue<uint64_t> to_visit;
   for (auto& leaf_node : leaves) {
     visited[leaf_node]= true;
@@ -429,14 +702,29 @@ multimap<uint64_t, uint64_t>* SolverDispatcher::ReadOutput(
   // would block. This could result in a situation of deadlock.
 
   // Process stdout in main thread
+  bool binary_format = FLAGS_flow_graph_wire_format == "binary";
   if (FLAGS_only_read_assignment_changes) {
-    task_mappings = ReadTaskMappingChanges(from_solver_, algorithm_runtime);
+    if (binary_format) {
+      task_mappings =
+        ReadBinaryTaskMappingChanges(from_solver_, algorithm_runtime);
+    } else {
+      task_mappings = ReadTaskMappingChanges(from_solver_, algorithm_runtime);
+    }
   } else {
     // Parse and process the result
     uint64_t num_nodes =
       flow_graph_manager_->flow_graph_change_manager()->flow_graph().NumNodes();
-    vector<unordered_map<uint64_t, uint64_t> >* extracted_flow =
-      ReadFlowGraph(from_solver_, algorithm_runtime, num_nodes);
+    vector<unordered_map<uint64_t, uint64_t> >* extracted_flow;
+    if (binary_format) {
+      extracted_flow =
+        ReadBinaryFlowGraph(from_solver_, algorithm_runtime, num_nodes);
+    } else {
+      extracted_flow =
+        ReadFlowGraph(from_solver_, algorithm_runtime, num_nodes);
+    }
+    if (extracted_flow == NULL) {
+      return NULL;
+    }
     task_mappings = GetMappings(extracted_flow,
                                 flow_graph_manager_->leaf_node_ids(),
                                 flow_graph_manager_->sink_node()->id_);
@@ -445,6 +733,74 @@ multimap<uint64_t, uint64_t>* SolverDispatcher::ReadOutput(
   return task_mappings;
 }
 
+vector<unordered_map<uint64_t, uint64_t>>*
+SolverDispatcher::ReadBinaryFlowGraph(FILE* fptr, uint64_t* algorithm_runtime,
+                                      uint64_t num_vertices) {
+  // The solver sends the entire iteration in a single frame.
+  if (!ReadBinaryFrame(fptr, &binary_input_buffer_)) {
+    LOG(ERROR) << "Solver closed the stream before sending the flows";
+    return NULL;
+  }
+  vector<unordered_map<uint64_t, uint64_t>>* adj_list =
+    new vector<unordered_map<uint64_t, uint64_t> >(num_vertices + 1);
+  const char* pos = binary_input_buffer_.data();
+  const char* end = pos + binary_input_buffer_.size();
+  while (pos < end) {
+    char tag = *pos++;
+    if (tag == BINARY_FLOW) {
+      uint64_t src;
+      uint64_t dst;
+      uint64_t flow;
+      CHECK(ReadVarint(&pos, end, &src) && ReadVarint(&pos, end, &dst) &&
+            ReadVarint(&pos, end, &flow)) << "Truncated flow record";
+      // Only add it to the adjacency list if flow > 0
+      if (flow > 0) {
+        (*adj_list)[dst].insert(make_pair(src, flow));
+      }
+    } else if (tag == BINARY_ALGORITHM_TIME) {
+      CHECK(ReadVarint(&pos, end, algorithm_runtime))
+        << "Truncated algorithm time record";
+    } else if (tag == BINARY_COST) {
+      // The cost is not returned.
+      int64_t cost;
+      CHECK(ReadSignedVarint(&pos, end, &cost)) << "Truncated cost record";
+    } else {
+      LOG(FATAL) << "Unexpected record in binary flow graph: " << tag;
+    }
+  }
+  return adj_list;
+}
+
+multimap<uint64_t, uint64_t>* SolverDispatcher::ReadBinaryTaskMappingChanges(
+    FILE* fptr, uint64_t* algorithm_runtime) {
+  if (!ReadBinaryFrame(fptr, &binary_input_buffer_)) {
+    LOG(ERROR) << "Solver closed the stream before sending the assignments";
+    return NULL;
+  }
+  multimap<uint64_t, uint64_t>* task_node =
+    new multimap<uint64_t, uint64_t>();
+  const char* pos = binary_input_buffer_.data();
+  const char* end = pos + binary_input_buffer_.size();
+  while (pos < end) {
+    char tag = *pos++;
+    if (tag == BINARY_TASK_MAPPING) {
+      uint64_t task_id;
+      uint64_t core_id;
+      CHECK(ReadVarint(&pos, end, &task_id) &&
+            ReadVarint(&pos, end, &core_id)) << "Truncated mapping record";
+      VLOG(2) << "Assigning task node " << task_id << " to PU node "
+              << core_id;
+      task_node->insert(pair<uint64_t, uint64_t>(task_id, core_id));
+    } else if (tag == BINARY_ALGORITHM_TIME) {
+      CHECK(ReadVarint(&pos, end, algorithm_runtime))
+        << "Truncated algorithm time record";
+    } else {
+      LOG(FATAL) << "Unexpected record in binary task mappings: " << tag;
+    }
+  }
+  return task_node;
+}
+
 vector<unordered_map<uint64_t, uint64_t>>* SolverDispatcher::ReadFlowGraph(
     FILE* fptr, uint64_t* algorithm_runtime, uint64_t num_vertices) {
   vector<unordered_map<uint64_t, uint64_t>>* adj_list =
@@ -453,6 +809,7 @@ vector<unordered_map<uint64_t, uint64_t>>* SolverDispatcher::ReadFlowGraph(
   int64_t cost;
   char line[100];
   vector<string> vals;
+  bool end_of_iteration = false;
   FILE* dbg_fptr = NULL;
   if (FLAGS_debug_flow_graph) {
     // Somewhat ugly hack to generate unique output file name.
@@ -477,6 +834,7 @@ vector<unordered_map<uint64_t, uint64_t>>* SolverDispatcher::ReadFlowGraph(
       }
     } else if (line[0] == 'c') {
       if (!strcmp(line, "c EOI\n")) {
+        end_of_iteration = true;
         break;
       } else if (!strncmp(line, "c ALGORITHM TIME", 16)) {
         sscanf(line, "%*c %*s %*s %ju", algorithm_runtime);
@@ -489,6 +847,13 @@ vector<unordered_map<uint64_t, uint64_t>>* SolverDispatcher::ReadFlowGraph(
   }
   if (FLAGS_debug_flow_graph)
     CHECK_EQ(fclose(dbg_fptr), 0);
+  if (FLAGS_incremental_flow && !end_of_iteration) {
+    // The solver must stay alive and end every iteration in incremental
+    // mode. It has crashed.
+    LOG(ERROR) << "Solver closed the stream before the end of the iteration";
+    delete adj_list;
+    return NULL;
+  }
   return adj_list;
 }
 
@@ -499,7 +864,12 @@ multimap<uint64_t, uint64_t>* SolverDispatcher::ReadTaskMappingChanges(
   char line[100];
   bool end_of_iteration = false;
   while (!end_of_iteration) {
-    if (fgets(line, 100, fptr) != NULL) {
+    if (fgets(line, 100, fptr) == NULL) {
+      LOG(ERROR) << "Solver closed the stream before the end of the "
+                 << "iteration";
+      delete task_node;
+      return NULL;
+    } else {
       if (line[0] == 'm') {
         uint64_t task_id;
         uint64_t core_id;
@@ -7,11 +7,16 @@
 #include <string>
 #include <vector>
 
+#include <boost/thread.hpp>
+#include <boost/timer/timer.hpp>
+
 #include "base/common.h"
 #include "scheduling/scheduler_interface.h"
+#include "scheduling/flow/binary_exporter.h"
 #include "scheduling/flow/dimacs_exporter.h"
 #include "scheduling/flow/json_exporter.h"
 #include "scheduling/flow/flow_graph_manager.h"
+#include "scheduling/flow/in_process_solver.h"
 
 namespace firmament {
 namespace scheduler {
@@ -24,17 +29,66 @@ class SolverDispatcher {
 
   void ExportJSON(string* output) const;
   multimap<uint64_t, uint64_t>* Run(SchedulerStats* scheduler_stats);
+  /**
+   * Starts a solver run, but does not wait for it to complete. The graph
+   * changes are exported to a snapshot and reset before the method returns.
+   * Hence, the flow graph can be changed while the solver runs, and the new
+   * changes are sent to the solver in the next run.
+   */
+  void StartRun();
+  /**
+   * Waits for the run started by StartRun to complete. The mappings of the
+   * nodes that have been removed since StartRun are not valid anymore (see
+   * FlowGraphChangeManager::removed_node_ids).
+   * @return the task node to PU node mappings computed by the solver
+   */
+  multimap<uint64_t, uint64_t>* FinishRun(SchedulerStats* scheduler_stats);
+
+  inline bool run_in_flight() const {
+    return run_in_flight_;
+  }
 
   uint64_t seq_num() const {
     return debug_seq_num_;
   }
 
  private:
-  void ExportGraph(FILE* stream);
+  /**
+   * Writes the graph (or the changes to it) to the stream in the configured
+   * wire format.
+   * @return false if writing to the stream failed
+   */
+  bool ExportGraph(FILE* stream);
+  void PrepareRun();
+  /**
+   * Kills the solver after it failed, and makes sure that the next run
+   * starts a new solver and sends it the full graph.
+   */
+  void RecoverSolver();
+  /**
+   * Sends the graph to the external solver and reads its output. The solver
+   * is restarted if it fails, up to -max_solver_restarts times.
+   */
+  multimap<uint64_t, uint64_t>* RunExternalSolver(
+      SchedulerStats* scheduler_stats);
+  void RunOnSnapshot();
+  pid_t StartSolver(pthread_t* logger_thread);
+  /**
+   * Waits for the solver to exit.
+   * @return true if the solver exited successfully
+   */
+  bool StopSolver(pid_t solver_pid, pthread_t logger_thread);
   multimap<uint64_t, uint64_t>* GetMappings(
       vector<unordered_map<uint64_t, uint64_t>>* extracted_flow,
       unordered_set<uint64_t> leaves, uint64_t sink);
   multimap<uint64_t, uint64_t>* ReadOutput(uint64_t* algorithm_runtime);
+  vector<unordered_map<uint64_t, uint64_t>>* ReadBinaryFlowGraph(
+      FILE* fptr,
+      uint64_t* algorithm_runtime,
+      uint64_t num_vertices);
+  multimap<uint64_t, uint64_t>* ReadBinaryTaskMappingChanges(
+      FILE* fptr,
+      uint64_t* algorithm_runtime);
   vector<unordered_map<uint64_t, uint64_t>>* ReadFlowGraph(
       FILE* fptr,
       uint64_t* algorithm_runtime,
@@ -42,15 +96,29 @@ class SolverDispatcher {
   multimap<uint64_t, uint64_t>* ReadTaskMappingChanges(
       FILE* fptr,
       uint64_t* algorithm_runtime);
+  multimap<uint64_t, uint64_t>* RunInProcessSolver(
+      SchedulerStats* scheduler_stats);
   void SolverConfiguration(const string& solver, string* binary,
                            vector<string> *args);
   friend void *ExportToSolver(void *x);
+  FRIEND_TEST(SolverDispatcherTest, ReadBinaryFlowGraph);
+  FRIEND_TEST(SolverDispatcherTest, ReadBinaryTaskMappingChanges);
+  FRIEND_TEST(SolverDispatcherTest, ReadEmptyBinaryStream);
 
   shared_ptr<FlowGraphManager> flow_graph_manager_;
   // DIMACS exporter for interfacing to the solver
   DIMACSExporter dimacs_exporter_;
+  // Binary exporter for interfacing to solvers that speak the binary wire
+  // format (see binary_wire_format.h)
+  BinaryExporter binary_exporter_;
+  // Buffer holding the last binary frame received from the solver. It is
+  // re-used across rounds.
+  string binary_input_buffer_;
   // JSON exporter for debug and visualisation
   JSONExporter json_exporter_;
+  // Solver used when the flow graph is solved in-process, without exporting
+  // it to an external solver binary.
+  InProcessSolver in_process_solver_;
   // Boolean that indicates if the solver has knowledge of the flow graph (i.e.
   // it is set after the initial from scratch run of the solver).
   bool solver_ran_once_;
@@ -64,6 +132,29 @@ class SolverDispatcher {
   FILE* to_solver_;
   FILE* from_solver_;
   FILE* from_solver_stderr_;
+  // The solver process and the thread that logs its stderr. In incremental
+  // mode the solver is kept running across rounds.
+  pid_t solver_pid_;
+  pthread_t solver_logger_thread_;
+  // Set if sending the graph to the solver failed (e.g., because the solver
+  // crashed).
+  bool solver_write_failed_;
+  // Time it took to send the graph to the solver in the last attempt.
+  uint64_t graph_export_runtime_;
+
+  // State of the run started by StartRun.
+  bool run_in_flight_;
+  // Thread that sends the snapshot to the solver and reads its output.
+  boost::thread* solver_thread_;
+  // Set by the solver thread if the solver failed during the run.
+  bool run_solver_failed_;
+  // The exported graph changes the solver thread sends to the solver.
+  string graph_snapshot_;
+  uint64_t snapshot_num_nodes_;
+  boost::timer::cpu_timer run_timer_;
+  SchedulerStats run_stats_;
+  multimap<uint64_t, uint64_t>* run_task_mappings_;
+  vector<unordered_map<uint64_t, uint64_t>>* run_extracted_flow_;
 };
 
 } // namespace scheduler
@@ -0,0 +1,248 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the solver dispatcher.
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "misc/wall_time.h"
+#include "scheduling/flow/binary_wire_format.h"
+#include "scheduling/flow/dimacs_change_stats.h"
+#include "scheduling/flow/flow_graph_manager.h"
+#include "scheduling/flow/solver_dispatcher.h"
+#include "scheduling/flow/trivial_cost_model.h"
+
+DECLARE_string(custom_flow_scheduling_args);
+DECLARE_string(flow_scheduling_binary);
+DECLARE_string(flow_scheduling_solver);
+DECLARE_bool(incremental_flow);
+DECLARE_uint64(max_solver_restarts);
+DECLARE_bool(only_read_assignment_changes);
+
+namespace firmament {
+namespace scheduler {
+
+// The fixture for testing the SolverDispatcher class.
+class SolverDispatcherTest : public ::testing::Test {
+ protected:
+  SolverDispatcherTest() {
+    FLAGS_v = 2;
+    resource_map_ = shared_ptr<ResourceMap_t>(new ResourceMap_t);
+    task_map_ = shared_ptr<TaskMap_t>(new TaskMap_t);
+    leaf_res_ids_ =
+      new unordered_set<ResourceID_t, boost::hash<boost::uuids::uuid>>;
+    trace_generator_ = new TraceGenerator(&wall_time_);
+    flow_graph_manager_ = shared_ptr<FlowGraphManager>(
+        new FlowGraphManager(
+            new TrivialCostModel(resource_map_, task_map_, leaf_res_ids_),
+            leaf_res_ids_, &wall_time_, trace_generator_, &dimacs_stats_));
+  }
+
+  virtual ~SolverDispatcherTest() {
+    flow_graph_manager_.reset();
+    delete leaf_res_ids_;
+    delete trace_generator_;
+  }
+
+  // Sets up a stub solver that exits with an error the first num_failures
+  // times it runs, and afterwards reads the graph and places no tasks.
+  void UseFailingSolver(uint64_t num_failures) {
+    char dir_template[] = "/tmp/solver_dispatcher_test_XXXXXX";
+    solver_dir_ = CHECK_NOTNULL(mkdtemp(dir_template));
+    string failures_file = solver_dir_ + "/failures";
+    FILE* failures = fopen(failures_file.c_str(), "w");
+    CHECK_NOTNULL(failures);
+    fprintf(failures, "%ju\n", num_failures);
+    CHECK_EQ(fclose(failures), 0);
+    string solver_binary = solver_dir_ + "/solver.sh";
+    FILE* solver = fopen(solver_binary.c_str(), "w");
+    CHECK_NOTNULL(solver);
+    fprintf(solver,
+            "#!/bin/sh\n"
+            "failures=$(cat \"$1\")\n"
+            "if [ \"$failures\" -gt 0 ]; then\n"
+            "  echo $((failures - 1)) > \"$1\"\n"
+            "  exit 1\n"
+            "fi\n"
+            "cat > /dev/null\n"
+            "echo \"c ALGORITHM TIME 7\"\n"
+            "echo \"c EOI\"\n");
+    CHECK_EQ(fclose(solver), 0);
+    CHECK_EQ(chmod(solver_binary.c_str(), 0755), 0);
+    FLAGS_flow_scheduling_solver = "custom";
+    FLAGS_flow_scheduling_binary = solver_binary;
+    FLAGS_custom_flow_scheduling_args = failures_file;
+    FLAGS_only_read_assignment_changes = true;
+    FLAGS_incremental_flow = false;
+  }
+
+  virtual void TearDown() {
+    if (!solver_dir_.empty()) {
+      string cmd = "rm -rf " + solver_dir_;
+      CHECK_EQ(system(cmd.c_str()), 0);
+    }
+    FLAGS_flow_scheduling_solver = "cs2";
+    FLAGS_flow_scheduling_binary = "";
+    FLAGS_custom_flow_scheduling_args = "";
+    FLAGS_only_read_assignment_changes = false;
+  }
+
+  // Returns a stream from which the frame can be read.
+  FILE* StreamWithFrame(const string& payload) {
+    FILE* stream = tmpfile();
+    CHECK_NOTNULL(stream);
+    CHECK(WriteBinaryFrame(payload, stream));
+    rewind(stream);
+    return stream;
+  }
+
+  string solver_dir_;
+  shared_ptr<ResourceMap_t> resource_map_;
+  shared_ptr<TaskMap_t> task_map_;
+  unordered_set<ResourceID_t, boost::hash<boost::uuids::uuid>>* leaf_res_ids_;
+  WallTime wall_time_;
+  TraceGenerator* trace_generator_;
+  DIMACSChangeStats dimacs_stats_;
+  shared_ptr<FlowGraphManager> flow_graph_manager_;
+};
+
+TEST_F(SolverDispatcherTest, ReadBinaryFlowGraph) {
+  SolverDispatcher dispatcher(flow_graph_manager_, false);
+  string payload;
+  AppendRecordTag(BINARY_FLOW, &payload);
+  AppendVarint(3, &payload);
+  AppendVarint(1, &payload);
+  AppendVarint(2, &payload);
+  // Arcs without flow are not added to the adjacency list.
+  AppendRecordTag(BINARY_FLOW, &payload);
+  AppendVarint(4, &payload);
+  AppendVarint(1, &payload);
+  AppendVarint(0, &payload);
+  AppendRecordTag(BINARY_FLOW, &payload);
+  AppendVarint(5, &payload);
+  AppendVarint(3, &payload);
+  AppendVarint(1, &payload);
+  AppendRecordTag(BINARY_COST, &payload);
+  AppendSignedVarint(-12, &payload);
+  AppendRecordTag(BINARY_ALGORITHM_TIME, &payload);
+  AppendVarint(1234, &payload);
+  FILE* stream = StreamWithFrame(payload);
+  uint64_t algorithm_runtime = 0;
+  vector<unordered_map<uint64_t, uint64_t>>* adj_list =
+    dispatcher.ReadBinaryFlowGraph(stream, &algorithm_runtime, 5);
+  ASSERT_TRUE(adj_list != NULL);
+  EXPECT_EQ(6, adj_list->size());
+  EXPECT_EQ(1234, algorithm_runtime);
+  // The arcs are reversed.
+  EXPECT_EQ(1, (*adj_list)[1].size());
+  EXPECT_EQ(2, FindWithDefault((*adj_list)[1], 3, 0));
+  EXPECT_EQ(1, (*adj_list)[3].size());
+  EXPECT_EQ(1, FindWithDefault((*adj_list)[3], 5, 0));
+  EXPECT_TRUE((*adj_list)[4].empty());
+  delete adj_list;
+  fclose(stream);
+}
+
+TEST_F(SolverDispatcherTest, ReadBinaryTaskMappingChanges) {
+  SolverDispatcher dispatcher(flow_graph_manager_, false);
+  string payload;
+  AppendRecordTag(BINARY_TASK_MAPPING, &payload);
+  AppendVarint(7, &payload);
+  AppendVarint(2, &payload);
+  AppendRecordTag(BINARY_TASK_MAPPING, &payload);
+  AppendVarint(300, &payload);
+  AppendVarint(3, &payload);
+  AppendRecordTag(BINARY_ALGORITHM_TIME, &payload);
+  AppendVarint(42, &payload);
+  FILE* stream = StreamWithFrame(payload);
+  uint64_t algorithm_runtime = 0;
+  multimap<uint64_t, uint64_t>* task_mappings =
+    dispatcher.ReadBinaryTaskMappingChanges(stream, &algorithm_runtime);
+  ASSERT_TRUE(task_mappings != NULL);
+  EXPECT_EQ(2, task_mappings->size());
+  EXPECT_EQ(2, task_mappings->find(7)->second);
+  EXPECT_EQ(3, task_mappings->find(300)->second);
+  EXPECT_EQ(42, algorithm_runtime);
+  delete task_mappings;
+  fclose(stream);
+}
+
+// Checks that a solver that exits without sending a frame is detected.
+TEST_F(SolverDispatcherTest, ReadEmptyBinaryStream) {
+  SolverDispatcher dispatcher(flow_graph_manager_, false);
+  FILE* stream = tmpfile();
+  ASSERT_TRUE(stream != NULL);
+  uint64_t algorithm_runtime = 0;
+  EXPECT_TRUE(dispatcher.ReadBinaryFlowGraph(stream, &algorithm_runtime,
+                                             5) == NULL);
+  EXPECT_TRUE(dispatcher.ReadBinaryTaskMappingChanges(
+      stream, &algorithm_runtime) == NULL);
+  fclose(stream);
+}
+
+// Checks that a round completes if the solver crashes, as long as it
+// recovers within -max_solver_restarts restarts.
+TEST_F(SolverDispatcherTest, RestartFailedSolver) {
+  UseFailingSolver(2);
+  FLAGS_max_solver_restarts = 3;
+  SolverDispatcher dispatcher(flow_graph_manager_, false);
+  SchedulerStats scheduler_stats;
+  multimap<uint64_t, uint64_t>* task_mappings =
+    dispatcher.Run(&scheduler_stats);
+  ASSERT_TRUE(task_mappings != NULL);
+  EXPECT_TRUE(task_mappings->empty());
+  EXPECT_EQ(2, scheduler_stats.solver_restarts_);
+  EXPECT_EQ(7, scheduler_stats.algorithm_runtime_);
+  delete task_mappings;
+  // The next round runs without restarts.
+  task_mappings = dispatcher.Run(&scheduler_stats);
+  ASSERT_TRUE(task_mappings != NULL);
+  EXPECT_EQ(0, scheduler_stats.solver_restarts_);
+  delete task_mappings;
+}
+
+// Checks that a pipelined round completes if the solver crashes while the
+// scheduler is busy with other work.
+TEST_F(SolverDispatcherTest, RestartFailedSolverInBackground) {
+  UseFailingSolver(1);
+  FLAGS_max_solver_restarts = 3;
+  SolverDispatcher dispatcher(flow_graph_manager_, false);
+  dispatcher.StartRun();
+  EXPECT_TRUE(dispatcher.run_in_flight());
+  SchedulerStats scheduler_stats;
+  multimap<uint64_t, uint64_t>* task_mappings =
+    dispatcher.FinishRun(&scheduler_stats);
+  ASSERT_TRUE(task_mappings != NULL);
+  EXPECT_FALSE(dispatcher.run_in_flight());
+  EXPECT_EQ(1, scheduler_stats.solver_restarts_);
+  delete task_mappings;
+}
+
+// Checks that we give up once the solver has failed more than
+// -max_solver_restarts times in a row.
+TEST_F(SolverDispatcherTest, TooManySolverFailures) {
+  UseFailingSolver(3);
+  FLAGS_max_solver_restarts = 1;
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  SolverDispatcher dispatcher(flow_graph_manager_, false);
+  EXPECT_DEATH(delete dispatcher.Run(NULL),
+               "The solver failed 2 times in a row");
+}
+
+}  // namespace scheduler
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -192,4 +192,8 @@ FlowGraphNode* TrivialCostModel::UpdateStats(FlowGraphNode* accumulator,
   return accumulator;
 }
 
+bool TrivialCostModel::SupportsConcurrentQueries() const {
+  return true;
+}
+
 }  // namespace firmament
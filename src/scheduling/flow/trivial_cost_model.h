@@ -57,6 +57,7 @@ class TrivialCostModel : public CostModelInterface {
   FlowGraphNode* GatherStats(FlowGraphNode* accumulator, FlowGraphNode* other);
   void PrepareStats(FlowGraphNode* accumulator);
   FlowGraphNode* UpdateStats(FlowGraphNode* accumulator, FlowGraphNode* other);
+  bool SupportsConcurrentQueries() const;
 
  private:
   shared_ptr<ResourceMap_t> resource_map_;
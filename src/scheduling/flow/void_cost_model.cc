@@ -174,4 +174,8 @@ FlowGraphNode* VoidCostModel::UpdateStats(FlowGraphNode* accumulator,
   return accumulator;
 }
 
+bool VoidCostModel::SupportsConcurrentQueries() const {
+  return true;
+}
+
 } // namespace firmament
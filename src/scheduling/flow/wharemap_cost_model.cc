@@ -178,7 +178,10 @@ Cost_t WhareMapCostModel::TaskToClusterAggCost(TaskID_t task_id) {
     // zero.
     // TODO(malte): check if this can ever return a non-zero value when we
     // don't have a value in the worst_case_psi_map_.
-    return knowledge_base_->GetAvgPsPIForTEC(equiv_classes->front());
+    Cost_t avg_pspi =
+      knowledge_base_->GetAvgPsPIForTEC(equiv_classes->front());
+    delete equiv_classes;
+    return avg_pspi;
   }
   VLOG(1) << "Worst avg PsPI for TEC " << equiv_classes->front() << " is "
           << *worst_avg_pspi;
@@ -332,16 +335,6 @@ vector<EquivClass_t>* WhareMapCostModel::GetTaskEquivClasses(
   EquivClass_t task_agg =
     static_cast<EquivClass_t>(HashCommandLine(*td_ptr));
   equiv_classes->push_back(task_agg);
-  task_aggs_.insert(task_agg);
-  unordered_map<EquivClass_t, unordered_set<TaskID_t> >::iterator task_ec_it =
-    task_ec_to_set_task_id_.find(task_agg);
-  if (task_ec_it != task_ec_to_set_task_id_.end()) {
-    task_ec_it->second.insert(task_id);
-  } else {
-    unordered_set<TaskID_t> task_set;
-    task_set.insert(task_id);
-    CHECK(InsertIfNotPresent(&task_ec_to_set_task_id_, task_agg, task_set));
-  }
   // We also have one EC per job.
   // The ID of the aggregator is the hash of the job ID.
   EquivClass_t job_agg =
@@ -519,7 +512,15 @@ void WhareMapCostModel::RemoveMachine(ResourceID_t res_id) {
 }
 
 void WhareMapCostModel::AddTask(TaskID_t task_id) {
-  // No-op in the WhareMap cost model
+  // N.B.: We record the task's aggregator here rather than in
+  // GetTaskEquivClasses because the flow graph manager may call the latter
+  // concurrently for different tasks.
+  vector<EquivClass_t>* equiv_classes = GetTaskEquivClasses(task_id);
+  // The first EC is the task aggregator.
+  EquivClass_t task_agg = equiv_classes->front();
+  task_aggs_.insert(task_agg);
+  task_ec_to_set_task_id_[task_agg].insert(task_id);
+  delete equiv_classes;
 }
 
 void WhareMapCostModel::RecordMECtoPsPIMapping(
@@ -760,6 +761,10 @@ FlowGraphNode* WhareMapCostModel::UpdateStats(FlowGraphNode* accumulator,
   return accumulator;
 }
 
+bool WhareMapCostModel::SupportsConcurrentQueries() const {
+  return true;
+}
+
 void WhareMapCostModel::AccumulateWhareMapStats(WhareMapStats* accumulator,
                                                 WhareMapStats* other) {
   accumulator->set_num_devils(accumulator->num_devils() +
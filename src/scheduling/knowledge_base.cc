@@ -7,6 +7,7 @@
 #include "scheduling/knowledge_base.h"
 
 #include <algorithm>
+#include <cstring>
 #include <deque>
 #include <vector>
 
@@ -27,17 +28,30 @@ DEFINE_string(serial_task_samples, "serial_task_samples",
               " specific information");
 DEFINE_uint64(max_sample_queue_size, 100,
               "Maximum size (in KB) of each queue storing historical data");
+DEFINE_string(knowledge_base_format, "stream",
+              "Format in which the knowledge base serializes samples. Options: "
+              "stream | segments. With segments, -serial_machine_samples and "
+              "-serial_task_samples are directories of indexed segments, "
+              "which are memory-mapped and read on demand.");
+DEFINE_uint64(knowledge_base_segment_size, 65536,
+              "Number of samples per knowledge base segment");
 
 namespace firmament {
 
-KnowledgeBase::KnowledgeBase()
-  : data_layer_manager_(NULL) {
-  KnowledgeBase(NULL);
+KnowledgeBase::KnowledgeBase() : KnowledgeBase(NULL) {
 }
 
 KnowledgeBase::KnowledgeBase(DataLayerManagerInterface* data_layer_manager)
-  : data_layer_manager_(data_layer_manager) {
-  if (FLAGS_serialize_knowledge_base) {
+  : machine_sample_store_(NULL), task_sample_store_(NULL),
+    data_layer_manager_(data_layer_manager) {
+  if (FLAGS_knowledge_base_format == "segments") {
+    if (FLAGS_serialize_knowledge_base) {
+      OpenSampleStores();
+    }
+  } else if (FLAGS_knowledge_base_format != "stream") {
+    LOG(FATAL) << "Unknown knowledge base format: "
+               << FLAGS_knowledge_base_format;
+  } else if (FLAGS_serialize_knowledge_base) {
     serial_machine_samples_.open(FLAGS_serial_machine_samples.c_str(),
                                  ios::out | ios::trunc | ios::binary);
     CHECK(serial_machine_samples_.is_open());
@@ -57,6 +71,9 @@ KnowledgeBase::KnowledgeBase(DataLayerManagerInterface* data_layer_manager)
 }
 
 KnowledgeBase::~KnowledgeBase() {
+  // Deleting the stores writes their remaining samples.
+  delete machine_sample_store_;
+  delete task_sample_store_;
   if (serial_machine_samples_.is_open()) {
     delete coded_machine_output_;
     delete raw_machine_output_;
@@ -71,26 +88,166 @@ KnowledgeBase::~KnowledgeBase() {
   // the KnowledgeBase.
 }
 
+// Returns the number of samples of the given size that fit in a sample queue.
+static uint64_t SampleQueueCapacity(uint64_t sample_size) {
+  uint64_t max_queue_size = FLAGS_max_sample_queue_size * KB_TO_BYTES;
+  return max(static_cast<uint64_t>(1),
+             (max_queue_size + sample_size - 1) / sample_size);
+}
+
+static SampleKey ToSampleKey(const ResourceID_t& res_id) {
+  SampleKey key;
+  memcpy(&key, res_id.data, sizeof(key));
+  return key;
+}
+
+static SampleKey ToSampleKey(TaskID_t task_id) {
+  return SampleKey(0, task_id);
+}
+
+// Returns the ring buffer of key in shard, adding one if the key doesn't
+// have one yet. If store is not NULL, the new ring buffer is filled with the
+// key's most recent samples from the store. The shard's lock must be held in
+// exclusive mode.
+template <typename Shard, typename Key, typename Sample>
+static RingBuffer<Sample>* FindOrAddSampleQueue(Shard* shard, const Key& key,
+                                                const Sample& sample,
+                                                SampleSegmentStore* store) {
+  RingBuffer<Sample>* q = FindOrNull(shard->samples_, key);
+  if (!q) {
+    // Add a blank queue for this key
+    CHECK(InsertIfNotPresent(&shard->samples_, key,
+                             RingBuffer<Sample>(
+                                 SampleQueueCapacity(sizeof(sample)))));
+    q = FindOrNull(shard->samples_, key);
+    CHECK_NOTNULL(q);
+    if (store) {
+      vector<string> serialized_samples;
+      store->LookupLatest(ToSampleKey(key), q->capacity(),
+                          &serialized_samples);
+      for (auto& serialized_sample : serialized_samples) {
+        Sample stored_sample;
+        CHECK(stored_sample.ParseFromString(serialized_sample));
+        q->push_back(stored_sample);
+      }
+    }
+  }
+  return q;
+}
+
+// Makes sure that the samples of key have been loaded from the store.
+template <typename Shard, typename Key, typename Sample>
+static void WarmUpSampleQueue(Shard* shard, const Key& key,
+                              const Sample& sample,
+                              SampleSegmentStore* store) {
+  if (!store) {
+    return;
+  }
+  {
+    boost::shared_lock<boost::upgrade_mutex> lock(shard->lock_);
+    if (ContainsKey(shard->samples_, key)) {
+      return;
+    }
+  }
+  boost::lock_guard<boost::upgrade_mutex> lock(shard->lock_);
+  FindOrAddSampleQueue(shard, key, sample, store);
+}
+
+// Adds a sample to the ring buffer of key in shard.
+template <typename Shard, typename Key, typename Sample>
+static void AddSampleToShard(Shard* shard, const Key& key,
+                             const Sample& sample,
+                             SampleSegmentStore* store) {
+  boost::lock_guard<boost::upgrade_mutex> lock(shard->lock_);
+  // Drops the oldest sample if the queue is full.
+  FindOrAddSampleQueue(shard, key, sample, store)->push_back(sample);
+}
+
+// Orders the indices of a batch's samples by the shard they belong to.
+template <typename Shard>
+struct ShardOrder {
+  explicit ShardOrder(const vector<Shard*>& shards) : shards_(shards) {
+  }
+  bool operator()(uint64_t index1, uint64_t index2) const {
+    return shards_[index1] < shards_[index2];
+  }
+  const vector<Shard*>& shards_;
+};
+
+// Adds a batch of samples to the ring buffers of their keys. shards[i] and
+// keys[i] are the shard and the key of samples[i]. Each shard's lock is taken
+// once, and the samples of a key are added in batch order.
+template <typename Shard, typename Key, typename Sample>
+static void AddSamplesToShards(const vector<Shard*>& shards,
+                               const vector<Key>& keys,
+                               const vector<const Sample*>& samples,
+                               SampleSegmentStore* store) {
+  vector<uint64_t> order(samples.size());
+  for (uint64_t index = 0; index < order.size(); ++index) {
+    order[index] = index;
+  }
+  stable_sort(order.begin(), order.end(), ShardOrder<Shard>(shards));
+  uint64_t begin = 0;
+  while (begin < order.size()) {
+    Shard* shard = shards[order[begin]];
+    boost::lock_guard<boost::upgrade_mutex> lock(shard->lock_);
+    for (; begin < order.size() && shards[order[begin]] == shard; ++begin) {
+      const Sample& sample = *samples[order[begin]];
+      FindOrAddSampleQueue(shard, keys[order[begin]], sample, store)
+        ->push_back(sample);
+    }
+  }
+}
+
+// Copies the samples of key in shard to a deque.
+template <typename Shard, typename Key, typename Sample>
+static void CopySamplesFromShard(const Shard& shard, const Key& key,
+                                 deque<Sample>* samples) {
+  boost::shared_lock<boost::upgrade_mutex> lock(shard.lock_);
+  const RingBuffer<Sample>* q = FindOrNull(shard.samples_, key);
+  if (q) {
+    q->CopyTo(samples);
+  }
+}
+
+// Appends the samples held in memory that are in [start_time, end_time] and
+// newer than the key's samples in the store. A read-only store does not hold
+// the samples received since it was opened.
+template <typename Sample>
+static void AppendUnstoredSamples(SampleSegmentStore* store,
+                                  const SampleKey& key,
+                                  const deque<Sample>& recent_samples,
+                                  uint64_t start_time, uint64_t end_time,
+                                  vector<Sample>* samples) {
+  vector<string> latest_stored;
+  store->LookupLatest(key, 1, &latest_stored);
+  uint64_t min_time = start_time;
+  if (!latest_stored.empty()) {
+    Sample stored_sample;
+    CHECK(stored_sample.ParseFromString(latest_stored[0]));
+    min_time = max(min_time, stored_sample.timestamp() + 1);
+  }
+  for (auto& sample : recent_samples) {
+    if (sample.timestamp() >= min_time && sample.timestamp() <= end_time) {
+      samples->push_back(sample);
+    }
+  }
+}
+
 void KnowledgeBase::AddMachineSample(
     const MachinePerfStatisticsSample& sample) {
-  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
   ResourceID_t rid = ResourceIDFromString(sample.resource_id());
-  // Check if we already have a record for this machine
-  deque<MachinePerfStatisticsSample>* q =
-      FindOrNull(machine_map_, rid);
-  if (!q) {
-    // Add a blank queue for this machine
-    CHECK(InsertOrUpdate(&machine_map_, rid,
-                         deque<MachinePerfStatisticsSample>()));
-    q = FindOrNull(machine_map_, rid);
-    CHECK_NOTNULL(q);
+  AddSampleToShard(MachineShard(rid), rid, sample, machine_sample_store_);
+  if (!FLAGS_serialize_knowledge_base) {
+    return;
   }
-  if (q->size() * sizeof(sample) >= FLAGS_max_sample_queue_size * KB_TO_BYTES)
-    q->pop_front();  // drop from the front
-  q->push_back(sample);
-  if (FLAGS_serialize_knowledge_base) {
-    string message_string;
-    sample.SerializeToString(&message_string);
+  string message_string;
+  sample.SerializeToString(&message_string);
+  if (machine_sample_store_) {
+    machine_sample_store_->Append(ToSampleKey(rid), sample.timestamp(),
+                                  message_string);
+  } else {
+    boost::lock_guard<boost::mutex> lock(serial_lock_);
     coded_machine_output_->WriteVarint32(message_string.size());
     coded_machine_output_->WriteRaw(message_string.data(),
                                     message_string.size());
@@ -99,49 +256,114 @@ void KnowledgeBase::AddMachineSample(
 
 void KnowledgeBase::AddTaskSample(const TaskPerfStatisticsSample& sample) {
   TaskID_t tid = sample.task_id();
-  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
-  // Check if we already have a record for this task
-  deque<TaskPerfStatisticsSample>* q = FindOrNull(task_map_, tid);
-  if (!q) {
-    // Add a blank queue for this task
-    CHECK(InsertOrUpdate(&task_map_, tid,
-                         deque<TaskPerfStatisticsSample>()));
-    q = FindOrNull(task_map_, tid);
-    CHECK_NOTNULL(q);
+  AddSampleToShard(TaskShard(tid), tid, sample, task_sample_store_);
+  if (!FLAGS_serialize_knowledge_base) {
+    return;
   }
-  if (q->size() * sizeof(sample) >= FLAGS_max_sample_queue_size * KB_TO_BYTES)
-    q->pop_front();  // drop from the front
-  q->push_back(sample);
-  if (FLAGS_serialize_knowledge_base) {
-    string message_string;
-    sample.SerializeToString(&message_string);
+  string message_string;
+  sample.SerializeToString(&message_string);
+  if (task_sample_store_) {
+    task_sample_store_->Append(ToSampleKey(tid), sample.timestamp(),
+                               message_string);
+  } else {
+    boost::lock_guard<boost::mutex> lock(serial_lock_);
     coded_task_output_->WriteVarint32(message_string.size());
     coded_task_output_->WriteRaw(message_string.data(), message_string.size());
   }
 }
 
+void KnowledgeBase::AddMachineSamples(
+    const vector<const MachinePerfStatisticsSample*>& samples) {
+  vector<MachineShard_t*> shards;
+  vector<ResourceID_t> res_ids;
+  shards.reserve(samples.size());
+  res_ids.reserve(samples.size());
+  for (auto& sample : samples) {
+    res_ids.push_back(ResourceIDFromString(sample->resource_id()));
+    shards.push_back(MachineShard(res_ids.back()));
+  }
+  AddSamplesToShards(shards, res_ids, samples, machine_sample_store_);
+  if (!FLAGS_serialize_knowledge_base) {
+    return;
+  }
+  if (machine_sample_store_) {
+    string message_string;
+    for (uint64_t index = 0; index < samples.size(); ++index) {
+      samples[index]->SerializeToString(&message_string);
+      machine_sample_store_->Append(ToSampleKey(res_ids[index]),
+                                    samples[index]->timestamp(),
+                                    message_string);
+    }
+  } else {
+    string message_string;
+    boost::lock_guard<boost::mutex> lock(serial_lock_);
+    for (auto& sample : samples) {
+      sample->SerializeToString(&message_string);
+      coded_machine_output_->WriteVarint32(message_string.size());
+      coded_machine_output_->WriteRaw(message_string.data(),
+                                      message_string.size());
+    }
+  }
+}
+
+void KnowledgeBase::AddTaskSamples(
+    const vector<const TaskPerfStatisticsSample*>& samples) {
+  vector<TaskShard_t*> shards;
+  vector<TaskID_t> task_ids;
+  shards.reserve(samples.size());
+  task_ids.reserve(samples.size());
+  for (auto& sample : samples) {
+    task_ids.push_back(sample->task_id());
+    shards.push_back(TaskShard(task_ids.back()));
+  }
+  AddSamplesToShards(shards, task_ids, samples, task_sample_store_);
+  if (!FLAGS_serialize_knowledge_base) {
+    return;
+  }
+  if (task_sample_store_) {
+    string message_string;
+    for (uint64_t index = 0; index < samples.size(); ++index) {
+      samples[index]->SerializeToString(&message_string);
+      task_sample_store_->Append(ToSampleKey(task_ids[index]),
+                                 samples[index]->timestamp(), message_string);
+    }
+  } else {
+    string message_string;
+    boost::lock_guard<boost::mutex> lock(serial_lock_);
+    for (auto& sample : samples) {
+      sample->SerializeToString(&message_string);
+      coded_task_output_->WriteVarint32(message_string.size());
+      coded_task_output_->WriteRaw(message_string.data(),
+                                   message_string.size());
+    }
+  }
+}
+
 void KnowledgeBase::DumpMachineStats(const ResourceID_t& res_id) const {
+  const MachineShard_t& shard = MachineShard(res_id);
+  boost::shared_lock<boost::upgrade_mutex> lock(shard.lock_);
   // Sanity checks
-  const deque<MachinePerfStatisticsSample>* q =
-      FindOrNull(machine_map_, res_id);
+  const RingBuffer<MachinePerfStatisticsSample>* q =
+      FindOrNull(shard.samples_, res_id);
   if (!q)
     return;
   // Dump
   LOG(INFO) << "STATS FOR " << res_id << ": ";
   LOG(INFO) << "Have " << q->size() << " samples.";
-  for (deque<MachinePerfStatisticsSample>::const_iterator it = q->begin();
-      it != q->end();
-      ++it) {
-    LOG(INFO) << it->free_ram();
+  for (uint64_t index = 0; index < q->size(); ++index) {
+    LOG(INFO) << (*q)[index].free_ram();
   }
 }
 
 bool KnowledgeBase::GetLatestStatsForMachine(
     ResourceID_t id,
     MachinePerfStatisticsSample* sample) {
-  boost::lock_guard<boost::upgrade_mutex> lock_shared(kb_lock_);
-  const deque<MachinePerfStatisticsSample>* res = FindOrNull(machine_map_, id);
-  if (!res)
+  MachineShard_t* shard = MachineShard(id);
+  WarmUpSampleQueue(shard, id, *sample, machine_sample_store_);
+  boost::shared_lock<boost::upgrade_mutex> lock_shared(shard->lock_);
+  const RingBuffer<MachinePerfStatisticsSample>* res =
+    FindOrNull(shard->samples_, id);
+  if (!res || res->empty())
     return false;
   // We make a copy here, as we lose the lock when returning
   sample->CopyFrom(res->back());
@@ -150,97 +372,144 @@ bool KnowledgeBase::GetLatestStatsForMachine(
 
 const deque<MachinePerfStatisticsSample> KnowledgeBase::GetStatsForMachine(
       ResourceID_t id) {
-  boost::lock_guard<boost::upgrade_mutex> lock_shared(kb_lock_);
-  const deque<MachinePerfStatisticsSample>* res = FindOrNull(machine_map_, id);
-  if (!res) {
-    const deque<MachinePerfStatisticsSample> empty;
-    return empty;
-  }
   // We make a copy here, as we lose the lock when returning
-  const deque<MachinePerfStatisticsSample> copy(*res);
+  deque<MachinePerfStatisticsSample> copy;
+  WarmUpSampleQueue(MachineShard(id), id, MachinePerfStatisticsSample(),
+                    machine_sample_store_);
+  CopySamplesFromShard(*MachineShard(id), id, &copy);
   return copy;
 }
 
-const deque<TaskPerfStatisticsSample>* KnowledgeBase::GetStatsForTask(
-      TaskID_t id) const {
-  const deque<TaskPerfStatisticsSample>* res = FindOrNull(task_map_, id);
-  return res;
+const deque<TaskPerfStatisticsSample> KnowledgeBase::GetStatsForTask(
+      TaskID_t id) {
+  deque<TaskPerfStatisticsSample> copy;
+  WarmUpSampleQueue(TaskShard(id), id, TaskPerfStatisticsSample(),
+                    task_sample_store_);
+  CopySamplesFromShard(*TaskShard(id), id, &copy);
+  return copy;
 }
 
-const deque<TaskFinalReport>* KnowledgeBase::GetFinalReportForTask(
-      TaskID_t task_id) const {
-  const deque<TaskFinalReport>* res = FindOrNull(task_exec_reports_, task_id);
-  return res;
+void KnowledgeBase::GetHistoricalStatsForMachine(
+    ResourceID_t id, uint64_t start_time, uint64_t end_time,
+    vector<MachinePerfStatisticsSample>* samples) {
+  if (!machine_sample_store_) {
+    // We only have the samples held in memory.
+    deque<MachinePerfStatisticsSample> recent_samples = GetStatsForMachine(id);
+    for (auto& sample : recent_samples) {
+      if (sample.timestamp() >= start_time && sample.timestamp() <= end_time) {
+        samples->push_back(sample);
+      }
+    }
+    return;
+  }
+  vector<string> serialized_samples;
+  machine_sample_store_->Lookup(ToSampleKey(id), start_time, end_time,
+                                &serialized_samples);
+  for (auto& serialized_sample : serialized_samples) {
+    samples->push_back(MachinePerfStatisticsSample());
+    CHECK(samples->back().ParseFromString(serialized_sample));
+  }
+  if (machine_sample_store_->read_only()) {
+    AppendUnstoredSamples(machine_sample_store_, ToSampleKey(id),
+                          GetStatsForMachine(id), start_time, end_time,
+                          samples);
+  }
 }
 
-const deque<TaskFinalReport>* KnowledgeBase::GetFinalReportsForTEC(
-      EquivClass_t ec_id) const {
-  const deque<TaskFinalReport>* res = FindOrNull(task_exec_reports_, ec_id);
-  return res;
+void KnowledgeBase::GetHistoricalStatsForTask(
+    TaskID_t id, uint64_t start_time, uint64_t end_time,
+    vector<TaskPerfStatisticsSample>* samples) {
+  if (!task_sample_store_) {
+    // We only have the samples held in memory.
+    deque<TaskPerfStatisticsSample> recent_samples = GetStatsForTask(id);
+    for (auto& sample : recent_samples) {
+      if (sample.timestamp() >= start_time && sample.timestamp() <= end_time) {
+        samples->push_back(sample);
+      }
+    }
+    return;
+  }
+  vector<string> serialized_samples;
+  task_sample_store_->Lookup(ToSampleKey(id), start_time, end_time,
+                             &serialized_samples);
+  for (auto& serialized_sample : serialized_samples) {
+    samples->push_back(TaskPerfStatisticsSample());
+    CHECK(samples->back().ParseFromString(serialized_sample));
+  }
+  if (task_sample_store_->read_only()) {
+    AppendUnstoredSamples(task_sample_store_, ToSampleKey(id),
+                          GetStatsForTask(id), start_time, end_time, samples);
+  }
+}
+
+const deque<TaskFinalReport> KnowledgeBase::GetFinalReportForTask(
+      TaskID_t task_id) {
+  deque<TaskFinalReport> copy;
+  CopySamplesFromShard(*ReportShard(task_id), task_id, &copy);
+  return copy;
+}
+
+const deque<TaskFinalReport> KnowledgeBase::GetFinalReportsForTEC(
+      EquivClass_t ec_id) {
+  deque<TaskFinalReport> copy;
+  CopySamplesFromShard(*ReportShard(ec_id), ec_id, &copy);
+  return copy;
 }
 
 double KnowledgeBase::GetAvgCPIForTEC(EquivClass_t id) {
-  boost::lock_guard<boost::upgrade_mutex> lock_shared(kb_lock_);
-  const deque<TaskFinalReport>* res = FindOrNull(task_exec_reports_, id);
-  CHECK_NOTNULL(res);
-  if (!res || res->size() == 0)
-    return 0;
-  double accumulator = 0;
-  for (deque<TaskFinalReport>::const_iterator it = res->begin();
-       it != res->end();
-       ++it) {
-    accumulator += static_cast<double>(it->cycles()) /
-      static_cast<double>(it->instructions());
-  }
-  return accumulator / res->size();
+  ReportShard_t* shard = ReportShard(id);
+  boost::shared_lock<boost::upgrade_mutex> lock_shared(shard->lock_);
+  const EquivClassStats* stats = FindOrNull(shard->ec_stats_, id);
+  CHECK_NOTNULL(stats);
+  return stats->AvgCPI();
 }
 
 double KnowledgeBase::GetAvgIPMAForTEC(EquivClass_t id) {
-  boost::lock_guard<boost::upgrade_mutex> lock_shared(kb_lock_);
-  const deque<TaskFinalReport>* res = FindOrNull(task_exec_reports_, id);
-  if (!res || res->size() == 0)
+  ReportShard_t* shard = ReportShard(id);
+  boost::shared_lock<boost::upgrade_mutex> lock_shared(shard->lock_);
+  const EquivClassStats* stats = FindOrNull(shard->ec_stats_, id);
+  if (!stats)
     return 0;
-  double accumulator = 0;
-  for (deque<TaskFinalReport>::const_iterator it = res->begin();
-       it != res->end();
-       ++it) {
-    accumulator += static_cast<double>(it->instructions()) /
-      static_cast<double>(it->llc_refs());
-  }
-  return accumulator / res->size();
+  return stats->AvgIPMA();
 }
 
 double KnowledgeBase::GetAvgPsPIForTEC(EquivClass_t id) {
-  boost::lock_guard<boost::upgrade_mutex> lock_shared(kb_lock_);
-  const deque<TaskFinalReport>* res = FindOrNull(task_exec_reports_, id);
-  if (!res || res->size() == 0)
+  ReportShard_t* shard = ReportShard(id);
+  boost::shared_lock<boost::upgrade_mutex> lock_shared(shard->lock_);
+  const EquivClassStats* stats = FindOrNull(shard->ec_stats_, id);
+  if (!stats)
     return 0;
-  double accumulator = 0;
-  for (deque<TaskFinalReport>::const_iterator it = res->begin();
-       it != res->end();
-       ++it) {
-    accumulator += static_cast<double>(it->runtime() * 10000000000.0) /
-      static_cast<double>(it->instructions());
-  }
-  return accumulator / res->size();
+  return stats->AvgPsPI();
 }
 
 double KnowledgeBase::GetAvgRuntimeForTEC(EquivClass_t id) {
-  boost::lock_guard<boost::upgrade_mutex> lock_shared(kb_lock_);
-  const deque<TaskFinalReport>* res = FindOrNull(task_exec_reports_, id);
-  if (!res || res->size() == 0)
+  ReportShard_t* shard = ReportShard(id);
+  boost::shared_lock<boost::upgrade_mutex> lock_shared(shard->lock_);
+  const EquivClassStats* stats = FindOrNull(shard->ec_stats_, id);
+  if (!stats)
     return 0;
-  double accumulator = 0;
-  for (deque<TaskFinalReport>::const_iterator it = res->begin();
-       it != res->end();
-       ++it) {
-    // Runtime is in seconds, but a double -- so convert into ms here
-    accumulator += it->runtime() * 1000.0;
-  }
-  return accumulator / res->size();
+  return stats->AvgRuntime();
+}
+
+bool KnowledgeBase::GetStatsForTEC(EquivClass_t id, EquivClassStats* stats) {
+  ReportShard_t* shard = ReportShard(id);
+  boost::shared_lock<boost::upgrade_mutex> lock_shared(shard->lock_);
+  const EquivClassStats* ec_stats = FindOrNull(shard->ec_stats_, id);
+  if (!ec_stats)
+    return false;
+  *stats = *ec_stats;
+  return true;
 }
 
 void KnowledgeBase::LoadKnowledgeBaseFromFile() {
+  if (FLAGS_knowledge_base_format == "segments") {
+    // We don't replay the samples. They are loaded from the segments the
+    // first time a machine or a task is queried.
+    if (!machine_sample_store_) {
+      OpenSampleStores();
+    }
+    return;
+  }
   // Load the machine samples.
   fstream machine_samples(FLAGS_serial_machine_samples.c_str(),
                           ios::in | ios::binary);
@@ -303,25 +572,38 @@ void KnowledgeBase::LoadKnowledgeBaseFromFile() {
   task_samples.close();
 }
 
+void KnowledgeBase::OpenSampleStores() {
+  // Unless we serialize the knowledge base, we only read the stored samples.
+  bool read_only = !FLAGS_serialize_knowledge_base;
+  machine_sample_store_ =
+    new SampleSegmentStore(FLAGS_serial_machine_samples,
+                           FLAGS_knowledge_base_segment_size, read_only);
+  task_sample_store_ =
+    new SampleSegmentStore(FLAGS_serial_task_samples,
+                           FLAGS_knowledge_base_segment_size, read_only);
+}
+
 void KnowledgeBase::ProcessTaskFinalReport(
     const vector<EquivClass_t>& equiv_classes,
     const TaskFinalReport& report) {
-  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
   for (auto& tec : equiv_classes) {
-    // Check if we already have a record for this equiv class
-    deque<TaskFinalReport>* reports = FindOrNull(task_exec_reports_, tec);
-    if (!reports) {
-      // Add a blank queue for this task
-      CHECK(InsertOrUpdate(&task_exec_reports_, tec,
-                           deque<TaskFinalReport>()));
-      reports = FindOrNull(task_exec_reports_, tec);
-      CHECK_NOTNULL(reports);
-    }
-    if (reports->size() * sizeof(report) >=
-        FLAGS_max_sample_queue_size * KB_TO_BYTES) {
-      reports->pop_front();
+    ReportShard_t* shard = ReportShard(tec);
+    boost::lock_guard<boost::upgrade_mutex> lock(shard->lock_);
+    RingBuffer<TaskFinalReport>* reports =
+      FindOrAddSampleQueue(shard, tec, report,
+                           static_cast<SampleSegmentStore*>(NULL));
+    EquivClassStats* stats = &shard->ec_stats_[tec];
+    if (reports->size() == reports->capacity()) {
+      // The oldest report is about to be dropped.
+      stats->EvictReport((*reports)[0]);
     }
     reports->push_back(report);
+    stats->AddReport(report);
+    if (stats->total_reports() % reports->capacity() == 0) {
+      // Every time the window has been entirely replaced we recompute the
+      // window statistics in order to avoid accumulating rounding errors.
+      stats->RecomputeWindow(*reports);
+    }
     VLOG(2) << "Recorded final report for task " << report.task_id();
   }
 }
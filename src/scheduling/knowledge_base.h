@@ -16,6 +16,7 @@
 #include <string>
 #include <vector>
 
+#include <boost/thread.hpp>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 
@@ -24,10 +25,32 @@
 #include "base/machine_perf_statistics_sample.pb.h"
 #include "base/task_perf_statistics_sample.pb.h"
 #include "base/task_final_report.pb.h"
+#include "misc/ring_buffer.h"
 #include "scheduling/data_layer_manager_interface.h"
+#include "scheduling/equiv_class_stats.h"
+#include "scheduling/sample_segment_store.h"
 
 namespace firmament {
 
+/**
+ * A shard of the knowledge base's samples. Each key's samples are kept in a
+ * fixed-capacity ring buffer that drops the oldest samples once full.
+ */
+template <typename Key, typename Sample, typename Hash = hash<Key> >
+struct KnowledgeBaseShard {
+  mutable boost::upgrade_mutex lock_;
+  unordered_map<Key, RingBuffer<Sample>, Hash> samples_;
+};
+
+/**
+ * Shard of the final reports. It also holds the running statistics of the
+ * equivalence classes whose reports it stores.
+ */
+struct KnowledgeBaseReportShard
+  : public KnowledgeBaseShard<TaskID_t, TaskFinalReport> {
+  unordered_map<EquivClass_t, EquivClassStats> ec_stats_;
+};
+
 class KnowledgeBase {
  public:
   KnowledgeBase();
@@ -35,19 +58,45 @@ class KnowledgeBase {
   virtual ~KnowledgeBase();
   void AddMachineSample(const MachinePerfStatisticsSample& sample);
   void AddTaskSample(const TaskPerfStatisticsSample& sample);
+  /**
+   * Adds a batch of samples. The samples are grouped by shard so that each
+   * shard's lock is taken once per batch. The samples of a machine or task
+   * are added in the order in which they appear in the batch.
+   */
+  void AddMachineSamples(
+      const vector<const MachinePerfStatisticsSample*>& samples);
+  void AddTaskSamples(const vector<const TaskPerfStatisticsSample*>& samples);
   void DumpMachineStats(const ResourceID_t& res_id) const;
   bool GetLatestStatsForMachine(ResourceID_t id,
                                 MachinePerfStatisticsSample* sample);
   const deque<MachinePerfStatisticsSample> GetStatsForMachine(
       ResourceID_t id);
-  const deque<TaskPerfStatisticsSample>* GetStatsForTask(
-      TaskID_t id) const;
+  const deque<TaskPerfStatisticsSample> GetStatsForTask(TaskID_t id);
+
+  /**
+   * Gets the samples of a machine with timestamps in [start_time, end_time].
+   * If the knowledge base stores samples in segments, then the samples are
+   * read from the segments and include the samples that are no longer held
+   * in memory.
+   */
+  void GetHistoricalStatsForMachine(
+      ResourceID_t id, uint64_t start_time, uint64_t end_time,
+      vector<MachinePerfStatisticsSample>* samples);
+  void GetHistoricalStatsForTask(TaskID_t id, uint64_t start_time,
+                                 uint64_t end_time,
+                                 vector<TaskPerfStatisticsSample>* samples);
   virtual double GetAvgCPIForTEC(EquivClass_t id);
   virtual double GetAvgIPMAForTEC(EquivClass_t id);
   virtual double GetAvgPsPIForTEC(EquivClass_t id);
   virtual double GetAvgRuntimeForTEC(EquivClass_t id);
-  const deque<TaskFinalReport>* GetFinalReportForTask(TaskID_t task_id) const;
-  const deque<TaskFinalReport>* GetFinalReportsForTEC(EquivClass_t ec_id) const;
+
+  /**
+   * Copies the statistics of an equivalence class's final reports.
+   * @return false if there are no reports for the equivalence class
+   */
+  bool GetStatsForTEC(EquivClass_t id, EquivClassStats* stats);
+  const deque<TaskFinalReport> GetFinalReportForTask(TaskID_t task_id);
+  const deque<TaskFinalReport> GetFinalReportsForTEC(EquivClass_t ec_id);
   void LoadKnowledgeBaseFromFile();
   void ProcessTaskFinalReport(const vector<EquivClass_t>& equiv_classes,
                               const TaskFinalReport& report);
@@ -61,15 +110,47 @@ class KnowledgeBase {
   }
 
  protected:
-  unordered_map<ResourceID_t, deque<MachinePerfStatisticsSample>,
-      boost::hash<boost::uuids::uuid> > machine_map_;
+  // The samples are spread over kNumShards shards, each with its own lock.
+  // Writers only lock the shard of the machine, task or equivalence class
+  // they add a sample for, and readers take shared locks. Hence, sample
+  // ingestion does not serialize on a single lock and does not block on
+  // readers of other shards.
+  static const uint64_t kNumShards = 64;
+  typedef KnowledgeBaseShard<ResourceID_t, MachinePerfStatisticsSample,
+                             boost::hash<boost::uuids::uuid> > MachineShard_t;
+  typedef KnowledgeBaseShard<TaskID_t, TaskPerfStatisticsSample> TaskShard_t;
+  typedef KnowledgeBaseReportShard ReportShard_t;
+
+  inline MachineShard_t* MachineShard(ResourceID_t res_id) {
+    return &machine_shards_[boost::hash<boost::uuids::uuid>()(res_id) %
+                            kNumShards];
+  }
+  inline const MachineShard_t& MachineShard(ResourceID_t res_id) const {
+    return machine_shards_[boost::hash<boost::uuids::uuid>()(res_id) %
+                           kNumShards];
+  }
+  inline TaskShard_t* TaskShard(TaskID_t task_id) {
+    return &task_shards_[task_id % kNumShards];
+  }
+  inline ReportShard_t* ReportShard(uint64_t id) {
+    return &report_shards_[id % kNumShards];
+  }
+
+  MachineShard_t machine_shards_[kNumShards];
   // TODO(malte): note that below sample queue has no awareness of time within a
   // task, i.e. it mixes samples from all phases
-  unordered_map<TaskID_t, deque<TaskPerfStatisticsSample> > task_map_;
-  unordered_map<TaskID_t, deque<TaskFinalReport> > task_exec_reports_;
-  boost::upgrade_mutex kb_lock_;
+  TaskShard_t task_shards_[kNumShards];
+  ReportShard_t report_shards_[kNumShards];
 
  private:
+  void OpenSampleStores();
+
+  // Stores holding the serialized samples when the knowledge base uses the
+  // segments format. NULL otherwise.
+  SampleSegmentStore* machine_sample_store_;
+  SampleSegmentStore* task_sample_store_;
+  // Serializes the writes to the sample files.
+  boost::mutex serial_lock_;
   fstream serial_machine_samples_;
   fstream serial_task_samples_;
   ::google::protobuf::io::ZeroCopyOutputStream* raw_machine_output_;
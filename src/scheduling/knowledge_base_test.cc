@@ -0,0 +1,269 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the knowledge base.
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "base/units.h"
+#include "misc/utils.h"
+#include "scheduling/knowledge_base.h"
+
+DECLARE_string(knowledge_base_format);
+DECLARE_uint64(knowledge_base_segment_size);
+DECLARE_uint64(max_sample_queue_size);
+DECLARE_string(serial_machine_samples);
+DECLARE_string(serial_task_samples);
+DECLARE_bool(serialize_knowledge_base);
+
+namespace firmament {
+
+class KnowledgeBaseTest : public ::testing::Test {
+ protected:
+  KnowledgeBaseTest() {
+    FLAGS_v = 2;
+    // Keep the report queues short.
+    FLAGS_max_sample_queue_size = 1;
+  }
+
+  // Returns the number of entries of type T that fit in a queue of
+  // FLAGS_max_sample_queue_size KB. This depends on the size of the generated
+  // protobuf classes, so the tests must not hard-code it.
+  template<typename T>
+  uint64_t QueueCapacity() {
+    return (FLAGS_max_sample_queue_size * KB_TO_BYTES + sizeof(T) - 1) /
+      sizeof(T);
+  }
+
+  uint64_t ReportQueueCapacity() {
+    return QueueCapacity<TaskFinalReport>();
+  }
+
+  TaskFinalReport CreateReport(uint64_t task_id, double runtime) {
+    TaskFinalReport report;
+    report.set_task_id(task_id);
+    report.set_runtime(runtime);
+    report.set_instructions(1000);
+    report.set_cycles(task_id * 1000);
+    report.set_llc_refs(100);
+    return report;
+  }
+};
+
+// Checks that the equivalence class averages only cover the reports that are
+// still in the knowledge base.
+TEST_F(KnowledgeBaseTest, TECAveragesOverRecentReports) {
+  KnowledgeBase knowledge_base;
+  vector<EquivClass_t> equiv_classes;
+  equiv_classes.push_back(42);
+  uint64_t capacity = ReportQueueCapacity();
+  uint64_t num_reports = 3 * capacity + 1;
+  for (uint64_t task_id = 1; task_id <= num_reports; ++task_id) {
+    knowledge_base.ProcessTaskFinalReport(equiv_classes,
+                                          CreateReport(task_id, task_id));
+  }
+  EXPECT_EQ(knowledge_base.GetFinalReportsForTEC(42).size(), capacity);
+  // The window holds the reports of tasks num_reports - capacity + 1 to
+  // num_reports.
+  double avg_task_id = num_reports - (capacity - 1) / 2.0;
+  EXPECT_NEAR(knowledge_base.GetAvgCPIForTEC(42), avg_task_id, 1e-6);
+  EXPECT_NEAR(knowledge_base.GetAvgRuntimeForTEC(42), avg_task_id * 1000.0,
+              1e-6);
+  EXPECT_NEAR(knowledge_base.GetAvgIPMAForTEC(42), 10.0, 1e-6);
+  EquivClassStats stats;
+  EXPECT_TRUE(knowledge_base.GetStatsForTEC(42, &stats));
+  EXPECT_FALSE(knowledge_base.GetStatsForTEC(43, &stats));
+  EXPECT_EQ(stats.num_reports(), capacity);
+  EXPECT_EQ(stats.total_reports(), num_reports);
+  // The runtime quantiles are computed over all the reports.
+  EXPECT_NEAR(stats.RuntimeP50(), num_reports * 1000.0 / 2.0,
+              num_reports * 1000.0 * 0.1);
+  EXPECT_GT(stats.RuntimeP99(), stats.RuntimeP50());
+  EXPECT_GT(stats.DecayedAvgRuntime(), stats.RuntimeP50());
+}
+
+// Checks that a report with an undefined metric only affects the average
+// while it is in the knowledge base.
+TEST_F(KnowledgeBaseTest, TECAveragesWithNonFiniteMetrics) {
+  KnowledgeBase knowledge_base;
+  vector<EquivClass_t> equiv_classes;
+  equiv_classes.push_back(42);
+  TaskFinalReport report = CreateReport(1, 1);
+  report.set_llc_refs(0);
+  knowledge_base.ProcessTaskFinalReport(equiv_classes, report);
+  EXPECT_TRUE(std::isinf(knowledge_base.GetAvgIPMAForTEC(42)));
+  for (uint64_t index = 0; index < ReportQueueCapacity(); ++index) {
+    knowledge_base.ProcessTaskFinalReport(equiv_classes, CreateReport(1, 1));
+  }
+  EXPECT_NEAR(knowledge_base.GetAvgIPMAForTEC(42), 10.0, 1e-6);
+}
+
+// Checks that reports with an undefined CPI do not poison the decayed
+// average, which is kept over all the reports.
+TEST_F(KnowledgeBaseTest, TECDecayedAveragesSkipNonFiniteMetrics) {
+  KnowledgeBase knowledge_base;
+  vector<EquivClass_t> equiv_classes;
+  equiv_classes.push_back(42);
+  // No instructions and no cycles, i.e. a CPI of NaN.
+  TaskFinalReport report = CreateReport(0, 1);
+  report.set_instructions(0);
+  knowledge_base.ProcessTaskFinalReport(equiv_classes, report);
+  EquivClassStats stats;
+  EXPECT_TRUE(knowledge_base.GetStatsForTEC(42, &stats));
+  EXPECT_EQ(stats.DecayedAvgCPI(), 0.0);
+  knowledge_base.ProcessTaskFinalReport(equiv_classes, CreateReport(2, 1));
+  report.set_cycles(1000);
+  knowledge_base.ProcessTaskFinalReport(equiv_classes, report);
+  EXPECT_TRUE(knowledge_base.GetStatsForTEC(42, &stats));
+  EXPECT_EQ(stats.total_reports(), 3);
+  EXPECT_NEAR(stats.DecayedAvgCPI(), 2.0, 1e-6);
+  EXPECT_NEAR(stats.DecayedAvgRuntime(), 1000.0, 1e-6);
+}
+
+// Checks that the samples written to segments can be queried after the
+// knowledge base restarts.
+TEST_F(KnowledgeBaseTest, LoadSamplesFromSegments) {
+  char dir_template[] = "/tmp/knowledge_base_test_XXXXXX";
+  string dir = CHECK_NOTNULL(mkdtemp(dir_template));
+  string serial_machine_samples = FLAGS_serial_machine_samples;
+  string serial_task_samples = FLAGS_serial_task_samples;
+  uint64_t segment_size = FLAGS_knowledge_base_segment_size;
+  FLAGS_knowledge_base_format = "segments";
+  FLAGS_knowledge_base_segment_size = 7;
+  FLAGS_serial_machine_samples = dir + "/machine_samples";
+  FLAGS_serial_task_samples = dir + "/task_samples";
+  FLAGS_serialize_knowledge_base = true;
+  ResourceID_t machine1 = GenerateResourceID("machine1");
+  ResourceID_t machine2 = GenerateResourceID("machine2");
+  {
+    KnowledgeBase knowledge_base;
+    for (uint64_t timestamp = 1; timestamp <= 100; ++timestamp) {
+      MachinePerfStatisticsSample sample;
+      sample.set_resource_id(
+          to_string(timestamp % 2 == 0 ? machine1 : machine2));
+      sample.set_timestamp(timestamp);
+      sample.set_total_ram(1000);
+      sample.set_free_ram(timestamp);
+      knowledge_base.AddMachineSample(sample);
+      TaskPerfStatisticsSample task_sample;
+      task_sample.set_task_id(timestamp % 3);
+      task_sample.set_timestamp(timestamp);
+      knowledge_base.AddTaskSample(task_sample);
+    }
+  }
+  FLAGS_serialize_knowledge_base = false;
+  {
+    KnowledgeBase knowledge_base;
+    knowledge_base.LoadKnowledgeBaseFromFile();
+    MachinePerfStatisticsSample latest_sample;
+    EXPECT_TRUE(knowledge_base.GetLatestStatsForMachine(machine1,
+                                                        &latest_sample));
+    EXPECT_EQ(latest_sample.free_ram(), 100);
+    EXPECT_TRUE(knowledge_base.GetLatestStatsForMachine(machine2,
+                                                        &latest_sample));
+    EXPECT_EQ(latest_sample.free_ram(), 99);
+    EXPECT_FALSE(knowledge_base.GetLatestStatsForMachine(
+        GenerateResourceID("machine3"), &latest_sample));
+    vector<MachinePerfStatisticsSample> machine_samples;
+    knowledge_base.GetHistoricalStatsForMachine(machine1, 10, 30,
+                                                &machine_samples);
+    EXPECT_EQ(machine_samples.size(), 11);
+    for (uint64_t index = 0; index < machine_samples.size(); ++index) {
+      EXPECT_EQ(machine_samples[index].timestamp(), 10 + 2 * index);
+    }
+    vector<TaskPerfStatisticsSample> task_samples;
+    knowledge_base.GetHistoricalStatsForTask(1, 0, 100, &task_samples);
+    EXPECT_EQ(task_samples.size(), 34);
+    EXPECT_EQ(knowledge_base.GetStatsForTask(2).back().timestamp(), 98);
+    // Without -serialize_knowledge_base, new samples are only held in
+    // memory, but the historical queries still return them.
+    MachinePerfStatisticsSample new_sample;
+    new_sample.set_resource_id(to_string(machine1));
+    new_sample.set_timestamp(101);
+    knowledge_base.AddMachineSample(new_sample);
+    machine_samples.clear();
+    knowledge_base.GetHistoricalStatsForMachine(machine1, 96, 200,
+                                                &machine_samples);
+    EXPECT_EQ(machine_samples.size(), 4);
+    EXPECT_EQ(machine_samples.back().timestamp(), 101);
+  }
+  {
+    // The new sample has not been written to the segments.
+    KnowledgeBase knowledge_base;
+    knowledge_base.LoadKnowledgeBaseFromFile();
+    vector<MachinePerfStatisticsSample> machine_samples;
+    knowledge_base.GetHistoricalStatsForMachine(machine1, 96, 200,
+                                                &machine_samples);
+    EXPECT_EQ(machine_samples.size(), 3);
+    EXPECT_EQ(machine_samples.back().timestamp(), 100);
+  }
+  FLAGS_knowledge_base_format = "stream";
+  FLAGS_serial_machine_samples = serial_machine_samples;
+  FLAGS_serial_task_samples = serial_task_samples;
+  FLAGS_knowledge_base_segment_size = segment_size;
+  string cmd = "rm -rf " + dir;
+  CHECK_EQ(system(cmd.c_str()), 0);
+}
+
+// Checks that a batch of samples is added in order for every machine and
+// task.
+TEST_F(KnowledgeBaseTest, AddSamplesInBulk) {
+  KnowledgeBase knowledge_base;
+  vector<ResourceID_t> machines;
+  for (uint64_t index = 0; index < 10; ++index) {
+    machines.push_back(GenerateResourceID("machine" + to_string(index)));
+  }
+  vector<MachinePerfStatisticsSample> machine_samples(100);
+  vector<TaskPerfStatisticsSample> task_samples(100);
+  vector<const MachinePerfStatisticsSample*> machine_batch;
+  vector<const TaskPerfStatisticsSample*> task_batch;
+  for (uint64_t timestamp = 0; timestamp < 100; ++timestamp) {
+    machine_samples[timestamp].set_resource_id(
+        to_string(machines[timestamp % machines.size()]));
+    machine_samples[timestamp].set_timestamp(timestamp);
+    machine_batch.push_back(&machine_samples[timestamp]);
+    task_samples[timestamp].set_task_id(timestamp % 11);
+    task_samples[timestamp].set_timestamp(timestamp);
+    task_batch.push_back(&task_samples[timestamp]);
+  }
+  knowledge_base.AddMachineSamples(machine_batch);
+  knowledge_base.AddTaskSamples(task_batch);
+  // Every machine gets 10 samples, of which the queue keeps the most recent
+  // ones that fit.
+  uint64_t num_machine_samples =
+    min(static_cast<uint64_t>(10),
+        QueueCapacity<MachinePerfStatisticsSample>());
+  for (uint64_t index = 0; index < machines.size(); ++index) {
+    deque<MachinePerfStatisticsSample> samples =
+      knowledge_base.GetStatsForMachine(machines[index]);
+    EXPECT_EQ(samples.size(), num_machine_samples);
+    uint64_t first_sample = 10 - num_machine_samples;
+    for (uint64_t sample = 0; sample < samples.size(); ++sample) {
+      EXPECT_EQ(samples[sample].timestamp(),
+                index + (first_sample + sample) * 10);
+    }
+  }
+  // Task 3 gets 9 samples.
+  uint64_t num_task_samples =
+    min(static_cast<uint64_t>(9), QueueCapacity<TaskPerfStatisticsSample>());
+  deque<TaskPerfStatisticsSample> samples = knowledge_base.GetStatsForTask(3);
+  EXPECT_EQ(samples.size(), num_task_samples);
+  uint64_t first_sample = 9 - num_task_samples;
+  for (uint64_t sample = 0; sample < samples.size(); ++sample) {
+    EXPECT_EQ(samples[sample].timestamp(), 3 + (first_sample + sample) * 11);
+  }
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,413 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "scheduling/sample_segment_store.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <utility>
+
+#include "misc/map-util.h"
+#include "misc/utils.h"
+
+namespace firmament {
+
+static const char kSegmentMagic[4] = {'F', 'K', 'B', 'S'};
+static const uint32_t kSegmentVersion = 1;
+static const char kSegmentSuffix[] = ".seg";
+// Maximum number of full batches that may wait for the writer thread before
+// Append blocks.
+static const uint64_t kMaxSealedBatches = 4;
+
+// The segment files start with this header. It is followed by the key,
+// timestamp and offset columns, and by the serialized samples. The offset
+// column has an extra entry that holds the size of the samples.
+struct SegmentHeader {
+  char magic_[4];
+  uint32_t version_;
+  uint64_t num_records_;
+  uint64_t min_timestamp_;
+  uint64_t max_timestamp_;
+  uint64_t payload_size_;
+};
+
+// Orders timestamp-sample pairs by timestamp.
+static bool TimestampLess(const pair<uint64_t, string>& first,
+                          const pair<uint64_t, string>& second) {
+  return first.first < second.first;
+}
+
+SampleSegmentStore::SampleSegmentStore(const string& directory,
+                                       uint64_t records_per_segment,
+                                       bool read_only)
+  : directory_(directory), records_per_segment_(records_per_segment),
+    read_only_(read_only), next_segment_id_(0), stop_(false),
+    writer_thread_(NULL) {
+  CHECK_GT(records_per_segment_, 0);
+  CHECK_LE(records_per_segment_, numeric_limits<uint32_t>::max());
+  if (!read_only_) {
+    MkdirIfNotPresent(directory_);
+  }
+  DIR* dir = opendir(directory_.c_str());
+  if (!dir) {
+    PLOG(FATAL) << "Could not open sample directory " << directory_;
+  }
+  vector<uint64_t> segment_ids;
+  size_t suffix_length = strlen(kSegmentSuffix);
+  for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir)) {
+    string name(entry->d_name);
+    if (name.size() > suffix_length &&
+        name.compare(name.size() - suffix_length, suffix_length,
+                     kSegmentSuffix) == 0) {
+      segment_ids.push_back(strtoull(name.c_str(), NULL, 10));
+    }
+  }
+  closedir(dir);
+  sort(segment_ids.begin(), segment_ids.end());
+  for (auto& segment_id : segment_ids) {
+    OpenSegment(SegmentPath(segment_id));
+    next_segment_id_ = segment_id + 1;
+  }
+  VLOG(1) << "Opened " << segments_.size() << " sample segments in "
+          << directory_;
+  if (!read_only_) {
+    writer_thread_ = new boost::thread(
+        boost::bind(&SampleSegmentStore::WriteSegments, this));
+  }
+}
+
+SampleSegmentStore::~SampleSegmentStore() {
+  if (writer_thread_) {
+    Flush();
+    {
+      boost::lock_guard<boost::mutex> lock(lock_);
+      stop_ = true;
+    }
+    batch_sealed_.notify_one();
+    writer_thread_->join();
+    delete writer_thread_;
+  }
+  for (auto& segment : segments_) {
+    munmap(segment.data_, segment.size_);
+  }
+}
+
+void SampleSegmentStore::Append(const SampleKey& key, uint64_t timestamp,
+                                const string& sample) {
+  CHECK(!read_only_) << "Cannot append samples to read-only store in "
+                     << directory_;
+  boost::unique_lock<boost::mutex> lock(lock_);
+  pending_batch_.key_samples_[key].push_back(
+      static_cast<uint32_t>(pending_batch_.samples_.size()));
+  pending_batch_.samples_.push_back(PendingSample());
+  PendingSample* pending_sample = &pending_batch_.samples_.back();
+  pending_sample->key_ = key;
+  pending_sample->timestamp_ = timestamp;
+  pending_sample->sample_ = sample;
+  if (pending_batch_.samples_.size() >= records_per_segment_) {
+    // We only block if the writer thread cannot keep up.
+    while (sealed_batches_.size() >= kMaxSealedBatches) {
+      batch_written_.wait(lock);
+    }
+    SealPendingBatch();
+  }
+}
+
+void SampleSegmentStore::Flush() {
+  boost::unique_lock<boost::mutex> lock(lock_);
+  SealPendingBatch();
+  while (!sealed_batches_.empty()) {
+    batch_written_.wait(lock);
+  }
+}
+
+void SampleSegmentStore::FindBatchSamples(
+    const SampleBatch& batch, const SampleKey& key, uint64_t start_time,
+    uint64_t end_time, vector<pair<uint64_t, string> >* found) {
+  const vector<uint32_t>* indices = FindOrNull(batch.key_samples_, key);
+  if (!indices) {
+    return;
+  }
+  for (auto& index : *indices) {
+    const PendingSample& pending_sample = batch.samples_[index];
+    if (pending_sample.timestamp_ >= start_time &&
+        pending_sample.timestamp_ <= end_time) {
+      found->push_back(make_pair(pending_sample.timestamp_,
+                                 pending_sample.sample_));
+    }
+  }
+}
+
+void SampleSegmentStore::FindLatestBatchSamples(
+    const SampleBatch& batch, const SampleKey& key, uint64_t max_samples,
+    vector<pair<uint64_t, string> >* found) {
+  const vector<uint32_t>* indices = FindOrNull(batch.key_samples_, key);
+  if (!indices) {
+    return;
+  }
+  for (vector<uint32_t>::const_reverse_iterator it = indices->rbegin();
+       it != indices->rend() && found->size() < max_samples; ++it) {
+    const PendingSample& pending_sample = batch.samples_[*it];
+    found->push_back(make_pair(pending_sample.timestamp_,
+                               pending_sample.sample_));
+  }
+}
+
+uint64_t SampleSegmentStore::LowerBound(const Segment& segment,
+                                        const SampleKey& key,
+                                        uint64_t timestamp) {
+  uint64_t low = 0;
+  uint64_t high = segment.num_records_;
+  while (low < high) {
+    uint64_t mid = low + (high - low) / 2;
+    if (segment.keys_[mid] < key ||
+        (segment.keys_[mid] == key && segment.timestamps_[mid] < timestamp)) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+void SampleSegmentStore::Lookup(const SampleKey& key, uint64_t start_time,
+                                uint64_t end_time, vector<string>* samples) {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  vector<pair<uint64_t, string> > found;
+  const vector<uint32_t>* segment_indices = FindOrNull(key_segments_, key);
+  if (segment_indices) {
+    for (auto& segment_index : *segment_indices) {
+      const Segment& segment = segments_[segment_index];
+      if (segment.max_timestamp_ < start_time ||
+          segment.min_timestamp_ > end_time) {
+        continue;
+      }
+      for (uint64_t index = LowerBound(segment, key, start_time);
+           index < segment.num_records_ && segment.keys_[index] == key &&
+             segment.timestamps_[index] <= end_time;
+           ++index) {
+        found.push_back(make_pair(
+            segment.timestamps_[index],
+            string(segment.payload_ + segment.offsets_[index],
+                   segment.offsets_[index + 1] - segment.offsets_[index])));
+      }
+    }
+  }
+  for (auto& batch : sealed_batches_) {
+    FindBatchSamples(*batch, key, start_time, end_time, &found);
+  }
+  FindBatchSamples(pending_batch_, key, start_time, end_time, &found);
+  stable_sort(found.begin(), found.end(), TimestampLess);
+  for (auto& timestamp_sample : found) {
+    samples->push_back(timestamp_sample.second);
+  }
+}
+
+void SampleSegmentStore::LookupLatest(const SampleKey& key,
+                                      uint64_t max_samples,
+                                      vector<string>* samples) {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  vector<pair<uint64_t, string> > found;
+  // We look at the newest samples first, and stop as soon as we have enough.
+  FindLatestBatchSamples(pending_batch_, key, max_samples, &found);
+  for (deque<SampleBatch*>::reverse_iterator it = sealed_batches_.rbegin();
+       it != sealed_batches_.rend() && found.size() < max_samples; ++it) {
+    FindLatestBatchSamples(**it, key, max_samples, &found);
+  }
+  const vector<uint32_t>* segment_indices = FindOrNull(key_segments_, key);
+  if (segment_indices) {
+    for (vector<uint32_t>::const_reverse_iterator it =
+           segment_indices->rbegin();
+         it != segment_indices->rend() && found.size() < max_samples; ++it) {
+      const Segment& segment = segments_[*it];
+      uint64_t first = LowerBound(segment, key, 0);
+      uint64_t end =
+        LowerBound(segment, key, numeric_limits<uint64_t>::max());
+      if (end < segment.num_records_ && segment.keys_[end] == key) {
+        // A sample has the maximum timestamp.
+        end++;
+      }
+      for (uint64_t index = end; index > first && found.size() < max_samples;
+           --index) {
+        found.push_back(make_pair(
+            segment.timestamps_[index - 1],
+            string(segment.payload_ + segment.offsets_[index - 1],
+                   segment.offsets_[index] - segment.offsets_[index - 1])));
+      }
+    }
+  }
+  reverse(found.begin(), found.end());
+  stable_sort(found.begin(), found.end(), TimestampLess);
+  for (auto& timestamp_sample : found) {
+    samples->push_back(timestamp_sample.second);
+  }
+}
+
+void SampleSegmentStore::OpenSegment(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    PLOG(FATAL) << "Could not open sample segment " << path;
+  }
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0);
+  uint64_t size = static_cast<uint64_t>(file_stat.st_size);
+  if (size < sizeof(SegmentHeader)) {
+    LOG(ERROR) << "Ignoring truncated sample segment " << path;
+    close(fd);
+    return;
+  }
+  void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping remains valid after we close the file.
+  close(fd);
+  if (data == MAP_FAILED) {
+    PLOG(FATAL) << "Could not map sample segment " << path;
+  }
+  const SegmentHeader* header = static_cast<const SegmentHeader*>(data);
+  uint64_t num_records = header->num_records_;
+  if (memcmp(header->magic_, kSegmentMagic, sizeof(kSegmentMagic)) != 0 ||
+      header->version_ != kSegmentVersion ||
+      size != sizeof(SegmentHeader) + num_records * sizeof(SampleKey) +
+        num_records * sizeof(uint64_t) +
+        (num_records + 1) * sizeof(uint64_t) + header->payload_size_) {
+    LOG(ERROR) << "Ignoring invalid sample segment " << path;
+    munmap(data, size);
+    return;
+  }
+  Segment segment;
+  segment.data_ = data;
+  segment.size_ = size;
+  segment.num_records_ = num_records;
+  segment.min_timestamp_ = header->min_timestamp_;
+  segment.max_timestamp_ = header->max_timestamp_;
+  const char* columns = static_cast<const char*>(data) + sizeof(SegmentHeader);
+  segment.keys_ = reinterpret_cast<const SampleKey*>(columns);
+  columns += num_records * sizeof(SampleKey);
+  segment.timestamps_ = reinterpret_cast<const uint64_t*>(columns);
+  columns += num_records * sizeof(uint64_t);
+  segment.offsets_ = reinterpret_cast<const uint64_t*>(columns);
+  columns += (num_records + 1) * sizeof(uint64_t);
+  segment.payload_ = columns;
+  // The records are sorted by key, so each key's records are adjacent.
+  uint32_t segment_index = static_cast<uint32_t>(segments_.size());
+  for (uint64_t index = 0; index < num_records; ++index) {
+    if (index == 0 || !(segment.keys_[index] == segment.keys_[index - 1])) {
+      key_segments_[segment.keys_[index]].push_back(segment_index);
+    }
+  }
+  segments_.push_back(segment);
+}
+
+void SampleSegmentStore::SealPendingBatch() {
+  if (pending_batch_.samples_.empty()) {
+    return;
+  }
+  SampleBatch* batch = new SampleBatch;
+  batch->samples_.swap(pending_batch_.samples_);
+  batch->key_samples_.swap(pending_batch_.key_samples_);
+  sealed_batches_.push_back(batch);
+  batch_sealed_.notify_one();
+}
+
+string SampleSegmentStore::SegmentPath(uint64_t segment_id) {
+  char name[32];
+  snprintf(name, sizeof(name), "%010ju%s",
+           static_cast<uintmax_t>(segment_id), kSegmentSuffix);
+  return directory_ + "/" + name;
+}
+
+void SampleSegmentStore::WriteSegment(const SampleBatch& batch,
+                                      const string& path) {
+  uint64_t num_records = batch.samples_.size();
+  // Sort the samples by key and timestamp.
+  vector<pair<pair<SampleKey, uint64_t>, uint64_t> > order;
+  order.reserve(num_records);
+  for (uint64_t index = 0; index < num_records; ++index) {
+    order.push_back(make_pair(make_pair(batch.samples_[index].key_,
+                                        batch.samples_[index].timestamp_),
+                              index));
+  }
+  sort(order.begin(), order.end());
+  SegmentHeader header;
+  memcpy(header.magic_, kSegmentMagic, sizeof(kSegmentMagic));
+  header.version_ = kSegmentVersion;
+  header.num_records_ = num_records;
+  header.min_timestamp_ = numeric_limits<uint64_t>::max();
+  header.max_timestamp_ = 0;
+  header.payload_size_ = 0;
+  vector<SampleKey> keys;
+  vector<uint64_t> timestamps;
+  vector<uint64_t> offsets;
+  keys.reserve(num_records);
+  timestamps.reserve(num_records);
+  offsets.reserve(num_records + 1);
+  for (auto& key_index : order) {
+    const PendingSample& pending_sample = batch.samples_[key_index.second];
+    keys.push_back(pending_sample.key_);
+    timestamps.push_back(pending_sample.timestamp_);
+    offsets.push_back(header.payload_size_);
+    header.payload_size_ += pending_sample.sample_.size();
+    header.min_timestamp_ =
+      min(header.min_timestamp_, pending_sample.timestamp_);
+    header.max_timestamp_ =
+      max(header.max_timestamp_, pending_sample.timestamp_);
+  }
+  offsets.push_back(header.payload_size_);
+  // We write the segment to a temporary file first, so that a partially
+  // written segment is never picked up.
+  string tmp_path = path + ".tmp";
+  ofstream segment_file(tmp_path.c_str(),
+                        ios::out | ios::trunc | ios::binary);
+  CHECK(segment_file.is_open()) << "Could not create " << tmp_path;
+  segment_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  segment_file.write(reinterpret_cast<const char*>(&keys[0]),
+                     num_records * sizeof(SampleKey));
+  segment_file.write(reinterpret_cast<const char*>(&timestamps[0]),
+                     num_records * sizeof(uint64_t));
+  segment_file.write(reinterpret_cast<const char*>(&offsets[0]),
+                     (num_records + 1) * sizeof(uint64_t));
+  for (auto& key_index : order) {
+    const string& sample = batch.samples_[key_index.second].sample_;
+    segment_file.write(sample.data(), sample.size());
+  }
+  segment_file.close();
+  CHECK(!segment_file.fail()) << "Could not write " << tmp_path;
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    PLOG(FATAL) << "Could not rename " << tmp_path << " to " << path;
+  }
+}
+
+void SampleSegmentStore::WriteSegments() {
+  boost::unique_lock<boost::mutex> lock(lock_);
+  while (true) {
+    while (sealed_batches_.empty() && !stop_) {
+      batch_sealed_.wait(lock);
+    }
+    if (sealed_batches_.empty()) {
+      // We have been stopped.
+      break;
+    }
+    // The batch is not modified once it has been sealed, so we can write it
+    // without holding the lock. The lookups keep using the batch until its
+    // segment has been opened.
+    SampleBatch* batch = sealed_batches_.front();
+    string path = SegmentPath(next_segment_id_++);
+    lock.unlock();
+    WriteSegment(*batch, path);
+    lock.lock();
+    OpenSegment(path);
+    sealed_batches_.pop_front();
+    delete batch;
+    batch_written_.notify_all();
+  }
+}
+
+}  // namespace firmament
@@ -0,0 +1,196 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// On-disk store for the samples the knowledge base serializes. The samples
+// are written in immutable segment files. Each segment holds an index made of
+// a key column, a timestamp column and an offset column, followed by the
+// serialized samples. The records of a segment are sorted by key and
+// timestamp, and the segments are memory-mapped when they are opened. Hence,
+// the samples of a machine or task within a time range can be found without
+// reading the entire store.
+//
+// The store keeps an in-memory index of the segments that hold samples of
+// each key, so looking up a key only touches the segments that hold it.
+// Full segments are sorted and written by a background thread.
+
+#ifndef FIRMAMENT_SCHEDULING_SAMPLE_SEGMENT_STORE_H
+#define FIRMAMENT_SCHEDULING_SAMPLE_SEGMENT_STORE_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/thread.hpp>
+
+#include "base/common.h"
+#include "base/types.h"
+
+namespace firmament {
+
+/**
+ * Key of the samples in the store. Task samples use their task id as the low
+ * half, and machine samples use the bytes of their resource id.
+ */
+struct SampleKey {
+  SampleKey() : high_(0), low_(0) {
+  }
+  SampleKey(uint64_t high, uint64_t low) : high_(high), low_(low) {
+  }
+  inline bool operator==(const SampleKey& other) const {
+    return high_ == other.high_ && low_ == other.low_;
+  }
+  inline bool operator<(const SampleKey& other) const {
+    return high_ < other.high_ || (high_ == other.high_ && low_ < other.low_);
+  }
+  uint64_t high_;
+  uint64_t low_;
+};
+
+struct SampleKeyHash {
+  size_t operator()(const SampleKey& key) const {
+    size_t seed = 0;
+    boost::hash_combine(seed, key.high_);
+    boost::hash_combine(seed, key.low_);
+    return seed;
+  }
+};
+
+class SampleSegmentStore {
+ public:
+  /**
+   * Opens the store in directory. The existing segments are memory-mapped,
+   * but not read.
+   * @param directory the directory containing the segment files
+   * @param records_per_segment number of samples after which the store writes
+   * a segment
+   * @param read_only true if no samples may be appended to the store
+   */
+  SampleSegmentStore(const string& directory, uint64_t records_per_segment,
+                     bool read_only);
+  ~SampleSegmentStore();
+
+  /**
+   * Appends a sample to the store. Once -records_per_segment samples have
+   * been appended, they are handed to the writer thread.
+   * @param key the key of the machine or task the sample is for
+   * @param timestamp the time of the sample
+   * @param sample the serialized sample
+   */
+  void Append(const SampleKey& key, uint64_t timestamp, const string& sample);
+
+  /**
+   * Writes the samples that have not been written to a segment yet, and
+   * waits until the writer thread has written them.
+   */
+  void Flush();
+
+  /**
+   * Gets the samples of key with timestamps in [start_time, end_time].
+   * @param samples vector to which the serialized samples are appended in
+   * timestamp order
+   */
+  void Lookup(const SampleKey& key, uint64_t start_time, uint64_t end_time,
+              vector<string>* samples);
+
+  /**
+   * Gets the most recent samples of key.
+   * @param max_samples the maximum number of samples to get
+   * @param samples vector to which the serialized samples are appended in
+   * timestamp order
+   */
+  void LookupLatest(const SampleKey& key, uint64_t max_samples,
+                    vector<string>* samples);
+
+  inline bool read_only() const {
+    return read_only_;
+  }
+
+  inline uint64_t num_segments() {
+    boost::lock_guard<boost::mutex> lock(lock_);
+    return segments_.size();
+  }
+
+ private:
+  // A sample that has not been written to a segment yet.
+  struct PendingSample {
+    SampleKey key_;
+    uint64_t timestamp_;
+    string sample_;
+  };
+
+  // Samples that have not been written to a segment yet. A batch is no
+  // longer modified once it has been handed to the writer thread.
+  struct SampleBatch {
+    vector<PendingSample> samples_;
+    // The indices of each key's samples, in the order they were appended.
+    unordered_map<SampleKey, vector<uint32_t>, SampleKeyHash> key_samples_;
+  };
+
+  // A memory-mapped segment. The pointers point into the mapping.
+  struct Segment {
+    void* data_;
+    uint64_t size_;
+    uint64_t num_records_;
+    uint64_t min_timestamp_;
+    uint64_t max_timestamp_;
+    const SampleKey* keys_;
+    const uint64_t* timestamps_;
+    const uint64_t* offsets_;
+    const char* payload_;
+  };
+
+  /**
+   * Adds the samples of key in batch with timestamps in
+   * [start_time, end_time] to found.
+   */
+  void FindBatchSamples(const SampleBatch& batch, const SampleKey& key,
+                        uint64_t start_time, uint64_t end_time,
+                        vector<pair<uint64_t, string> >* found);
+  /**
+   * Adds the most recent samples of key in batch to found, newest first,
+   * until found holds max_samples samples.
+   */
+  void FindLatestBatchSamples(const SampleBatch& batch, const SampleKey& key,
+                              uint64_t max_samples,
+                              vector<pair<uint64_t, string> >* found);
+  /**
+   * @return the index of the first record of the segment that is not smaller
+   * than (key, timestamp)
+   */
+  uint64_t LowerBound(const Segment& segment, const SampleKey& key,
+                      uint64_t timestamp);
+  // Must be called with lock_ held once the writer thread is running.
+  void OpenSegment(const string& path);
+  // Hands the pending samples to the writer thread. Must be called with
+  // lock_ held.
+  void SealPendingBatch();
+  string SegmentPath(uint64_t segment_id);
+  void WriteSegment(const SampleBatch& batch, const string& path);
+  // Loop of the writer thread.
+  void WriteSegments();
+
+  string directory_;
+  uint64_t records_per_segment_;
+  bool read_only_;
+  // Segments in the order in which they were written.
+  vector<Segment> segments_;
+  // The indices of the segments that hold samples of each key, in ascending
+  // order.
+  unordered_map<SampleKey, vector<uint32_t>, SampleKeyHash> key_segments_;
+  // The batch to which samples are appended.
+  SampleBatch pending_batch_;
+  // Batches waiting for the writer thread, oldest first. They are removed
+  // once their segments have been opened.
+  deque<SampleBatch*> sealed_batches_;
+  uint64_t next_segment_id_;
+  bool stop_;
+  boost::mutex lock_;
+  boost::condition_variable batch_sealed_;
+  boost::condition_variable batch_written_;
+  boost::thread* writer_thread_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_SAMPLE_SEGMENT_STORE_H
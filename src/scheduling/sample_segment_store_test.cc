@@ -0,0 +1,109 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the sample segment store.
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "misc/utils.h"
+#include "scheduling/sample_segment_store.h"
+
+namespace firmament {
+
+class SampleSegmentStoreTest : public ::testing::Test {
+ protected:
+  SampleSegmentStoreTest() {
+    FLAGS_v = 2;
+  }
+
+  virtual void SetUp() {
+    char dir_template[] = "/tmp/sample_segment_store_test_XXXXXX";
+    dir_ = CHECK_NOTNULL(mkdtemp(dir_template));
+  }
+
+  virtual void TearDown() {
+    string cmd = "rm -rf " + dir_;
+    CHECK_EQ(system(cmd.c_str()), 0);
+  }
+
+  // Appends a sample for every timestamp in [1, num_samples]. The samples
+  // alternate between the keys, and hold their timestamps.
+  void AppendSamples(SampleSegmentStore* store, uint64_t num_samples,
+                     const vector<SampleKey>& keys) {
+    for (uint64_t timestamp = 1; timestamp <= num_samples; ++timestamp) {
+      store->Append(keys[timestamp % keys.size()], timestamp,
+                    to_string(timestamp));
+    }
+  }
+
+  string dir_;
+};
+
+// Checks that the lookups find the samples whether they are pending, waiting
+// for the writer thread or written to segments.
+TEST_F(SampleSegmentStoreTest, LookupAcrossSegments) {
+  vector<SampleKey> keys;
+  keys.push_back(SampleKey(0, 1));
+  keys.push_back(SampleKey(0, 2));
+  SampleSegmentStore store(dir_, 10, false);
+  AppendSamples(&store, 95, keys);
+  vector<string> samples;
+  store.LookupLatest(keys[1], 3, &samples);
+  ASSERT_EQ(samples.size(), 3);
+  EXPECT_EQ(samples[0], "91");
+  EXPECT_EQ(samples[2], "95");
+  samples.clear();
+  store.Lookup(keys[0], 8, 24, &samples);
+  ASSERT_EQ(samples.size(), 9);
+  for (uint64_t index = 0; index < samples.size(); ++index) {
+    EXPECT_EQ(samples[index], to_string(8 + 2 * index));
+  }
+  store.Flush();
+  EXPECT_EQ(store.num_segments(), 10);
+  samples.clear();
+  store.LookupLatest(keys[0], 100, &samples);
+  ASSERT_EQ(samples.size(), 47);
+  EXPECT_EQ(samples.front(), "2");
+  EXPECT_EQ(samples.back(), "94");
+  // Keys without samples are found in none of the segments.
+  samples.clear();
+  store.LookupLatest(SampleKey(0, 3), 100, &samples);
+  store.Lookup(SampleKey(0, 3), 0, 100, &samples);
+  EXPECT_TRUE(samples.empty());
+}
+
+// Checks that the segments are found again when the store is reopened, and
+// that a read-only store does not write any segments.
+TEST_F(SampleSegmentStoreTest, ReopenStore) {
+  vector<SampleKey> keys;
+  keys.push_back(SampleKey(1, 1));
+  keys.push_back(SampleKey(2, 1));
+  keys.push_back(SampleKey(3, 1));
+  {
+    SampleSegmentStore store(dir_, 16, false);
+    AppendSamples(&store, 100, keys);
+  }
+  SampleSegmentStore store(dir_, 16, true);
+  EXPECT_TRUE(store.read_only());
+  EXPECT_EQ(store.num_segments(), 7);
+  vector<string> samples;
+  store.Lookup(keys[0], 90, 100, &samples);
+  ASSERT_EQ(samples.size(), 4);
+  EXPECT_EQ(samples[0], "90");
+  EXPECT_EQ(samples[3], "99");
+  store.Flush();
+  EXPECT_EQ(store.num_segments(), 7);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -34,7 +34,8 @@ using store::ObjectStoreInterface;
 
 struct SchedulerStats {
   SchedulerStats() : algorithm_runtime_(numeric_limits<uint64_t>::max()),
-    scheduler_runtime_(0ULL), total_runtime_(0ULL) {
+    scheduler_runtime_(0ULL), total_runtime_(0ULL),
+    graph_export_runtime_(0ULL), solver_restarts_(0ULL) {
   }
   // Accounts only the algorithmic part of the scheduler (in u-sec).
   uint64_t algorithm_runtime_;
@@ -45,6 +46,11 @@ struct SchedulerStats {
   // writing it, running the solver, reading the output and updating again
   // the graph.
   uint64_t total_runtime_;
+  // Accounts only the time spent sending the graph to the solver (in u-sec).
+  uint64_t graph_export_runtime_;
+  // Number of times the solver crashed and had to be restarted during the
+  // scheduling round.
+  uint64_t solver_restarts_;
 };
 
 class SchedulerInterface : public PrintableInterface {
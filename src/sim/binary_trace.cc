@@ -0,0 +1,278 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "sim/binary_trace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "misc/binary_frame.h"
+#include "misc/string_utils.h"
+
+namespace firmament {
+namespace sim {
+
+// "FIRMTRCE" in little-endian.
+static const uint64_t kBinaryTraceMagic = 0x4543525454524946ULL;
+static const uint32_t kBinaryTraceVersion = 1;
+// Number of task events in a block.
+static const uint64_t kTaskEventsBlockSize = 64 * 1024;
+
+string BinaryTraceFileName(const string& trace_path, const string& name) {
+  return trace_path + "/binary/" + name + ".bin";
+}
+
+string BinaryTaskEventsFileName(const string& trace_path, int32_t file_id) {
+  string file_name;
+  spf(&file_name, "%s/binary/task_events/part-%05d-of-00500.bin",
+      trace_path.c_str(), file_id);
+  return file_name;
+}
+
+BinaryTraceFile::BinaryTraceFile()
+  : data_(NULL), size_(0), num_records_(0) {
+}
+
+BinaryTraceFile::~BinaryTraceFile() {
+  Close();
+}
+
+bool BinaryTraceFile::Open(const string& file_name, uint32_t record_size) {
+  Close();
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0 ||
+      static_cast<uint64_t>(file_stat.st_size) < sizeof(BinaryTraceHeader)) {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+  data_ = static_cast<const char*>(data);
+  size_ = file_stat.st_size;
+  const BinaryTraceHeader* header =
+    reinterpret_cast<const BinaryTraceHeader*>(data_);
+  if (header->magic_ != kBinaryTraceMagic ||
+      header->version_ != kBinaryTraceVersion ||
+      header->record_size_ != record_size ||
+      (record_size > 0 && sizeof(BinaryTraceHeader) +
+       header->num_records_ * record_size > size_)) {
+    LOG(ERROR) << file_name << " is not a binary trace file of the expected "
+               << "format";
+    Close();
+    return false;
+  }
+  num_records_ = header->num_records_;
+  return true;
+}
+
+void BinaryTraceFile::Close() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+  data_ = NULL;
+  size_ = 0;
+  num_records_ = 0;
+}
+
+BinaryTaskEventsReader::BinaryTaskEventsReader()
+  : next_block_offset_(0), next_block_event_(0) {
+}
+
+bool BinaryTaskEventsReader::Open(const string& file_name) {
+  if (!BinaryTraceFile::Open(file_name, 0)) {
+    return false;
+  }
+  next_block_offset_ = sizeof(BinaryTraceHeader);
+  block_events_.clear();
+  next_block_event_ = 0;
+  return true;
+}
+
+bool BinaryTaskEventsReader::Next(TraceTaskEvent* task_event) {
+  if (next_block_event_ == block_events_.size()) {
+    if (next_block_offset_ >= size_) {
+      return false;
+    }
+    DecodeBlock();
+  }
+  *task_event = block_events_[next_block_event_++];
+  return true;
+}
+
+void BinaryTaskEventsReader::DecodeBlock() {
+  const char* cursor = data_ + next_block_offset_;
+  const char* end = data_ + size_;
+  uint64_t num_events;
+  uint64_t block_size;
+  CHECK(ReadVarint(&cursor, end, &num_events) &&
+        ReadVarint(&cursor, end, &block_size))
+    << "Truncated task events block header";
+  CHECK_LE(block_size, static_cast<uint64_t>(end - cursor));
+  end = cursor + block_size;
+  next_block_offset_ = end - data_;
+  block_events_.resize(num_events);
+  next_block_event_ = 0;
+  // The columns are stored one after the other.
+  uint64_t value;
+  uint64_t timestamp = 0;
+  for (auto& task_event : block_events_) {
+    CHECK(ReadVarint(&cursor, end, &value)) << "Truncated task events block";
+    timestamp += value;
+    task_event.timestamp_ = timestamp;
+  }
+  int64_t job_id_delta;
+  uint64_t job_id = 0;
+  for (auto& task_event : block_events_) {
+    CHECK(ReadSignedVarint(&cursor, end, &job_id_delta))
+      << "Truncated task events block";
+    job_id += job_id_delta;
+    task_event.job_id_ = job_id;
+  }
+  for (auto& task_event : block_events_) {
+    CHECK(ReadVarint(&cursor, end, &value)) << "Truncated task events block";
+    task_event.task_index_ = value;
+  }
+  for (auto& task_event : block_events_) {
+    CHECK(ReadVarint(&cursor, end, &value)) << "Truncated task events block";
+    task_event.event_type_ = value;
+  }
+  for (auto& task_event : block_events_) {
+    CHECK(ReadVarint(&cursor, end, &value)) << "Truncated task events block";
+    task_event.scheduling_class_ = value;
+  }
+  for (auto& task_event : block_events_) {
+    CHECK(ReadVarint(&cursor, end, &value)) << "Truncated task events block";
+    task_event.priority_ = value;
+  }
+  CHECK_LE(num_events * (1 + sizeof(float) + sizeof(double)),
+           static_cast<uint64_t>(end - cursor));
+  for (auto& task_event : block_events_) {
+    task_event.fields_set_ = static_cast<uint8_t>(*cursor);
+    cursor++;
+  }
+  // The requests are not aligned, so we copy them out.
+  for (auto& task_event : block_events_) {
+    memcpy(&task_event.cpu_request_, cursor, sizeof(float));
+    cursor += sizeof(float);
+  }
+  for (auto& task_event : block_events_) {
+    memcpy(&task_event.ram_request_, cursor, sizeof(double));
+    cursor += sizeof(double);
+  }
+}
+
+BinaryTraceWriter::BinaryTraceWriter(const string& file_name,
+                                     uint32_t record_size)
+  : file_name_(file_name) {
+  header_.magic_ = kBinaryTraceMagic;
+  header_.record_size_ = record_size;
+  header_.version_ = kBinaryTraceVersion;
+  header_.num_records_ = 0;
+  if ((file_ = fopen(file_name.c_str(), "w")) == NULL) {
+    PLOG(FATAL) << "Failed to open " << file_name << " for writing";
+  }
+  // The header is rewritten once we know the number of records.
+  Write(&header_, sizeof(header_));
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() {
+  Close();
+}
+
+void BinaryTraceWriter::Close() {
+  if (!file_) {
+    return;
+  }
+  CHECK_EQ(fseek(file_, 0, SEEK_SET), 0);
+  Write(&header_, sizeof(header_));
+  if (fclose(file_) != 0) {
+    PLOG(FATAL) << "Failed to write " << file_name_;
+  }
+  file_ = NULL;
+}
+
+void BinaryTraceWriter::Write(const void* data, size_t size) {
+  if (fwrite(data, 1, size, file_) != size) {
+    PLOG(FATAL) << "Failed to write " << file_name_;
+  }
+}
+
+BinaryTaskEventsWriter::BinaryTaskEventsWriter(const string& file_name)
+  : writer_(file_name, 0), last_timestamp_(0) {
+}
+
+void BinaryTaskEventsWriter::Append(const TraceTaskEvent& task_event) {
+  CHECK_GE(task_event.timestamp_, last_timestamp_)
+    << "Task events must be appended in timestamp order";
+  last_timestamp_ = task_event.timestamp_;
+  block_events_.push_back(task_event);
+  if (block_events_.size() == kTaskEventsBlockSize) {
+    EncodeBlock();
+  }
+}
+
+void BinaryTaskEventsWriter::Close() {
+  if (!block_events_.empty()) {
+    EncodeBlock();
+  }
+  writer_.Close();
+}
+
+void BinaryTaskEventsWriter::EncodeBlock() {
+  block_.clear();
+  uint64_t timestamp = 0;
+  for (auto& task_event : block_events_) {
+    AppendVarint(task_event.timestamp_ - timestamp, &block_);
+    timestamp = task_event.timestamp_;
+  }
+  uint64_t job_id = 0;
+  for (auto& task_event : block_events_) {
+    AppendSignedVarint(task_event.job_id_ - job_id, &block_);
+    job_id = task_event.job_id_;
+  }
+  for (auto& task_event : block_events_) {
+    AppendVarint(task_event.task_index_, &block_);
+  }
+  for (auto& task_event : block_events_) {
+    AppendVarint(task_event.event_type_, &block_);
+  }
+  for (auto& task_event : block_events_) {
+    AppendVarint(task_event.scheduling_class_, &block_);
+  }
+  for (auto& task_event : block_events_) {
+    AppendVarint(task_event.priority_, &block_);
+  }
+  for (auto& task_event : block_events_) {
+    block_.push_back(static_cast<char>(task_event.fields_set_));
+  }
+  for (auto& task_event : block_events_) {
+    block_.append(reinterpret_cast<const char*>(&task_event.cpu_request_),
+                  sizeof(float));
+  }
+  for (auto& task_event : block_events_) {
+    block_.append(reinterpret_cast<const char*>(&task_event.ram_request_),
+                  sizeof(double));
+  }
+  string block_header;
+  AppendVarint(block_events_.size(), &block_header);
+  AppendVarint(block_.size(), &block_header);
+  writer_.Write(block_header.data(), block_header.size());
+  writer_.Write(block_.data(), block_.size());
+  writer_.IncrementNumRecords(block_events_.size());
+  block_events_.clear();
+}
+
+}  // namespace sim
+}  // namespace firmament
@@ -0,0 +1,227 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Binary version of the Google trace files the simulator loads. The binary
+// trace is written once by google_trace_processor -binary_trace, and is then
+// memory-mapped by the GoogleTraceLoader when it runs with
+// -trace_format=binary.
+//
+// Every file starts with a BinaryTraceHeader. The machine events, the number
+// of tasks of each job, the task runtimes and the task usage statistics are
+// stored as arrays of fixed-size records that are used in place. The task
+// events are stored in blocks of columns. The timestamps and job ids are
+// delta-encoded, and all the integers are varint-encoded.
+
+#ifndef FIRMAMENT_SIM_BINARY_TRACE_H
+#define FIRMAMENT_SIM_BINARY_TRACE_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+
+namespace firmament {
+namespace sim {
+
+struct BinaryTraceHeader {
+  uint64_t magic_;
+  // Size of the records, or 0 if the file holds task events blocks.
+  uint32_t record_size_;
+  uint32_t version_;
+  uint64_t num_records_;
+};
+
+struct TraceMachineEvent {
+  uint64_t timestamp_;
+  uint64_t machine_id_;
+  int32_t event_type_;
+  uint32_t padding_;
+};
+
+struct TraceJobNumTasks {
+  uint64_t job_id_;
+  uint64_t num_tasks_;
+};
+
+struct TraceTaskRuntime {
+  uint64_t job_id_;
+  uint64_t task_index_;
+  uint64_t runtime_;
+};
+
+struct TraceTaskUsage {
+  uint64_t job_id_;
+  uint64_t task_index_;
+  double avg_mean_cpu_usage_;
+  double avg_canonical_mem_usage_;
+  double avg_assigned_mem_usage_;
+  double avg_unmapped_page_cache_;
+  double avg_total_page_cache_;
+  double avg_mean_disk_io_time_;
+  double avg_mean_local_disk_used_;
+  double avg_cpi_;
+  double avg_mai_;
+};
+
+// Bits of TraceTaskEvent::fields_set_.
+static const uint8_t kTraceCpuRequestSet = 1 << 0;
+static const uint8_t kTraceRamRequestSet = 1 << 1;
+
+struct TraceTaskEvent {
+  uint64_t timestamp_;
+  uint64_t job_id_;
+  uint64_t task_index_;
+  uint32_t event_type_;
+  uint32_t scheduling_class_;
+  uint32_t priority_;
+  uint8_t fields_set_;
+  // The requests are normalized to the largest machine in the trace.
+  float cpu_request_;
+  double ram_request_;
+};
+
+/**
+ * @return the path of a binary trace file in the trace directory
+ */
+string BinaryTraceFileName(const string& trace_path, const string& name);
+string BinaryTaskEventsFileName(const string& trace_path, int32_t file_id);
+
+/**
+ * A memory-mapped binary trace file.
+ */
+class BinaryTraceFile {
+ public:
+  BinaryTraceFile();
+  virtual ~BinaryTraceFile();
+
+  void Close();
+
+  inline uint64_t num_records() const {
+    return num_records_;
+  }
+
+ protected:
+  /**
+   * Maps the file and checks its header.
+   * @param record_size the expected size of the records
+   * @return false if the file could not be opened or has a different format
+   */
+  bool Open(const string& file_name, uint32_t record_size);
+
+  const char* data_;
+  uint64_t size_;
+  uint64_t num_records_;
+};
+
+/**
+ * Reader for the files that hold fixed-size records.
+ */
+template <typename T>
+class BinaryTableReader : public BinaryTraceFile {
+ public:
+  bool Open(const string& file_name) {
+    return BinaryTraceFile::Open(file_name, sizeof(T));
+  }
+
+  inline const T& operator[](uint64_t index) const {
+    const T* records =
+      reinterpret_cast<const T*>(data_ + sizeof(BinaryTraceHeader));
+    return records[index];
+  }
+};
+
+/**
+ * Reader for the task events files. The events are decoded one block at a
+ * time.
+ */
+class BinaryTaskEventsReader : public BinaryTraceFile {
+ public:
+  BinaryTaskEventsReader();
+
+  bool Open(const string& file_name);
+
+  /**
+   * Gets the next task event.
+   * @return false if there are no events left
+   */
+  bool Next(TraceTaskEvent* task_event);
+
+ private:
+  void DecodeBlock();
+
+  // Offset of the next block to decode.
+  uint64_t next_block_offset_;
+  vector<TraceTaskEvent> block_events_;
+  uint64_t next_block_event_;
+};
+
+/**
+ * Writes a binary trace file.
+ */
+class BinaryTraceWriter {
+ public:
+  BinaryTraceWriter(const string& file_name, uint32_t record_size);
+  ~BinaryTraceWriter();
+
+  /**
+   * Writes the header and closes the file.
+   */
+  void Close();
+
+  void Write(const void* data, size_t size);
+
+  inline void IncrementNumRecords(uint64_t num_records) {
+    header_.num_records_ += num_records;
+  }
+
+ private:
+  string file_name_;
+  FILE* file_;
+  BinaryTraceHeader header_;
+};
+
+template <typename T>
+class BinaryTableWriter {
+ public:
+  explicit BinaryTableWriter(const string& file_name)
+    : writer_(file_name, sizeof(T)) {
+  }
+
+  void Append(const T& record) {
+    writer_.Write(&record, sizeof(T));
+    writer_.IncrementNumRecords(1);
+  }
+
+  void Close() {
+    writer_.Close();
+  }
+
+ private:
+  BinaryTraceWriter writer_;
+};
+
+class BinaryTaskEventsWriter {
+ public:
+  explicit BinaryTaskEventsWriter(const string& file_name);
+
+  /**
+   * Appends an event. The events must be appended in timestamp order.
+   */
+  void Append(const TraceTaskEvent& task_event);
+  void Close();
+
+ private:
+  void EncodeBlock();
+
+  BinaryTraceWriter writer_;
+  vector<TraceTaskEvent> block_events_;
+  // Buffer in which the blocks are encoded. It is reused across blocks.
+  string block_;
+  uint64_t last_timestamp_;
+};
+
+}  // namespace sim
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SIM_BINARY_TRACE_H
@@ -0,0 +1,106 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the binary trace reader and writers.
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include "sim/binary_trace.h"
+
+namespace firmament {
+namespace sim {
+
+class BinaryTraceTest : public ::testing::Test {
+ protected:
+  BinaryTraceTest() {
+    file_name_ = "/tmp/firmament_binary_trace_test.bin";
+  }
+
+  virtual void TearDown() {
+    unlink(file_name_.c_str());
+  }
+
+  string file_name_;
+};
+
+TEST_F(BinaryTraceTest, ReadWriteTable) {
+  BinaryTableWriter<TraceTaskRuntime> writer(file_name_);
+  for (uint64_t task_index = 0; task_index < 10; ++task_index) {
+    TraceTaskRuntime task_runtime;
+    task_runtime.job_id_ = 42;
+    task_runtime.task_index_ = task_index;
+    task_runtime.runtime_ = task_index * 1000;
+    writer.Append(task_runtime);
+  }
+  writer.Close();
+  BinaryTableReader<TraceTaskRuntime> reader;
+  CHECK(reader.Open(file_name_));
+  CHECK_EQ(reader.num_records(), 10);
+  CHECK_EQ(reader[7].job_id_, 42);
+  CHECK_EQ(reader[7].task_index_, 7);
+  CHECK_EQ(reader[7].runtime_, 7000);
+  // The records have a different size.
+  BinaryTableReader<TraceJobNumTasks> wrong_reader;
+  CHECK(!wrong_reader.Open(file_name_));
+}
+
+TEST_F(BinaryTraceTest, ReadWriteTaskEvents) {
+  // More events than fit in a block.
+  const uint64_t num_events = 100 * 1000;
+  BinaryTaskEventsWriter writer(file_name_);
+  for (uint64_t index = 0; index < num_events; ++index) {
+    TraceTaskEvent task_event;
+    memset(&task_event, 0, sizeof(task_event));
+    task_event.timestamp_ = 600000000 + index / 3;
+    // The job ids are not sorted.
+    task_event.job_id_ = 6000000000ULL + (index % 7) * 1000;
+    task_event.task_index_ = index;
+    task_event.event_type_ = index % 9;
+    task_event.scheduling_class_ = index % 4;
+    task_event.priority_ = index % 12;
+    if (index % 2 == 0) {
+      task_event.fields_set_ = kTraceCpuRequestSet | kTraceRamRequestSet;
+      task_event.cpu_request_ = 0.125;
+      task_event.ram_request_ = 0.0001 * (index % 100);
+    }
+    writer.Append(task_event);
+  }
+  writer.Close();
+  BinaryTaskEventsReader reader;
+  CHECK(reader.Open(file_name_));
+  CHECK_EQ(reader.num_records(), num_events);
+  TraceTaskEvent task_event;
+  for (uint64_t index = 0; index < num_events; ++index) {
+    CHECK(reader.Next(&task_event));
+    CHECK_EQ(task_event.timestamp_, 600000000 + index / 3);
+    CHECK_EQ(task_event.job_id_, 6000000000ULL + (index % 7) * 1000);
+    CHECK_EQ(task_event.task_index_, index);
+    CHECK_EQ(task_event.event_type_, index % 9);
+    CHECK_EQ(task_event.scheduling_class_, index % 4);
+    CHECK_EQ(task_event.priority_, index % 12);
+    if (index % 2 == 0) {
+      CHECK_EQ(task_event.fields_set_,
+               kTraceCpuRequestSet | kTraceRamRequestSet);
+      CHECK_EQ(task_event.cpu_request_, 0.125);
+      CHECK_EQ(task_event.ram_request_, 0.0001 * (index % 100));
+    } else {
+      CHECK_EQ(task_event.fields_set_, 0);
+    }
+  }
+  CHECK(!reader.Next(&task_event));
+}
+
+}  // namespace sim
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  FLAGS_logtostderr = true;
+  FLAGS_stderrthreshold = 0;
+  return RUN_ALL_TESTS();
+}
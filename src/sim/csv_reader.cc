@@ -0,0 +1,236 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "sim/csv_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace firmament {
+namespace sim {
+
+// Longest field that can be parsed as a floating point number. The trace's
+// numbers are much shorter.
+static const uint64_t kMaxNumberLength = 64;
+
+CSVReader::CSVReader()
+  : data_(NULL), size_(0), cursor_(NULL), line_number_(0) {
+}
+
+CSVReader::~CSVReader() {
+  Close();
+}
+
+bool CSVReader::Open(const string& file_name) {
+  Close();
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    close(fd);
+    return false;
+  }
+  size_ = file_stat.st_size;
+  if (size_ > 0) {
+    void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      size_ = 0;
+      return false;
+    }
+    // We read the file once, from start to end.
+    madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+  }
+  // The mapping remains valid after the file is closed.
+  close(fd);
+  cursor_ = data_;
+  line_number_ = 0;
+  file_name_ = file_name;
+  return true;
+}
+
+void CSVReader::Close() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+  data_ = NULL;
+  size_ = 0;
+  cursor_ = NULL;
+  fields_.clear();
+}
+
+bool CSVReader::NextRow() {
+  const char* data_end = data_ + size_;
+  while (cursor_ < data_end) {
+    const char* row_begin = cursor_;
+    // memchr is vectorized, which makes it much faster than a byte-by-byte
+    // scan for the delimiters.
+    const char* row_end = static_cast<const char*>(
+        memchr(row_begin, '\n', data_end - row_begin));
+    if (row_end == NULL) {
+      row_end = data_end;
+      cursor_ = data_end;
+    } else {
+      cursor_ = row_end + 1;
+    }
+    line_number_++;
+    if (row_end > row_begin && *(row_end - 1) == '\r') {
+      row_end--;
+    }
+    if (row_begin == row_end) {
+      // Skip empty lines.
+      continue;
+    }
+    fields_.clear();
+    Field field;
+    field.begin_ = row_begin;
+    while (true) {
+      const char* comma = static_cast<const char*>(
+          memchr(field.begin_, ',', row_end - field.begin_));
+      if (comma == NULL) {
+        field.end_ = row_end;
+        fields_.push_back(field);
+        break;
+      }
+      field.end_ = comma;
+      fields_.push_back(field);
+      field.begin_ = comma + 1;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool CSVReader::ParseUInt64(uint32_t index, uint64_t* value) const {
+  DCHECK_LT(index, fields_.size());
+  const char* begin = fields_[index].begin_;
+  const char* end = fields_[index].end_;
+  if (begin == end) {
+    return false;
+  }
+  uint64_t result = 0;
+  for (const char* digit = begin; digit < end; ++digit) {
+    if (*digit < '0' || *digit > '9') {
+      return false;
+    }
+    uint64_t digit_value = *digit - '0';
+    if (result > (UINT64_MAX - digit_value) / 10) {
+      // Overflow.
+      return false;
+    }
+    result = result * 10 + digit_value;
+  }
+  *value = result;
+  return true;
+}
+
+bool CSVReader::ParseInt64(uint32_t index, int64_t* value) const {
+  DCHECK_LT(index, fields_.size());
+  const char* begin = fields_[index].begin_;
+  const char* end = fields_[index].end_;
+  bool negative = false;
+  if (begin < end && (*begin == '-' || *begin == '+')) {
+    negative = *begin == '-';
+    begin++;
+  }
+  if (begin == end) {
+    return false;
+  }
+  // The magnitude of INT64_MIN is one larger than INT64_MAX.
+  uint64_t limit = static_cast<uint64_t>(INT64_MAX) + (negative ? 1 : 0);
+  uint64_t result = 0;
+  for (const char* digit = begin; digit < end; ++digit) {
+    if (*digit < '0' || *digit > '9') {
+      return false;
+    }
+    uint64_t digit_value = *digit - '0';
+    if (result > (limit - digit_value) / 10) {
+      // Overflow.
+      return false;
+    }
+    result = result * 10 + digit_value;
+  }
+  *value = negative ? -static_cast<int64_t>(result - 1) - 1 :
+    static_cast<int64_t>(result);
+  return true;
+}
+
+bool CSVReader::ParseDouble(uint32_t index, double* value) const {
+  DCHECK_LT(index, fields_.size());
+  uint64_t length = fields_[index].end_ - fields_[index].begin_;
+  if (length == 0 || length >= kMaxNumberLength) {
+    return false;
+  }
+  // strtod needs a NUL-terminated string. We copy the field to the stack
+  // rather than to a heap-allocated string.
+  char number[kMaxNumberLength];
+  memcpy(number, fields_[index].begin_, length);
+  number[length] = '\0';
+  char* number_end = NULL;
+  double result = strtod(number, &number_end);
+  if (number_end != number + length) {
+    return false;
+  }
+  *value = result;
+  return true;
+}
+
+uint64_t CSVReader::GetUInt64(uint32_t index) const {
+  uint64_t value = 0;
+  if (!ParseUInt64(index, &value)) {
+    FailToParse(index, "an unsigned integer");
+  }
+  return value;
+}
+
+int64_t CSVReader::GetInt64(uint32_t index) const {
+  int64_t value = 0;
+  if (!ParseInt64(index, &value)) {
+    FailToParse(index, "an integer");
+  }
+  return value;
+}
+
+int64_t CSVReader::GetInt64(uint32_t index, int64_t empty_value) const {
+  if (IsEmpty(index)) {
+    return empty_value;
+  }
+  return GetInt64(index);
+}
+
+double CSVReader::GetDouble(uint32_t index) const {
+  double value = 0;
+  if (!ParseDouble(index, &value)) {
+    FailToParse(index, "a number");
+  }
+  return value;
+}
+
+double CSVReader::GetDouble(uint32_t index, double empty_value) const {
+  if (IsEmpty(index)) {
+    return empty_value;
+  }
+  return GetDouble(index);
+}
+
+string CSVReader::GetString(uint32_t index) const {
+  DCHECK_LT(index, fields_.size());
+  return string(fields_[index].begin_, fields_[index].end_);
+}
+
+void CSVReader::FailToParse(uint32_t index, const char* type) const {
+  LOG(FATAL) << "Field " << index << " on line " << line_number_ << " of "
+             << file_name_ << " is not " << type << ": \""
+             << GetString(index) << "\"";
+}
+
+}  // namespace sim
+}  // namespace firmament
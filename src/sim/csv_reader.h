@@ -0,0 +1,97 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Reader for the comma-separated files of the Google cluster trace. The file
+// is memory-mapped and the rows are tokenized in place, so reading a row does
+// not copy or allocate. The fields are parsed on demand.
+
+#ifndef FIRMAMENT_SIM_CSV_READER_H
+#define FIRMAMENT_SIM_CSV_READER_H
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+
+namespace firmament {
+namespace sim {
+
+class CSVReader {
+ public:
+  CSVReader();
+  ~CSVReader();
+
+  /**
+   * Memory-maps a file. Any previously opened file is closed.
+   * @param file_name the path of the file
+   * @return false if the file could not be opened
+   */
+  bool Open(const string& file_name);
+  void Close();
+
+  /**
+   * Tokenizes the next non-empty row of the file.
+   * @return false if there are no rows left
+   */
+  bool NextRow();
+
+  /**
+   * Parses a field as an unsigned integer.
+   * @return false if the field is empty or is not a number
+   */
+  bool ParseUInt64(uint32_t index, uint64_t* value) const;
+  bool ParseInt64(uint32_t index, int64_t* value) const;
+  bool ParseDouble(uint32_t index, double* value) const;
+
+  /**
+   * The following methods fail if the field is not a number. The variants
+   * that take an empty_value return it when the field is empty.
+   */
+  uint64_t GetUInt64(uint32_t index) const;
+  int64_t GetInt64(uint32_t index) const;
+  int64_t GetInt64(uint32_t index, int64_t empty_value) const;
+  double GetDouble(uint32_t index) const;
+  double GetDouble(uint32_t index, double empty_value) const;
+  string GetString(uint32_t index) const;
+
+  inline bool IsEmpty(uint32_t index) const {
+    return fields_[index].begin_ == fields_[index].end_;
+  }
+
+  /**
+   * @return the line number of the current row, starting from 1
+   */
+  inline uint64_t line_number() const {
+    return line_number_;
+  }
+
+  inline uint32_t num_fields() const {
+    return fields_.size();
+  }
+
+ private:
+  struct Field {
+    const char* begin_;
+    const char* end_;
+  };
+
+  // Uncopyable, as the reader owns the mapping.
+  CSVReader(const CSVReader&);
+  CSVReader& operator=(const CSVReader&);
+
+  void FailToParse(uint32_t index, const char* type) const;
+
+  const char* data_;
+  uint64_t size_;
+  // Position of the first character that has not been tokenized yet.
+  const char* cursor_;
+  uint64_t line_number_;
+  string file_name_;
+  // The fields of the current row. The vector is reused across rows.
+  vector<Field> fields_;
+};
+
+}  // namespace sim
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SIM_CSV_READER_H
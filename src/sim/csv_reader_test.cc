@@ -0,0 +1,106 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Tests for the CSV reader.
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include "sim/csv_reader.h"
+
+namespace firmament {
+namespace sim {
+
+class CSVReaderTest : public ::testing::Test {
+ protected:
+  CSVReaderTest() {
+    file_name_ = "/tmp/firmament_csv_reader_test.csv";
+  }
+
+  virtual void TearDown() {
+    unlink(file_name_.c_str());
+  }
+
+  void WriteFile(const string& contents) {
+    FILE* csv_file = fopen(file_name_.c_str(), "w");
+    CHECK_NOTNULL(csv_file);
+    fputs(contents.c_str(), csv_file);
+    fclose(csv_file);
+  }
+
+  string file_name_;
+};
+
+TEST_F(CSVReaderTest, ReadRows) {
+  WriteFile("600000000,,3418309,0,,0.125,1e-05\n\n-1,abc\r\nlast,row");
+  CSVReader reader;
+  CHECK(reader.Open(file_name_));
+  CHECK(reader.NextRow());
+  CHECK_EQ(reader.num_fields(), 7);
+  CHECK_EQ(reader.line_number(), 1);
+  CHECK_EQ(reader.GetUInt64(0), 600000000);
+  CHECK(reader.IsEmpty(1));
+  CHECK_EQ(reader.GetInt64(1, -1), -1);
+  CHECK_EQ(reader.GetUInt64(2), 3418309);
+  CHECK_EQ(reader.GetDouble(4, -1), -1);
+  CHECK_EQ(reader.GetDouble(5), 0.125);
+  CHECK_EQ(reader.GetDouble(6), 1e-05);
+  // The empty line is skipped.
+  CHECK(reader.NextRow());
+  CHECK_EQ(reader.num_fields(), 2);
+  CHECK_EQ(reader.line_number(), 3);
+  uint64_t unsigned_value;
+  CHECK(!reader.ParseUInt64(0, &unsigned_value));
+  CHECK_EQ(reader.GetInt64(0), -1);
+  double double_value;
+  CHECK(!reader.ParseDouble(1, &double_value));
+  // The carriage return is not part of the field.
+  CHECK_EQ(reader.GetString(1), "abc");
+  // The last row doesn't end with a new line.
+  CHECK(reader.NextRow());
+  CHECK_EQ(reader.GetString(1), "row");
+  CHECK(!reader.NextRow());
+}
+
+TEST_F(CSVReaderTest, ParseIntegerLimits) {
+  WriteFile("9223372036854775807,-9223372036854775808,9223372036854775808,"
+            "-9223372036854775809,20000000000000000000,"
+            "18446744073709551615,18446744073709551616\n");
+  CSVReader reader;
+  CHECK(reader.Open(file_name_));
+  CHECK(reader.NextRow());
+  int64_t signed_value;
+  CHECK(reader.ParseInt64(0, &signed_value));
+  CHECK_EQ(signed_value, INT64_MAX);
+  CHECK(reader.ParseInt64(1, &signed_value));
+  CHECK_EQ(signed_value, INT64_MIN);
+  CHECK(!reader.ParseInt64(2, &signed_value));
+  CHECK(!reader.ParseInt64(3, &signed_value));
+  CHECK(!reader.ParseInt64(4, &signed_value));
+  uint64_t unsigned_value;
+  CHECK(reader.ParseUInt64(5, &unsigned_value));
+  CHECK_EQ(unsigned_value, UINT64_MAX);
+  CHECK(!reader.ParseUInt64(6, &unsigned_value));
+}
+
+TEST_F(CSVReaderTest, ReadEmptyFile) {
+  WriteFile("");
+  CSVReader reader;
+  CHECK(reader.Open(file_name_));
+  CHECK(!reader.NextRow());
+  CHECK(!reader.Open(file_name_ + ".missing"));
+}
+
+}  // namespace sim
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  FLAGS_logtostderr = true;
+  FLAGS_stderrthreshold = 0;
+  return RUN_ALL_TESTS();
+}
@@ -3,9 +3,11 @@
 #include "sim/event_manager.h"
 
 #include <algorithm>
+#include <functional>
 #include <utility>
 
 #include "base/units.h"
+#include "misc/map-util.h"
 #include "misc/utils.h"
 
 DEFINE_uint64(batch_step, 0, "Batch mode: time interval to run scheduler "
@@ -46,8 +48,18 @@ static const bool batch_step_validator =
 namespace firmament {
 namespace sim {
 
+// Bits of SimulatorEvent::fields_set_.
+static const uint8_t kMachineIdSet = 1 << 0;
+static const uint8_t kTaskIndexSet = 1 << 1;
+static const uint8_t kJobIdSet = 1 << 2;
+static const uint8_t kRequestedCpuCoresSet = 1 << 3;
+static const uint8_t kRequestedRamSet = 1 << 4;
+static const uint8_t kPrioritySet = 1 << 5;
+static const uint8_t kSchedulingClassSet = 1 << 6;
+
 EventManager::EventManager(SimulatedWallTime* simulated_time) :
-  simulated_time_(simulated_time), num_events_processed_(0) {
+  simulated_time_(simulated_time), num_pending_events_(0),
+  num_events_processed_(0) {
   LOG(INFO) << "Maximum number of task events to process: " << FLAGS_max_events;
   LOG(INFO) << "Maximum number of scheduling rounds: "
             << FLAGS_max_scheduling_rounds;
@@ -56,26 +68,140 @@ EventManager::EventManager(SimulatedWallTime* simulated_time) :
 EventManager::~EventManager() {
 }
 
+uint32_t EventManager::AcquireBucket(uint64_t timestamp) {
+  uint32_t bucket_index;
+  if (free_buckets_.empty()) {
+    bucket_index = buckets_.size();
+    buckets_.push_back(EventBucket());
+  } else {
+    bucket_index = free_buckets_.back();
+    free_buckets_.pop_back();
+  }
+  EventBucket& bucket = buckets_[bucket_index];
+  bucket.timestamp_ = timestamp;
+  bucket.next_event_ = 0;
+  bucket.num_pending_events_ = 0;
+  bucket.num_pending_placement_events_ = 0;
+  // The bucket's events have been cleared when it was released. Its vector
+  // keeps the capacity, so reused buckets don't allocate memory.
+  CHECK(InsertIfNotPresent(&timestamp_to_bucket_, timestamp, bucket_index));
+  event_timestamps_.push_back(timestamp);
+  push_heap(event_timestamps_.begin(), event_timestamps_.end(),
+            greater<uint64_t>());
+  return bucket_index;
+}
+
 void EventManager::AddEvent(uint64_t timestamp, EventDescriptor event) {
-  events_.insert(pair<uint64_t, EventDescriptor>(timestamp, event));
+  uint32_t* bucket_index_ptr = FindOrNull(timestamp_to_bucket_, timestamp);
+  uint32_t bucket_index = bucket_index_ptr != NULL ?
+    *bucket_index_ptr : AcquireBucket(timestamp);
+  EventBucket& bucket = buckets_[bucket_index];
+  bucket.events_.push_back(SimulatorEvent());
+  SimulatorEvent& sim_event = bucket.events_.back();
+  EncodeEvent(event, &sim_event);
+  bucket.num_pending_events_++;
+  num_pending_events_++;
+  if (IsPlacementEvent(sim_event.type_)) {
+    if (bucket.num_pending_placement_events_++ == 0) {
+      placement_event_timestamps_.push_back(timestamp);
+      push_heap(placement_event_timestamps_.begin(),
+                placement_event_timestamps_.end(), greater<uint64_t>());
+    }
+  }
+  if (sim_event.type_ == EventDescriptor::TASK_END_RUNTIME) {
+    TraceTaskIdentifier task_identifier;
+    task_identifier.job_id = sim_event.job_id_;
+    task_identifier.task_index = sim_event.task_index_;
+    EventHandle handle;
+    handle.bucket_index_ = bucket_index;
+    handle.event_index_ = bucket.events_.size() - 1;
+    InsertOrUpdate(&task_end_events_, task_identifier, handle);
+  }
+}
+
+void EventManager::DecodeEvent(const SimulatorEvent& sim_event,
+                               EventDescriptor* event) {
+  event->Clear();
+  event->set_type(static_cast<EventDescriptor::EventType>(sim_event.type_));
+  if (sim_event.fields_set_ & kMachineIdSet) {
+    event->set_machine_id(sim_event.machine_id_);
+  }
+  if (sim_event.fields_set_ & kTaskIndexSet) {
+    event->set_task_index(sim_event.task_index_);
+  }
+  if (sim_event.fields_set_ & kJobIdSet) {
+    event->set_job_id(sim_event.job_id_);
+  }
+  if (sim_event.fields_set_ & kRequestedCpuCoresSet) {
+    event->set_requested_cpu_cores(sim_event.requested_cpu_cores_);
+  }
+  if (sim_event.fields_set_ & kRequestedRamSet) {
+    event->set_requested_ram(sim_event.requested_ram_);
+  }
+  if (sim_event.fields_set_ & kPrioritySet) {
+    event->set_priority(sim_event.priority_);
+  }
+  if (sim_event.fields_set_ & kSchedulingClassSet) {
+    event->set_scheduling_class(sim_event.scheduling_class_);
+  }
+}
+
+void EventManager::EncodeEvent(const EventDescriptor& event,
+                               SimulatorEvent* sim_event) {
+  sim_event->machine_id_ = event.machine_id();
+  sim_event->task_index_ = event.task_index();
+  sim_event->job_id_ = event.job_id();
+  sim_event->requested_ram_ = event.requested_ram();
+  sim_event->requested_cpu_cores_ = event.requested_cpu_cores();
+  sim_event->priority_ = event.priority();
+  sim_event->scheduling_class_ = event.scheduling_class();
+  sim_event->type_ = static_cast<uint8_t>(event.type());
+  sim_event->fields_set_ =
+    (event.has_machine_id() ? kMachineIdSet : 0) |
+    (event.has_task_index() ? kTaskIndexSet : 0) |
+    (event.has_job_id() ? kJobIdSet : 0) |
+    (event.has_requested_cpu_cores() ? kRequestedCpuCoresSet : 0) |
+    (event.has_requested_ram() ? kRequestedRamSet : 0) |
+    (event.has_priority() ? kPrioritySet : 0) |
+    (event.has_scheduling_class() ? kSchedulingClassSet : 0);
+  sim_event->done_ = false;
 }
 
 pair<uint64_t, EventDescriptor> EventManager::GetNextEvent() {
-  num_events_processed_++;
-  multimap<uint64_t, EventDescriptor>::iterator it = events_.begin();
-  pair<uint64_t, EventDescriptor> time_event = *it;
-  events_.erase(it);
-  simulated_time_->UpdateCurrentTimestampIfSmaller(time_event.first);
+  pair<uint64_t, EventDescriptor> time_event;
+  time_event.first = GetTimeOfNextEvent();
+  CHECK(GetNextEventAt(time_event.first, &time_event.second))
+    << "No simulator event left";
   return time_event;
 }
 
+bool EventManager::GetNextEventAt(uint64_t timestamp,
+                                  EventDescriptor* event) {
+  ReleaseDoneBuckets();
+  if (event_timestamps_.empty() || event_timestamps_.front() != timestamp) {
+    return false;
+  }
+  uint32_t* bucket_index_ptr = FindOrNull(timestamp_to_bucket_, timestamp);
+  CHECK_NOTNULL(bucket_index_ptr);
+  EventBucket& bucket = buckets_[*bucket_index_ptr];
+  // The bucket at the front of the queue has at least a pending event.
+  while (bucket.events_[bucket.next_event_].done_) {
+    bucket.next_event_++;
+  }
+  DecodeEvent(bucket.events_[bucket.next_event_], event);
+  MarkEventDone(*bucket_index_ptr, bucket.next_event_);
+  bucket.next_event_++;
+  num_events_processed_++;
+  simulated_time_->UpdateCurrentTimestampIfSmaller(timestamp);
+  return true;
+}
+
 uint64_t EventManager::GetTimeOfNextEvent() {
-  multimap<uint64_t, EventDescriptor>::iterator it = events_.begin();
-  if (it == events_.end()) {
-    // Empty collection.
+  ReleaseDoneBuckets();
+  if (event_timestamps_.empty()) {
     return UINT64_MAX;
   } else {
-    return it->first;
+    return event_timestamps_.front();
   }
 }
 
@@ -90,16 +216,12 @@ uint64_t EventManager::GetTimeOfNextSchedulerRun(
     if (cur_scheduler_runtime == 0) {
       // The scheduler didn't have anything to do.
       // Only run it after the next event that can change task placement.
-      for (auto& time_event : events_) {
-        if (time_event.second.type() == EventDescriptor::TASK_SUBMIT ||
-            time_event.second.type() == EventDescriptor::REMOVE_MACHINE ||
-            time_event.second.type() == EventDescriptor::ADD_MACHINE ||
-            time_event.second.type() == EventDescriptor::TASK_END_RUNTIME) {
-          return time_event.first;
-        }
+      DropStalePlacementTimestamps();
+      if (placement_event_timestamps_.empty()) {
+        // There's no event left that requires a scheduler run.
+        return UINT64_MAX;
       }
-      // There's no event left that requires a scheduler run.
-      return UINT64_MAX;
+      return placement_event_timestamps_.front();
     }
   } else {
     // We're in batch mode.
@@ -108,6 +230,20 @@ uint64_t EventManager::GetTimeOfNextSchedulerRun(
   return cur_run_scheduler_at;
 }
 
+void EventManager::DropStalePlacementTimestamps() {
+  while (!placement_event_timestamps_.empty()) {
+    uint32_t* bucket_index_ptr =
+      FindOrNull(timestamp_to_bucket_, placement_event_timestamps_.front());
+    if (bucket_index_ptr != NULL &&
+        buckets_[*bucket_index_ptr].num_pending_placement_events_ > 0) {
+      break;
+    }
+    pop_heap(placement_event_timestamps_.begin(),
+             placement_event_timestamps_.end(), greater<uint64_t>());
+    placement_event_timestamps_.pop_back();
+  }
+}
+
 bool EventManager::HasSimulationCompleted(uint64_t num_scheduling_rounds) {
   // We only run for the first FLAGS_runtime microseconds.
   if (FLAGS_runtime / FLAGS_trace_speed_up < GetTimeOfNextEvent()) {
@@ -123,27 +259,72 @@ bool EventManager::HasSimulationCompleted(uint64_t num_scheduling_rounds) {
               << " scheduling rounds.";
     return true;
   }
-  return events_.begin() == events_.end();
+  return num_pending_events_ == 0;
 }
 
-void EventManager::RemoveTaskEndRuntimeEvent(
-    const TraceTaskIdentifier& task_identifier,
-    uint64_t task_end_time) {
-  // Remove the task end time event from the simulator events_.
-  pair<multimap<uint64_t, EventDescriptor>::iterator,
-       multimap<uint64_t, EventDescriptor>::iterator> range_it =
-    events_.equal_range(task_end_time);
-  for (; range_it.first != range_it.second; range_it.first++) {
-    if (range_it.first->second.type() == EventDescriptor::TASK_END_RUNTIME &&
-        range_it.first->second.job_id() == task_identifier.job_id &&
-        range_it.first->second.task_index() == task_identifier.task_index) {
+bool EventManager::IsPlacementEvent(uint8_t event_type) {
+  return event_type == EventDescriptor::TASK_SUBMIT ||
+    event_type == EventDescriptor::REMOVE_MACHINE ||
+    event_type == EventDescriptor::ADD_MACHINE ||
+    event_type == EventDescriptor::TASK_END_RUNTIME;
+}
+
+void EventManager::MarkEventDone(uint32_t bucket_index, uint32_t event_index) {
+  EventBucket& bucket = buckets_[bucket_index];
+  SimulatorEvent& sim_event = bucket.events_[event_index];
+  CHECK(!sim_event.done_);
+  sim_event.done_ = true;
+  bucket.num_pending_events_--;
+  num_pending_events_--;
+  if (IsPlacementEvent(sim_event.type_)) {
+    bucket.num_pending_placement_events_--;
+  }
+  if (sim_event.type_ == EventDescriptor::TASK_END_RUNTIME) {
+    TraceTaskIdentifier task_identifier;
+    task_identifier.job_id = sim_event.job_id_;
+    task_identifier.task_index = sim_event.task_index_;
+    EventHandle* handle_ptr = FindOrNull(task_end_events_, task_identifier);
+    // Only forget the handle if it still refers to this event.
+    if (handle_ptr != NULL && handle_ptr->bucket_index_ == bucket_index &&
+        handle_ptr->event_index_ == event_index) {
+      task_end_events_.erase(task_identifier);
+    }
+  }
+}
+
+void EventManager::ReleaseDoneBuckets() {
+  while (!event_timestamps_.empty()) {
+    uint64_t timestamp = event_timestamps_.front();
+    uint32_t* bucket_index_ptr = FindOrNull(timestamp_to_bucket_, timestamp);
+    CHECK_NOTNULL(bucket_index_ptr);
+    EventBucket& bucket = buckets_[*bucket_index_ptr];
+    if (bucket.num_pending_events_ > 0) {
       break;
     }
+    bucket.events_.clear();
+    free_buckets_.push_back(*bucket_index_ptr);
+    timestamp_to_bucket_.erase(timestamp);
+    pop_heap(event_timestamps_.begin(), event_timestamps_.end(),
+             greater<uint64_t>());
+    event_timestamps_.pop_back();
   }
-  // We've found the event.
-  if (range_it.first != range_it.second) {
-    events_.erase(range_it.first);
+  // Batch mode never looks at the placement timestamps, so we drop the
+  // stale ones here to keep them from piling up.
+  DropStalePlacementTimestamps();
+}
+
+void EventManager::RemoveTaskEndRuntimeEvent(
+    const TraceTaskIdentifier& task_identifier,
+    uint64_t task_end_time) {
+  EventHandle* handle_ptr = FindOrNull(task_end_events_, task_identifier);
+  if (handle_ptr == NULL ||
+      buckets_[handle_ptr->bucket_index_].timestamp_ != task_end_time) {
+    // The task doesn't have an end event at task_end_time.
+    return;
   }
+  // Copy the handle because MarkEventDone erases it.
+  EventHandle handle = *handle_ptr;
+  MarkEventDone(handle.bucket_index_, handle.event_index_);
 }
 
 } // namespace sim
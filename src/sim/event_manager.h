@@ -4,8 +4,9 @@
 #ifndef FIRMAMENT_SIM_EVENT_MANAGER_H
 #define FIRMAMENT_SIM_EVENT_MANAGER_H
 
-#include <map>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "base/common.h"
 #include "misc/time_interface.h"
@@ -34,6 +35,17 @@ class EventManager {
    */
   pair<uint64_t, EventDescriptor> GetNextEvent();
 
+  /**
+   * Gets the next event that happens at timestamp. The events that share a
+   * timestamp are stored together, so the caller can process a batch of
+   * events by calling this method until it returns false.
+   * @param timestamp the time of the batch; must be the time of the next event
+   * @param event set to the next event of the batch
+   * @return false if there are no more events at timestamp or if an earlier
+   * event has been added in the meantime
+   */
+  bool GetNextEventAt(uint64_t timestamp, EventDescriptor* event);
+
   /**
    * Time of the next simulator event. UINT64_MAX if no more simulator events.
    */
@@ -64,10 +76,68 @@ class EventManager {
                                  uint64_t task_end_time);
 
  private:
+  FRIEND_TEST(EventManagerTest, DropStalePlacementTimestamps);
+  // Compact copy of an EventDescriptor.
+  struct SimulatorEvent {
+    uint64_t machine_id_;
+    uint64_t task_index_;
+    uint64_t job_id_;
+    uint64_t requested_ram_;
+    float requested_cpu_cores_;
+    uint32_t priority_;
+    uint32_t scheduling_class_;
+    // EventDescriptor::EventType of the event.
+    uint8_t type_;
+    // Bitmask of the optional EventDescriptor fields that are set.
+    uint8_t fields_set_;
+    // True if the event has been processed or removed.
+    bool done_;
+  };
+
+  // The events that happen at a timestamp, in the order in which they were
+  // added.
+  struct EventBucket {
+    uint64_t timestamp_;
+    // Index of the first event that may not be done.
+    uint64_t next_event_;
+    uint64_t num_pending_events_;
+    // Number of pending events after which the scheduler must run.
+    uint64_t num_pending_placement_events_;
+    vector<SimulatorEvent> events_;
+  };
+
+  // Location of a task end event, used to remove it in O(1).
+  struct EventHandle {
+    uint32_t bucket_index_;
+    uint32_t event_index_;
+  };
+
+  uint32_t AcquireBucket(uint64_t timestamp);
+  void DecodeEvent(const SimulatorEvent& sim_event, EventDescriptor* event);
+  // Pops the timestamps at the front of placement_event_timestamps_ whose
+  // buckets have no pending placement events left.
+  void DropStalePlacementTimestamps();
+  void EncodeEvent(const EventDescriptor& event, SimulatorEvent* sim_event);
+  bool IsPlacementEvent(uint8_t event_type);
+  void MarkEventDone(uint32_t bucket_index, uint32_t event_index);
+  // Releases the buckets at the front of the queue that have no pending
+  // events.
+  void ReleaseDoneBuckets();
+
   SimulatedWallTime* simulated_time_;
-  // The map storing the simulator events. Maps from timestamp to simulator
-  // event.
-  multimap<uint64_t, EventDescriptor> events_;
+  // Buckets holding the simulator events. The buckets are reused once all
+  // their events are done.
+  vector<EventBucket> buckets_;
+  vector<uint32_t> free_buckets_;
+  unordered_map<uint64_t, uint32_t> timestamp_to_bucket_;
+  // Min-heap of the timestamps that have a bucket.
+  vector<uint64_t> event_timestamps_;
+  // Min-heap of the timestamps whose buckets have had pending placement
+  // events. Stale timestamps are dropped once they reach the front.
+  vector<uint64_t> placement_event_timestamps_;
+  unordered_map<TraceTaskIdentifier, EventHandle,
+    TraceTaskIdentifierHasher> task_end_events_;
+  uint64_t num_pending_events_;
   uint64_t num_events_processed_;
 };
 
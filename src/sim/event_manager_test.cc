@@ -82,6 +82,84 @@ TEST(EventManagerTest, RemoveTaskEndRuntimeEvent) {
   CHECK_EQ(event_manager.GetTimeOfNextEvent(), UINT64_MAX);
 }
 
+// Checks that the timestamps of placement events are dropped once the events
+// are done, even if nothing asks for the next scheduler run.
+TEST(EventManagerTest, DropStalePlacementTimestamps) {
+  SimulatedWallTime simulated_time;
+  EventManager event_manager(&simulated_time);
+  EventDescriptor event_desc;
+  event_desc.set_type(EventDescriptor::TASK_SUBMIT);
+  event_desc.set_job_id(1);
+  for (uint64_t timestamp = 1; timestamp <= 100; ++timestamp) {
+    event_desc.set_task_index(timestamp);
+    event_manager.AddEvent(timestamp, event_desc);
+  }
+  CHECK_EQ(event_manager.placement_event_timestamps_.size(), 100);
+  for (uint64_t timestamp = 1; timestamp <= 100; ++timestamp) {
+    CHECK_EQ(event_manager.GetNextEvent().first, timestamp);
+  }
+  CHECK_EQ(event_manager.GetTimeOfNextEvent(), UINT64_MAX);
+  CHECK(event_manager.placement_event_timestamps_.empty());
+  // The bucket at time 2 lives on after its placement event is done.
+  event_desc.set_type(EventDescriptor::TASK_SUBMIT);
+  event_manager.AddEvent(2, event_desc);
+  event_desc.set_type(EventDescriptor::MACHINE_HEARTBEAT);
+  event_manager.AddEvent(2, event_desc);
+  CHECK_EQ(event_manager.GetNextEvent().first, 2);
+  CHECK_EQ(event_manager.GetTimeOfNextEvent(), 2);
+  CHECK(event_manager.placement_event_timestamps_.empty());
+}
+
+TEST(EventManagerTest, GetNextEventAt) {
+  SimulatedWallTime simulated_time;
+  EventManager event_manager(&simulated_time);
+  EventDescriptor event_desc;
+  event_desc.set_type(EventDescriptor::TASK_SUBMIT);
+  event_desc.set_job_id(1);
+  event_desc.set_task_index(1);
+  event_desc.set_priority(2);
+  event_manager.AddEvent(3, event_desc);
+  event_desc.set_type(EventDescriptor::TASK_END_RUNTIME);
+  event_desc.clear_priority();
+  event_desc.set_task_index(2);
+  event_manager.AddEvent(3, event_desc);
+  event_desc.set_task_index(3);
+  event_manager.AddEvent(3, event_desc);
+  event_desc.set_type(EventDescriptor::MACHINE_HEARTBEAT);
+  event_manager.AddEvent(5, event_desc);
+  // The events at time 3 come out in the order in which they were added.
+  EventDescriptor event;
+  CHECK(!event_manager.GetNextEventAt(5, &event));
+  CHECK(event_manager.GetNextEventAt(3, &event));
+  CHECK_EQ(event.type(), EventDescriptor::TASK_SUBMIT);
+  CHECK_EQ(event.task_index(), 1);
+  CHECK(event.has_priority());
+  CHECK_EQ(event.priority(), 2);
+  // Remove an event of the batch while the batch is being processed.
+  TraceTaskIdentifier task_identifier;
+  task_identifier.job_id = 1;
+  task_identifier.task_index = 2;
+  event_manager.RemoveTaskEndRuntimeEvent(task_identifier, 3);
+  CHECK(event_manager.GetNextEventAt(3, &event));
+  CHECK_EQ(event.type(), EventDescriptor::TASK_END_RUNTIME);
+  CHECK_EQ(event.task_index(), 3);
+  CHECK(!event.has_priority());
+  // Events added at the batch's time are part of the batch.
+  event_desc.set_type(EventDescriptor::ADD_MACHINE);
+  event_desc.set_machine_id(4);
+  event_manager.AddEvent(3, event_desc);
+  CHECK(event_manager.GetNextEventAt(3, &event));
+  CHECK_EQ(event.machine_id(), 4);
+  CHECK(!event_manager.GetNextEventAt(3, &event));
+  CHECK_EQ(simulated_time.GetCurrentTimestamp(), 3);
+  CHECK_EQ(event_manager.GetTimeOfNextEvent(), 5);
+  // Heartbeats do not change task placements.
+  CHECK_EQ(event_manager.GetTimeOfNextSchedulerRun(3, 0), UINT64_MAX);
+  CHECK(!event_manager.HasSimulationCompleted(0));
+  CHECK_EQ(event_manager.GetNextEvent().first, 5);
+  CHECK(event_manager.HasSimulationCompleted(0));
+}
+
 } // namespace sim
 } // namespace firmament
 
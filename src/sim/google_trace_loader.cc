@@ -7,9 +7,7 @@
 
 #include <SpookyV2.h>
 
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
-#include <cstdio>
+#include <boost/bind.hpp>
 #include <map>
 #include <string>
 #include <utility>
@@ -18,15 +16,20 @@
 #include "base/units.h"
 #include "misc/string_utils.h"
 #include "misc/utils.h"
-
-#define MAX_LINE_LENGTH 1000
+#include "sim/csv_reader.h"
 
 DEFINE_double(events_fraction, 1.0, "Fraction of events to retain.");
 DEFINE_double(machine_events_fraction, 1.0,
               "Fraction of machine events to retain. NOTE: the minimum "
               "of events_fraction and machine_events_fraction will be used");
 DEFINE_int32(num_files_to_process, 500, "Number of files to process.");
+DEFINE_int32(num_trace_parser_threads, 4, "Number of threads that parse task "
+             "events files ahead of the simulation. If 0, the files are "
+             "parsed when the simulation reaches them.");
 DEFINE_string(trace_path, "", "Path where the trace files are.");
+DEFINE_string(trace_format, "csv", "Format of the trace files: csv or binary. "
+              "The binary trace is generated with google_trace_processor "
+              "-binary_trace.");
 DEFINE_uint64(sim_machine_max_cores, 12,
               "Maximum number of cores the simulated machines have");
 DEFINE_uint64(sim_machine_max_ram, 65536,
@@ -51,9 +54,17 @@ static bool ValidateTracePath(const char* flagname, const string& trace_path) {
 static const bool trace_path_validator =
   google::RegisterFlagValidator(&FLAGS_trace_path, &ValidateTracePath);
 
-using boost::lexical_cast;
-using boost::algorithm::is_any_of;
-using boost::token_compress_off;
+static bool ValidateTraceFormat(const char* flagname,
+                                const string& trace_format) {
+  if (trace_format != "csv" && trace_format != "binary") {
+    LOG(ERROR) << "Unknown trace format " << trace_format;
+    return false;
+  }
+  return true;
+}
+
+static const bool trace_format_validator =
+  google::RegisterFlagValidator(&FLAGS_trace_format, &ValidateTraceFormat);
 
 namespace firmament {
 namespace sim {
@@ -61,106 +72,261 @@ namespace sim {
 GoogleTraceLoader::GoogleTraceLoader(EventManager* event_manager)
   : TraceLoader(event_manager),
     current_task_events_file_id_(0),
-    task_events_file_(NULL),
+    task_events_(NULL),
+    next_task_event_index_(0),
+    next_task_events_file_to_parse_(0),
+    last_task_events_file_to_parse_(-1),
+    stop_parsing_task_events_(false),
     loaded_synthetic_task_(false) {
   synthetic_task_.job_id = 0;
   synthetic_task_.task_index = 0;
 }
 
 GoogleTraceLoader::~GoogleTraceLoader() {
-  if (task_events_file_) {
-    fclose(task_events_file_);
+  {
+    boost::lock_guard<boost::mutex> lock(task_events_lock_);
+    stop_parsing_task_events_ = true;
+  }
+  task_events_cond_.notify_all();
+  task_events_parsers_.join_all();
+  for (auto& file_events : parsed_task_events_) {
+    delete file_events.second;
+  }
+  delete task_events_;
+}
+
+bool GoogleTraceLoader::AddMachineEvent(
+    const TraceMachineEvent& machine_event,
+    multimap<uint64_t, EventDescriptor>* machine_events) {
+  uint64_t timestamp = machine_event.timestamp_;
+  if (timestamp > FLAGS_runtime) {
+    // only load the events that we need
+    return false;
   }
+  timestamp /= FLAGS_trace_speed_up;
+  uint64_t machine_id = machine_event.machine_id_;
+  // Sub-sample the trace if we only retain < 100% of machines.
+  if (SpookyHash::Hash64(&machine_id, sizeof(machine_id), kSeed) >
+      MaxMachineEventHashToRetain()) {
+    // skip event
+    return true;
+  }
+  EventDescriptor event_desc;
+  event_desc.set_machine_id(machine_id);
+  event_desc.set_type(TranslateMachineEvent(machine_event.event_type_));
+  if (event_desc.type() == EventDescriptor::REMOVE_MACHINE ||
+      event_desc.type() == EventDescriptor::ADD_MACHINE) {
+    machine_events->insert(
+        pair<uint64_t, EventDescriptor>(timestamp, event_desc));
+  } else {
+    // TODO(ionel): Handle machine update events.
+  }
+  return true;
+}
+
+void GoogleTraceLoader::AddTaskEvent(const TraceTaskEvent& trace_task_event,
+                                     vector<TaskEvent>* task_events) {
+  TaskEvent task_event;
+  task_event.timestamp_ = trace_task_event.timestamp_;
+  task_event.timestamp_ /= FLAGS_trace_speed_up;
+  task_event.task_id_.job_id = trace_task_event.job_id_;
+  task_event.task_id_.task_index = trace_task_event.task_index_;
+  // Sub-sample the trace if we only retain < 100% of tasks.
+  task_event.filtered_ =
+    SpookyHash::Hash64(&task_event.task_id_, sizeof(task_event.task_id_),
+                       kSeed) > MaxEventHashToRetain();
+  if (task_event.filtered_) {
+    task_events->push_back(task_event);
+    return;
+  }
+  if (trace_task_event.event_type_ != TASK_SUBMIT_EVENT) {
+    // Skip this event and read next event from the trace.
+    return;
+  }
+  task_event.scheduling_class_ = trace_task_event.scheduling_class_;
+  task_event.priority_ = trace_task_event.priority_;
+  if (trace_task_event.fields_set_ & kTraceCpuRequestSet) {
+    task_event.requested_cpu_cores_ =
+      trace_task_event.cpu_request_ * FLAGS_sim_machine_max_cores;
+  } else {
+    task_event.requested_cpu_cores_ = 0;
+  }
+  if (trace_task_event.fields_set_ & kTraceRamRequestSet) {
+    task_event.requested_ram_ = static_cast<uint64_t>(
+        trace_task_event.ram_request_ * FLAGS_sim_machine_max_ram);
+  } else {
+    task_event.requested_ram_ = 0;
+  }
+  task_events->push_back(task_event);
+}
+
+void GoogleTraceLoader::AddTaskRuntime(
+    const TraceTaskRuntime& trace_task_runtime,
+    unordered_map<TaskID_t, uint64_t>* task_runtime) {
+  TraceTaskIdentifier ti;
+  ti.job_id = trace_task_runtime.job_id_;
+  ti.task_index = trace_task_runtime.task_index_;
+  // Sub-sample the trace if we only retain < 100% of tasks.
+  if (SpookyHash::Hash64(&ti, sizeof(ti), kSeed) > MaxEventHashToRetain()) {
+    // skip event
+    return;
+  }
+  // Get the total runtime of the task. This includes the time
+  // of the runs that failed or were killed. In this way, we make
+  // sure that the task runs for the same amount of time as when
+  // it executed in real-world.
+  uint64_t runtime = trace_task_runtime.runtime_;
+  runtime /= FLAGS_trace_speed_up;
+  if (!InsertIfNotPresent(task_runtime, GenerateTaskIDFromTraceIdentifier(ti),
+                          runtime) &&
+      VLOG_IS_ON(1)) {
+    LOG(ERROR) << "LoadTasksRunningTime: There should not be more than "
+               << "one entry for job " << ti.job_id
+               << ", task " << ti.task_index;
+  } else {
+    VLOG(2) << "Loaded runtime for " << ti.job_id << "/" << ti.task_index;
+  }
+}
+
+void GoogleTraceLoader::AddTaskUsage(
+    const TraceTaskUsage& trace_task_usage,
+    unordered_map<TaskID_t, TraceTaskStats>* task_id_to_stats) {
+  TraceTaskIdentifier ti;
+  ti.job_id = trace_task_usage.job_id_;
+  ti.task_index = trace_task_usage.task_index_;
+  TraceTaskStats task_stats;
+  task_stats.avg_mean_cpu_usage_ = trace_task_usage.avg_mean_cpu_usage_;
+  task_stats.avg_canonical_mem_usage_ =
+    trace_task_usage.avg_canonical_mem_usage_;
+  task_stats.avg_assigned_mem_usage_ =
+    trace_task_usage.avg_assigned_mem_usage_;
+  task_stats.avg_unmapped_page_cache_ =
+    trace_task_usage.avg_unmapped_page_cache_;
+  task_stats.avg_total_page_cache_ = trace_task_usage.avg_total_page_cache_;
+  task_stats.avg_mean_disk_io_time_ = trace_task_usage.avg_mean_disk_io_time_;
+  task_stats.avg_mean_local_disk_used_ =
+    trace_task_usage.avg_mean_local_disk_used_;
+  task_stats.avg_cpi_ = trace_task_usage.avg_cpi_;
+  task_stats.avg_mai_ = trace_task_usage.avg_mai_;
+  if (!InsertIfNotPresent(task_id_to_stats,
+                          GenerateTaskIDFromTraceIdentifier(ti),
+                          task_stats) &&
+      VLOG_IS_ON(1)) {
+    LOG(ERROR) << "LoadTaskUtilizationStats: There should not be more "
+               << "than an entry for job " << ti.job_id
+               << ", task " << ti.task_index;
+  } else {
+    VLOG(2) << "Loaded stats for " << ti.job_id << "/" << ti.task_index;
+  }
+}
+
+vector<GoogleTraceLoader::TaskEvent>* GoogleTraceLoader::GetTaskEventsFile(
+    int32_t file_id) {
+  if (FLAGS_num_trace_parser_threads <= 0) {
+    vector<TaskEvent>* task_events = new vector<TaskEvent>();
+    ParseTaskEventsFile(file_id, task_events);
+    return task_events;
+  }
+  boost::unique_lock<boost::mutex> lock(task_events_lock_);
+  // The parsers can parse the files up to FLAGS_num_trace_parser_threads
+  // ahead of the file the simulator reads from.
+  last_task_events_file_to_parse_ = file_id + FLAGS_num_trace_parser_threads;
+  if (task_events_parsers_.size() == 0) {
+    for (int32_t thread_index = 0;
+         thread_index < FLAGS_num_trace_parser_threads; ++thread_index) {
+      task_events_parsers_.create_thread(
+          boost::bind(&GoogleTraceLoader::ParseTaskEventsFiles, this));
+    }
+  } else {
+    task_events_cond_.notify_all();
+  }
+  map<int32_t, vector<TaskEvent>*>::iterator it;
+  while ((it = parsed_task_events_.find(file_id)) ==
+         parsed_task_events_.end()) {
+    task_events_cond_.wait(lock);
+  }
+  vector<TaskEvent>* task_events = it->second;
+  parsed_task_events_.erase(it);
+  return task_events;
 }
 
 void GoogleTraceLoader::LoadJobsNumTasks(
     unordered_map<uint64_t, uint64_t>* job_num_tasks) {
-  char line[MAX_LINE_LENGTH];
-  vector<string> cols;
-  FILE* jobs_tasks_file = NULL;
+  // Load the synthetic job.
+  CHECK(InsertIfNotPresent(job_num_tasks, synthetic_task_.job_id,
+                           FLAGS_num_tasks_synthetic_job_after_initial_run));
+  if (FLAGS_trace_format == "binary") {
+    BinaryTableReader<TraceJobNumTasks> reader;
+    if (!reader.Open(BinaryTraceFileName(FLAGS_trace_path,
+                                         "jobs_num_tasks"))) {
+      LOG(FATAL) << "Failed to open binary jobs num tasks file.";
+    }
+    for (uint64_t index = 0; index < reader.num_records(); ++index) {
+      CHECK(InsertIfNotPresent(job_num_tasks, reader[index].job_id_,
+                               reader[index].num_tasks_));
+    }
+    return;
+  }
+  CSVReader reader;
   string jobs_tasks_file_name = FLAGS_trace_path +
     "/jobs_num_tasks/jobs_num_tasks.csv";
-  if ((jobs_tasks_file = fopen(jobs_tasks_file_name.c_str(), "r")) == NULL) {
+  if (!reader.Open(jobs_tasks_file_name)) {
     LOG(FATAL) << "Failed to open jobs num tasks file.";
   }
-  // Load the synthetic job.
-  CHECK(InsertIfNotPresent(job_num_tasks, synthetic_task_.job_id,
-                           FLAGS_num_tasks_synthetic_job_after_initial_run));
-  int64_t num_line = 1;
-  while (!feof(jobs_tasks_file)) {
-    if (fscanf(jobs_tasks_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-      boost::split(cols, line, is_any_of(","), token_compress_off);
-      if (cols.size() != 2) {
-        LOG(ERROR) << "Unexpected structure of jobs num tasks row on line: "
-                   << num_line;
-      } else {
-        uint64_t job_id = lexical_cast<uint64_t>(cols[0]);
-        uint64_t num_tasks = lexical_cast<uint64_t>(cols[1]);
-        CHECK(InsertIfNotPresent(job_num_tasks, job_id, num_tasks));
-      }
+  while (reader.NextRow()) {
+    if (reader.num_fields() != 2) {
+      LOG(ERROR) << "Unexpected structure of jobs num tasks row on line: "
+                 << reader.line_number();
+    } else {
+      uint64_t job_id = reader.GetUInt64(0);
+      uint64_t num_tasks = reader.GetUInt64(1);
+      CHECK(InsertIfNotPresent(job_num_tasks, job_id, num_tasks));
     }
-    num_line++;
   }
-  fclose(jobs_tasks_file);
 }
 
 void GoogleTraceLoader::LoadMachineEvents(
     multimap<uint64_t, EventDescriptor>* machine_events) {
-  char line[MAX_LINE_LENGTH];
-  vector<string> cols;
-  FILE* machines_file;
+  if (FLAGS_trace_format == "binary") {
+    BinaryTableReader<TraceMachineEvent> reader;
+    if (!reader.Open(BinaryTraceFileName(FLAGS_trace_path,
+                                         "machine_events"))) {
+      LOG(FATAL) << "Failed to open binary trace for reading machine events.";
+    }
+    for (uint64_t index = 0; index < reader.num_records(); ++index) {
+      if (!AddMachineEvent(reader[index], machine_events)) {
+        break;
+      }
+    }
+    return;
+  }
+  CSVReader reader;
   string machines_file_name = FLAGS_trace_path +
     "/machine_events/part-00000-of-00001.csv";
-  if ((machines_file = fopen(machines_file_name.c_str(), "r")) == NULL) {
+  if (!reader.Open(machines_file_name)) {
     LOG(FATAL) << "Failed to open trace for reading machine events.";
   }
-
-  int64_t num_line = 1;
-  while (!feof(machines_file)) {
-    if (fscanf(machines_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-      boost::split(cols, line, is_any_of(","), token_compress_off);
-      if (cols.size() != 6) {
-        LOG(ERROR) << "Unexpected structure of machine events on line "
-                   << num_line << ": found " << cols.size() << " columns.";
-      } else {
-        uint64_t timestamp = lexical_cast<uint64_t>(cols[0]);
-        if (timestamp > FLAGS_runtime) {
-          // only load the events that we need
-          break;
-        }
-        timestamp /= FLAGS_trace_speed_up;
-        // schema: (timestamp, machine_id, event_type, platform, CPUs, Memory)
-        uint64_t machine_id = lexical_cast<uint64_t>(cols[1]);
-        // Sub-sample the trace if we only retain < 100% of machines.
-        if (SpookyHash::Hash64(&machine_id, sizeof(machine_id), kSeed) >
-            MaxMachineEventHashToRetain()) {
-          // skip event
-          continue;
-        }
-
-        EventDescriptor event_desc;
-        event_desc.set_machine_id(lexical_cast<uint64_t>(cols[1]));
-        event_desc.set_type(TranslateMachineEvent(
-            lexical_cast<int32_t>(cols[2])));
-        if (event_desc.type() == EventDescriptor::REMOVE_MACHINE ||
-            event_desc.type() == EventDescriptor::ADD_MACHINE) {
-          machine_events->insert(
-              pair<uint64_t, EventDescriptor>(timestamp, event_desc));
-        } else {
-          // TODO(ionel): Handle machine update events.
-        }
+  while (reader.NextRow()) {
+    if (reader.num_fields() != 6) {
+      LOG(ERROR) << "Unexpected structure of machine events on line "
+                 << reader.line_number() << ": found " << reader.num_fields()
+                 << " columns.";
+    } else {
+      // schema: (timestamp, machine_id, event_type, platform, CPUs, Memory)
+      TraceMachineEvent machine_event;
+      machine_event.timestamp_ = reader.GetUInt64(0);
+      machine_event.machine_id_ = reader.GetUInt64(1);
+      machine_event.event_type_ = static_cast<int32_t>(reader.GetInt64(2));
+      if (!AddMachineEvent(machine_event, machine_events)) {
+        break;
       }
     }
-    num_line++;
   }
-  fclose(machines_file);
 }
 
 bool GoogleTraceLoader::LoadTaskEvents(
     uint64_t events_up_to_time,
     unordered_map<uint64_t, uint64_t>* job_num_tasks) {
-  char line[MAX_LINE_LENGTH];
-  vector<string> vals;
   bool loaded_event = false;
   if (!loaded_synthetic_task_) {
     // Add a submit event for the synthetic task.
@@ -181,101 +347,58 @@ bool GoogleTraceLoader::LoadTaskEvents(
   }
   while (true) {
     // Check if we're already reading from a file.
-    if (!task_events_file_) {
+    if (!task_events_) {
       if (current_task_events_file_id_ < FLAGS_num_files_to_process) {
-        // We still have files to open.
-        string fname;
-        spf(&fname, "%s/task_events/part-%05d-of-00500.csv",
-            FLAGS_trace_path.c_str(), current_task_events_file_id_);
-        if ((task_events_file_ = fopen(fname.c_str(), "r")) == NULL) {
-          LOG(FATAL) << "Failed to open trace for reading of task events.";
-        }
+        // We still have files to read.
+        task_events_ = GetTaskEventsFile(current_task_events_file_id_);
+        next_task_event_index_ = 0;
       } else {
         // There are no task events left to load.
         return loaded_event;
       }
     }
-    while (!feof(task_events_file_)) {
-      if (fscanf(task_events_file_, "%[^\n]%*[\n]", &line[0]) > 0) {
-        boost::split(vals, line, is_any_of(","), token_compress_off);
-        if (vals.size() != 13) {
-          LOG(ERROR) << "Unexpected structure of task event row: found "
-                     << vals.size() << " columns.";
-        } else {
-          TraceTaskIdentifier task_id;
-          uint64_t task_event_time = lexical_cast<uint64_t>(vals[0]);
-          task_event_time /= FLAGS_trace_speed_up;
-          task_id.job_id = lexical_cast<uint64_t>(vals[2]);
-          task_id.task_index = lexical_cast<uint64_t>(vals[3]);
-          uint64_t event_type = lexical_cast<uint64_t>(vals[5]);
-
-          // Sub-sample the trace if we only retain < 100% of tasks.
-          if (SpookyHash::Hash64(&task_id, sizeof(task_id), kSeed) >
-              MaxEventHashToRetain()) {
-            if (filtered_tasks_.find(task_id) == filtered_tasks_.end()) {
-              // The task has been filtered. Decrease the number of tasks the
-              // job has.
-              uint64_t* num_tasks = FindOrNull(*job_num_tasks, task_id.job_id);
-              CHECK_NOTNULL(num_tasks);
-              (*num_tasks)--;
-              filtered_tasks_.insert(task_id);
-            }
-            // skip event
-            continue;
-          }
-
-          if (event_type == TASK_SUBMIT_EVENT) {
-            EventDescriptor event_desc;
-            event_desc.set_type(EventDescriptor::TASK_SUBMIT);
-            event_desc.set_job_id(task_id.job_id);
-            event_desc.set_task_index(task_id.task_index);
-            event_desc.set_scheduling_class(lexical_cast<uint32_t>(vals[7]));
-            event_desc.set_priority(lexical_cast<uint32_t>(vals[8]));
-            try {
-              event_desc.set_requested_cpu_cores(lexical_cast<float>(vals[9]) *
-                                                 FLAGS_sim_machine_max_cores);
-            } catch (boost::bad_lexical_cast e) {
-              event_desc.set_requested_cpu_cores(0);
-            }
-            try {
-              event_desc.set_requested_ram(
-                  static_cast<uint64_t>(lexical_cast<double>(vals[10]) *
-                                        FLAGS_sim_machine_max_ram));
-            } catch (boost::bad_lexical_cast e) {
-              event_desc.set_requested_ram(0);
-            }
-            event_manager_->AddEvent(task_event_time, event_desc);
-            loaded_event = true;
-          } else {
-            // Skip this event and read next event from the trace.
-            continue;
-          }
-          if (task_event_time > events_up_to_time) {
-            // We've loaded all the events up to the given time.
-            // NOTE: we also loaded the current task event.
-            return true;
-          }
+    while (next_task_event_index_ < task_events_->size()) {
+      const TaskEvent& task_event = (*task_events_)[next_task_event_index_++];
+      if (task_event.filtered_) {
+        if (filtered_tasks_.find(task_event.task_id_) ==
+            filtered_tasks_.end()) {
+          // The task has been filtered. Decrease the number of tasks the
+          // job has.
+          uint64_t* num_tasks =
+            FindOrNull(*job_num_tasks, task_event.task_id_.job_id);
+          CHECK_NOTNULL(num_tasks);
+          (*num_tasks)--;
+          filtered_tasks_.insert(task_event.task_id_);
         }
+        continue;
+      }
+      EventDescriptor event_desc;
+      event_desc.set_type(EventDescriptor::TASK_SUBMIT);
+      event_desc.set_job_id(task_event.task_id_.job_id);
+      event_desc.set_task_index(task_event.task_id_.task_index);
+      event_desc.set_scheduling_class(task_event.scheduling_class_);
+      event_desc.set_priority(task_event.priority_);
+      event_desc.set_requested_cpu_cores(task_event.requested_cpu_cores_);
+      event_desc.set_requested_ram(task_event.requested_ram_);
+      event_manager_->AddEvent(task_event.timestamp_, event_desc);
+      loaded_event = true;
+      if (task_event.timestamp_ > events_up_to_time) {
+        // We've loaded all the events up to the given time.
+        // NOTE: we also loaded the current task event.
+        return true;
       }
     }
-    fclose(task_events_file_);
+    delete task_events_;
     current_task_events_file_id_++;
-    // We set the file to NULL to indicate that we should open the next file.
-    task_events_file_ = NULL;
+    // We set the events to NULL to indicate that we should read the next
+    // file.
+    task_events_ = NULL;
   }
   return true;
 }
 
 void GoogleTraceLoader::LoadTaskUtilizationStats(
     unordered_map<TaskID_t, TraceTaskStats>* task_id_to_stats) {
-  char line[MAX_LINE_LENGTH];
-  vector<string> cols;
-  FILE* usage_file = NULL;
-  string usage_file_name = FLAGS_trace_path +
-    "/task_usage_stat/task_usage_stat.csv";
-  if ((usage_file = fopen(usage_file_name.c_str(), "r")) == NULL) {
-    LOG(FATAL) << "Failed to open trace task runtime stats file.";
-  }
   TraceTaskStats synthetic_task_stats;
   TraceTaskIdentifier cur_synthetic_task;
   cur_synthetic_task.job_id = synthetic_task_.job_id;
@@ -288,84 +411,49 @@ void GoogleTraceLoader::LoadTaskUtilizationStats(
         GenerateTaskIDFromTraceIdentifier(cur_synthetic_task),
         synthetic_task_stats));
   }
-  int64_t num_line = 1;
-  while (!feof(usage_file)) {
-    if (fscanf(usage_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-      boost::split(cols, line, is_any_of(","), token_compress_off);
-      if (cols.size() != 38) {
-        LOG(WARNING) << "Malformed task usage, " << cols.size()
-                     << " != 38 columns at line " << num_line;
-      } else {
-        TraceTaskIdentifier ti;
-        ti.job_id = lexical_cast<uint64_t>(cols[0]);
-        ti.task_index = lexical_cast<uint64_t>(cols[1]);
-        TraceTaskStats task_stats;
-        task_stats.avg_mean_cpu_usage_ = lexical_cast<double>(cols[4]);
-        task_stats.avg_canonical_mem_usage_ = lexical_cast<double>(cols[8]);
-        task_stats.avg_assigned_mem_usage_ = lexical_cast<double>(cols[12]);
-        task_stats.avg_unmapped_page_cache_ = lexical_cast<double>(cols[16]);
-        task_stats.avg_total_page_cache_ = lexical_cast<double>(cols[20]);
-        task_stats.avg_mean_disk_io_time_ = lexical_cast<double>(cols[24]);
-        task_stats.avg_mean_local_disk_used_ = lexical_cast<double>(cols[28]);
-        task_stats.avg_cpi_ = lexical_cast<double>(cols[32]);
-        task_stats.avg_mai_ = lexical_cast<double>(cols[36]);
-
-        if (!InsertIfNotPresent(task_id_to_stats,
-                                GenerateTaskIDFromTraceIdentifier(ti),
-                                task_stats) &&
-            VLOG_IS_ON(1)) {
-          LOG(ERROR) << "LoadTaskUtilizationStats: There should not be more "
-                     << "than an entry for job " << ti.job_id
-                     << ", task " << ti.task_index;
-        } else {
-          VLOG(2) << "Loaded stats for "
-                  << ti.job_id << "/" << ti.task_index;
-        }
-
-        // double min_mean_cpu_usage = lexical_cast<double>(cols[2]);
-        // double max_mean_cpu_usage = lexical_cast<double>(cols[3]);
-        // double sd_mean_cpu_usage = lexical_cast<double>(cols[5]);
-        // double min_canonical_mem_usage = lexical_cast<double>(cols[6]);
-        // double max_canonical_mem_usage = lexical_cast<double>(cols[7]);
-        // double sd_canonical_mem_usage = lexical_cast<double>(cols[9]);
-        // double min_assigned_mem_usage = lexical_cast<double>(cols[10]);
-        // double max_assigned_mem_usage = lexical_cast<double>(cols[11]);
-        // double sd_assigned_mem_usage = lexical_cast<double>(cols[13]);
-        // double min_unmapped_page_cache = lexical_cast<double>(cols[14]);
-        // double max_unmapped_page_cache = lexical_cast<double>(cols[15]);
-        // double sd_unmapped_page_cache = lexical_cast<double>(cols[17]);
-        // double min_total_page_cache = lexical_cast<double>(cols[18]);
-        // double max_total_page_cache = lexical_cast<double>(cols[19]);
-        // double sd_total_page_cache = lexical_cast<double>(cols[21]);
-        // double min_mean_disk_io_time = lexical_cast<double>(cols[22]);
-        // double max_mean_disk_io_time = lexical_cast<double>(cols[23]);
-        // double sd_mean_disk_io_time = lexical_cast<double>(cols[25]);
-        // double min_mean_local_disk_used = lexical_cast<double>(cols[26]);
-        // double max_mean_local_disk_used = lexical_cast<double>(cols[27]);
-        // double sd_mean_local_disk_used = lexical_cast<double>(cols[29]);
-        // double min_cpi = lexical_cast<double>(cols[30]);
-        // double max_cpi = lexical_cast<double>(cols[31]);
-        // double sd_cpi = lexical_cast<double>(cols[33]);
-        // double min_mai = lexical_cast<double>(cols[34]);
-        // double max_mai = lexical_cast<double>(cols[35]);
-        // double sd_mai = lexical_cast<double>(cols[37]);
-      }
+  if (FLAGS_trace_format == "binary") {
+    BinaryTableReader<TraceTaskUsage> reader;
+    if (!reader.Open(BinaryTraceFileName(FLAGS_trace_path,
+                                         "task_usage_stat"))) {
+      LOG(FATAL) << "Failed to open binary trace task runtime stats file.";
+    }
+    for (uint64_t index = 0; index < reader.num_records(); ++index) {
+      AddTaskUsage(reader[index], task_id_to_stats);
+    }
+    return;
+  }
+  CSVReader reader;
+  string usage_file_name = FLAGS_trace_path +
+    "/task_usage_stat/task_usage_stat.csv";
+  if (!reader.Open(usage_file_name)) {
+    LOG(FATAL) << "Failed to open trace task runtime stats file.";
+  }
+  while (reader.NextRow()) {
+    if (reader.num_fields() != 38) {
+      LOG(WARNING) << "Malformed task usage, " << reader.num_fields()
+                   << " != 38 columns at line " << reader.line_number();
+    } else {
+      TraceTaskUsage task_usage;
+      task_usage.job_id_ = reader.GetUInt64(0);
+      task_usage.task_index_ = reader.GetUInt64(1);
+      task_usage.avg_mean_cpu_usage_ = reader.GetDouble(4);
+      task_usage.avg_canonical_mem_usage_ = reader.GetDouble(8);
+      task_usage.avg_assigned_mem_usage_ = reader.GetDouble(12);
+      task_usage.avg_unmapped_page_cache_ = reader.GetDouble(16);
+      task_usage.avg_total_page_cache_ = reader.GetDouble(20);
+      task_usage.avg_mean_disk_io_time_ = reader.GetDouble(24);
+      task_usage.avg_mean_local_disk_used_ = reader.GetDouble(28);
+      task_usage.avg_cpi_ = reader.GetDouble(32);
+      task_usage.avg_mai_ = reader.GetDouble(36);
+      // The other columns hold the min, max and standard deviation of each
+      // of the resources.
+      AddTaskUsage(task_usage, task_id_to_stats);
     }
-    num_line++;
   }
-  fclose(usage_file);
 }
 
 void GoogleTraceLoader::LoadTasksRunningTime(
     unordered_map<TaskID_t, uint64_t>* task_runtime) {
-  char line[MAX_LINE_LENGTH];
-  vector<string> cols;
-  FILE* tasks_file = NULL;
-  string tasks_file_name = FLAGS_trace_path +
-    "/task_runtime_events/task_runtime_events.csv";
-  if ((tasks_file = fopen(tasks_file_name.c_str(), "r")) == NULL) {
-    LOG(FATAL) << "Failed to open trace runtime events file.";
-  }
   // Load the runtime of the synthetic task.
   TraceTaskIdentifier cur_synthetic_task;
   cur_synthetic_task.job_id = synthetic_task_.job_id;
@@ -378,46 +466,35 @@ void GoogleTraceLoader::LoadTasksRunningTime(
     CHECK(InsertIfNotPresent(task_runtime, synthetic_task_id,
                              FLAGS_synthetic_task_runtime));
   }
-  int64_t num_line = 1;
-  while (!feof(tasks_file)) {
-    if (fscanf(tasks_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-      boost::split(cols, line, is_any_of(","), token_compress_off);
-      if (cols.size() != 13) {
-        LOG(ERROR) << "Unexpected structure of task runtime row on line: "
-                   << num_line;
-      } else {
-        TraceTaskIdentifier ti;
-        ti.job_id = lexical_cast<uint64_t>(cols[0]);
-        ti.task_index = lexical_cast<uint64_t>(cols[1]);
-
-        // Sub-sample the trace if we only retain < 100% of tasks.
-        if (SpookyHash::Hash64(&ti, sizeof(ti), kSeed) >
-            MaxEventHashToRetain()) {
-          // skip event
-          continue;
-        }
-        // Get the total runtime of the task. This includes the time
-        // of the runs that failed or were killed. In this way, we make
-        // sure that the task runs for the same amount of time as when
-        // it executed in real-world.
-        uint64_t runtime = lexical_cast<uint64_t>(cols[4]);
-        runtime /= FLAGS_trace_speed_up;
-        if (!InsertIfNotPresent(task_runtime,
-                                GenerateTaskIDFromTraceIdentifier(ti),
-                                runtime) &&
-            VLOG_IS_ON(1)) {
-          LOG(ERROR) << "LoadTasksRunningTime: There should not be more than "
-                     << "one entry for job " << ti.job_id
-                     << ", task " << ti.task_index;
-        } else {
-          VLOG(2) << "Loaded runtime for "
-                  << ti.job_id << "/" << ti.task_index;
-        }
-      }
+  if (FLAGS_trace_format == "binary") {
+    BinaryTableReader<TraceTaskRuntime> reader;
+    if (!reader.Open(BinaryTraceFileName(FLAGS_trace_path,
+                                         "task_runtime_events"))) {
+      LOG(FATAL) << "Failed to open binary trace runtime events file.";
+    }
+    for (uint64_t index = 0; index < reader.num_records(); ++index) {
+      AddTaskRuntime(reader[index], task_runtime);
+    }
+    return;
+  }
+  CSVReader reader;
+  string tasks_file_name = FLAGS_trace_path +
+    "/task_runtime_events/task_runtime_events.csv";
+  if (!reader.Open(tasks_file_name)) {
+    LOG(FATAL) << "Failed to open trace runtime events file.";
+  }
+  while (reader.NextRow()) {
+    if (reader.num_fields() != 13) {
+      LOG(ERROR) << "Unexpected structure of task runtime row on line: "
+                 << reader.line_number();
+    } else {
+      TraceTaskRuntime trace_task_runtime;
+      trace_task_runtime.job_id_ = reader.GetUInt64(0);
+      trace_task_runtime.task_index_ = reader.GetUInt64(1);
+      trace_task_runtime.runtime_ = reader.GetUInt64(4);
+      AddTaskRuntime(trace_task_runtime, task_runtime);
     }
-    num_line++;
   }
-  fclose(tasks_file);
 }
 
 uint64_t GoogleTraceLoader::MaxEventHashToRetain() {
@@ -442,5 +519,87 @@ uint64_t GoogleTraceLoader::MaxMachineEventHashToRetain() {
   }
 }
 
+void GoogleTraceLoader::ParseTaskEventsFile(int32_t file_id,
+                                            vector<TaskEvent>* task_events) {
+  if (FLAGS_trace_format == "binary") {
+    ReadBinaryTaskEventsFile(file_id, task_events);
+    return;
+  }
+  string fname;
+  spf(&fname, "%s/task_events/part-%05d-of-00500.csv",
+      FLAGS_trace_path.c_str(), file_id);
+  CSVReader reader;
+  if (!reader.Open(fname)) {
+    LOG(FATAL) << "Failed to open trace for reading of task events.";
+  }
+  while (reader.NextRow()) {
+    if (reader.num_fields() != 13) {
+      LOG(ERROR) << "Unexpected structure of task event row: found "
+                 << reader.num_fields() << " columns.";
+      continue;
+    }
+    TraceTaskEvent trace_task_event;
+    trace_task_event.timestamp_ = reader.GetUInt64(0);
+    trace_task_event.job_id_ = reader.GetUInt64(2);
+    trace_task_event.task_index_ = reader.GetUInt64(3);
+    trace_task_event.event_type_ = static_cast<uint32_t>(reader.GetUInt64(5));
+    trace_task_event.fields_set_ = 0;
+    if (trace_task_event.event_type_ == TASK_SUBMIT_EVENT) {
+      trace_task_event.scheduling_class_ =
+        static_cast<uint32_t>(reader.GetUInt64(7));
+      trace_task_event.priority_ = static_cast<uint32_t>(reader.GetUInt64(8));
+      double request = 0;
+      if (reader.ParseDouble(9, &request)) {
+        trace_task_event.cpu_request_ = static_cast<float>(request);
+        trace_task_event.fields_set_ |= kTraceCpuRequestSet;
+      }
+      if (reader.ParseDouble(10, &trace_task_event.ram_request_)) {
+        trace_task_event.fields_set_ |= kTraceRamRequestSet;
+      }
+    }
+    AddTaskEvent(trace_task_event, task_events);
+  }
+}
+
+void GoogleTraceLoader::ParseTaskEventsFiles() {
+  while (true) {
+    int32_t file_id;
+    {
+      boost::unique_lock<boost::mutex> lock(task_events_lock_);
+      while (!stop_parsing_task_events_ &&
+             next_task_events_file_to_parse_ >
+             last_task_events_file_to_parse_) {
+        task_events_cond_.wait(lock);
+      }
+      if (stop_parsing_task_events_ ||
+          next_task_events_file_to_parse_ >= FLAGS_num_files_to_process) {
+        return;
+      }
+      file_id = next_task_events_file_to_parse_++;
+    }
+    vector<TaskEvent>* task_events = new vector<TaskEvent>();
+    ParseTaskEventsFile(file_id, task_events);
+    {
+      boost::lock_guard<boost::mutex> lock(task_events_lock_);
+      CHECK(InsertIfNotPresent(&parsed_task_events_, file_id, task_events));
+    }
+    task_events_cond_.notify_all();
+  }
+}
+
+void GoogleTraceLoader::ReadBinaryTaskEventsFile(
+    int32_t file_id,
+    vector<TaskEvent>* task_events) {
+  BinaryTaskEventsReader reader;
+  if (!reader.Open(BinaryTaskEventsFileName(FLAGS_trace_path, file_id))) {
+    LOG(FATAL) << "Failed to open binary trace for reading of task events.";
+  }
+  task_events->reserve(reader.num_records());
+  TraceTaskEvent trace_task_event;
+  while (reader.Next(&trace_task_event)) {
+    AddTaskEvent(trace_task_event, task_events);
+  }
+}
+
 } // namespace sim
 } // namespace firmament
@@ -11,9 +11,12 @@
 #include <unordered_map>
 #include <vector>
 
+#include <boost/thread.hpp>
+
 #include "base/common.h"
 #include "base/resource_topology_node_desc.pb.h"
 #include "misc/map-util.h"
+#include "sim/binary_trace.h"
 #include "sim/event_desc.pb.h"
 #include "sim/event_manager.h"
 #include "sim/trace_loader.h"
@@ -58,13 +61,65 @@ class GoogleTraceLoader : public TraceLoader {
       unordered_map<TaskID_t, uint64_t>* task_runtime);
 
  private:
+  // Task event of the trace that affects the simulation. We only keep the
+  // submit events of the retained tasks, and one event for every filtered
+  // task event.
+  struct TaskEvent {
+    uint64_t timestamp_;
+    TraceTaskIdentifier task_id_;
+    uint64_t requested_ram_;
+    float requested_cpu_cores_;
+    uint32_t priority_;
+    uint32_t scheduling_class_;
+    bool filtered_;
+  };
+
+  /**
+   * The following methods add a trace record to the simulator's data. They
+   * are shared by the CSV and the binary trace formats.
+   * @return false if the record and all the records after it are past the
+   * simulation's runtime
+   */
+  bool AddMachineEvent(const TraceMachineEvent& machine_event,
+                       multimap<uint64_t, EventDescriptor>* machine_events);
+  void AddTaskEvent(const TraceTaskEvent& trace_task_event,
+                    vector<TaskEvent>* task_events);
+  void AddTaskRuntime(const TraceTaskRuntime& trace_task_runtime,
+                      unordered_map<TaskID_t, uint64_t>* task_runtime);
+  void AddTaskUsage(const TraceTaskUsage& trace_task_usage,
+                    unordered_map<TaskID_t, TraceTaskStats>* task_id_to_stats);
+  /**
+   * Returns the parsed events of the task events file the simulator reads
+   * from. The call blocks until the file has been parsed.
+   */
+  vector<TaskEvent>* GetTaskEventsFile(int32_t file_id);
   uint64_t MaxEventHashToRetain();
   uint64_t MaxMachineEventHashToRetain();
+  void ParseTaskEventsFile(int32_t file_id, vector<TaskEvent>* task_events);
+  void ReadBinaryTaskEventsFile(int32_t file_id,
+                                vector<TaskEvent>* task_events);
+  /**
+   * Method run by the threads that parse the task events files ahead of the
+   * file the simulator reads from.
+   */
+  void ParseTaskEventsFiles();
 
   // The number of the task events file the simulator is reading from.
   int32_t current_task_events_file_id_;
-  // File from which to read the task events.
-  FILE* task_events_file_;
+  // Events of the file the simulator is reading from, and index of the next
+  // event to load.
+  vector<TaskEvent>* task_events_;
+  uint64_t next_task_event_index_;
+  // The task events files that have been parsed ahead, by file number.
+  map<int32_t, vector<TaskEvent>*> parsed_task_events_;
+  // The number of the next task events file to parse, and of the last file
+  // the parsers may parse before the simulator moves on to the next file.
+  int32_t next_task_events_file_to_parse_;
+  int32_t last_task_events_file_to_parse_;
+  bool stop_parsing_task_events_;
+  boost::thread_group task_events_parsers_;
+  boost::mutex task_events_lock_;
+  boost::condition_variable task_events_cond_;
   // The first time we encounter a filtered task we must update the number of
   // tasks its corresponding job has. However, upon subsequent encounters we do
   // not have to do that. We use this collection to maintain a set of tasks
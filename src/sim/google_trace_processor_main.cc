@@ -7,6 +7,9 @@ DEFINE_string(trace_path, "", "Path where the trace files are.");
 DEFINE_bool(aggregate_task_usage, false, "Generate aggregated task usage.");
 DEFINE_bool(jobs_runtime, false, "Generate task events with runtime.");
 DEFINE_bool(jobs_num_tasks, false, "Generate num tasks for each jobs.");
+DEFINE_bool(binary_trace, false,
+            "Convert the files the simulator loads to the binary trace format "
+            "used with -trace_format=binary.");
 DEFINE_int32(num_files_to_process, 500, "Number of files to process.");
 DEFINE_bool(tasks_preemption_bins, false,
             "Compute bins of number of preempted tasks.");
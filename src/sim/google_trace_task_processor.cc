@@ -3,8 +3,6 @@
 
 #include "sim/google_trace_task_processor.h"
 
-#include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast.hpp>
 #include <errno.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -12,7 +10,9 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <limits>
 #include <utility>
 #include <vector>
@@ -20,10 +20,6 @@
 #include "misc/map-util.h"
 #include "misc/string_utils.h"
 
-using boost::lexical_cast;
-using boost::algorithm::is_any_of;
-using boost::token_compress_off;
-
 #define TASK_SUBMIT 0
 #define TASK_SCHEDULE 1
 #define TASK_EVICT 2
@@ -37,6 +33,7 @@ using boost::token_compress_off;
 #define EPS 0.00001
 
 DECLARE_bool(aggregate_task_usage);
+DECLARE_bool(binary_trace);
 DECLARE_bool(jobs_runtime);
 DECLARE_bool(jobs_num_tasks);
 DECLARE_int32(num_files_to_process);
@@ -46,6 +43,11 @@ DEFINE_uint64(bin_time_duration, 10, "Bin size in microseconds.");
 namespace firmament {
 namespace sim {
 
+  static bool TraceTaskEventTimestampLess(const TraceTaskEvent& event1,
+                                          const TraceTaskEvent& event2) {
+    return event1.timestamp_ < event2.timestamp_;
+  }
+
   void MkdirIfNotPresent(const string &directory) {
     if (mkdir(directory.c_str(), 0777) < 0) {
       // mkdir error
@@ -66,67 +68,57 @@ namespace sim {
     // Store the scheduling events for every timestamp.
     multimap<uint64_t, TaskSchedulingEvent> *scheduling_events =
       new multimap<uint64_t, TaskSchedulingEvent>();
-    char line[200];
-    vector<string> line_cols;
-    FILE* events_file = NULL;
+    CSVReader reader;
     for (int32_t file_num = 0; file_num < FLAGS_num_files_to_process;
          file_num++) {
       LOG(INFO) << "Reading task_events file " << file_num;
       string file_name;
       spf(&file_name, "%s/task_events/part-%05d-of-00500.csv",
           trace_path_.c_str(), file_num);
-      if ((events_file = fopen(file_name.c_str(), "r")) == NULL) {
+      if (!reader.Open(file_name)) {
         LOG(FATAL) << "Failed to open trace for reading of task events.";
       }
-      int64_t num_line = 1;
-      while (!feof(events_file)) {
-        if (fscanf(events_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-          boost::split(line_cols, line, is_any_of(","), token_compress_off);
-          if (line_cols.size() != 13) {
-            LOG(ERROR) << "Unexpected structure of task event on line "
-                       << num_line << ": found " << line_cols.size()
-                       << " columns.";
-          } else {
-            uint64_t timestamp = lexical_cast<uint64_t>(line_cols[0]);
-            uint64_t job_id = lexical_cast<uint64_t>(line_cols[2]);
-            uint64_t task_index = lexical_cast<uint64_t>(line_cols[3]);
-            int32_t task_event = lexical_cast<int32_t>(line_cols[5]);
-            // Only handle the events we're interested in. We do not care about
-            // TASK_SUBMIT because that's not the event that starts a task. The
-            // events we are interested in are the ones that change the state
-            // of a task to/from running.
-            if (task_event == TASK_SCHEDULE || task_event == TASK_EVICT ||
-                task_event == TASK_FAIL || task_event == TASK_FINISH ||
-                task_event == TASK_KILL || task_event == TASK_LOST) {
-              TaskSchedulingEvent event;
-              event.job_id_ = job_id;
-              event.task_index_ = task_index;
-              event.event_type_ = task_event;
-              scheduling_events->insert(
-                  pair<uint64_t, TaskSchedulingEvent>(timestamp, event));
-            }
-            if (FLAGS_jobs_num_tasks && task_event == TASK_SUBMIT) {
-              uint64_t* num_tasks = FindOrNull(*job_num_tasks, job_id);
-              if (num_tasks == NULL) {
-                CHECK(InsertOrUpdate(job_num_tasks, job_id, 1));
-              } else {
-                (*num_tasks)++;
-              }
+      while (reader.NextRow()) {
+        if (reader.num_fields() != 13) {
+          LOG(ERROR) << "Unexpected structure of task event on line "
+                     << reader.line_number() << ": found "
+                     << reader.num_fields() << " columns.";
+        } else {
+          uint64_t timestamp = reader.GetUInt64(0);
+          uint64_t job_id = reader.GetUInt64(2);
+          uint64_t task_index = reader.GetUInt64(3);
+          int32_t task_event = static_cast<int32_t>(reader.GetInt64(5));
+          // Only handle the events we're interested in. We do not care about
+          // TASK_SUBMIT because that's not the event that starts a task. The
+          // events we are interested in are the ones that change the state
+          // of a task to/from running.
+          if (task_event == TASK_SCHEDULE || task_event == TASK_EVICT ||
+              task_event == TASK_FAIL || task_event == TASK_FINISH ||
+              task_event == TASK_KILL || task_event == TASK_LOST) {
+            TaskSchedulingEvent event;
+            event.job_id_ = job_id;
+            event.task_index_ = task_index;
+            event.event_type_ = task_event;
+            scheduling_events->insert(
+                pair<uint64_t, TaskSchedulingEvent>(timestamp, event));
+          }
+          if (FLAGS_jobs_num_tasks && task_event == TASK_SUBMIT) {
+            uint64_t* num_tasks = FindOrNull(*job_num_tasks, job_id);
+            if (num_tasks == NULL) {
+              CHECK(InsertOrUpdate(job_num_tasks, job_id, 1));
+            } else {
+              (*num_tasks)++;
             }
           }
         }
-        num_line++;
       }
-      fclose(events_file);
     }
     return *scheduling_events;
   }
 
   void GoogleTraceTaskProcessor::BinTasksByEventType(int32_t event,
                                                      FILE* out_file) {
-    char line[200];
-    vector<string> vals;
-    FILE* fptr = NULL;
+    CSVReader reader;
     uint64_t time_interval_bound = FLAGS_bin_time_duration;
     uint64_t num_tasks = 0;
     for (int32_t file_num = 0; file_num < FLAGS_num_files_to_process;
@@ -134,39 +126,36 @@ namespace sim {
       string fname;
       spf(&fname, "%s/task_events/part-%05d-of-00500.csv",
           trace_path_.c_str(), file_num);
-      if ((fptr = fopen(fname.c_str(), "r")) == NULL) {
+      if (!reader.Open(fname)) {
         LOG(ERROR) << "Failed to open trace for reading of task events.";
+        continue;
       }
-      while (!feof(fptr)) {
-        if (fscanf(fptr, "%[^\n]%*[\n]", &line[0]) > 0) {
-          boost::split(vals, line, is_any_of(","), token_compress_off);
-          if (vals.size() != 13) {
-            LOG(ERROR) << "Unexpected structure of task event row: found "
-                       << vals.size() << " columns.";
-          } else {
-            uint64_t task_time = lexical_cast<uint64_t>(vals[0]);
-            int32_t event_type = lexical_cast<int32_t>(vals[5]);
-            if (event_type == event) {
-              if (task_time <= time_interval_bound) {
-                num_tasks++;
-              } else {
-                fprintf(out_file, "(%ju, %ju]: %ju\n",
+      while (reader.NextRow()) {
+        if (reader.num_fields() != 13) {
+          LOG(ERROR) << "Unexpected structure of task event row: found "
+                     << reader.num_fields() << " columns.";
+        } else {
+          uint64_t task_time = reader.GetUInt64(0);
+          int32_t event_type = static_cast<int32_t>(reader.GetInt64(5));
+          if (event_type == event) {
+            if (task_time <= time_interval_bound) {
+              num_tasks++;
+            } else {
+              fprintf(out_file, "(%ju, %ju]: %ju\n",
+                      time_interval_bound - FLAGS_bin_time_duration,
+                      time_interval_bound, num_tasks);
+              time_interval_bound += FLAGS_bin_time_duration;
+              while (time_interval_bound < task_time) {
+                fprintf(out_file, "(%ju, %ju]: 0\n",
                         time_interval_bound - FLAGS_bin_time_duration,
-                        time_interval_bound, num_tasks);
+                        time_interval_bound);
                 time_interval_bound += FLAGS_bin_time_duration;
-                while (time_interval_bound < task_time) {
-                  fprintf(out_file, "(%ju, %ju]: 0\n",
-                          time_interval_bound - FLAGS_bin_time_duration,
-                          time_interval_bound);
-                  time_interval_bound += FLAGS_bin_time_duration;
-                }
-                num_tasks = 1;
               }
+              num_tasks = 1;
             }
           }
         }
       }
-      fclose(fptr);
     }
     fprintf(out_file, "(%ju, %ju]: %ju\n",
             time_interval_bound - FLAGS_bin_time_duration,
@@ -174,32 +163,22 @@ namespace sim {
   }
 
   TaskResourceUsage GoogleTraceTaskProcessor::BuildTaskResourceUsage(
-      vector<string>& line_cols) {
+      const CSVReader& reader) {
     TaskResourceUsage task_resource_usage;
     // Set resource value to -1 if not present. We can then later not take it
     // into account when we compute the statistics.
-    for (uint32_t index = 5; index < 17; index++) {
-      if (!line_cols[index].compare("")) {
-        line_cols[index] = "-1";
-      }
-    }
-    task_resource_usage.mean_cpu_usage_ = lexical_cast<double>(line_cols[5]);
-    task_resource_usage.canonical_mem_usage_ =
-      lexical_cast<double>(line_cols[6]);
-    task_resource_usage.assigned_mem_usage_ =
-      lexical_cast<double>(line_cols[7]);
-    task_resource_usage.unmapped_page_cache_ =
-      lexical_cast<double>(line_cols[8]);
-    task_resource_usage.total_page_cache_ = lexical_cast<double>(line_cols[9]);
-    task_resource_usage.max_mem_usage_ = lexical_cast<double>(line_cols[10]);
-    task_resource_usage.mean_disk_io_time_ =
-      lexical_cast<double>(line_cols[11]);
-    task_resource_usage.mean_local_disk_used_ =
-      lexical_cast<double>(line_cols[12]);
-    task_resource_usage.max_cpu_usage_ = lexical_cast<double>(line_cols[13]);
-    task_resource_usage.max_disk_io_time_ = lexical_cast<double>(line_cols[14]);
-    task_resource_usage.cpi_ = lexical_cast<double>(line_cols[15]);
-    task_resource_usage.mai_ = lexical_cast<double>(line_cols[16]);
+    task_resource_usage.mean_cpu_usage_ = reader.GetDouble(5, -1);
+    task_resource_usage.canonical_mem_usage_ = reader.GetDouble(6, -1);
+    task_resource_usage.assigned_mem_usage_ = reader.GetDouble(7, -1);
+    task_resource_usage.unmapped_page_cache_ = reader.GetDouble(8, -1);
+    task_resource_usage.total_page_cache_ = reader.GetDouble(9, -1);
+    task_resource_usage.max_mem_usage_ = reader.GetDouble(10, -1);
+    task_resource_usage.mean_disk_io_time_ = reader.GetDouble(11, -1);
+    task_resource_usage.mean_local_disk_used_ = reader.GetDouble(12, -1);
+    task_resource_usage.max_cpu_usage_ = reader.GetDouble(13, -1);
+    task_resource_usage.max_disk_io_time_ = reader.GetDouble(14, -1);
+    task_resource_usage.cpi_ = reader.GetDouble(15, -1);
+    task_resource_usage.mai_ = reader.GetDouble(16, -1);
     return task_resource_usage;
   }
 
@@ -208,20 +187,20 @@ namespace sim {
       unordered_map<TaskIdentifier, TaskRuntime,
                     TaskIdentifierHasher>* tasks_runtime,
       unordered_map<uint64_t, string>* job_id_to_name,
-      vector<string>& line_cols) {
+      const CSVReader& reader) {
     if (event_type == TASK_SCHEDULE) {
       TaskRuntime* task_runtime_ptr = FindOrNull(*tasks_runtime, task_id);
       if (task_runtime_ptr == NULL) {
         TaskRuntime task_runtime;
         task_runtime.start_time_ = timestamp;
         task_runtime.last_schedule_time_ = timestamp;
-        PopulateTaskRuntime(&task_runtime, line_cols);
+        PopulateTaskRuntime(&task_runtime, reader);
         InsertIfNotPresent(tasks_runtime, task_id, task_runtime);
       } else {
         // Update the last scheduling time for the task. Assumes that
         // the previously running instance of the task has finished/failed.
         task_runtime_ptr->last_schedule_time_ = timestamp;
-        PopulateTaskRuntime(task_runtime_ptr, line_cols);
+        PopulateTaskRuntime(task_runtime_ptr, reader);
       }
     } else if (event_type == TASK_EVICT || event_type == TASK_FAIL ||
                event_type == TASK_KILL || event_type == TASK_LOST) {
@@ -234,7 +213,7 @@ namespace sim {
         task_runtime.start_time_ = 0;
         task_runtime.num_runs_ = 1;
         task_runtime.total_runtime_ = timestamp;
-        PopulateTaskRuntime(&task_runtime, line_cols);
+        PopulateTaskRuntime(&task_runtime, reader);
         InsertIfNotPresent(tasks_runtime, task_id, task_runtime);
       } else {
         // Update the runtime for the task. The failed tasks are included
@@ -242,7 +221,7 @@ namespace sim {
         task_runtime_ptr->num_runs_++;
         task_runtime_ptr->total_runtime_ +=
           timestamp - task_runtime_ptr->last_schedule_time_;
-        PopulateTaskRuntime(task_runtime_ptr, line_cols);
+        PopulateTaskRuntime(task_runtime_ptr, reader);
         task_runtime_ptr->last_schedule_time_ = -1;  // unscheduled
       }
     } else if (event_type == TASK_FINISH) {
@@ -255,14 +234,14 @@ namespace sim {
         task_runtime.start_time_ = 0;
         task_runtime.num_runs_ = 1;
         task_runtime.total_runtime_ = timestamp;
-        PopulateTaskRuntime(&task_runtime, line_cols);
+        PopulateTaskRuntime(&task_runtime, reader);
         task_runtime.runtime_ = timestamp;
         InsertIfNotPresent(tasks_runtime, task_id, task_runtime);
       } else {
         task_runtime_ptr->num_runs_++;
         task_runtime_ptr->total_runtime_ +=
           timestamp - task_runtime_ptr->last_schedule_time_;
-        PopulateTaskRuntime(task_runtime_ptr, line_cols);
+        PopulateTaskRuntime(task_runtime_ptr, reader);
         CHECK_GE(task_runtime_ptr->last_schedule_time_, 0);
         // NOTE: runtime_ represents the time the task spent running in the run
         // that finished correctly. This value is computed as
@@ -453,9 +432,7 @@ namespace sim {
     // is used to filter task usage events that have been recoreded after the
     // end of the task.
     unordered_set<TaskIdentifier, TaskIdentifierHasher> finished_tasks;
-    char line[200];
-    vector<string> line_cols;
-    FILE* usage_file = NULL;
+    CSVReader reader;
     FILE* usage_stat_file = NULL;
     string usage_directory;
     spf(&usage_directory, "%s/task_usage_stat", trace_path_.c_str());
@@ -472,54 +449,47 @@ namespace sim {
       string file_name;
       spf(&file_name, "%s/task_usage/part-%05d-of-00500.csv",
           trace_path_.c_str(), file_num);
-      if ((usage_file = fopen(file_name.c_str(), "r")) == NULL) {
+      if (!reader.Open(file_name)) {
         LOG(FATAL) << "Failed to open trace for reading of task "
                    << "resource usage.";
       }
-      int64_t num_line = 1;
-      while (!feof(usage_file)) {
-        if (fscanf(usage_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-          boost::split(line_cols, line, is_any_of(","), token_compress_off);
-          if (line_cols.size() != 19 && line_cols.size() != 20) {
-            // 19 columns in v2 of trace, 20 columns in v2.1 of trace
-            // (we do not use the 20th column, being sampled CPU usage)
-            LOG(ERROR) << "Unexpected structure of task usage on line "
-                       << num_line << ": found " << line_cols.size()
-                       << " columns.";
+      while (reader.NextRow()) {
+        if (reader.num_fields() != 19 && reader.num_fields() != 20) {
+          // 19 columns in v2 of trace, 20 columns in v2.1 of trace
+          // (we do not use the 20th column, being sampled CPU usage)
+          LOG(ERROR) << "Unexpected structure of task usage on line "
+                     << reader.line_number() << ": found "
+                     << reader.num_fields() << " columns.";
+        } else {
+          uint64_t start_timestamp = reader.GetUInt64(0);
+          TaskIdentifier cur_task_id;
+          cur_task_id.job_id_ = reader.GetUInt64(2);
+          cur_task_id.task_index_ = reader.GetUInt64(3);
+          if (last_timestamp < start_timestamp) {
+            ProcessSchedulingEvents(last_timestamp, &scheduling_events,
+                                    &task_usage_stats, &finished_tasks,
+                                    usage_stat_file);
+          }
+          last_timestamp = start_timestamp;
+          if (finished_tasks.find(cur_task_id) != finished_tasks.end()) {
+            // We've already seen a FINISH event for the task. Ignore task
+            // usage statistics after the end of the task.
+            continue;
+          }
+          TaskResourceUsage task_resource_usage =
+            BuildTaskResourceUsage(reader);
+          TaskResourceUsageStats* usage_stats_ptr =
+            FindOrNull(task_usage_stats, cur_task_id);
+          if (!usage_stats_ptr) {
+            TaskResourceUsageStats new_usage_stats;
+            InitializeResourceUsageStats(&new_usage_stats);
+            UpdateUsageStats(task_resource_usage, &new_usage_stats);
+            InsertOrUpdate(&task_usage_stats, cur_task_id, new_usage_stats);
           } else {
-            uint64_t start_timestamp = lexical_cast<uint64_t>(line_cols[0]);
-            TaskIdentifier cur_task_id;
-            cur_task_id.job_id_ = lexical_cast<uint64_t>(line_cols[2]);
-            cur_task_id.task_index_ = lexical_cast<uint64_t>(line_cols[3]);
-            if (last_timestamp < start_timestamp) {
-              ProcessSchedulingEvents(last_timestamp, &scheduling_events,
-                                      &task_usage_stats, &finished_tasks,
-                                      usage_stat_file);
-            }
-            last_timestamp = start_timestamp;
-            if (finished_tasks.find(cur_task_id) != finished_tasks.end()) {
-              // We've already seen a FINISH event for the task. Ignore task
-              // usage statistics after the end of the task.
-              num_line++;
-              continue;
-            }
-            TaskResourceUsage task_resource_usage =
-              BuildTaskResourceUsage(line_cols);
-            TaskResourceUsageStats* usage_stats_ptr =
-              FindOrNull(task_usage_stats, cur_task_id);
-            if (!usage_stats_ptr) {
-              TaskResourceUsageStats new_usage_stats;
-              InitializeResourceUsageStats(&new_usage_stats);
-              UpdateUsageStats(task_resource_usage, &new_usage_stats);
-              InsertOrUpdate(&task_usage_stats, cur_task_id, new_usage_stats);
-            } else {
-              UpdateUsageStats(task_resource_usage, usage_stats_ptr);
-            }
+            UpdateUsageStats(task_resource_usage, usage_stats_ptr);
           }
         }
-        num_line++;
       }
-      fclose(usage_file);
     }
     // Process the scheduling events up to the last timestamp.
     ProcessSchedulingEvents(last_timestamp, &scheduling_events,
@@ -540,51 +510,40 @@ namespace sim {
       GoogleTraceTaskProcessor::ReadLogicalJobsName() {
     unordered_map<uint64_t, string> *job_id_to_name =
       new unordered_map<uint64_t, string>();
-    char line[200];
-    vector<string> line_cols;
-    FILE* events_file = NULL;
+    CSVReader reader;
     for (int32_t file_num = 0; file_num < FLAGS_num_files_to_process;
          file_num++) {
       LOG(INFO) << "Reading job_events file " << file_num;
       string file_name;
       spf(&file_name, "%s/job_events/part-%05d-of-00500.csv",
           trace_path_.c_str(), file_num);
-      if ((events_file = fopen(file_name.c_str(), "r")) == NULL) {
+      if (!reader.Open(file_name)) {
         LOG(FATAL) << "Failed to open trace for reading of job events.";
       }
-      int64_t num_line = 1;
-      while (!feof(events_file)) {
-        if (fscanf(events_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-          boost::split(line_cols, line, is_any_of(","), token_compress_off);
-          if (line_cols.size() != 8) {
-            LOG(ERROR) << "Unexpected structure of job event on line "
-                       << num_line << ": found " << line_cols.size()
-                       << " columns.";
-          } else {
-            uint64_t job_id = lexical_cast<uint64_t>(line_cols[2]);
-            InsertOrUpdate(job_id_to_name, job_id, line_cols[7]);
-          }
+      while (reader.NextRow()) {
+        if (reader.num_fields() != 8) {
+          LOG(ERROR) << "Unexpected structure of job event on line "
+                     << reader.line_number() << ": found "
+                     << reader.num_fields() << " columns.";
+        } else {
+          uint64_t job_id = reader.GetUInt64(2);
+          InsertOrUpdate(job_id_to_name, job_id, reader.GetString(7));
         }
-        num_line++;
       }
-      fclose(events_file);
     }
     return *job_id_to_name;
   }
 
   void GoogleTraceTaskProcessor::PopulateTaskRuntime(
-      TaskRuntime* task_runtime_ptr, vector<string>& cols) {
-    for (uint32_t index = 7; index < 13; ++index) {
-      if (!cols[index].compare("")) {
-        cols[index] = "-1";
-      }
-    }
-    task_runtime_ptr->scheduling_class_ = lexical_cast<uint64_t>(cols[7]);
-    task_runtime_ptr->priority_ = lexical_cast<uint64_t>(cols[8]);
-    task_runtime_ptr->cpu_request_ = lexical_cast<double>(cols[9]);
-    task_runtime_ptr->ram_request_ = lexical_cast<double>(cols[10]);
-    task_runtime_ptr->disk_request_ = lexical_cast<double>(cols[11]);
-    task_runtime_ptr->machine_constraint_ = lexical_cast<int32_t>(cols[12]);
+      TaskRuntime* task_runtime_ptr, const CSVReader& reader) {
+    // The missing values are set to -1.
+    task_runtime_ptr->scheduling_class_ = reader.GetInt64(7, -1);
+    task_runtime_ptr->priority_ = reader.GetInt64(8, -1);
+    task_runtime_ptr->cpu_request_ = reader.GetDouble(9, -1);
+    task_runtime_ptr->ram_request_ = reader.GetDouble(10, -1);
+    task_runtime_ptr->disk_request_ = reader.GetDouble(11, -1);
+    task_runtime_ptr->machine_constraint_ =
+      static_cast<int32_t>(reader.GetInt64(12, -1));
   }
 
   void GoogleTraceTaskProcessor::PrintTaskRuntime(
@@ -632,9 +591,7 @@ namespace sim {
     unordered_map<TaskIdentifier, TaskRuntime,
                   TaskIdentifierHasher> tasks_runtime;
     uint64_t end_simulation_time = 0;
-    char line[200];
-    vector<string> line_cols;
-    FILE* events_file = NULL;
+    CSVReader reader;
     string out_events_directory;
     spf(&out_events_directory, "%s/task_runtime_events", trace_path_.c_str());
     MkdirIfNotPresent(out_events_directory);
@@ -651,33 +608,27 @@ namespace sim {
       string file_name;
       spf(&file_name, "%s/task_events/part-%05d-of-00500.csv",
           trace_path_.c_str(), file_num);
-      if ((events_file = fopen(file_name.c_str(), "r")) == NULL) {
+      if (!reader.Open(file_name)) {
         LOG(FATAL) << "Failed to open trace for reading of task events.";
       }
-      int64_t num_line = 1;
-      while (!feof(events_file)) {
-        if (fscanf(events_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-          boost::split(line_cols, line, is_any_of(","), token_compress_off);
-          if (line_cols.size() != 13) {
-            LOG(ERROR) << "Unexpected structure of task event on line "
-                       << num_line << ": found " << line_cols.size()
-                       << " columns.";
-          } else {
-            TaskIdentifier task_id;
-            uint64_t timestamp = lexical_cast<uint64_t>(line_cols[0]);
-            if (timestamp < numeric_limits<int64_t>::max()) {
-              end_simulation_time = max(end_simulation_time, timestamp);
-            }
-            task_id.job_id_ = lexical_cast<uint64_t>(line_cols[2]);
-            task_id.task_index_ = lexical_cast<uint64_t>(line_cols[3]);
-            int32_t event_type = lexical_cast<int32_t>(line_cols[5]);
-            ExpandTaskEvent(timestamp, task_id, event_type, &tasks_runtime,
-                            &job_id_to_name, line_cols);
+      while (reader.NextRow()) {
+        if (reader.num_fields() != 13) {
+          LOG(ERROR) << "Unexpected structure of task event on line "
+                     << reader.line_number() << ": found "
+                     << reader.num_fields() << " columns.";
+        } else {
+          TaskIdentifier task_id;
+          uint64_t timestamp = reader.GetUInt64(0);
+          if (timestamp < numeric_limits<int64_t>::max()) {
+            end_simulation_time = max(end_simulation_time, timestamp);
           }
+          task_id.job_id_ = reader.GetUInt64(2);
+          task_id.task_index_ = reader.GetUInt64(3);
+          int32_t event_type = static_cast<int32_t>(reader.GetInt64(5));
+          ExpandTaskEvent(timestamp, task_id, event_type, &tasks_runtime,
+                          &job_id_to_name, reader);
         }
-        num_line++;
       }
-      fclose(events_file);
     }
 
     for (auto& task_id_runtime : tasks_runtime) {
@@ -765,6 +716,9 @@ namespace sim {
     if (FLAGS_aggregate_task_usage) {
       AggregateTaskUsage();
     }
+    if (FLAGS_binary_trace) {
+      WriteBinaryTrace();
+    }
   }
 
   void GoogleTraceTaskProcessor::UpdateStats(double task_usage,
@@ -888,5 +842,187 @@ namespace sim {
     }
   }
 
+  void GoogleTraceTaskProcessor::WriteBinaryJobsNumTasks() {
+    CSVReader reader;
+    if (!reader.Open(trace_path_ + "/jobs_num_tasks/jobs_num_tasks.csv")) {
+      LOG(FATAL) << "Failed to open jobs num tasks file.";
+    }
+    BinaryTableWriter<TraceJobNumTasks> writer(
+        BinaryTraceFileName(trace_path_, "jobs_num_tasks"));
+    while (reader.NextRow()) {
+      if (reader.num_fields() != 2) {
+        LOG(ERROR) << "Unexpected structure of jobs num tasks row on line: "
+                   << reader.line_number();
+        continue;
+      }
+      TraceJobNumTasks job_num_tasks;
+      job_num_tasks.job_id_ = reader.GetUInt64(0);
+      job_num_tasks.num_tasks_ = reader.GetUInt64(1);
+      writer.Append(job_num_tasks);
+    }
+    writer.Close();
+  }
+
+  void GoogleTraceTaskProcessor::WriteBinaryMachineEvents() {
+    CSVReader reader;
+    if (!reader.Open(trace_path_ +
+                     "/machine_events/part-00000-of-00001.csv")) {
+      LOG(FATAL) << "Failed to open trace for reading machine events.";
+    }
+    BinaryTableWriter<TraceMachineEvent> writer(
+        BinaryTraceFileName(trace_path_, "machine_events"));
+    while (reader.NextRow()) {
+      if (reader.num_fields() != 6) {
+        LOG(ERROR) << "Unexpected structure of machine events on line "
+                   << reader.line_number() << ": found "
+                   << reader.num_fields() << " columns.";
+        continue;
+      }
+      TraceMachineEvent machine_event;
+      machine_event.timestamp_ = reader.GetUInt64(0);
+      machine_event.machine_id_ = reader.GetUInt64(1);
+      machine_event.event_type_ = static_cast<int32_t>(reader.GetInt64(2));
+      machine_event.padding_ = 0;
+      writer.Append(machine_event);
+    }
+    writer.Close();
+  }
+
+  void GoogleTraceTaskProcessor::WriteBinaryTaskEvents() {
+    string binary_task_events_directory;
+    spf(&binary_task_events_directory, "%s/binary/task_events",
+        trace_path_.c_str());
+    MkdirIfNotPresent(binary_task_events_directory);
+    // Tasks for which we've already kept an event.
+    unordered_set<TaskIdentifier, TaskIdentifierHasher> seen_tasks;
+    vector<TraceTaskEvent> task_events;
+    CSVReader reader;
+    for (int32_t file_num = 0; file_num < FLAGS_num_files_to_process;
+         file_num++) {
+      LOG(INFO) << "Converting task_events file " << file_num;
+      string file_name;
+      spf(&file_name, "%s/task_events/part-%05d-of-00500.csv",
+          trace_path_.c_str(), file_num);
+      if (!reader.Open(file_name)) {
+        LOG(FATAL) << "Failed to open trace for reading of task events.";
+      }
+      task_events.clear();
+      while (reader.NextRow()) {
+        if (reader.num_fields() != 13) {
+          LOG(ERROR) << "Unexpected structure of task event on line "
+                     << reader.line_number() << ": found "
+                     << reader.num_fields() << " columns.";
+          continue;
+        }
+        TraceTaskEvent task_event;
+        memset(&task_event, 0, sizeof(task_event));
+        task_event.timestamp_ = reader.GetUInt64(0);
+        task_event.job_id_ = reader.GetUInt64(2);
+        task_event.task_index_ = reader.GetUInt64(3);
+        task_event.event_type_ = static_cast<uint32_t>(reader.GetUInt64(5));
+        TaskIdentifier task_id;
+        task_id.job_id_ = task_event.job_id_;
+        task_id.task_index_ = task_event.task_index_;
+        // The simulator uses the first event of a task to account for the
+        // tasks it filters out, and otherwise only uses the submit events.
+        bool first_event = seen_tasks.insert(task_id).second;
+        if (task_event.event_type_ != TASK_SUBMIT) {
+          if (first_event) {
+            task_events.push_back(task_event);
+          }
+          continue;
+        }
+        task_event.scheduling_class_ =
+          static_cast<uint32_t>(reader.GetUInt64(7));
+        task_event.priority_ = static_cast<uint32_t>(reader.GetUInt64(8));
+        double request = 0;
+        if (reader.ParseDouble(9, &request)) {
+          task_event.cpu_request_ = static_cast<float>(request);
+          task_event.fields_set_ |= kTraceCpuRequestSet;
+        }
+        if (reader.ParseDouble(10, &task_event.ram_request_)) {
+          task_event.fields_set_ |= kTraceRamRequestSet;
+        }
+        task_events.push_back(task_event);
+      }
+      // The events are mostly sorted already. The sort is stable in order to
+      // keep the relative order of the events that have the same timestamp.
+      stable_sort(task_events.begin(), task_events.end(),
+                  TraceTaskEventTimestampLess);
+      BinaryTaskEventsWriter writer(
+          BinaryTaskEventsFileName(trace_path_, file_num));
+      for (auto& task_event : task_events) {
+        writer.Append(task_event);
+      }
+      writer.Close();
+    }
+  }
+
+  void GoogleTraceTaskProcessor::WriteBinaryTaskRuntimes() {
+    CSVReader reader;
+    if (!reader.Open(trace_path_ +
+                     "/task_runtime_events/task_runtime_events.csv")) {
+      LOG(FATAL) << "Failed to open trace runtime events file.";
+    }
+    BinaryTableWriter<TraceTaskRuntime> writer(
+        BinaryTraceFileName(trace_path_, "task_runtime_events"));
+    while (reader.NextRow()) {
+      if (reader.num_fields() != 13) {
+        LOG(ERROR) << "Unexpected structure of task runtime row on line: "
+                   << reader.line_number();
+        continue;
+      }
+      TraceTaskRuntime task_runtime;
+      task_runtime.job_id_ = reader.GetUInt64(0);
+      task_runtime.task_index_ = reader.GetUInt64(1);
+      task_runtime.runtime_ = reader.GetUInt64(4);
+      writer.Append(task_runtime);
+    }
+    writer.Close();
+  }
+
+  void GoogleTraceTaskProcessor::WriteBinaryTaskUsage() {
+    CSVReader reader;
+    if (!reader.Open(trace_path_ + "/task_usage_stat/task_usage_stat.csv")) {
+      LOG(FATAL) << "Failed to open trace task runtime stats file.";
+    }
+    BinaryTableWriter<TraceTaskUsage> writer(
+        BinaryTraceFileName(trace_path_, "task_usage_stat"));
+    while (reader.NextRow()) {
+      if (reader.num_fields() != 38) {
+        LOG(WARNING) << "Malformed task usage, " << reader.num_fields()
+                     << " != 38 columns at line " << reader.line_number();
+        continue;
+      }
+      // Only the averages are used by the simulator.
+      TraceTaskUsage task_usage;
+      task_usage.job_id_ = reader.GetUInt64(0);
+      task_usage.task_index_ = reader.GetUInt64(1);
+      task_usage.avg_mean_cpu_usage_ = reader.GetDouble(4);
+      task_usage.avg_canonical_mem_usage_ = reader.GetDouble(8);
+      task_usage.avg_assigned_mem_usage_ = reader.GetDouble(12);
+      task_usage.avg_unmapped_page_cache_ = reader.GetDouble(16);
+      task_usage.avg_total_page_cache_ = reader.GetDouble(20);
+      task_usage.avg_mean_disk_io_time_ = reader.GetDouble(24);
+      task_usage.avg_mean_local_disk_used_ = reader.GetDouble(28);
+      task_usage.avg_cpi_ = reader.GetDouble(32);
+      task_usage.avg_mai_ = reader.GetDouble(36);
+      writer.Append(task_usage);
+    }
+    writer.Close();
+  }
+
+  void GoogleTraceTaskProcessor::WriteBinaryTrace() {
+    string binary_directory;
+    spf(&binary_directory, "%s/binary", trace_path_.c_str());
+    MkdirIfNotPresent(binary_directory);
+    LOG(INFO) << "Writing the binary trace to " << binary_directory;
+    WriteBinaryMachineEvents();
+    WriteBinaryJobsNumTasks();
+    WriteBinaryTaskRuntimes();
+    WriteBinaryTaskUsage();
+    WriteBinaryTaskEvents();
+  }
+
 } // namespace sim
 } // namespace firmament
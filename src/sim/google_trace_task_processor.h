@@ -9,6 +9,9 @@
 #include <unordered_set>
 #include <vector>
 
+#include "sim/binary_trace.h"
+#include "sim/csv_reader.h"
+
 using namespace std; // NOLINT
 
 namespace firmament {
@@ -129,17 +132,24 @@ class GoogleTraceTaskProcessor {
 
   void Run();
 
+  /**
+   * Convert the files the simulator loads to the binary trace format. The
+   * task events are reduced to the submit events and to the first event of
+   * every task, which are the only events the simulator uses.
+   */
+  void WriteBinaryTrace();
+
  private:
-  TaskResourceUsage BuildTaskResourceUsage(vector<string>& line_cols); // NOLINT
+  TaskResourceUsage BuildTaskResourceUsage(const CSVReader& reader);
   void ExpandTaskEvent(
       uint64_t timestamp, const TaskIdentifier& task_id, int32_t event_type,
       unordered_map<TaskIdentifier, TaskRuntime,
                     TaskIdentifierHasher>* tasks_runtime,
       unordered_map<uint64_t, string>* job_id_to_name,
-      vector<string>& line_cols); // NOLINT
+      const CSVReader& reader);
   void InitializeResourceUsageStats(TaskResourceUsageStats* usage_stats);
   void PopulateTaskRuntime(TaskRuntime* task_runtime_ptr,
-                           vector<string>& cols); // NOLINT
+                           const CSVReader& reader);
   void PrintStats(FILE* usage_stat_file, const TaskIdentifier& task_id,
                   const TaskResourceUsageStats& task_resource);
   void PrintTaskRuntime(FILE* out_events_file, const TaskRuntime& task_runtime,
@@ -159,6 +169,11 @@ class GoogleTraceTaskProcessor {
                    uint32_t* num_usage);
   void UpdateUsageStats(const TaskResourceUsage& task_resource_usage,
                         TaskResourceUsageStats* usage_stats);
+  void WriteBinaryJobsNumTasks();
+  void WriteBinaryMachineEvents();
+  void WriteBinaryTaskEvents();
+  void WriteBinaryTaskRuntimes();
+  void WriteBinaryTaskUsage();
 
   string trace_path_;
 };
@@ -0,0 +1,216 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+
+#include "sim/simulation_sweep.h"
+
+#include <errno.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+#include <cstdio>
+#include <fstream>
+
+#include "misc/map-util.h"
+#include "misc/string_utils.h"
+#include "misc/utils.h"
+
+DEFINE_string(sweep_configurations, "",
+              "File that lists the configurations of a parameter sweep, one "
+              "per line. Each line contains flags, e.g. "
+              "-flow_scheduling_cost_model=6 -preemption. The trace is loaded "
+              "once and the configurations are simulated in parallel. The "
+              "configurations must not change the flags that affect how the "
+              "trace is loaded.");
+DEFINE_string(sweep_output_dir, "/tmp/firmament-sweep",
+              "Directory in which the output of each sweep configuration is "
+              "written.");
+DEFINE_int32(sweep_parallelism, 0,
+             "Maximum number of configurations to simulate in parallel. If "
+             "set to 0, one configuration is simulated per core.");
+
+DECLARE_string(debug_output_dir);
+DECLARE_bool(generate_trace);
+DECLARE_string(generated_trace_path);
+
+using boost::algorithm::is_any_of;
+using boost::token_compress_on;
+
+namespace firmament {
+namespace sim {
+
+SimulationSweep::SimulationSweep() {
+  simulator_ = new Simulator();
+}
+
+SimulationSweep::~SimulationSweep() {
+  delete simulator_;
+}
+
+void SimulationSweep::ApplyConfiguration(const string& configuration) {
+  vector<pair<string, string>> flags;
+  ParseConfiguration(configuration, &flags);
+  for (auto& name_value : flags) {
+    if (google::SetCommandLineOption(name_value.first.c_str(),
+                                     name_value.second.c_str()).empty()) {
+      LOG(FATAL) << "Could not set flag " << name_value.first << " to "
+                 << name_value.second << " in sweep configuration "
+                 << configuration;
+    }
+  }
+}
+
+void SimulationSweep::ParseConfiguration(
+    const string& configuration,
+    vector<pair<string, string>>* flags) {
+  vector<string> tokens;
+  boost::split(tokens, configuration, is_any_of(" \t"), token_compress_on);
+  for (auto& token : tokens) {
+    if (token.empty()) {
+      continue;
+    }
+    // As on the command line, a flag starts with one or two dashes.
+    size_t name_pos = token.find_first_not_of('-');
+    if (name_pos == 0 || name_pos > 2 || name_pos == string::npos ||
+        token[name_pos] == '=') {
+      LOG(FATAL) << "Malformed flag \"" << token << "\" in sweep "
+                 << "configuration " << configuration << ": expected "
+                 << "-name, -name=value or -noname";
+    }
+    string name = token.substr(name_pos);
+    string value;
+    size_t equals_pos = name.find('=');
+    bool has_value = equals_pos != string::npos;
+    if (has_value) {
+      value = name.substr(equals_pos + 1);
+      name = name.substr(0, equals_pos);
+    }
+    google::CommandLineFlagInfo flag_info;
+    if (google::GetCommandLineFlagInfo(name.c_str(), &flag_info)) {
+      if (!has_value) {
+        // Only boolean flags can be given without a value.
+        if (flag_info.type != "bool") {
+          LOG(FATAL) << "Flag " << name << " in sweep configuration "
+                     << configuration << " needs a value";
+        }
+        value = "true";
+      }
+    } else if (!has_value && name.compare(0, 2, "no") == 0 &&
+               google::GetCommandLineFlagInfo(name.substr(2).c_str(),
+                                              &flag_info) &&
+               flag_info.type == "bool") {
+      // -noname sets the boolean flag name to false.
+      name = name.substr(2);
+      value = "false";
+    } else {
+      LOG(FATAL) << "Unknown flag " << name << " in sweep configuration "
+                 << configuration;
+    }
+    flags->push_back(make_pair(name, value));
+  }
+}
+
+void SimulationSweep::ReadConfigurations() {
+  std::ifstream configurations_file(FLAGS_sweep_configurations.c_str());
+  if (!configurations_file.is_open()) {
+    LOG(FATAL) << "Could not open sweep configurations file "
+               << FLAGS_sweep_configurations;
+  }
+  string line;
+  while (getline(configurations_file, line)) {
+    boost::trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    // Check the flags now, rather than in the forked processes.
+    vector<pair<string, string>> flags;
+    ParseConfiguration(line, &flags);
+    configurations_.push_back(line);
+  }
+  CHECK(!configurations_.empty()) << "The sweep has no configurations";
+}
+
+uint32_t SimulationSweep::Run() {
+  ReadConfigurations();
+  MkdirIfNotPresent(FLAGS_sweep_output_dir);
+  uint32_t parallelism = FLAGS_sweep_parallelism;
+  if (parallelism == 0) {
+    parallelism = max(boost::thread::hardware_concurrency(), 1U);
+  }
+  LOG(INFO) << "Loading the trace for " << configurations_.size()
+            << " sweep configurations";
+  simulator_->LoadTrace();
+  uint32_t num_failed = 0;
+  for (uint32_t index = 0; index < configurations_.size(); ++index) {
+    if (running_configurations_.size() == parallelism &&
+        !WaitForConfiguration()) {
+      num_failed++;
+    }
+    // Flush the buffers so that the forked process doesn't output them again.
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+      PLOG(FATAL) << "Failed to fork the simulation of sweep configuration "
+                  << index;
+    } else if (pid == 0) {
+      RunConfiguration(index);
+    }
+    LOG(INFO) << "Simulating sweep configuration " << index << " ("
+              << configurations_[index] << ") in process " << pid;
+    CHECK(InsertIfNotPresent(&running_configurations_, pid, index));
+  }
+  while (!running_configurations_.empty()) {
+    if (!WaitForConfiguration()) {
+      num_failed++;
+    }
+  }
+  return num_failed;
+}
+
+void SimulationSweep::RunConfiguration(uint32_t index) {
+  string output_dir;
+  spf(&output_dir, "%s/config_%u", FLAGS_sweep_output_dir.c_str(), index);
+  MkdirIfNotPresent(output_dir);
+  ApplyConfiguration(configurations_[index]);
+  FLAGS_debug_output_dir = output_dir + "/debug";
+  if (FLAGS_generate_trace) {
+    FLAGS_generated_trace_path = output_dir + "/trace";
+  }
+  // Record the configuration alongside its output.
+  FILE* configuration_file =
+    fopen((output_dir + "/configuration").c_str(), "w");
+  CHECK_NOTNULL(configuration_file);
+  fprintf(configuration_file, "%s\n", configurations_[index].c_str());
+  fclose(configuration_file);
+  simulator_->Run();
+  // The simulator must be deleted in order to flush its output.
+  delete simulator_;
+  simulator_ = NULL;
+  exit(0);
+}
+
+bool SimulationSweep::WaitForConfiguration() {
+  int status;
+  pid_t pid;
+  while ((pid = wait(&status)) < 0 && errno == EINTR) {
+  }
+  if (pid < 0) {
+    PLOG(FATAL) << "Failed to wait for the sweep simulations";
+  }
+  uint32_t* index = FindOrNull(running_configurations_, pid);
+  CHECK_NOTNULL(index);
+  bool succeeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (succeeded) {
+    LOG(INFO) << "Sweep configuration " << *index << " completed";
+  } else {
+    LOG(ERROR) << "Sweep configuration " << *index << " ("
+               << configurations_[*index] << ") failed with status "
+               << status;
+  }
+  running_configurations_.erase(pid);
+  return succeeded;
+}
+
+}  // namespace sim
+}  // namespace firmament
@@ -0,0 +1,71 @@
+// The Firmament project
+// Copyright (c) 2016 Ionel Gog <ionel.gog@cl.cam.ac.uk>
+//
+// Driver for parameter sweeps over the simulator's configuration. The trace is
+// loaded once, and every configuration is then simulated in a process forked
+// from the loading process. The forked processes share the loaded trace data
+// copy-on-write, and run in parallel.
+
+#ifndef FIRMAMENT_SIM_SIMULATION_SWEEP_H
+#define FIRMAMENT_SIM_SIMULATION_SWEEP_H
+
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/common.h"
+#include "sim/simulator.h"
+
+namespace firmament {
+namespace sim {
+
+class SimulationSweep {
+ public:
+  SimulationSweep();
+  ~SimulationSweep();
+
+  /**
+   * Loads the trace and simulates all the configurations.
+   * @return the number of configurations whose simulation failed
+   */
+  uint32_t Run();
+
+ private:
+  /**
+   * Sets the flags of a configuration. A configuration is a list of
+   * whitespace-separated flags, e.g. "-flow_scheduling_cost_model=6
+   * -preemption".
+   */
+  void ApplyConfiguration(const string& configuration);
+  /**
+   * Splits a configuration into the names and values of its flags. Boolean
+   * flags may be given without a value, or as -noname to set them to false.
+   * Malformed and unknown flags are fatal errors.
+   */
+  void ParseConfiguration(const string& configuration,
+                          vector<pair<string, string>>* flags);
+  void ReadConfigurations();
+  /**
+   * Simulates a configuration. It is called in the forked process, and it
+   * does not return.
+   */
+  void RunConfiguration(uint32_t index);
+  /**
+   * Waits for one of the running simulations to exit.
+   * @return true if the simulation succeeded
+   */
+  bool WaitForConfiguration();
+
+  Simulator* simulator_;
+  vector<string> configurations_;
+  // The simulations that are running, indexed by process id.
+  map<pid_t, uint32_t> running_configurations_;
+};
+
+}  // namespace sim
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SIM_SIMULATION_SWEEP_H
@@ -29,7 +29,7 @@ using boost::algorithm::is_any_of;
 using boost::token_compress_off;
 
 DEFINE_string(solver, "flowlessly",
-              "Solver to use: flowlessly | cs2 | custom.");
+              "Solver to use: flowlessly | cs2 | inprocess | custom.");
 DEFINE_bool(run_incremental_scheduler, false,
             "Run the Flowlessly incremental scheduler.");
 DEFINE_string(simulation, "google",
@@ -46,8 +46,8 @@ DECLARE_string(solver_runtime_accounting_mode);
 
 static bool ValidateSolver(const char* flagname, const string& solver) {
   if (solver.compare("cs2") && solver.compare("flowlessly") &&
-      solver.compare("custom")) {
-    LOG(ERROR) << "Solver can be one of: cs2, flowlessly or custom";
+      solver.compare("inprocess") && solver.compare("custom")) {
+    LOG(ERROR) << "Solver can be one of: cs2, flowlessly, inprocess or custom";
     return false;
   }
   return true;
@@ -82,27 +82,35 @@ static const bool simulation_validator =
 namespace firmament {
 namespace sim {
 
-Simulator::Simulator() {
+Simulator::Simulator() : bridge_(NULL), trace_loader_(NULL) {
   event_manager_ = new EventManager(&simulated_time_);
-  bridge_ = new SimulatorBridge(event_manager_, &simulated_time_);
   scheduler_run_cnt_ = 0;
 }
 
 Simulator::~Simulator() {
-  delete bridge_;
+  if (bridge_) {
+    delete bridge_;
+  }
+  if (trace_loader_) {
+    delete trace_loader_;
+  }
   delete event_manager_;
 }
 
-void Simulator::ReplaySimulation() {
+void Simulator::LoadTrace() {
   // Load the trace ingredients
-  TraceLoader* trace_loader = NULL;
+  CHECK(trace_loader_ == NULL) << "The trace has already been loaded";
   if (!FLAGS_simulation.compare("google")) {
-    trace_loader = new GoogleTraceLoader(event_manager_);
+    trace_loader_ = new GoogleTraceLoader(event_manager_);
   } else if (!FLAGS_simulation.compare("synthetic")) {
-    trace_loader = new SyntheticTraceLoader(event_manager_);
+    trace_loader_ = new SyntheticTraceLoader(event_manager_);
   }
-  CHECK_NOTNULL(trace_loader);
-  bridge_->LoadTraceData(trace_loader);
+  CHECK_NOTNULL(trace_loader_);
+  trace_loader_->LoadTraceData(&trace_data_);
+}
+
+void Simulator::ReplaySimulation() {
+  bridge_->LoadTraceData(&trace_data_);
 
   uint64_t run_scheduler_at = 0;
   uint64_t current_heartbeat_time = 0;
@@ -122,8 +130,8 @@ void Simulator::ReplaySimulation() {
     // (via OnSchedulingDecisionsCompletion) after it decides where to place
     // tasks.
     bool loaded_events =
-      trace_loader->LoadTaskEvents(run_scheduler_at + FLAGS_max_solver_runtime,
-                                   bridge_->job_num_tasks());
+      trace_loader_->LoadTaskEvents(run_scheduler_at + FLAGS_max_solver_runtime,
+                                    bridge_->job_num_tasks());
     // Add the machine heartbeat events up to the next scheduler run.
     for (; run_scheduler_at >= current_heartbeat_time;
          current_heartbeat_time += FLAGS_heartbeat_interval) {
@@ -150,7 +158,6 @@ void Simulator::ReplaySimulation() {
       break;
     }
   }
-  delete trace_loader;
 }
 
 void Simulator::Run() {
@@ -164,8 +171,18 @@ void Simulator::Run() {
     FLAGS_incremental_flow = false;
     FLAGS_only_read_assignment_changes = false;
     FLAGS_flow_scheduling_binary = SOLVER_DIR "/cs2/src/cs2/cs2.exe";
+  } else if (!FLAGS_solver.compare("inprocess")) {
+    // The in-process solver always reads the entire flow graph.
+    FLAGS_incremental_flow = false;
+    FLAGS_only_read_assignment_changes = false;
   } else if (!FLAGS_solver.compare("custom")) {
   }
+  if (!trace_loader_) {
+    LoadTrace();
+  }
+  // The bridge is created after the solver flags have been set because the
+  // scheduler it creates depends on them.
+  bridge_ = new SimulatorBridge(event_manager_, &simulated_time_);
 
   LOG(INFO) << "Starting Google trace simulator!";
   ReplaySimulation();
@@ -17,6 +17,7 @@
 #include "sim/event_manager.h"
 #include "sim/simulated_wall_time.h"
 #include "sim/simulator_bridge.h"
+#include "sim/trace_loader.h"
 #include "sim/trace_utils.h"
 
 DECLARE_string(flow_scheduling_binary);
@@ -30,6 +31,12 @@ class Simulator {
  public:
   explicit Simulator();
   virtual ~Simulator();
+
+  /**
+   * Loads the trace data that does not depend on the scheduler configuration.
+   * Run calls it if the trace has not been loaded yet.
+   */
+  void LoadTrace();
   void Run();
   static void SchedulerTimeoutHandler(int sig);
 
@@ -46,6 +53,8 @@ class Simulator {
 
   SimulatorBridge* bridge_;
   EventManager* event_manager_;
+  TraceLoader* trace_loader_;
+  TraceData trace_data_;
   SimulatedWallTime simulated_time_;
   uint64_t scheduler_run_cnt_;
 };
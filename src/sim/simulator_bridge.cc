@@ -332,50 +332,53 @@ TaskDescriptor* SimulatorBridge::AddTaskToJob(
   return new_task;
 }
 
-void SimulatorBridge::LoadTraceData(TraceLoader* trace_loader) {
-  // Load all the machine events.
-  multimap<uint64_t, EventDescriptor> machine_events;
-  trace_loader->LoadMachineEvents(&machine_events);
-  for (auto& machine_event : machine_events) {
+void SimulatorBridge::LoadTraceData(TraceData* trace_data) {
+  // Add all the machine events.
+  for (auto& machine_event : trace_data->machine_events_) {
     event_manager_->AddEvent(machine_event.first, machine_event.second);
   }
+  trace_data->machine_events_.clear();
   // Populate the job_id to number of tasks mapping.
-  trace_loader->LoadJobsNumTasks(&job_num_tasks_);
-  trace_loader->LoadJobsNumTasks(&immutable_job_num_tasks_);
-  // Load tasks' runtime.
-  trace_loader->LoadTasksRunningTime(&task_runtime_);
+  immutable_job_num_tasks_ = trace_data->job_num_tasks_;
+  job_num_tasks_.swap(trace_data->job_num_tasks_);
+  // Tasks' runtime.
+  task_runtime_.swap(trace_data->task_runtime_);
   // Populate the knowledge base.
-  trace_loader->LoadTaskUtilizationStats(&task_id_to_stats_);
+  task_id_to_stats_.swap(trace_data->task_id_to_stats_);
 }
 
 void SimulatorBridge::ProcessSimulatorEvents(uint64_t events_up_to_time) {
+  EventDescriptor event;
   while (true) {
-    if (event_manager_->GetTimeOfNextEvent() > events_up_to_time) {
+    uint64_t timestamp = event_manager_->GetTimeOfNextEvent();
+    if (timestamp > events_up_to_time) {
       // Processed all events <= events_up_to_time.
       break;
     }
-    pair<uint64_t, EventDescriptor> event = event_manager_->GetNextEvent();
-    if (event.second.type() == EventDescriptor::ADD_MACHINE) {
-      AddMachine(event.second.machine_id());
-    } else if (event.second.type() == EventDescriptor::REMOVE_MACHINE) {
-      RemoveMachine(event.second.machine_id());
-    } else if (event.second.type() == EventDescriptor::UPDATE_MACHINE) {
-      // TODO(ionel): Handle machine update event.
-    } else if (event.second.type() == EventDescriptor::TASK_END_RUNTIME) {
-      TraceTaskIdentifier task_identifier;
-      task_identifier.task_index = event.second.task_index();
-      task_identifier.job_id = event.second.job_id();
-      TaskCompleted(task_identifier);
-    } else if (event.second.type() == EventDescriptor::MACHINE_HEARTBEAT) {
-      AddMachineSamples(event.first);
-    } else if (event.second.type() == EventDescriptor::TASK_SUBMIT) {
-      TraceTaskIdentifier task_identifier;
-      task_identifier.task_index = event.second.task_index();
-      task_identifier.job_id = event.second.job_id();
-      AddTask(task_identifier, event.second);
-    } else {
-      LOG(FATAL) << "Unexpected event type " << event.second.type() << " @ "
-                 << event.first;
+    // Process the batch of events that happen at timestamp.
+    while (event_manager_->GetNextEventAt(timestamp, &event)) {
+      if (event.type() == EventDescriptor::ADD_MACHINE) {
+        AddMachine(event.machine_id());
+      } else if (event.type() == EventDescriptor::REMOVE_MACHINE) {
+        RemoveMachine(event.machine_id());
+      } else if (event.type() == EventDescriptor::UPDATE_MACHINE) {
+        // TODO(ionel): Handle machine update event.
+      } else if (event.type() == EventDescriptor::TASK_END_RUNTIME) {
+        TraceTaskIdentifier task_identifier;
+        task_identifier.task_index = event.task_index();
+        task_identifier.job_id = event.job_id();
+        TaskCompleted(task_identifier);
+      } else if (event.type() == EventDescriptor::MACHINE_HEARTBEAT) {
+        AddMachineSamples(timestamp);
+      } else if (event.type() == EventDescriptor::TASK_SUBMIT) {
+        TraceTaskIdentifier task_identifier;
+        task_identifier.task_index = event.task_index();
+        task_identifier.job_id = event.job_id();
+        AddTask(task_identifier, event);
+      } else {
+        LOG(FATAL) << "Unexpected event type " << event.type() << " @ "
+                   << timestamp;
+      }
     }
   }
 }
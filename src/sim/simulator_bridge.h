@@ -59,7 +59,11 @@ class SimulatorBridge : public scheduler::SchedulingEventNotifierInterface {
   bool AddTask(const TraceTaskIdentifier& task_identifier,
                const EventDescriptor& event_desc);
 
-  void LoadTraceData(TraceLoader* trace_loader);
+  /**
+   * Takes over the trace data loaded before the simulation. The tables are
+   * swapped in rather than copied, and the trace data is left empty.
+   */
+  void LoadTraceData(TraceData* trace_data);
 
   /**
    * Event called by the event driven scheduler upon job completion.
@@ -3,13 +3,20 @@
 //
 
 #include "base/common.h"
+#include "sim/simulation_sweep.h"
 #include "sim/simulator.h"
 
+DECLARE_string(sweep_configurations);
+
 using namespace firmament;  // NOLINT
 
 int main(int argc, char *argv[]) {
   VLOG(1) << "Calling common::InitFirmament";
   common::InitFirmament(argc, argv);
+  if (!FLAGS_sweep_configurations.empty()) {
+    sim::SimulationSweep sweep;
+    return sweep.Run() > 0 ? 1 : 0;
+  }
   //HeapProfilerStart("ts");
   sim::Simulator simulator;
   //HeapProfilerStop();
@@ -13,6 +13,16 @@
 namespace firmament {
 namespace sim {
 
+// The trace data that is loaded before the simulation starts. The data does
+// not depend on the scheduler configuration, which makes it possible to load
+// it once and share it across the simulations of a parameter sweep.
+struct TraceData {
+  multimap<uint64_t, EventDescriptor> machine_events_;
+  unordered_map<uint64_t, uint64_t> job_num_tasks_;
+  unordered_map<TaskID_t, uint64_t> task_runtime_;
+  unordered_map<TaskID_t, TraceTaskStats> task_id_to_stats_;
+};
+
 class TraceLoader {
  public:
   TraceLoader(EventManager* event_manager) : event_manager_(event_manager) {
@@ -52,6 +62,17 @@ class TraceLoader {
   virtual void LoadTasksRunningTime(
       unordered_map<TaskID_t, uint64_t>* task_runtime) = 0;
 
+  /**
+   * Loads all the trace data except for the task events, which are loaded
+   * while the simulation runs.
+   */
+  void LoadTraceData(TraceData* trace_data) {
+    LoadMachineEvents(&trace_data->machine_events_);
+    LoadJobsNumTasks(&trace_data->job_num_tasks_);
+    LoadTasksRunningTime(&trace_data->task_runtime_);
+    LoadTaskUtilizationStats(&trace_data->task_id_to_stats_);
+  }
+
  protected:
   EventManager* event_manager_;
 };